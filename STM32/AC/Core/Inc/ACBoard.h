@@ -24,8 +24,14 @@
 /* Is on if user requests more than 10 seconds on time for a port until next request */
 #define AC_LIMIT_ON_TIME_STATUS_Msk  (1UL << 6UL)              
 
+/* Each of the 4 AC ports (x = 1-4) is on when the port is commanded on but draws no current (e.g.
+** open heater element), or is commanded off but still draws current (e.g. welded relay) */
+#define AC_PORT_x_NO_CURRENT_Msk(x)   (1UL << (6UL + (x)))
+#define AC_PORT_x_OFF_CURRENT_Msk(x)  (1UL << (10UL + (x)))
+#define AC_PORTS_CURRENT_ERROR_Msk    (((1UL << 8UL) - 1UL) << 7UL)
+
 /* Define showing which bits are "errors" and which are only for information */
-#define AC_BOARD_No_Error_Msk         (BS_SYSTEM_ERRORS_Msk | AC_POWER_ERROR_Msk)
+#define AC_BOARD_No_Error_Msk         (BS_SYSTEM_ERRORS_Msk | AC_POWER_ERROR_Msk | AC_PORTS_CURRENT_ERROR_Msk)
 
 /* Common definitions for AC Board */
 #define AC_BOARD_NUM_PORTS            4
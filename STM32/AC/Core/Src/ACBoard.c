@@ -24,6 +24,8 @@
 #include "pcbversion.h"
 #include "flashHandler.h"
 #include "CAProtocolACDC.h"
+#include "portCurrent.h"
+#include "ADCWatchdog.h"
 
 /***************************************************************************************************
 ** DEFINES
@@ -31,14 +33,26 @@
 
 #define ADC_CHANNELS                8   // 4 current + 4 temperature
 #define ADC_CHANNEL_BUF_SIZE      400
+#define ADC_SAMPLES_PER_MS          4   // ADC is triggered by TIM2 at 4 kHz
 #define NUM_CURRENT_CHANNELS        4
 #define NUM_TEMP_CHANNELS           4
 
 #define MAX_TEMPERATURE            70
+#define HEATSINK_TRIP_TEMPERATURE  80 // Heaters are cut off immediately (within ~1 ms) above this
+#define HEATSINK_TRIP_DEBOUNCE      4 // Consecutive samples above the trip temperature (1 ms)
 #define MAX_ON_TIME_REQUEST        10 // seconds
 
 #define USB_COMMS_TIMEOUT_MS     5000
 
+/* Conversion of the heat sink temperature sensors */
+#define TEMP_SCALAR           0.0806f
+#define TEMP_BIAS              -50.0f
+
+/* Current thresholds (in A RMS) for detecting a mismatch between commanded and actual port state */
+#define PORT_ON_MIN_CURRENT       0.1
+#define PORT_OFF_MAX_CURRENT      0.1
+#define PORT_MIN_SETTLED_SAMPLES   40 // 10 ms of samples in a state before it is evaluated
+
 /***************************************************************************************************
 ** PRIVATE TYPEDEFS
 ***************************************************************************************************/
@@ -68,6 +82,10 @@ static double ADCtoCurrent(double adc_val);
 static double ADCtoTemperature(double adc_val);
 static void actuatePins(ActuationInfo actuationInfo);
 static void heatSinkLoop(); 
+static uint16_t getPortMask();
+static void updatePortCurrentStatus(int16_t *pData, int noOfChannels, int noOfSamples);
+static int16_t temperatureToADC(double temperature);
+static void heatSinkTrip(int id, int channel, int16_t value);
 
 /***************************************************************************************************
 ** PRIVATE OBJECTS
@@ -86,6 +104,10 @@ static double heatSinkMaxTemp = 0;
 static float isMainsConnected = 0;
 static bool isFanForceOn = false;
 
+static int16_t ADCBuffer[ADC_CHANNELS * ADC_CHANNEL_BUF_SIZE * 2]; // array for all ADC readings, filled by DMA.
+static int16_t currentZeroLevels[NUM_CURRENT_CHANNELS] = {0};
+static int heatSinkWatchIds[NUM_TEMP_CHANNELS];
+
 static ACDCProtocolCtx acProto =
 {
         .allOn = CAallOn,
@@ -138,8 +160,16 @@ static void printAcStatus() {
  * @brief Definition of status definition information when the 'StatusDef' command is received
 */
 static void printAcStatusDef() {
-    static char buf[300] = {0};
+    static char buf[600] = {0};
     int len              = 0;
+    for (int i = AC_BOARD_NUM_PORTS; i > 0; i--) {
+        CA_SNPRINTF(buf, len, "0x%08lx,Port %d off but drawing current\r\n",
+                    AC_PORT_x_OFF_CURRENT_Msk(i), i);
+    }
+    for (int i = AC_BOARD_NUM_PORTS; i > 0; i--) {
+        CA_SNPRINTF(buf, len, "0x%08lx,Port %d on but not drawing current\r\n",
+                    AC_PORT_x_NO_CURRENT_Msk(i), i);
+    }
     CA_SNPRINTF(buf, len, "0x%08lx,Mains not-connected error\r\n", AC_POWER_ERROR_Msk);
     CA_SNPRINTF(buf, len, "0x%08lx,Port 4 switching state\r\n", AC_BOARD_PORT_x_STATUS_Msk(4));
     CA_SNPRINTF(buf, len, "0x%08lx,Port 3 switching state\r\n", AC_BOARD_PORT_x_STATUS_Msk(3));
@@ -195,12 +225,14 @@ static double ADCtoCurrent(double adc_val)
 
 static double ADCtoTemperature(double adc_val)
 {
-    static const float TEMP_SCALAR = 0.0806;
-    static const float TEMP_BIAS = -50.0;
-
     return TEMP_SCALAR * adc_val + TEMP_BIAS;
 }
 
+static int16_t temperatureToADC(double temperature)
+{
+    return (int16_t)((temperature - TEMP_BIAS) / TEMP_SCALAR);
+}
+
 static void computeHeatSinkTemperatures(int16_t *pData)
 {
     double maxTemp = DBL_MIN;
@@ -252,10 +284,14 @@ static void printCurrentArray(int16_t *pData, int noOfChannels, int noOfSamples)
         {
             // finding the average of each channel array to subtract from the readings
             current_calibration[i] = -ADCMean(pData, i);
+            currentZeroLevels[i]   = -current_calibration[i];
         }
         isCalibrationDone = true;
     }
 
+    /* Must be done before the offsets are applied, as it works on the raw samples */
+    updatePortCurrentStatus(pData, noOfChannels, noOfSamples);
+
     // Set bias for each current channel.
     for (int i = 0; i < NUM_CURRENT_CHANNELS; i++)
     {
@@ -370,6 +406,18 @@ static void CAportState(int port, bool state, int percent, int duration)
 */
 static void heatSinkLoop()
 {
+    /* The heaters have already been switched off in the interrupt, make sure they stay off. The
+    ** temperature is known to be at least the trip temperature until the next ADC buffer is ready */
+    for (int i = 0; i < NUM_TEMP_CHANNELS; i++)
+    {
+        if (adcWatchdogIsTripped(heatSinkWatchIds[i]))
+        {
+            allOff();
+            heatSinkMaxTemp = HEATSINK_TRIP_TEMPERATURE;
+            adcWatchdogRearm(heatSinkWatchIds[i]);
+        }
+    }
+
     // Turn on fan if temp > 55 and turn of when temp < 50.
     if (heatSinkMaxTemp <= MAX_TEMPERATURE)
     {
@@ -397,6 +445,64 @@ static void heatSinkLoop()
     setBoardTemp(heatSinkMaxTemp);
 }
 
+/*!
+** @brief Called from the ADC trigger timer interrupt when a heat sink exceeds the trip temperature
+**
+** Only switches the heater outputs off. The rest is handled by heatSinkLoop in the main loop
+*/
+static void heatSinkTrip(int id, int channel, int16_t value)
+{
+    for (int i = 0; i < AC_BOARD_NUM_PORTS; i++)
+    {
+        stmSetGpio(heaterPorts[i].heater, false);
+    }
+}
+
+/*!
+** @brief Returns a bit mask with bit x set if port x is currently commanded on
+*/
+static uint16_t getPortMask()
+{
+    uint16_t mask = 0;
+    for (int i = 0; i < AC_BOARD_NUM_PORTS; i++)
+    {
+        if (stmGetGpio(heaterPorts[i].heater))
+        {
+            mask |= (1U << i);
+        }
+    }
+    return mask;
+}
+
+/*!
+** @brief Compares the commanded state of each port with the current it draws
+**
+** A port which is on but draws no current indicates e.g. an open heater element, and a port which
+** is off but still draws current indicates e.g. a welded relay. A port is only evaluated for a 
+** state if it spent enough time in that state during the last buffer, otherwise the previous 
+** result is kept. Missing current is not flagged when mains is not connected.
+*/
+static void updatePortCurrentStatus(int16_t *pData, int noOfChannels, int noOfSamples)
+{
+    PortCurrentStats stats[NUM_CURRENT_CHANNELS];
+    pcUpdate(pData, noOfChannels, noOfSamples, currentZeroLevels, stats);
+
+    for (int i = 0; i < AC_BOARD_NUM_PORTS; i++)
+    {
+        if (stats[i].onSamples >= PORT_MIN_SETTLED_SAMPLES && pcIsMainsOn(isMainsConnected))
+        {
+            (ADCtoCurrent(stats[i].onRms) < PORT_ON_MIN_CURRENT) ? bsSetError(AC_PORT_x_NO_CURRENT_Msk(i+1)) 
+                                                                 : bsClearField(AC_PORT_x_NO_CURRENT_Msk(i+1));
+        }
+
+        if (stats[i].offSamples >= PORT_MIN_SETTLED_SAMPLES)
+        {
+            (ADCtoCurrent(stats[i].offRms) > PORT_OFF_MAX_CURRENT) ? bsSetError(AC_PORT_x_OFF_CURRENT_Msk(i+1)) 
+                                                                   : bsClearField(AC_PORT_x_OFF_CURRENT_Msk(i+1));
+        }
+    }
+}
+
 /*!
 ** @brief Updates the global error/status object.
 **
@@ -417,7 +523,7 @@ static void updateBoardStatus()
     ** The gpio input is not supposed to change value generally so should be fine to use a large filter
     ** Note: When power is toggled the status code changes within one print cycle */
     isMainsConnected += (stmGetGpio(powerStatus) - isMainsConnected)/FILTER_LEN;
-    (isMainsConnected >= 0.5) ? bsClearField(AC_POWER_ERROR_Msk) : bsSetError(AC_POWER_ERROR_Msk);
+    pcIsMainsOn(isMainsConnected) ? bsClearField(AC_POWER_ERROR_Msk) : bsSetError(AC_POWER_ERROR_Msk);
 
     /* Clear the error mask if there are no error bits set any more. This logic could be done when
     ** the (other) error bits are cleared, but doing here means it only needs to be done once */
@@ -443,11 +549,19 @@ void ACBoardInit(ADC_HandleTypeDef* hadc)
     // Always allow for DFU also if programmed on non-matching board or PCB version.
     initCAProtocol(&caProto, usbRx);
 
-    static int16_t ADCBuffer[ADC_CHANNELS * ADC_CHANNEL_BUF_SIZE * 2]; // array for all ADC readings, filled by DMA.
-
     ADCMonitorInit(hadc, ADCBuffer, sizeof(ADCBuffer)/sizeof(int16_t));
+    pcInit(ADCBuffer, AC_BOARD_NUM_PORTS, ADC_CHANNELS, ADC_CHANNEL_BUF_SIZE, ADC_SAMPLES_PER_MS);
     GpioInit();
 
+    /* Hard over temperature limit on every heat sink sensor, checked on every ADC sample */
+    adcWatchdogInit(ADCBuffer, ADC_CHANNELS, 2 * ADC_CHANNEL_BUF_SIZE);
+    for (int i = 0; i < NUM_TEMP_CHANNELS; i++)
+    {
+        heatSinkWatchIds[i] = adcWatchdogAdd(NUM_CURRENT_CHANNELS + i, INT16_MIN, 
+                                             temperatureToADC(HEATSINK_TRIP_TEMPERATURE),
+                                             HEATSINK_TRIP_DEBOUNCE, heatSinkTrip);
+    }
+
     /* Setup flash handling */
     fhLoadDeposit();
     setLocalFaultInfo(fhGetFaultInfo());
@@ -472,6 +586,7 @@ void ACBoardLoop(const char *bootMsg)
         }
     };
     updateBoardStatus();
+    pcRecordPortStates(getPortMask());
     ADCMonitorLoop(printCurrentArray);
     heatSinkLoop();
 
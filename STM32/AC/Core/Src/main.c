@@ -18,6 +18,8 @@
 /* USER CODE BEGIN Includes */
 #include "CAProtocolStm.h"
 #include "ACBoard.h"
+#include "ADCWatchdog.h"
+#include "portCurrent.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -113,6 +115,7 @@ int main(void)
     {
       HAL_IWDG_Refresh(&hiwdg);
       HAL_WWDG_Refresh(&hwwdg);
+      pcDmaPosition(__HAL_DMA_GET_COUNTER(&hdma_adc1));
       ACBoardLoop(bootMsg);
     /* USER CODE END WHILE */
 
@@ -449,6 +452,16 @@ static void MX_GPIO_Init(void)
 }
 
 /* USER CODE BEGIN 4 */
+/*!
+** @brief Checks the ADC samples written since the last trigger against the ADC watchdog windows
+*/
+void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim)
+{
+  if (htim->Instance == TIM2)
+  {
+    adcWatchdogScan(adcWatchdogDmaIndex(__HAL_DMA_GET_COUNTER(&hdma_adc1)));
+  }
+}
 /* USER CODE END 4 */
 
 /**
@@ -23,8 +23,21 @@
 #define AC_TEN_CH_PORT_x_STATUS_Msk(x) ((uint32_t)(1U << (x)))
 #define AC_TEN_CH_PORTS_STATUS_Msk     ((uint32_t)((1U << 10U) - 1U))
 
+/* Each of the 10 ports is on if the current drawn does not match the commanded port state. Which
+** kind of mismatch is indicated by the two bits below */
+#define AC_TEN_CH_PORT_x_CURRENT_ERROR_Msk(x) ((uint32_t)(1U << (12U + (x))))
+#define AC_TEN_CH_PORTS_CURRENT_ERROR_Msk     ((uint32_t)(((1U << 10U) - 1U) << 12U))
+
+/* Is on if any port is on but draws no current (e.g. open heater element) */
+#define AC_TEN_CH_NO_CURRENT_Msk  ((uint32_t)(1U << 22U))
+
+/* Is on if any port is off but still draws current (e.g. welded relay) */
+#define AC_TEN_CH_OFF_CURRENT_Msk ((uint32_t)(1U << 23U))
+
 /* Define showing which bits are "errors" and which are only for information */
-#define AC_TEN_CH_No_Error_Msk (BS_SYSTEM_ERRORS_Msk | AC_POWER_ERROR_Msk)
+#define AC_TEN_CH_No_Error_Msk                                                              \
+    (BS_SYSTEM_ERRORS_Msk | AC_POWER_ERROR_Msk | AC_TEN_CH_PORTS_CURRENT_ERROR_Msk |        \
+     AC_TEN_CH_NO_CURRENT_Msk | AC_TEN_CH_OFF_CURRENT_Msk)
 
 /* Common definitions for AC 10 Channel */
 #define AC_TEN_CH_NUM_PORTS 10
@@ -21,6 +21,7 @@
 #include "USBprint.h"
 #include "main.h"
 #include "pcbversion.h"
+#include "portCurrent.h"
 #include "systemInfo.h"
 
 /***************************************************************************************************
@@ -29,9 +30,15 @@
 
 #define ADC_CHANNELS         10
 #define ADC_CHANNEL_BUF_SIZE 400
+#define ADC_SAMPLES_PER_MS   4  // ADC is triggered by TIM2 at 4 kHz
 
 #define USB_COMMS_TIMEOUT_MS 5000
 
+/* Current thresholds (in A RMS) for detecting a mismatch between commanded and actual port state */
+#define PORT_ON_MIN_CURRENT      0.1
+#define PORT_OFF_MAX_CURRENT     0.1
+#define PORT_MIN_SETTLED_SAMPLES 40  // 10 ms of samples in a state before it is evaluated
+
 /***************************************************************************************************
 ** PRIVATE TYPEDEFS
 ***************************************************************************************************/
@@ -53,6 +60,8 @@ static void ACTenChannelInputHandler(const char* input);
 static void printAcTenChannelStatus();
 static void printAcTenChannelStatusDef();
 static void updateBoardStatus();
+static uint16_t getPortMask();
+static void updatePortCurrentStatus(int16_t* pData, int noOfChannels, int noOfSamples);
 
 /***************************************************************************************************
 ** PRIVATE OBJECTS
@@ -75,11 +84,19 @@ static CAProtocolCtx caProto = {.undefined        = ACTenChannelInputHandler,
                                 .otpWrite         = NULL};
 
 /* Status printout buffer, shared */
-static char buf[600] = {0};
+static char buf[1000] = {0};
 
 static StmGpio powerStatus;
 static float isMainsConnected = 0;
 
+// array for all ADC readings, filled by DMA.
+static int16_t ADCBuffer[ADC_CHANNELS * ADC_CHANNEL_BUF_SIZE * 2];
+static int16_t currentZeroLevels[ADC_CHANNELS] = {0};
+
+/* Latest result of the port state / current comparison */
+static bool isOnWithoutCurrent[AC_TEN_CH_NUM_PORTS] = {0};
+static bool isOffWithCurrent[AC_TEN_CH_NUM_PORTS]   = {0};
+
 /***************************************************************************************************
 ** PRIVATE FUNCTIONS
 ***************************************************************************************************/
@@ -106,6 +123,14 @@ static void printAcTenChannelStatus() {
 static void printAcTenChannelStatusDef() {
     int len = 0;
 
+    CA_SNPRINTF(buf, len, "0x%08" PRIx32 ",Port off but drawing current\r\n",
+                AC_TEN_CH_OFF_CURRENT_Msk);
+    CA_SNPRINTF(buf, len, "0x%08" PRIx32 ",Port on but not drawing current\r\n",
+                AC_TEN_CH_NO_CURRENT_Msk);
+    for (int i = AC_TEN_CH_NUM_PORTS - 1; i >= 0; i--) {
+        CA_SNPRINTF(buf, len, "0x%08" PRIx32 ",Port %d current mismatch\r\n",
+                    AC_TEN_CH_PORT_x_CURRENT_ERROR_Msk(i), i);
+    }
     CA_SNPRINTF(buf, len, "0x%08" PRIx32 ",Mains not-connected error\r\n", AC_POWER_ERROR_Msk);
     CA_SNPRINTF(buf, len, "0x%08" PRIx32 ",Fan state\r\n", AC_TEN_CH_PORT_x_STATUS_Msk(10));
     for (int i = 0; i < AC_TEN_CH_NUM_PORTS; i++) {
@@ -176,10 +201,14 @@ static void printCurrentArray(int16_t* pData, int noOfChannels, int noOfSamples)
         for (int i = 0; i < noOfChannels; i++) {
             // finding the average of each channel array to subtract from the readings
             current_calibration[i] = -ADCMean(pData, i);
+            currentZeroLevels[i]   = -current_calibration[i];
         }
         isCalibrationDone = true;
     }
 
+    /* Must be done before the offsets are applied, as it works on the raw samples */
+    updatePortCurrentStatus(pData, noOfChannels, noOfSamples);
+
     // Set bias for each ADC channel.
     for (int i = 0; i < noOfChannels; i++) {
         ADCSetOffset(pData, current_calibration[i], i);
@@ -255,6 +284,51 @@ static void CAportState(int port, bool state, int percent, int duration) {
     }
 }
 
+/*!
+** @brief Returns a bit mask with bit x set if port x is currently commanded on
+*/
+static uint16_t getPortMask() {
+    uint16_t mask = 0;
+    for (int i = 0; i < AC_TEN_CH_NUM_PORTS; i++) {
+        if (stmGetGpio(heaterPorts[i])) {
+            mask |= (1U << i);
+        }
+    }
+    return mask;
+}
+
+/*!
+** @brief Compares the commanded state of each port with the current it draws
+**
+** A port which is on but draws no current indicates e.g. an open heater element, and a port which
+** is off but still draws current indicates e.g. a welded relay. A port is only evaluated for a
+** state if it spent enough time in that state during the last buffer, otherwise the previous
+** result is kept. Missing current is not flagged when mains is not connected.
+*/
+static void updatePortCurrentStatus(int16_t* pData, int noOfChannels, int noOfSamples) {
+    PortCurrentStats stats[AC_TEN_CH_NUM_PORTS];
+    pcUpdate(pData, noOfChannels, noOfSamples, currentZeroLevels, stats);
+
+    bool anyOnWithoutCurrent = false;
+    bool anyOffWithCurrent   = false;
+    for (int i = 0; i < AC_TEN_CH_NUM_PORTS; i++) {
+        if (stats[i].onSamples >= PORT_MIN_SETTLED_SAMPLES && pcIsMainsOn(isMainsConnected)) {
+            isOnWithoutCurrent[i] = ADCtoCurrent(stats[i].onRms) < PORT_ON_MIN_CURRENT;
+        }
+        if (stats[i].offSamples >= PORT_MIN_SETTLED_SAMPLES) {
+            isOffWithCurrent[i] = ADCtoCurrent(stats[i].offRms) > PORT_OFF_MAX_CURRENT;
+        }
+
+        bsUpdateError(AC_TEN_CH_PORT_x_CURRENT_ERROR_Msk(i),
+                      isOnWithoutCurrent[i] || isOffWithCurrent[i], AC_TEN_CH_No_Error_Msk);
+        anyOnWithoutCurrent |= isOnWithoutCurrent[i];
+        anyOffWithCurrent |= isOffWithCurrent[i];
+    }
+
+    bsUpdateError(AC_TEN_CH_NO_CURRENT_Msk, anyOnWithoutCurrent, AC_TEN_CH_No_Error_Msk);
+    bsUpdateError(AC_TEN_CH_OFF_CURRENT_Msk, anyOffWithCurrent, AC_TEN_CH_No_Error_Msk);
+}
+
 /*!
 ** @brief Updates the global error/status object.
 **
@@ -274,7 +348,7 @@ static void updateBoardStatus() {
     * filter
     ** Note: When power is toggled the status code changes within one print cycle */
     isMainsConnected += ((float)stmGetGpio(powerStatus) - isMainsConnected) / FILTER_LEN;
-    bsUpdateError(AC_POWER_ERROR_Msk, isMainsConnected <= 0.5, AC_TEN_CH_No_Error_Msk);
+    bsUpdateError(AC_POWER_ERROR_Msk, !pcIsMainsOn(isMainsConnected), AC_TEN_CH_No_Error_Msk);
 }
 
 /***************************************************************************************************
@@ -297,9 +371,8 @@ void ACTenChannelInit(ADC_HandleTypeDef* hadc, TIM_HandleTypeDef* htim,
     (void)boardSetup(ACTenChannel, (pcbVersion){BREAKING_MAJOR, BREAKING_MINOR},
                      AC_TEN_CH_No_Error_Msk);
 
-    // array for all ADC readings, filled by DMA.
-    static int16_t ADCBuffer[ADC_CHANNELS * ADC_CHANNEL_BUF_SIZE * 2];
     ADCMonitorInit(hadc, ADCBuffer, sizeof(ADCBuffer) / sizeof(int16_t));
+    pcInit(ADCBuffer, AC_TEN_CH_NUM_PORTS, ADC_CHANNELS, ADC_CHANNEL_BUF_SIZE, ADC_SAMPLES_PER_MS);
     HAL_TIM_Base_Start(htim);
 
     if (!bsGetField(BS_VERSION_ERROR_Msk)) {
@@ -322,6 +395,7 @@ void ACTenChannelLoop(const char* bootMsg) {
         // Toggle pins if needed when in pwm mode
         heaterLoop();
         updateBoardStatus();
+        pcRecordPortStates(getPortMask());
     }
 
     ADCMonitorLoop(printCurrentArray);
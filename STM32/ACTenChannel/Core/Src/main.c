@@ -24,6 +24,7 @@
 /* USER CODE BEGIN Includes */
 #include "ACTenChannel.h"
 #include "CAProtocolStm.h"
+#include "portCurrent.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -120,6 +121,7 @@ int main(void)
   {
     HAL_IWDG_Refresh(&hiwdg);
     HAL_WWDG_Refresh(&hwwdg);
+    pcDmaPosition(__HAL_DMA_GET_COUNTER(&hdma_adc1));
     ACTenChannelLoop(bootMsg);
     /* USER CODE END WHILE */
 
@@ -16,6 +16,9 @@
 ** DEFINES
 ***************************************************************************************************/
 
+extern uint32_t _FlashAddrCal;  // Starting address of the learnt IR codes in FLASH
+#define FLASH_ADDR_CAL ((uintptr_t) &_FlashAddrCal)
+
 /* Define showing which bits are "errors" and which are only for information */
 #define AIRCON_BOARD_No_Error_Msk         (BS_SYSTEM_ERRORS_Msk)
 
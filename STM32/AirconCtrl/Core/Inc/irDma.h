@@ -0,0 +1,48 @@
+/*!
+** @file    irDma.h
+** @brief   Header file of irDma.c
+** @date:   18/10/2026
+*/
+
+#ifndef IR_DMA_H_
+#define IR_DMA_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "stm32f4xx_hal.h"
+
+/*
+** Usage:
+** * Initialise the timers in CubeMX, then call "irDmaInit" once. The carriers are gated by the
+**   output of channel 1 of the signal timer.
+** * Fill an array with one entry per mark and space (period of the signal timer and length of the
+**   mark), ending with a space, and send it with "irDmaStart". The array must not change until
+**   "irDmaIsBusy" returns false, or until the transmission has been stopped with "irDmaStop".
+**   The last entry is repeated until the next transmission.
+*/
+
+/***************************************************************************************************
+** TYPEDEFS
+***************************************************************************************************/
+
+/*!
+** @brief One period of the signal timer. The layout matches the registers written by the DMA burst
+**        (ARR, RCR, CCR1), so the array is streamed into the timer as it is
+*/
+typedef struct IrTiming {
+    uint32_t arr;           // Period, in counts of the signal timer
+    uint32_t reserved;      // RCR: must be 0
+    uint32_t ccr;           // Mark at the start of the period, in counts of the signal timer
+} IrTiming;
+
+/***************************************************************************************************
+** PUBLIC FUNCTION DECLARATIONS
+***************************************************************************************************/
+
+void irDmaInit(TIM_HandleTypeDef* signal, TIM_HandleTypeDef* carrier1, TIM_HandleTypeDef* carrier2);
+bool irDmaStart(const IrTiming* timings, uint32_t n);
+void irDmaStop();
+bool irDmaIsBusy();
+
+#endif /* IR_DMA_H_ */
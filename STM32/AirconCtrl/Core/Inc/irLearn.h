@@ -0,0 +1,60 @@
+/*!
+** @file    irLearn.h
+** @brief   Header file of irLearn.c
+** @date:   18/10/2026
+*/
+
+#ifndef IR_LEARN_H_
+#define IR_LEARN_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+** Usage:
+** * Give the durations of a received burst (see irReceiver.h) to "irLearnDecode". If they are a
+**   pulse distance code, it returns the timings and data bits of the code, which can be stored and
+**   sent again (see "sendLearntIR" in transmitterIR.h).
+** * "irLearnBit" returns the data bits, numbered from the first bit of the first frame.
+*/
+
+/***************************************************************************************************
+** DEFINES
+***************************************************************************************************/
+
+#define IR_LEARN_MAX_BITS       256     // Data bits of all frames of a burst
+#define IR_LEARN_MAX_FRAMES     4
+#define IR_LEARN_MIN_BITS       8       // Per frame. Shorter frames are taken as noise
+#define IR_LEARN_HEADER_RATIO   2       // A header mark is at least this many data marks long
+#define IR_LEARN_TOLERANCE_PCT  35      // Allowed deviation of each duration from its mean
+
+/***************************************************************************************************
+** TYPEDEFS
+***************************************************************************************************/
+
+/*!
+** @brief A burst of a pulse distance code: each frame is an optional header, data bits where a
+**        mark followed by a short space is a 0 and by a long space a 1, and a stop mark.
+**        Durations are in ticks of the receiver timer
+*/
+typedef struct IrLearntCode {
+    uint16_t headerMark;    // 0 if the frames have no header
+    uint16_t headerSpace;
+    uint16_t bitMark;
+    uint16_t zeroSpace;
+    uint16_t oneSpace;
+    uint16_t frameSpace;    // After the stop mark of each frame but the last
+    uint16_t frameBits;     // Data bits of each frame
+    uint8_t  frames;        // 0 if there is no code
+    uint8_t  reserved;
+    uint8_t  bits[IR_LEARN_MAX_BITS / 8];   // MSB first
+} IrLearntCode;
+
+/***************************************************************************************************
+** PUBLIC FUNCTION DECLARATIONS
+***************************************************************************************************/
+
+bool irLearnDecode(const uint16_t* durations, uint32_t n, IrLearntCode* code);
+bool irLearnBit(const IrLearntCode* code, uint32_t idx);
+
+#endif /* IR_LEARN_H_ */
@@ -0,0 +1,39 @@
+/*!
+** @file    irReceiver.h
+** @brief   Header file of irReceiver.c
+** @date:   18/10/2026
+*/
+
+#ifndef IR_RECEIVER_H_
+#define IR_RECEIVER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+** Usage:
+** * Call "irRxInit" once, then "irRxEdge" with the count of the receiver timer on every edge (both
+**   rising and falling) of the receiver output.
+** * Call "irRxPoll" from the main loop. Once the receiver has been silent for IR_RX_GAP_TICKS, it
+**   returns the mark and space durations of the burst, which stay valid until the next call.
+*/
+
+/***************************************************************************************************
+** DEFINES
+***************************************************************************************************/
+
+#define IR_RX_TICK_US           10      // Period of the receiver timer
+#define IR_RX_GAP_TICKS         2000    // A silence of 20 ms ends a burst
+#define IR_RX_RING_LEN          256     // Edges which can be stored between two polls
+#define IR_RX_MAX_DURATIONS     600     // Longer bursts are discarded
+
+/***************************************************************************************************
+** PUBLIC FUNCTION DECLARATIONS
+***************************************************************************************************/
+
+void irRxInit();
+void irRxEdge(uint16_t tick);
+uint32_t irRxPoll(uint16_t now, const uint16_t** durations);
+uint32_t irRxDiscarded();
+
+#endif /* IR_RECEIVER_H_ */
@@ -16,6 +16,8 @@
 
 #include "stm32f4xx_hal.h"
 
+#include "irLearn.h"
+
 /***************************************************************************************************
 ** DEFINES
 ***************************************************************************************************/
@@ -110,16 +112,31 @@
 
 #define NUM_COMMAND_REPEATS 5
 
+/* Silence after each frame, or pair of frames for the second aircon remote */
+#define FRAME_GAP_ARR       800000  // Period = 100 ms
+
+/* The carriers only run while the signal timer output is high (gated slave mode), and stop where
+** they are when it goes low. Each mark is therefore rounded to a whole number of carrier periods,
+** so the carriers always stop at the start of a period, where their outputs are off. 421 counts
+** of the signal timer (8 MHz) are 2 periods of the 38 kHz carrier (421 counts at 16 MHz) */
+#define CARRIER_MARK_STEP   421
+
+/* Whole transmission: the frames for the first remote, followed by the pairs of frames for the
+** second one. Each frame has a start bit, the data bits, a stop bit and a gap */
+#define IR_MAX_TIMINGS  (NUM_COMMAND_REPEATS * (MSG_LEN_BITS + 3) + \
+                         2 * NUM_COMMAND_REPEATS * (AC2_MSG_LEN_BITS + 3))
+
+/* Learnt codes are in ticks of the IR receiver timer (10 us) */
+#define LEARNT_TICK_COUNTS  80
+
 /***************************************************************************************************
 ** PUBLIC FUNCTIONS
 ***************************************************************************************************/
 
 void getACStates(int * tempState);
 bool updateTemperatureIR(int temp);
-void turnOnLED();
-void turnOffLED();
 void turnOffAC();
-void pwmGPIO();
+bool sendLearntIR(const IrLearntCode* code);
 void initTransmitterIR(TIM_HandleTypeDef *timFreqCarrier1_, TIM_HandleTypeDef *timFreqCarrier2_, TIM_HandleTypeDef *timSignal_);
 
 #endif /* INC_TRANSMITTERIR_H_ */
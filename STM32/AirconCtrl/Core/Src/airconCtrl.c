@@ -16,13 +16,34 @@
 #include "CAProtocolStm.h"
 #include "systemInfo.h"
 #include "transmitterIR.h"
+#include "irReceiver.h"
+#include "irLearn.h"
 #include "pcbversion.h"
+#include "printSnapshot.h"
+#include "flashWriter.h"
+
+/***************************************************************************************************
+** DEFINES
+***************************************************************************************************/
+
+#define LEARNT_CODE_SLOTS   8
+#define LEARNT_CODES_MAGIC  0x4C524E31U     // "LRN1": the flash holds learnt codes
+
+/***************************************************************************************************
+** TYPEDEFS
+***************************************************************************************************/
+
+typedef struct LearntCodes {
+    uint32_t magic;
+    IrLearntCode codes[LEARNT_CODE_SLOTS];
+} LearntCodes;
 
 /***************************************************************************************************
 ** PRIVATE FUNCTION DECLARATIONS
 ***************************************************************************************************/
 
 static void handleUserCommands(const char * input);
+static void onLearntCodesStored(int status);
 
 /***************************************************************************************************
 ** PRIVATE OBJECTS
@@ -40,11 +61,10 @@ static CAProtocolCtx caProto = {
         .otpWrite = NULL
 };
 
-int arrIdx = 0;
-uint8_t bitIndex;
-static int irqCnt = 0;
-static uint8_t tempCode;
-static uint8_t tempCodeArr[24];
+static SnapshotBuffer printBuffer;
+
+static LearntCodes learnt;
+static int learningSlot = -1;   // Slot the next received code is stored in, if any
 
 TIM_HandleTypeDef *timerCtx  = NULL; 
 TIM_HandleTypeDef *loopTimer = NULL;
@@ -57,6 +77,7 @@ WWDG_HandleTypeDef *hwwdg_   = NULL;
 static void handleUserCommands(const char * input)
 {
     int temp;
+    int slot;
     if (sscanf(input, "temp %d", &temp) == 1)
     {
         if (!updateTemperatureIR(temp))
@@ -69,102 +90,142 @@ static void handleUserCommands(const char * input)
     {
         turnOffAC();
     }
+    else if (sscanf(input, "learn %d", &slot) == 1 && slot >= 0 && slot < LEARNT_CODE_SLOTS)
+    {
+        learningSlot = slot;
+        USBnprintf("Waiting for the code to learn in slot %d", slot);
+    }
+    else if (sscanf(input, "send %d", &slot) == 1 && slot >= 0 && slot < LEARNT_CODE_SLOTS)
+    {
+        if (!sendLearntIR(&learnt.codes[slot]))
+        {
+            HALundefined(input);
+        }
+    }
     else {
         HALundefined(input);
     }
 }
 
 /*!
-** @brief Prints the latest temperature to the USB port.
+** @brief Prints the temperature snapshotted by the loop timer interrupt to the USB port.
 **
-** If the port is not open, does nothing. If the software is on the wrong board, prints the error 
-** code only.
+** If there is no new snapshot or the port is not open, does nothing. If the software is on the
+** wrong board, prints the error code only.
 */
 static void printACTemperature()
 {
-    static int temp;
-
-    if (!isUsbPortOpen()) {
+    PrintSnapshot s;
+    if (!snapshotRead(&printBuffer, &s) || !isUsbPortOpen()) {
         return;
     }
 
-    if (bsGetStatus() & BS_VERSION_ERROR_Msk) {
-        USBnprintf("0x%08" PRIx32, bsGetStatus());
+    if (s.status & BS_VERSION_ERROR_Msk) {
+        USBnprintf("0x%08" PRIx32, s.status);
         return;
     }
 
-    getACStates(&temp);
-    USBnprintf("%d, 0x%08" PRIx32, temp, bsGetStatus());
+    USBnprintf("%d, 0x%08" PRIx32, (int)s.values[0], s.status);
 }
 
-static void finishWord(bool endOfMessage)
+/*!
+** @brief Loads the learnt codes from flash. Slots which have never been written are empty
+*/
+static void loadLearntCodes()
 {
-    tempCodeArr[arrIdx++] = tempCode;
-    tempCode = 0;
-    bitIndex = 0;
-
-    if (endOfMessage)
+    if (flashWriterRead((uint32_t) FLASH_ADDR_CAL, &learnt, sizeof(learnt)) != (int) sizeof(learnt) ||
+        learnt.magic != LEARNT_CODES_MAGIC)
     {
-        for(int i = 0; i < 24; i++) {
-            char buf[10] = "";
-            int len = snprintf(buf, 10, "%x ", tempCodeArr[i]);
-            writeUSB(buf, len);
-        }
-        USBnprintf("");
-        arrIdx = 0;
-        irqCnt = 0;
+        memset(&learnt, 0, sizeof(learnt));
+        learnt.magic = LEARNT_CODES_MAGIC;
     }
 }
 
-/***************************************************************************************************
-** PUBLIC FUNCTION DEFINITIONS
-***************************************************************************************************/
+/*!
+** @brief Prints a received code on one line: timings in us, then the data bits in hex
+*/
+static void printCode(const IrLearntCode* code)
+{
+    /* Hex digits of the data of all frames */
+    char hex[IR_LEARN_MAX_BITS / 4 + 1] = "";
+    int numBits = code->frames * code->frameBits;
+    for (int i = 0; i < (numBits + 3) / 4; i++)
+    {
+        uint8_t nibble = (code->bits[i / 2] >> ((i % 2) ? 0 : 4)) & 0x0F;
+        hex[i] = "0123456789abcdef"[nibble];
+    }
+    hex[(numBits + 3) / 4] = '\0';
+
+    USBnprintf("IR code: %dx%d bits, header %d/%d us, 0: %d/%d us, 1: %d/%d us, "
+               "frame space %d us, %s", code->frames, code->frameBits, 
+               code->headerMark * IR_RX_TICK_US, code->headerSpace * IR_RX_TICK_US,
+               code->bitMark * IR_RX_TICK_US, code->zeroSpace * IR_RX_TICK_US,
+               code->bitMark * IR_RX_TICK_US, code->oneSpace * IR_RX_TICK_US,
+               code->frameSpace * IR_RX_TICK_US, hex);
+}
 
 /*!
-** @brief Decodes IR communication pulses into a set of 4 32-bit words
-**
-** Expected to be called every falling edge of a GPIO pin. Communication format is a start bit 
-** followed by some number of 1s and 0s. 
-**   * Start bit = Long high followed by long low (_|----|____)
-**   * 1         = Short high followed by long low (_|-|___)
-**   * 0         = Short high followed by short low (_|-|_)
-**
-** Requirements: htim1 expected to be running at 100 kHz (e.g. each count is 10us)
+** @brief Decodes the bursts received by the IR receiver, and stores the code being learnt
 */
-void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin)
+static void handleReceivedIR()
 {
-    static const int LEN_START_BIT = 400;
-    static const int LEN_HIGH_BIT  = 160;
-    static const int LEN_LOW_BIT   = 80;
-    static const int BITS_PER_BYTE = 8;
+    const uint16_t* durations;
+    uint32_t n = irRxPoll(__HAL_TIM_GET_COUNTER(timerCtx), &durations);
+    if (n == 0)
+    {
+        return;
+    }
 
-    if (GPIO_Pin == GPIO_PIN_7)
+    IrLearntCode code;
+    if (!irLearnDecode(durations, n, &code))
     {
-        irqCnt++;
+        USBnprintf("IR code: not recognised (%" PRIu32 " marks and spaces)", n);
+        return;
+    }
+    printCode(&code);
 
-        /* The high and low periods can be bunched together and read on the falling edge */
-        if (__HAL_TIM_GET_COUNTER(timerCtx) > LEN_START_BIT)
-        {
-            tempCode = 0;
-            bitIndex = 0;
-        }
-        else if (__HAL_TIM_GET_COUNTER(timerCtx) > LEN_HIGH_BIT)
+    if (learningSlot >= 0)
+    {
+        /* Written in the background by the main loop */
+        learnt.codes[learningSlot] = code;
+        if (flashWriterStart((uint32_t) FLASH_ADDR_CAL, &learnt, sizeof(learnt), onLearntCodesStored) == 0)
         {
-            tempCode |= (1UL << ((BITS_PER_BYTE - 1) - bitIndex));   // write 1
-            bitIndex++;
+            USBnprintf("Learnt code %d", learningSlot);
         }
-        else if (__HAL_TIM_GET_COUNTER(timerCtx) > LEN_LOW_BIT)
+        else
         {
-            tempCode &= ~(1UL << ((BITS_PER_BYTE - 1) - bitIndex));  // write 0
-            bitIndex++;
+            USBnprintf("Learnt code %d could not be written to flash", learningSlot);
         }
+        learningSlot = -1;
+    }
+}
 
-        if ((bitIndex == BITS_PER_BYTE))
-        {
-            finishWord(false);
-        }
+/*!
+** @brief Called by the flash writer once the learnt codes are written
+*/
+static void onLearntCodesStored(int status)
+{
+    if (status != 0)
+    {
+        USBnprintf("Learnt codes could not be written to flash");
+    }
+}
 
-        __HAL_TIM_SET_COUNTER(timerCtx, 0);
+/***************************************************************************************************
+** PUBLIC FUNCTION DEFINITIONS
+***************************************************************************************************/
+
+/*!
+** @brief Timestamps the edges of the IR receiver, which are decoded by the main loop
+**
+** Requirements: the EXTI is triggered on both edges, and htim1 is running freely at 100 kHz (e.g.
+** each count is 10us)
+*/
+void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin)
+{
+    if (GPIO_Pin == GPIO_PIN_7)
+    {
+        irRxEdge(__HAL_TIM_GET_COUNTER(timerCtx));
     }
 }
 
@@ -173,13 +234,22 @@ void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim)
     if (htim == loopTimer)
     {
         HAL_WWDG_Refresh(hwwdg_);
-        printACTemperature();
+
+        /* Only the temperature is copied here. It is printed by airconCtrlLoop */
+        int temp = 0;
+        getACStates(&temp);
+
+        PrintSnapshot* s = snapshotWrite(&printBuffer);
+        s->values[0] = temp;
+        s->status    = bsGetStatus();
+        snapshotPublish(&printBuffer);
     }
 }
 
 void airconCtrlInit(TIM_HandleTypeDef *ctx, TIM_HandleTypeDef *loopTimer_, WWDG_HandleTypeDef *hwwdg)
 {
     initCAProtocol(&caProto, usbRx);
+    snapshotInit(&printBuffer);
 
     loopTimer = loopTimer_;
     hwwdg_    = hwwdg;
@@ -190,6 +260,8 @@ void airconCtrlInit(TIM_HandleTypeDef *ctx, TIM_HandleTypeDef *loopTimer_, WWDG_
         return;
     }
 
+    loadLearntCodes();
+    irRxInit();
     HAL_TIM_Base_Start(timerCtx);
     __HAL_TIM_SET_COUNTER(timerCtx, 0);
 }
@@ -197,10 +269,7 @@ void airconCtrlInit(TIM_HandleTypeDef *ctx, TIM_HandleTypeDef *loopTimer_, WWDG_
 void airconCtrlLoop(const char* bootMsg)
 {
     CAhandleUserInputs(&caProto, bootMsg);
-    pwmGPIO();
-
-    /* Only prints if there is some message unprinted after 90 ms of inactivity */
-    if ((__HAL_TIM_GET_COUNTER(timerCtx) > 9000) && (arrIdx != 0)) {
-        finishWord(true);
-    }
+    printACTemperature();
+    handleReceivedIR();
+    flashWriterRun();
 }
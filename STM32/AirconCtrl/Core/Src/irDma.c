@@ -0,0 +1,129 @@
+/*!
+** @file    irDma.c
+** @brief   Streams precomputed IR frames into the signal timer by DMA
+** @date:   18/10/2026
+**
+** Each update event of the signal timer requests a DMA burst, which writes the period and mark of
+** the following bit into the preload registers (ARR, RCR and CCR1). The output of channel 1 gates
+** the two carrier timers, so the whole transmission runs without the CPU and its timing does not
+** depend on how busy the main loop or the interrupts are.
+**
+** The DMA stream is set up here rather than in CubeMX, and no DMA interrupts are used: the end of
+** a transmission is found from the NDTR register.
+*/
+
+#include <stddef.h>
+
+#include "irDma.h"
+
+/***************************************************************************************************
+** PRIVATE VARIABLES
+***************************************************************************************************/
+
+static TIM_HandleTypeDef* tim = NULL;
+static DMA_HandleTypeDef hdma;
+
+/***************************************************************************************************
+** PUBLIC FUNCTION DEFINITIONS
+***************************************************************************************************/
+
+/*!
+** @brief Starts the (already initialised) timers with the IR LED off
+**
+** @param[in] signal   32 bit timer whose channel 1 is the trigger output of the carriers
+** @param[in] carrier1 Carrier timer with its output on channel 1
+** @param[in] carrier2 Carrier timer with its output on channel 3
+*/
+void irDmaInit(TIM_HandleTypeDef* signal, TIM_HandleTypeDef* carrier1, TIM_HandleTypeDef* carrier2) {
+    tim = signal;
+
+    /* Gated carriers hold their count while the gate is low, so they must start at the beginning
+    ** of a period */
+    __HAL_TIM_SET_COUNTER(carrier1, 0);
+    __HAL_TIM_SET_COUNTER(carrier2, 0);
+    (void) HAL_TIM_PWM_Start(carrier1, TIM_CHANNEL_1);
+    (void) HAL_TIM_PWM_Start(carrier2, TIM_CHANNEL_3);
+
+    __HAL_TIM_SET_COMPARE(tim, TIM_CHANNEL_1, 0);
+    (void) HAL_TIM_PWM_Start(tim, TIM_CHANNEL_1);
+
+    /* TIM2_UP is on stream 7, channel 3 of DMA1 */
+    __HAL_RCC_DMA1_CLK_ENABLE();
+    hdma.Instance                 = DMA1_Stream7;
+    hdma.Init.Channel             = DMA_CHANNEL_3;
+    hdma.Init.Direction           = DMA_MEMORY_TO_PERIPH;
+    hdma.Init.PeriphInc           = DMA_PINC_DISABLE;
+    hdma.Init.MemInc              = DMA_MINC_ENABLE;
+    hdma.Init.PeriphDataAlignment = DMA_PDATAALIGN_WORD;
+    hdma.Init.MemDataAlignment    = DMA_MDATAALIGN_WORD;
+    hdma.Init.Mode                = DMA_NORMAL;
+    hdma.Init.Priority            = DMA_PRIORITY_HIGH;
+    hdma.Init.FIFOMode            = DMA_FIFOMODE_DISABLE;
+    if (HAL_DMA_Init(&hdma) != HAL_OK) {
+        hdma.Instance = NULL;
+        return;
+    }
+    __HAL_LINKDMA(tim, hdma[TIM_DMA_ID_UPDATE], hdma);
+
+    /* Every update request writes 3 words through DMAR, starting at ARR */
+    tim->Instance->DCR = TIM_DMABASE_ARR | TIM_DMABURSTLENGTH_3TRANSFERS;
+}
+
+/*!
+** @brief Starts sending a sequence, aborting the one in progress
+**
+** @param[in] timings Periods to send. Must stay valid until "irDmaIsBusy" returns false
+** @param[in] n       Number of periods, at least 2
+**
+** @return False if the DMA could not be started
+*/
+bool irDmaStart(const IrTiming* timings, uint32_t n) {
+    if (tim == NULL || hdma.Instance == NULL || n < 2) {
+        return false;
+    }
+
+    __HAL_TIM_DISABLE_DMA(tim, TIM_DMA_UPDATE);
+    (void) HAL_DMA_Abort(&hdma);
+
+    /* Load the first period straight away (UG restarts the counter and, without UDE, requests no
+    ** DMA), then preload the second. The DMA writes the rest, one period ahead of the counter */
+    tim->Instance->ARR  = timings[0].arr;
+    tim->Instance->CCR1 = timings[0].ccr;
+    tim->Instance->EGR  = TIM_EGR_UG;
+    tim->Instance->ARR  = timings[1].arr;
+    tim->Instance->CCR1 = timings[1].ccr;
+
+    if (n > 2) {
+        uint32_t words = 3 * (n - 2);
+        if (HAL_DMA_Start(&hdma, (uint32_t) &timings[2], (uint32_t) &tim->Instance->DMAR, words)
+            != HAL_OK) {
+            return false;
+        }
+        __HAL_TIM_ENABLE_DMA(tim, TIM_DMA_UPDATE);
+    }
+
+    return true;
+}
+
+/*!
+** @brief Stops the transmission in progress, if any, and turns the IR LED off
+**
+** The DMA no longer reads the array of the transmission after this returns, so the array can be
+** rebuilt. The period being sent finishes with the LED off.
+*/
+void irDmaStop() {
+    if (tim == NULL || hdma.Instance == NULL) {
+        return;
+    }
+
+    __HAL_TIM_DISABLE_DMA(tim, TIM_DMA_UPDATE);
+    (void) HAL_DMA_Abort(&hdma);
+    tim->Instance->CCR1 = 0;
+}
+
+/*!
+** @brief True until the last period has been loaded into the timer
+*/
+bool irDmaIsBusy() {
+    return hdma.Instance != NULL && __HAL_DMA_GET_COUNTER(&hdma) != 0;
+}
@@ -0,0 +1,216 @@
+/*!
+** @file    irLearn.c
+** @brief   Learns the timings and data of unknown pulse distance IR codes
+** @date:   18/10/2026
+**
+** Most aircon remotes send a pulse distance code: marks of equal length, separated by a short
+** space for a 0 and a long space for a 1, after a long header mark. The remotes differ in the
+** timings, the number of bits and the number of frames sent per button press, all of which are
+** learnt from a single burst:
+** * Frames start at the marks which are much longer than the shortest mark.
+** * The spaces between the data marks are split into 0s and 1s halfway between the shortest and
+**   the longest one.
+** * The learnt timings are the means of each kind of duration. The burst is rejected if any
+**   duration is too far from its mean, e.g. if it is not a pulse distance code or an edge was
+**   missed.
+*/
+
+#include <string.h>
+
+#include "irLearn.h"
+
+/***************************************************************************************************
+** PRIVATE TYPEDEFS
+***************************************************************************************************/
+
+typedef struct Mean {
+    uint32_t sum;
+    uint32_t n;
+} Mean;
+
+/***************************************************************************************************
+** PRIVATE FUNCTION DEFINITIONS
+***************************************************************************************************/
+
+static void addToMean(Mean* m, uint16_t d) {
+    m->sum += d;
+    m->n++;
+}
+
+static uint16_t meanOf(const Mean* m) {
+    return (m->n > 0) ? (m->sum + m->n / 2) / m->n : 0;
+}
+
+static bool isNear(uint16_t d, uint16_t mean) {
+    uint32_t diff = (d > mean) ? d - mean : mean - d;
+    return diff * 100 <= (uint32_t) mean * IR_LEARN_TOLERANCE_PCT;
+}
+
+/*!
+** @brief Start of the data of a frame, given the index of its first mark
+*/
+static uint32_t dataStart(bool hasHeader, uint32_t frameStart) {
+    return hasHeader ? frameStart + 2 : frameStart;
+}
+
+/*!
+** @brief Finds the first mark of each frame
+**
+** @return Number of frames, or 0 if the marks do not split into frames
+*/
+static uint32_t findFrames(const uint16_t* d, uint32_t n, uint32_t* starts, bool* hasHeader) {
+    uint16_t minMark = UINT16_MAX;
+    for (uint32_t i = 0; i < n; i += 2) {
+        minMark = (d[i] < minMark) ? d[i] : minMark;
+    }
+
+    uint32_t headerMin = (uint32_t) minMark * IR_LEARN_HEADER_RATIO;
+    uint32_t frames    = 0;
+
+    *hasHeader = (d[0] > headerMin);
+    if (!*hasHeader) {
+        starts[0] = 0;
+        frames    = 1;
+    }
+
+    for (uint32_t i = 0; i < n; i += 2) {
+        if (d[i] > headerMin) {
+            if (!*hasHeader || frames >= IR_LEARN_MAX_FRAMES) {
+                return 0;
+            }
+            starts[frames++] = i;
+        }
+    }
+    return frames;
+}
+
+/***************************************************************************************************
+** PUBLIC FUNCTION DEFINITIONS
+***************************************************************************************************/
+
+/*!
+** @brief Learns the code of a burst
+**
+** @param[in]  durations Marks (even entries) and spaces (odd entries), starting and ending with a
+**                       mark
+** @param[in]  n         Number of durations
+** @param[out] code      Learnt code. Only written if the burst is a valid code
+**
+** @return False if the burst is not a pulse distance code
+*/
+bool irLearnDecode(const uint16_t* d, uint32_t n, IrLearntCode* code) {
+    if (n < 2 * IR_LEARN_MIN_BITS + 1 || n % 2 == 0) {
+        return false;
+    }
+
+    IrLearntCode c;
+    memset(&c, 0, sizeof(c));
+
+    uint32_t starts[IR_LEARN_MAX_FRAMES + 1];
+    bool hasHeader;
+    uint32_t frames = findFrames(d, n, starts, &hasHeader);
+    if (frames == 0) {
+        return false;
+    }
+    starts[frames] = n + 1;     // Start of a frame after the stop mark at n - 1
+
+    c.frames = frames;
+
+    /* Every frame must have the same number of bits */
+    uint32_t first = dataStart(hasHeader, starts[0]);
+    if (starts[1] < first + 2 * IR_LEARN_MIN_BITS + 2) {
+        return false;
+    }
+    uint32_t bits = (starts[1] - 2 - first) / 2;
+    if (bits * frames > IR_LEARN_MAX_BITS) {
+        return false;
+    }
+    for (uint32_t f = 1; f < frames; f++) {
+        if (starts[f + 1] - starts[f] != starts[1] - starts[0]) {
+            return false;
+        }
+    }
+    c.frameBits = bits;
+
+    /* Threshold between the spaces of 0s and 1s */
+    uint16_t minSpace = UINT16_MAX;
+    uint16_t maxSpace = 0;
+    for (uint32_t f = 0; f < frames; f++) {
+        for (uint32_t b = 0; b < bits; b++) {
+            uint16_t s = d[dataStart(hasHeader, starts[f]) + 2 * b + 1];
+            minSpace   = (s < minSpace) ? s : minSpace;
+            maxSpace   = (s > maxSpace) ? s : maxSpace;
+        }
+    }
+    if (2 * (uint32_t) maxSpace < 3 * (uint32_t) minSpace) {
+        return false;
+    }
+    uint16_t threshold = ((uint32_t) minSpace + maxSpace) / 2;
+
+    /* Means of each kind of duration, and the bits */
+    Mean headerMark = {0}, headerSpace = {0}, mark = {0}, zero = {0}, one = {0}, frameSpace = {0};
+    for (uint32_t f = 0; f < frames; f++) {
+        uint32_t i = starts[f];
+        if (hasHeader) {
+            addToMean(&headerMark, d[i]);
+            addToMean(&headerSpace, d[i + 1]);
+        }
+
+        for (uint32_t b = 0; b < bits; b++) {
+            i = dataStart(hasHeader, starts[f]) + 2 * b;
+            addToMean(&mark, d[i]);
+            if (d[i + 1] > threshold) {
+                addToMean(&one, d[i + 1]);
+                c.bits[(f * bits + b) / 8] |= 0x80 >> ((f * bits + b) % 8);
+            }
+            else {
+                addToMean(&zero, d[i + 1]);
+            }
+        }
+
+        /* Stop mark, and the space to the next frame */
+        i = starts[f + 1] - 2;
+        addToMean(&mark, d[i]);
+        if (f + 1 < frames) {
+            addToMean(&frameSpace, d[i + 1]);
+        }
+    }
+
+    c.headerMark  = meanOf(&headerMark);
+    c.headerSpace = meanOf(&headerSpace);
+    c.bitMark     = meanOf(&mark);
+    c.zeroSpace   = meanOf(&zero);
+    c.oneSpace    = meanOf(&one);
+    c.frameSpace  = meanOf(&frameSpace);
+
+    /* Every duration must be close to its mean */
+    for (uint32_t f = 0; f < frames; f++) {
+        uint32_t i = starts[f];
+        if (hasHeader && (!isNear(d[i], c.headerMark) || !isNear(d[i + 1], c.headerSpace))) {
+            return false;
+        }
+
+        for (i = dataStart(hasHeader, starts[f]); i < starts[f + 1] - 2; i += 2) {
+            uint16_t space = (d[i + 1] > threshold) ? c.oneSpace : c.zeroSpace;
+            if (!isNear(d[i], c.bitMark) || !isNear(d[i + 1], space)) {
+                return false;
+            }
+        }
+
+        if (!isNear(d[i], c.bitMark) || (f + 1 < frames && !isNear(d[i + 1], c.frameSpace))) {
+            return false;
+        }
+    }
+
+    *code = c;
+    return true;
+}
+
+/*!
+** @brief Data bit of a learnt code
+**
+** @param[in] idx Index of the bit, counted over all frames
+*/
+bool irLearnBit(const IrLearntCode* code, uint32_t idx) {
+    return (code->bits[idx / 8] & (0x80 >> (idx % 8))) != 0;
+}
@@ -0,0 +1,164 @@
+/*!
+** @file    irReceiver.c
+** @brief   Mark and space durations of the IR receiver output, from the timestamps of its edges
+** @date:   18/10/2026
+**
+** The EXTI interrupt only stores the count of a free running timer on each edge. The main loop
+** turns the timestamps into durations, so the interrupt is short enough not to disturb anything
+** else, and the durations do not depend on how late the main loop is.
+**
+** The receiver output is idle between bursts, so the first edge after a silence is always the
+** start of a mark, and the edges then alternate between the ends of marks and spaces. A missed
+** edge therefore swaps marks and spaces until the next silence. Such bursts are not valid codes,
+** and are rejected by the decoder.
+*/
+
+#include <stddef.h>
+
+#include "irReceiver.h"
+
+/***************************************************************************************************
+** PRIVATE VARIABLES
+***************************************************************************************************/
+
+/* Written by the interrupt at head, read by the main loop at tail */
+static uint16_t ring[IR_RX_RING_LEN];
+static volatile uint16_t head = 0;
+static uint16_t tail = 0;
+static volatile bool isOverflow = false;
+
+/* Burst being received. Even entries are marks and odd entries spaces, in timer ticks */
+static uint16_t durations[IR_RX_MAX_DURATIONS];
+static uint32_t numDurations = 0;
+static bool isInBurst = false;
+static bool isTooLong = false;
+static uint16_t lastEdge = 0;
+
+static uint32_t discarded = 0;
+
+/***************************************************************************************************
+** PRIVATE FUNCTION DEFINITIONS
+***************************************************************************************************/
+
+static void startBurst(uint16_t tick) {
+    isInBurst    = true;
+    isTooLong    = false;
+    numDurations = 0;
+    lastEdge     = tick;
+}
+
+static void discardBurst() {
+    if (isInBurst) {
+        discarded++;
+    }
+    isInBurst = false;
+}
+
+/*!
+** @brief Ends the burst in a space, i.e. after the end of a mark
+**
+** @return Number of durations (always odd), or 0 if the burst did not fit
+*/
+static uint32_t endBurst() {
+    isInBurst = false;
+    if (isTooLong) {
+        discarded++;
+        return 0;
+    }
+    return numDurations;
+}
+
+/***************************************************************************************************
+** PUBLIC FUNCTION DEFINITIONS
+***************************************************************************************************/
+
+void irRxInit() {
+    tail       = head;
+    isOverflow = false;
+    isInBurst  = false;
+    discarded  = 0;
+}
+
+/*!
+** @brief Stores the timestamp of an edge. Called from the EXTI interrupt
+*/
+void irRxEdge(uint16_t tick) {
+    uint16_t next = (head + 1) % IR_RX_RING_LEN;
+
+    if (next == tail) {
+        isOverflow = true;
+        return;
+    }
+    ring[head] = tick;
+    head       = next;
+}
+
+/*!
+** @brief Processes the new edges
+**
+** @param[in]  now       Current count of the receiver timer, read before this call
+** @param[out] durations Durations of the last burst, starting and ending with a mark
+**
+** @return Number of durations, or 0 if no burst has ended
+*/
+uint32_t irRxPoll(uint16_t now, const uint16_t** out) {
+    *out = durations;
+
+    if (isOverflow) {
+        tail       = head;
+        isOverflow = false;
+        discardBurst();
+        return 0;
+    }
+
+    while (tail != head) {
+        uint16_t tick = ring[tail];
+
+        if (!isInBurst) {
+            startBurst(tick);
+        }
+        else {
+            /* Wraps correctly when the timer rolls over */
+            uint16_t dt   = tick - lastEdge;
+            bool isInMark = (numDurations % 2 == 0);
+
+            if (dt > IR_RX_GAP_TICKS) {
+                /* The edge starts the next burst, so it is left for the next call. A long mark is
+                ** a missed edge */
+                if (!isInMark) {
+                    return endBurst();
+                }
+                discardBurst();
+                continue;
+            }
+
+            if (numDurations < IR_RX_MAX_DURATIONS) {
+                durations[numDurations++] = dt;
+            }
+            else {
+                isTooLong = true;
+            }
+            lastEdge = tick;
+        }
+
+        tail = (tail + 1) % IR_RX_RING_LEN;
+    }
+
+    /* Edges stored after "now" was read look like they are from the future */
+    uint16_t elapsed = now - lastEdge;
+    if (isInBurst && elapsed > IR_RX_GAP_TICKS && elapsed < 0x8000) {
+        if (numDurations % 2 == 1) {
+            return endBurst();
+        }
+        discardBurst();
+    }
+
+    return 0;
+}
+
+/*!
+** @brief Number of bursts which were too long, overflowed the ring or had a missed edge
+*/
+uint32_t irRxDiscarded() {
+    return discarded;
+}
@@ -14,54 +14,24 @@
 #include "stm32f4xx_hal.h"
 
 #include "transmitterIR.h"
-#include "StmGpio.h"
+#include "irDma.h"
 
 /***************************************************************************************************
 ** STATIC FUNCTION PROTOTYPES
 ***************************************************************************************************/
 
-static bool startSendingTempUpdate(int temp, bool isNewController);
-static void sendCommand();
-static void setupSignalTimer(uint32_t period, uint32_t interval);
-static void setupStartBit();
-static void setupHighBit();
-static void setupLowBit();
+static bool startSendingTempUpdate(int temp);
+static void setCommand(int temp, bool isNewController);
+static uint32_t carrierMark(uint32_t ccr);
+static void addTiming(uint32_t period, uint32_t interval);
+static void addFrame(bool isNewController, uint32_t gap);
 
 /***************************************************************************************************
 ** STATIC VARIABLES
 ***************************************************************************************************/
 
-static TIM_HandleTypeDef* timFreqCarrier1 = NULL;
-static TIM_HandleTypeDef* timFreqCarrier2 = NULL;
-static TIM_HandleTypeDef* timSignal = NULL;
-
 static int currentTemp = 0;
 
-/*!
-** @brief Set of flags for controlling sending of IR message
-*/
-static struct {
-    uint32_t cmdTimeStamp;
-
-    /* Used to indicate how many bits will be sent */
-    uint8_t len_bits;
-
-    /* Used to indicate a command is ready to be sent */
-    uint8_t isCommandIssued: 1;
-
-    /* Indicates the start bit has been sent */
-    uint8_t isAddressSent: 1;
-
-    /* Used to indicate that the body of the command is ready to be sent */
-    uint8_t isCommReady: 1;
-
-    /* Used to indicate which controller version is being used */
-    uint8_t isNewController: 1;
-
-    /* Used to indicate a temperature or off message */
-    uint8_t isOffMessage: 1;
-} commandState = {0, 0, false, false, false, false, false};
-
 /*!
 ** @brief Holds the main body of the command
 */
@@ -83,152 +53,80 @@ static uint32_t tempCodes[2][8] =
 };
 static uint32_t crcCodes[8] = {CRC18, CRC19, CRC20, CRC21, CRC22, CRC23, CRC24, CRC25};
 
+/*!
+** @brief Whole transmission of the last command, which is streamed into the signal timer
+*/
+static IrTiming timings[IR_MAX_TIMINGS];
+static uint32_t numTimings = 0;
+
 /***************************************************************************************************
 ** STATIC FUNCTIONS
 ***************************************************************************************************/
 
 /*!
-** @brief Sets up the signal timer period and interval
-**
-** @param period   The period (in counts) that the timer should run for
-** @param interval The interval at which the timer should switch from on to off
+** @brief Rounds a mark to the nearest whole number of carrier periods (see CARRIER_MARK_STEP)
 */
-static void setupSignalTimer(uint32_t period, uint32_t interval)
+static uint32_t carrierMark(uint32_t ccr)
 {
-    timSignal->Instance->ARR = period;
-    timSignal->Instance->CCR2 = interval;
+    return ((ccr + CARRIER_MARK_STEP / 2) / CARRIER_MARK_STEP) * CARRIER_MARK_STEP;
 }
 
 /*!
-** @brief Sets up the signal timer for the start bit
+** @brief Appends one period of the signal timer to the transmission
 **
-** Changes the length of the start bit, depending on what controller version is being requested
-*/
-static void setupStartBit()
-{
-    uint32_t period   = !commandState.isNewController ? START_BIT_ARR : START_BIT_ARR_AC2;
-    uint32_t interval = !commandState.isNewController ? START_BIT_CCR : START_BIT_CCR_AC2;
-    setupSignalTimer(period, interval);
-}
-
-/*!
-** @brief Sets up the signal timer for the high bit
-**
-** Changes the length of the high bit, depending on what controller version is being requested
+** @param period   The period (in counts) that the timer should run for
+** @param interval The interval at which the timer should switch from on to off
 */
-static void setupHighBit()
+static void addTiming(uint32_t period, uint32_t interval)
 {
-    uint32_t period   = !commandState.isNewController ? HIGH_BIT_ARR : HIGH_BIT_ARR_AC2;
-    uint32_t interval = !commandState.isNewController ? HIGH_BIT_CCR : HIGH_BIT_CCR_AC2;
-    setupSignalTimer(period, interval);
+    if (numTimings < IR_MAX_TIMINGS)
+    {
+        timings[numTimings++] = (IrTiming) {.arr = period, .ccr = carrierMark(interval)};
+    }
 }
 
 /*!
-** @brief Sets up the signal timer for the low bit
+** @brief Appends the current command as one frame, followed by a silence
 **
-** Changes the length of the low bit, depending on what controller version is being requested
-*/
-static void setupLowBit()
-{
-    uint32_t period   = !commandState.isNewController ? LOW_BIT_ARR : LOW_BIT_ARR_AC2;
-    uint32_t interval = !commandState.isNewController ? LOW_BIT_CCR : LOW_BIT_CCR_AC2;
-    setupSignalTimer(period, interval);
-}
-
-/*!
-** @brief Sets up the timer to transmit the next bit
+** @param isNewController Which controller version the timings and length are for
+** @param gap             Length (in counts) of the silence after the frame
 */
-static void sendCommand()
+static void addFrame(bool isNewController, uint32_t gap)
 {
-    static int sendBitIdx = 0;
-    static int wordIdx = 0;
-    static int numRepeats = 0;
+    int lenBits = !isNewController ? MSG_LEN_BITS : AC2_MSG_LEN_BITS;
 
-    if (!commandState.isAddressSent)
-    {
-        commandState.isAddressSent = true;
-        setupStartBit();
-        return;
-    }
+    !isNewController ? addTiming(START_BIT_ARR, START_BIT_CCR) : 
+                       addTiming(START_BIT_ARR_AC2, START_BIT_CCR_AC2);
 
-    /* End of packet */
-    int bits = wordIdx * 32 + sendBitIdx;
-    
-    /* Go for 1 extra bit so that there is a downward going pulse to conclude the message (e.g. for
-    ** 48 bits, there needs to be 49 negative pulses) */
-    if (bits >= (commandState.len_bits+1))
+    for (int bit = 0; bit < lenBits; bit++)
     {
-        turnOffLED();
+        bool isHigh = IRCommand.command[bit / 32] & (1UL << (31 - (bit % 32)));
 
-        // Repeat command 'NUM_COMMAND_REPEATS' times to minimize risk of command
-        // not being received correctly
-        if (!commandState.isNewController) 
+        if (!isNewController)
         {
-            setupSignalTimer(START_BIT_ARR, 0);
-
-            if (++numRepeats < NUM_COMMAND_REPEATS) 
-            {
-                startSendingTempUpdate(currentTemp, false);
-            }
-            else
-            {
-                numRepeats = 0;
-                startSendingTempUpdate(currentTemp, true);
-            }
+            isHigh ? addTiming(HIGH_BIT_ARR, HIGH_BIT_CCR) : addTiming(LOW_BIT_ARR, LOW_BIT_CCR);
         }
         else
         {
-            setupSignalTimer(START_BIT_ARR_AC2, 0);
-
-            /* For the new controller, each packet consists of the same message sent twice */
-            if (++numRepeats < (2 * NUM_COMMAND_REPEATS))
-            {
-                /* Hackity hack: to prevent the double packets being hampered by the minimum send 
-                ** time, (see HAL_TIM_PWM_PulseFinishedCallback()), take a copy of the original time
-                ** stamp here and re-apply it if necessary */
-                uint32_t tmpTimestamp = commandState.cmdTimeStamp;
-                startSendingTempUpdate(currentTemp, true);
-                if (numRepeats % 2) /* e.g. odd numbers */
-                {
-                    commandState.cmdTimeStamp = tmpTimestamp;
-
-                    /* In between "double packets" a shorter rest period is observed on the second 
-                    ** AC controller */
-                    setupSignalTimer(START_BIT_REST_AC2, 0);
-                }
-            }
-            else if (commandState.isCommandIssued)
-            {
-                /* Finishes the transmission */
-                numRepeats = 0;
-                commandState.isCommandIssued = false;
-            }
+            isHigh ? addTiming(HIGH_BIT_ARR_AC2, HIGH_BIT_CCR_AC2) : 
+                     addTiming(LOW_BIT_ARR_AC2, LOW_BIT_CCR_AC2);
         }
-
-        wordIdx = 0;
-        sendBitIdx = 0;
-        return;
     }
 
-    // After overload of counter the new PWM settings will be set 
-    // that codes for a logical 1 and 0 respectively.
-    (IRCommand.command[wordIdx] & (1 << (31-sendBitIdx))) ? setupHighBit() : setupLowBit();
+    /* 1 extra low bit, so that there is a mark to conclude the message (e.g. for 48 bits, there 
+    ** needs to be 49 marks) */
+    !isNewController ? addTiming(LOW_BIT_ARR, LOW_BIT_CCR) : 
+                       addTiming(LOW_BIT_ARR_AC2, LOW_BIT_CCR_AC2);
 
-    if (++sendBitIdx % 32 == 0)
-    {
-        sendBitIdx = 0;
-        wordIdx++;
-    }
+    addTiming(gap, 0);
 }
 
 /*!
-** @brief Updates message packet with temperature value and prepares to send
+** @brief Updates message packet with temperature value
 */
-static bool startSendingTempUpdate(int temp, bool isNewController)
+static void setCommand(int temp, bool isNewController)
 {
-    commandState.isNewController = isNewController;
-
-    if (!commandState.isNewController) 
+    if (!isNewController) 
     {
         switch(temp)
         {
@@ -250,7 +148,6 @@ static bool startSendingTempUpdate(int temp, bool isNewController)
                         break;
         }
         IRCommand.address = IR_ADDRESS;
-        commandState.len_bits = MSG_LEN_BITS;
     }
     else
     {
@@ -263,45 +160,82 @@ static bool startSendingTempUpdate(int temp, bool isNewController)
                         IRCommand.command_u16[3] = AC2_TEMP_30;
                         break;
             /* The new AC unit cannot go below 17 degC. Test team agrees the best choice is to go
-            ** to the lowest setting if "5" is requested. Fall through intentional */                        
-            case 5:     temp = 17;
+            ** to the lowest setting if "5" is requested */
+            case 5:     IRCommand.command_u16[0] = AC2_FAN_MODE_2;
+                        IRCommand.command_u16[3] = AC2_TEMP_17;
+                        break;
             default:    IRCommand.command_u16[0] = AC2_FAN_MODE_2;
                         IRCommand.command_u16[3] = (uint16_t) tempCodes[1][temp-18];
                         break;
         }
         IRCommand.command_u16[1] = AC2_TEMP_COMMAND;
-        commandState.len_bits = AC2_MSG_LEN_BITS;
+    }
+}
+
+/*!
+** @brief Builds the whole transmission for a temperature and starts sending it
+**
+** The command is sent 'NUM_COMMAND_REPEATS' times to each controller version, to minimize the risk
+** of it not being received correctly. The second controller expects each command as the same frame
+** sent twice, with a shorter rest in between.
+*/
+static bool startSendingTempUpdate(int temp)
+{
+    /* The DMA may still be reading the previous transmission from the array */
+    irDmaStop();
+    numTimings = 0;
+
+    setCommand(temp, false);
+    for (int i = 0; i < NUM_COMMAND_REPEATS; i++)
+    {
+        addFrame(false, FRAME_GAP_ARR);
+    }
+
+    setCommand(temp, true);
+    for (int i = 0; i < NUM_COMMAND_REPEATS; i++)
+    {
+        addFrame(true, START_BIT_REST_AC2);
+        addFrame(true, FRAME_GAP_ARR);
     }
 
-    commandState.isCommandIssued = true;
-    commandState.isAddressSent = false;
-    commandState.isCommReady = false;
-    commandState.cmdTimeStamp = HAL_GetTick();
     currentTemp = temp;
 
-    return true;
+    return irDmaStart(timings, numTimings);
 }
 
-/***************************************************************************************************
-** PUBLIC
-***************************************************************************************************/
-
 /*!
-** @brief Turns the LED PWM on or off, depending on how far through the signal timer the count is.
-**
-** This function must be called as frequently as possible to maintain accurate timing.
+** @brief Appends a learnt code as one burst of frames, followed by a silence
 */
-void pwmGPIO()
+static void addLearntBurst(const IrLearntCode* code)
 {
-    if (!commandState.isCommReady)
+    uint32_t mark = code->bitMark * LEARNT_TICK_COUNTS;
+
+    for (int f = 0; f < code->frames; f++)
     {
-        turnOffLED();
-        return;
-    }
+        if (code->headerMark != 0)
+        {
+            addTiming((code->headerMark + code->headerSpace) * LEARNT_TICK_COUNTS, 
+                      code->headerMark * LEARNT_TICK_COUNTS);
+        }
+
+        for (int bit = 0; bit < code->frameBits; bit++)
+        {
+            uint32_t space = irLearnBit(code, f * code->frameBits + bit) ? code->oneSpace : 
+                                                                           code->zeroSpace;
+            addTiming(mark + space * LEARNT_TICK_COUNTS, mark);
+        }
 
-    timSignal->Instance->CNT < timSignal->Instance->CCR2 ? turnOnLED() : turnOffLED();
+        /* The stop mark is followed by the next frame or the silence */
+        uint32_t gap = (f + 1 < code->frames) ? code->frameSpace * LEARNT_TICK_COUNTS : 
+                                                FRAME_GAP_ARR;
+        addTiming(mark + gap, mark);
+    }
 }
 
+/***************************************************************************************************
+** PUBLIC
+***************************************************************************************************/
+
 /*!
 ** @brief Returns the current temperature
 */
@@ -311,7 +245,7 @@ void getACStates(int * tempState)
 }
 
 /*!
-** @brief Starts sending a temperature update with the first controller version
+** @brief Starts sending a temperature update to both controller versions
 */
 bool updateTemperatureIR(int temp)
 {
@@ -321,7 +255,7 @@ bool updateTemperatureIR(int temp)
         return false;
     }
 
-    return startSendingTempUpdate(temp, false);
+    return startSendingTempUpdate(temp);
 }
 
 /*!
@@ -329,61 +263,34 @@ bool updateTemperatureIR(int temp)
 */
 void turnOffAC()
 {
-    startSendingTempUpdate(0, false);
-}
-
-/*!
-** @brief Starts the PWM for the IR LED
-*/
-void turnOnLED()
-{
-    HAL_TIM_PWM_Start(timFreqCarrier1, TIM_CHANNEL_1);
-    HAL_TIM_PWM_Start(timFreqCarrier2, TIM_CHANNEL_3);
+    startSendingTempUpdate(0);
 }
 
 /*!
-** @brief Stops the PWM for the IR LED
+** @brief Starts sending a learnt code, 'NUM_COMMAND_REPEATS' times if there is room for it
 */
-void turnOffLED()
+bool sendLearntIR(const IrLearntCode* code)
 {
-    HAL_TIM_PWM_Stop(timFreqCarrier1, TIM_CHANNEL_1);
-    HAL_TIM_PWM_Stop(timFreqCarrier2, TIM_CHANNEL_3);
-}
-
-/*!
-** @brief Callback called when the timer CCR register is triggered (e.g. at the transition point 
-**        during the PWM pulse)
-**
-** Runs the main state machine of the module:
-** <img src="aircon_ctrl_ir_states.svg"/>
-*/
-void HAL_TIM_PWM_PulseFinishedCallback(TIM_HandleTypeDef *htim)
-{
-    if (!commandState.isCommandIssued || (HAL_GetTick() - commandState.cmdTimeStamp) < 100)
+    uint32_t burstLen = code->frames * (code->frameBits + (code->headerMark != 0 ? 2 : 1));
+    if (code->frames == 0 || burstLen > IR_MAX_TIMINGS)
     {
-        return;
+        return false;
     }
 
-    if (commandState.isAddressSent && !commandState.isCommReady)
+    irDmaStop();
+    numTimings = 0;
+    for (int i = 0; i < NUM_COMMAND_REPEATS && numTimings + burstLen <= IR_MAX_TIMINGS; i++)
     {
-        commandState.isCommReady = true;
-        return;
+        addLearntBurst(code);
     }
 
-    if (htim == timSignal)
-    {
-        sendCommand();
-    }
+    return irDmaStart(timings, numTimings);
 }
 
 /*!
-** @brief Initisalise IR transmitter by starting timer
+** @brief Initisalise IR transmitter by starting the timers, with the IR LED off
 */
 void initTransmitterIR(TIM_HandleTypeDef *timFreqCarrier1_, TIM_HandleTypeDef *timFreqCarrier2_, TIM_HandleTypeDef *timSignal_)
 {
-    HAL_TIM_PWM_Start_IT(timSignal_, TIM_CHANNEL_2);
-    timSignal = timSignal_;
-    timFreqCarrier1 = timFreqCarrier1_;
-    timFreqCarrier2 = timFreqCarrier2_;
+    irDmaInit(timSignal_, timFreqCarrier1_, timFreqCarrier2_);
 }
-
@@ -19,6 +19,11 @@
 
 /* AnalogInput board status register definitions */
 
+/* Status bits set while the measurement range of a port is changing. The values printed meanwhile
+   may have been taken on either range */
+#define PORT_SETTLING_Pos 14U
+#define PORT_SETTLING_Msk(x) (1U << (PORT_SETTLING_Pos + (x)))
+
 /* One error bit per chip (per channel would be preferable, but there aren't enough bits) */
 #define I2C_ERROR_Pos 8U 
 #define I2C_ERROR_Msk(x) (1U << (I2C_ERROR_Pos + (x)))
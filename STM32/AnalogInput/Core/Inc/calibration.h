@@ -11,6 +11,7 @@
 #include "CAProtocol.h"
 #include "CAProtocolStm.h"
 #include "main.h"
+#include "piecewiseLinear.h"
 
 /***************************************************************************************************
 ** DEFINES
@@ -23,6 +24,11 @@
 #define V_REF                   3.3f     // ADC internal voltage reference
 #define AMPS_TO_MILLIAMPS       1000.0f
 
+// CAL thresholds of the sensor calibration tables, which replace the slope and offset of a sensor
+// once they hold 2 points or more. The input is in volt or mA, as for the slope and offset
+#define CAL_TABLE_POINT 4  // CAL port,input,value,4 - Adds or replaces a point
+#define CAL_TABLE_CLEAR 5  // CAL port,0,0,5         - Clears the table
+
 enum adc_channels {
     ADC_CHANNEL_PORT_1 = 0,
     ADC_CHANNEL_PORT_2,
@@ -41,6 +47,7 @@ typedef struct FlashCalibration {
     float portVoltCalVal[NUM_CHANNELS];    // Slope to convert ADC to volt
     float portResCalVal[NUM_CHANNELS];     // Shunt resistance to convert voltage to current
     int measurementType[NUM_CHANNELS];
+    PwlTable sensorTable[NO_CALIBRATION_CHANNELS];  // Must be last, see calibrationInit
 } FlashCalibration;
 
 /***************************************************************************************************
@@ -0,0 +1,22 @@
+/*!
+** @file    digipotBus.h
+** @brief   Header file of digipotBus.c
+** @date:   18/10/2026
+*/
+
+#ifndef DIGIPOT_BUS_H_
+#define DIGIPOT_BUS_H_
+
+#include <stdint.h>
+
+#include "stm32f4xx_hal.h"
+
+/***************************************************************************************************
+** PUBLIC FUNCTION DECLARATIONS
+***************************************************************************************************/
+
+void digipotBusInit(I2C_HandleTypeDef* hi2c);
+int digipotBusWrite(uint16_t addr, uint8_t* data, uint16_t len);
+void digipotBusAbort();
+
+#endif /* DIGIPOT_BUS_H_ */
@@ -0,0 +1,52 @@
+/*!
+** @file    digipotQueue.h
+** @brief   Header file of digipotQueue.c
+** @date:   18/10/2026
+*/
+
+#ifndef DIGIPOT_QUEUE_H_
+#define DIGIPOT_QUEUE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+** Usage:
+** * Initialise with "digipotQueueInit" and register the HAL handle with "digipotBusInit". Then add
+**   each wiper with "digipotQueueAdd", giving the position it was set to at start-up.
+** * Set the wanted position of a wiper with "digipotQueueSetTarget" at any time. Only the latest
+**   target is kept, and the wiper is moved towards it one step at a time, at most one step every
+**   DIGIPOT_STEP_MS.
+** * Call "digipotQueueTxComplete" and "digipotQueueError" from the I2C interrupts (see
+**   digipotBus.c), and "digipotQueueRun" from the main loop. At most one transfer is started per
+**   call, so the main loop is never blocked by the bus.
+** * A wiper which does not answer, or whose write does not complete within DIGIPOT_TIMEOUT_MS, is
+**   reported by "digipotQueueHasFailed" and written again every DIGIPOT_RETRY_MS, straight to its
+**   target, until it answers. A write which timed out is aborted with "digipotBusAbort".
+*/
+
+/***************************************************************************************************
+** DEFINES
+***************************************************************************************************/
+
+#define DIGIPOT_QUEUE_MAX_POTS  12      // Wipers on the bus
+#define DIGIPOT_STEP_MS         1U      // Minimum time between two steps of a wiper
+#define DIGIPOT_RETRY_MS        1000U   // Time between writes to a wiper which has failed
+#define DIGIPOT_TIMEOUT_MS      10U     // A 3 byte write at 400 kHz takes about 70 us
+
+/***************************************************************************************************
+** PUBLIC FUNCTION DECLARATIONS
+***************************************************************************************************/
+
+void digipotQueueInit();
+void digipotQueueAdd(int pot, uint16_t addr, uint8_t wiperAddr, uint16_t pos, bool isOk);
+void digipotQueueSetTarget(int pot, uint16_t target);
+uint16_t digipotQueueGetPos(int pot);
+bool digipotQueueIsSettled(int pot);
+bool digipotQueueHasFailed(int pot);
+void digipotQueueRun(uint32_t now);
+
+void digipotQueueTxComplete();
+void digipotQueueError();
+
+#endif /* DIGIPOT_QUEUE_H_ */
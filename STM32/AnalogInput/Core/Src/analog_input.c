@@ -19,6 +19,11 @@
 #include "USBprint.h"
 #include "analog_input.h"
 #include "calibration.h"
+#include "cycleCount.h"
+#include "decimator.h"
+#include "digipotBus.h"
+#include "digipotQueue.h"
+#include "flashWriter.h"
 #include "githash.h"
 #include "pcbversion.h"
 #include "systemInfo.h"
@@ -30,17 +35,34 @@
 
 #define ADC_CHANNELS         8    // Channels: AnalogInput 1 - 6, FB_5V, FB_VBUS
 #define ADC_CHANNEL_BUF_SIZE 400  // 4kHz sampling rate
+#define ADC_SAMPLE_RATE      4000
+#define ADC_BITS             12
+
+/* The filtering and calibration may take 5 ms of the 100 ms between ADC callbacks */
+#define ADC_CALLBACK_BUDGET_MS 5
 
 /* Transform for addressing 6x digipots on single I2C bus */
 #define I2C_MUX(x)  ((uint8_t)0x28 + ((x) & 0x7U))
 #define DIGIPOT_MAX (pow(2, num_digipot_bits))
 
+/* Index of the wipers in the digipot queue */
+#define MEASURE_POT(x) (x)
+#define POWER_POT(x)   (NO_CALIBRATION_CHANNELS + (x))
+
 /* Circuit constants */
 #define MEASURE_VOLTAGE_DIVIDER (20.0f / (20.0f + 130.0f))
 #define POWER_VOLTAGE_DIVIDER   (4.3f / (130.0f + 4.3f))
 #define AP64060_FB_VOLTAGE      0.8f
 #define MAX_VOLTAGE             24.5f
 
+/* Auto ranging: the range is changed when the peak of a buffer leaves 50 - 90 % of full scale, and
+** is then set to put the peak at 70 %. The band gives the hysteresis between two ranges. */
+#define AUTO_RANGE_LOW            0.5f
+#define AUTO_RANGE_HIGH           0.9f
+#define AUTO_RANGE_TARGET         0.7f
+#define AUTO_RANGE_MIN_VOLTAGE    0.5f
+#define AUTO_RANGE_SETTLE_BUFFERS 1  // Buffers flagged after the wiper has reached its target
+
 typedef struct {
     float voltage_range;
     uint16_t wiperPos;
@@ -69,8 +91,10 @@ static uint16_t measureVoltageToDigipotIdx(float measure_volt);
 static uint16_t powerVoltageToDigipotIdx(float power_volt);
 static void forceCurrentMeasurementRange();
 static void setDigipotWiper(digipot_t *digipot, unsigned int channel, uint16_t pos, bool power);
+static void syncDigipot(digipot_t *digipot, int pot, bool power);
 static void analogInputUptimeHandler(const char *input);
 static void updateDigipotWipers();
+static void updateAutoRange(const int16_t *pData, int noOfChannels, int noOfSamples);
 
 /***************************************************************************************************
 ** PRIVATE OBJECTS
@@ -84,6 +108,9 @@ static float volts[ADC_CHANNELS];         // port voltage readings
 static float ADCMeans[ADC_CHANNELS];      // ADC mean readings adjusted with portCalVal
 static float ADCMeansRaw[ADC_CHANNELS];   // ADC mean readings
 
+static CycleStats decimCycles;  // Cycles taken by decimRun in the ADC callback
+static CycleStats calCycles;    // Cycles taken by the calibration in the ADC callback
+
 FlashCalibration cal;
 
 static int loggingMode = 0;
@@ -106,6 +133,9 @@ static I2C_HandleTypeDef *hi2c                         = NULL;
 static StmGpio boost_en;
 static uint8_t num_digipot_bits = 8U;
 
+static bool autoRange[NO_CALIBRATION_CHANNELS]   = {0};
+static int settleBuffers[NO_CALIBRATION_CHANNELS] = {0};
+
 /***************************************************************************************************
 ** PRIVATE FUNCTIONS
 ***************************************************************************************************/
@@ -166,12 +196,31 @@ static float digipotIdxToPowerVoltage(uint16_t idx) {
 static void analogInputCommandHandler(const char *input) {
     unsigned int channel = 0;
     float volt_range     = 0;
+    int rate             = 0;
+    char notch[8]        = {0};
+    char fir[8]          = {0};
+    DecimNotch decimNotch;
+    DecimFir decimFir;
+    char mode[8] = {0};
+    char spike[8] = {0};
+    DecimSpike decimSpike;
+
     if (sscanf(input, "p%d inmax %f", &channel, &volt_range) == 2) {
         /* Only for channels within range and set to measure voltage. Current measurement is forced
          * to 20 mA max. */
         if (channel >= 1 && channel <= NO_CALIBRATION_CHANNELS &&
             cal.measurementType[channel - 1] == 0 && volt_range >= 0 && volt_range <= MAX_VOLTAGE) {
             measure_pots[channel - 1].wiperTarget = measureVoltageToDigipotIdx(volt_range);
+            autoRange[channel - 1]                = false;
+        }
+        else {
+            HALundefined(input);
+        }
+    }
+    else if (sscanf(input, "p%d inmax %7s", &channel, mode) == 2 && strcmp(mode, "auto") == 0) {
+        if (channel >= 1 && channel <= NO_CALIBRATION_CHANNELS &&
+            cal.measurementType[channel - 1] == 0) {
+            autoRange[channel - 1] = true;
         }
         else {
             HALundefined(input);
@@ -186,6 +235,31 @@ static void analogInputCommandHandler(const char *input) {
             HALundefined(input);
         }
     }
+    else if (sscanf(input, "p%d filter %d %7s %7s", &channel, &rate, notch, fir) == 4) {
+        /* e.g. "p1 filter 50 50 flat": 50 Hz output rate, 50 Hz notch, droop compensation */
+        if (channel >= 1 && channel <= NO_CALIBRATION_CHANNELS &&
+            decimParseNotch(notch, &decimNotch) && decimParseFir(fir, &decimFir) &&
+            decimConfigure(channel - 1, rate, decimFir, decimNotch)) {
+            USBnprintf("Port %d: %d Hz, %.1f effective bits\r\n", channel, decimRate(channel - 1),
+                       decimEffectiveBits(channel - 1));
+        }
+        else {
+            HALundefined(input);
+        }
+    }
+    else if (sscanf(input, "p%d spike %7s", &channel, spike) == 2) {
+        /* e.g. "p1 spike median3": rejects spikes of one sample */
+        if (channel < 1 || channel > NO_CALIBRATION_CHANNELS ||
+            !decimParseSpike(spike, &decimSpike) || !decimSetSpikeFilter(channel - 1, decimSpike)) {
+            HALundefined(input);
+        }
+    }
+    else if (strcmp(input, "cycles") == 0) {
+        USBnprintf("Filter: %" PRIu32 " cycles (max %" PRIu32 "), calibration: %" PRIu32
+                   " cycles (max %" PRIu32 "), budget: %" PRIu32 " cycles\r\n",
+                   decimCycles.last, decimCycles.max, calCycles.last, calCycles.max,
+                   ADC_CALLBACK_BUDGET_MS * cycleCountPerMs());
+    }
     else {
         HALundefined(input);
     }
@@ -215,8 +289,9 @@ static void printAnalogInputStatus() {
             CA_SNPRINTF(buf, len, "Port %d measures current [4-20mA]\r\n", i + 1);
         }
         else {
-            CA_SNPRINTF(buf, len, "Port %d measures voltage [0-%.0fV]\r\n", i + 1,
-                        measure_pots[i].voltage_range);
+            CA_SNPRINTF(buf, len, "Port %d measures voltage [0-%.*fV]%s\r\n", i + 1,
+                        autoRange[i] ? 1 : 0, measure_pots[i].voltage_range,
+                        autoRange[i] ? ", auto range" : "");
         }
     }
 
@@ -229,6 +304,12 @@ static void printAnalogInputStatus() {
         CA_SNPRINTF(buf, len, "VBUS is: %.2f. It should be >=%.1fV\r\n", volts[ADC_CHANNEL_VBUS],
                     MIN_VBUS);
     }
+
+    if (decimCycles.max + calCycles.max > ADC_CALLBACK_BUDGET_MS * cycleCountPerMs()) {
+        CA_SNPRINTF(buf, len, "Filter and calibration took up to %" PRIu32 " cycles of %" PRIu32
+                    "\r\n", decimCycles.max + calCycles.max,
+                    ADC_CALLBACK_BUDGET_MS * cycleCountPerMs());
+    }
     writeUSB(buf, len);
 }
 
@@ -240,6 +321,11 @@ static void printAnalogInputStatusDef() {
 
     int len = 0;
 
+    for (int i = NO_CALIBRATION_CHANNELS - 1; i >= 0; i--) {
+        CA_SNPRINTF(buf, len, "0x%08" PRIx32 ",Port %d range settling\r\n",
+                    (uint32_t)PORT_SETTLING_Msk(i), i + 1);
+    }
+
     for (int i = NO_CALIBRATION_CHANNELS - 1; i >= 0; i--) {
         CA_SNPRINTF(buf, len, "0x%08" PRIx32 ",Error I2C Channel %d\r\n",
                     (uint32_t)I2C_ERROR_Msk(i), i + 1);
@@ -286,6 +372,8 @@ static void calibrateSensorOrBoard(int noOfCalibrations, const CACalibration *ca
     //   calibrations->threshold == 1 -> sensor calibration (current mode)
     //   calibrations->threshold == 2 -> board calibration (voltage mode)
     //   calibrations->threshold == 3 -> board calibration (voltage mode)
+    //   calibrations->threshold == 4 -> add a point to the sensor calibration table
+    //   calibrations->threshold == 5 -> clear the sensor calibration table
     if (calibrations->threshold == 2 || calibrations->threshold == 3) {
         if (loggingMode != 1) {
             USBnprintf("To calibrate board, first enter voltLogging mode by typing: 'LOG p1'\r\n");
@@ -337,10 +425,16 @@ static void ADCtoVolt(float *adcMeans, int noOfChannels) {
  */
 static void voltsToAnalog(int noOfChannels) {
     /* cal.sensorCalVal[channel*2]   - Scalar
-    ** cal.sensorCalVal[channel*2+1] - Analog bias */
+    ** cal.sensorCalVal[channel*2+1] - Analog bias
+    ** cal.sensorTable[channel]      - Replaces scalar and bias when it holds 2 points or more */
     for (int channel = 0; channel < noOfChannels; channel++) {
-        analog_input[channel] =
-            volts[channel] * cal.sensorCalVal[channel * 2] + cal.sensorCalVal[channel * 2 + 1];
+        if (channel < NO_CALIBRATION_CHANNELS && pwlIsValid(&cal.sensorTable[channel])) {
+            analog_input[channel] = pwlEval(&cal.sensorTable[channel], volts[channel]);
+        }
+        else {
+            analog_input[channel] =
+                volts[channel] * cal.sensorCalVal[channel * 2] + cal.sensorCalVal[channel * 2 + 1];
+        }
     }
 }
 
@@ -358,17 +452,6 @@ static void printPorts(float *portValues) {
  * @brief   Update status bits
  */
 static void updateBoardStatus() {
-    // Check all I2C channels and attempt to reconnect if one is down
-    if (!bsGetField(BS_VERSION_ERROR_Msk)) {
-        for (int i = 0; i < NO_CALIBRATION_CHANNELS; i++) {
-            if (bsGetField(I2C_ERROR_Msk(i))) {
-                if (0 == initDigiPots(i)) {
-                    bsClearField(I2C_ERROR_Msk(i));
-                }
-            }
-        }
-    }
-
     // Check whether a port is set to measure voltage (=0) or current (=1)
     for (int i = 0; i < 6; i++) {
         bsUpdateField(PORT_MEASUREMENT_TYPE(i), cal.measurementType[i]);
@@ -396,6 +479,12 @@ static void updateBoardStatus() {
  * @param   noOfSamples Number of ADC samples in buffer per channel
  */
 static void adcCallback(int16_t *pData, int noOfChannels, int noOfSamples) {
+    /* Always run, as the boxcars may span several buffers */
+    uint32_t start = cycleCountNow();
+    decimRun(pData, noOfSamples);
+    cycleStatsAdd(&decimCycles, cycleCountNow() - start);
+    updateAutoRange(pData, noOfChannels, noOfSamples);
+
     if (!isUsbPortOpen()) {
         return;
     }
@@ -408,14 +497,16 @@ static void adcCallback(int16_t *pData, int noOfChannels, int noOfSamples) {
 
     /* Apply calibration to make ADC means match calibration station (e.g. account for errors in the
      * divider/reference voltage) */
+    start = cycleCountNow();
     for (int channel = 0; channel < noOfChannels; channel++) {
-        ADCMeansRaw[channel] = ADCMean(pData, channel);
+        ADCMeansRaw[channel] = decimValue(channel);
         ADCMeans[channel]    = ADCMeansRaw[channel] * cal.portVoltCalVal[channel];
     }
 
     // We exclude the last two channels (28V rail and VBUS) when converting the voltages to analog.
     ADCtoVolt(ADCMeans, noOfChannels);
     voltsToAnalog(noOfChannels - 2);
+    cycleStatsAdd(&calCycles, cycleCountNow() - start);
 
     if (loggingMode == 0) {
         printPorts(analog_input);
@@ -429,37 +520,95 @@ static void adcCallback(int16_t *pData, int noOfChannels, int noOfSamples) {
 }
 
 /*!
-** @brief  Initialize the digital potentiometers
+** @brief Flags the ports whose range is changing, and moves the range of the auto ranging ports
+**
+** A buffer is flagged while the wiper moves, and for AUTO_RANGE_SETTLE_BUFFERS more buffers as it
+** may hold samples from before the last step. The new range is only written to wiperTarget, so the
+** wiper is stepped by the digipot queue without blocking.
+*/
+static void updateAutoRange(const int16_t *pData, int noOfChannels, int noOfSamples) {
+    for (int i = 0; i < NO_CALIBRATION_CHANNELS && i < noOfChannels; i++) {
+        digipot_t *pot = &measure_pots[i];
+
+        if (pot->wiperTarget != pot->wiperPos || !digipotQueueIsSettled(MEASURE_POT(i))) {
+            settleBuffers[i] = AUTO_RANGE_SETTLE_BUFFERS;
+            bsSetField(PORT_SETTLING_Msk(i));
+            continue;
+        }
+        if (settleBuffers[i] > 0) {
+            settleBuffers[i]--;
+            bsSetField(PORT_SETTLING_Msk(i));
+            continue;
+        }
+        bsClearField(PORT_SETTLING_Msk(i));
+
+        if (!autoRange[i] || cal.measurementType[i]) {
+            continue;
+        }
+
+        /* The inputs are unipolar, so only the peak sets the range */
+        int16_t peak = 0;
+        for (int j = 0; j < noOfSamples; j++) {
+            if (pData[j * noOfChannels + i] > peak) {
+                peak = pData[j * noOfChannels + i];
+            }
+        }
+
+        float fullScale = (float)peak / ADC_MAX;
+        if (fullScale >= AUTO_RANGE_LOW && fullScale <= AUTO_RANGE_HIGH) {
+            continue;
+        }
+
+        /* The level of a clipped signal is unknown, so the range is doubled until it fits */
+        float range = (peak >= ADC_MAX) ? 2.0f * pot->voltage_range
+                                        : fullScale * pot->voltage_range / AUTO_RANGE_TARGET;
+        if (range < AUTO_RANGE_MIN_VOLTAGE) {
+            range = AUTO_RANGE_MIN_VOLTAGE;
+        }
+        else if (range > MAX_VOLTAGE) {
+            range = MAX_VOLTAGE;
+        }
+
+        /* Nothing to do at the ends of the range, or if the signal is already within a step */
+        uint16_t idx = measureVoltageToDigipotIdx(range);
+        if (idx != pot->wiperTarget) {
+            pot->wiperTarget = idx;
+            settleBuffers[i] = AUTO_RANGE_SETTLE_BUFFERS;
+        }
+    }
+}
+
+/*!
+** @brief  Initialize the digital potentiometers and add them to the digipot queue
+** @note   Blocking, so only used at start-up. The queue retries the wipers which did not answer
 **
 ** @param  i Index of the digital potentiometer to initialize
 */
 static int initDigiPots(unsigned int i) {
-    int ret = 0;
-    if (0 == mcp4531_init(&measure_pots[i].handle, hi2c, I2C_MUX(i), num_digipot_bits, 0)) {
-        // Set wiper to 5V range by default
-        measure_pots[i].wiperTarget = measureVoltageToDigipotIdx(5.1);
-        setDigipotWiper(&measure_pots[i], i, measureVoltageToDigipotIdx(5.1), false);
-    }
-    else {
-        bsSetError(I2C_ERROR_Msk(i));
-        ret = -1;
-    }
+    // Set wipers to 5V range and 5V (5.1V) power output by default
+    measure_pots[i].wiperTarget = measureVoltageToDigipotIdx(5.1);
+    power_pots[i].wiperTarget   = powerVoltageToDigipotIdx(5.1);
 
-    if (0 == mcp4531_init(&power_pots[i].handle, hi2c, I2C_MUX(i), num_digipot_bits, 1)) {
-        // Set wiper to 5V (5.1V) power output by default
-        power_pots[i].wiperTarget = powerVoltageToDigipotIdx(5.1);
-        setDigipotWiper(&power_pots[i], i, powerVoltageToDigipotIdx(5.1), true);
+    if (0 == mcp4531_init(&measure_pots[i].handle, hi2c, I2C_MUX(i), num_digipot_bits, 0) &&
+        0 == mcp4531_init(&power_pots[i].handle, hi2c, I2C_MUX(i), num_digipot_bits, 1)) {
+        setDigipotWiper(&measure_pots[i], i, measure_pots[i].wiperTarget, false);
+        setDigipotWiper(&power_pots[i], i, power_pots[i].wiperTarget, true);
     }
     else {
         bsSetError(I2C_ERROR_Msk(i));
-        ret = -1;
     }
 
-    return ret;
+    bool isOk = !bsGetField(I2C_ERROR_Msk(i));
+    digipotQueueAdd(MEASURE_POT(i), I2C_MUX(i) << 1, MCP4X_WIPER_0_ADDR,
+                    measure_pots[i].wiperTarget, isOk);
+    digipotQueueAdd(POWER_POT(i), I2C_MUX(i) << 1, MCP4X_WIPER_1_ADDR, power_pots[i].wiperTarget,
+                    isOk);
+
+    return isOk ? 0 : -1;
 }
 
 /*!
-** @brief Set the wiper position of a digital potentiometer and update the local copy
+** @brief Set the wiper position of a digital potentiometer and update the local copy (blocking)
 */
 static void setDigipotWiper(digipot_t *digipot, unsigned int channel, uint16_t pos, bool power) {
     if (0 == mcp4531_setWiperPos(&digipot->handle, pos)) {
@@ -472,36 +621,53 @@ static void setDigipotWiper(digipot_t *digipot, unsigned int channel, uint16_t p
     }
 }
 
+/*!
+** @brief Updates the local copy of a digital potentiometer from the digipot queue
+*/
+static void syncDigipot(digipot_t *digipot, int pot, bool power) {
+    uint16_t pos = digipotQueueGetPos(pot);
+    if (pos != digipot->wiperPos) {
+        digipot->wiperPos = pos;
+        digipot->voltage_range =
+            power ? digipotIdxToPowerVoltage(pos) : digipotIdxToMeasureVoltage(pos);
+    }
+}
+
 /*!
 ** @brief Forces the measurement range to be suitable for 4 - 20 mA for current measurement channels
 */
 static void forceCurrentMeasurementRange() {
     for (int i = 0; i < NO_CALIBRATION_CHANNELS; i++) {
         if (cal.measurementType[i]) {
-            setDigipotWiper(&measure_pots[i], i, measureVoltageToDigipotIdx(V_REF), false);
+            measure_pots[i].wiperTarget = measureVoltageToDigipotIdx(V_REF);
         }
     }
 }
 
 /*!
 ** @brief Gradually update the digipot wipers to their target position
+**
+** The wipers are written by the digipot queue, which starts at most one I2C transfer per call and
+** steps each wiper at most once every DIGIPOT_STEP_MS.
 */
 static void updateDigipotWipers() {
     for (int i = 0; i < NO_CALIBRATION_CHANNELS; i++) {
-        digipot_t *dp = &measure_pots[i];
-        if (dp->wiperTarget > dp->wiperPos) {
-            setDigipotWiper(dp, i, dp->wiperPos + 1, false);
-        }
-        else if (dp->wiperTarget < dp->wiperPos) {
-            setDigipotWiper(dp, i, dp->wiperPos - 1, false);
-        }
+        digipotQueueSetTarget(MEASURE_POT(i), measure_pots[i].wiperTarget);
+        digipotQueueSetTarget(POWER_POT(i), power_pots[i].wiperTarget);
+    }
+
+    digipotQueueRun(HAL_GetTick());
 
-        dp = &power_pots[i];
-        if (dp->wiperTarget > dp->wiperPos) {
-            setDigipotWiper(dp, i, dp->wiperPos + 1, true);
+    for (int i = 0; i < NO_CALIBRATION_CHANNELS; i++) {
+        syncDigipot(&measure_pots[i], MEASURE_POT(i), false);
+        syncDigipot(&power_pots[i], POWER_POT(i), true);
+
+        // Clear the error once both wipers of the channel have answered again
+        if (digipotQueueHasFailed(MEASURE_POT(i)) || digipotQueueHasFailed(POWER_POT(i))) {
+            bsSetError(I2C_ERROR_Msk(i));
         }
-        else if (dp->wiperTarget < dp->wiperPos) {
-            setDigipotWiper(dp, i, dp->wiperPos - 1, true);
+        else if (bsGetField(I2C_ERROR_Msk(i))) {
+            bsClearField(I2C_ERROR_Msk(i));
         }
     }
 }
@@ -525,13 +691,16 @@ void analogInputInit(ADC_HandleTypeDef *hadc, CRC_HandleTypeDef *hcrc, I2C_Handl
     initCAProtocol(&caProto, usbRx);
 
     ADCMonitorInit(hadc, ADCBuffer, sizeof(ADCBuffer) / sizeof(int16_t));
+    cycleCountInit();
+    decimInit(ADC_CHANNELS, ADC_CHANNEL_BUF_SIZE, ADC_SAMPLE_RATE, ADC_BITS);
     calibrationInit(hcrc, &cal, sizeof(cal));
-    forceCurrentMeasurementRange();
 
     /* Initialise basic uptime counters */
     uptime_init(hcrc, 0, NULL, bootMsg, GIT_VERSION);
 
     hi2c = _hi2c;
+    digipotQueueInit();
+    digipotBusInit(hi2c);
 
     if (0 != boardSetup(AnalogInput, (pcbVersion){BREAKING_MAJOR, BREAKING_MINOR},
                         ANALOG_INPUT_ERROR_Msk)) {
@@ -553,6 +722,7 @@ void analogInputInit(ADC_HandleTypeDef *hadc, CRC_HandleTypeDef *hcrc, I2C_Handl
     for (int i = 0; i < NO_CALIBRATION_CHANNELS; i++) {
         (void)initDigiPots(i);
     }
+    forceCurrentMeasurementRange();
     stmGpioInit(&boost_en, BOOST_EN_GPIO_Port, BOOST_EN_Pin, STM_GPIO_OUTPUT);
     stmSetGpio(boost_en, true);  // Enable boost converter
 }
@@ -567,4 +737,5 @@ void analogInputLoop(const char *bootMsg) {
     ADCMonitorLoop(adcCallback);
     uptime_update();
     updateDigipotWipers();
+    flashWriterRun();
 }
@@ -11,10 +11,12 @@
  * - Sensor calibration: this "calibration" is really a user applied linear transformation between
  *   the measurement output of the sensor (e.g. voltage or current) and the physical value (e.g.
  *   pressure). It is stored in cal.sensorCalVal[] (even indices are scalars, odd indices are
- *   biases).
+ *   biases). Non-linear sensors can instead use a table of up to 16 points per channel, stored in
+ *   cal.sensorTable[] and interpolated linearly between the points.
  */
 
 #include <math.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <string.h>
 
@@ -22,6 +24,7 @@
 #include "StmGpio.h"
 #include "USBprint.h"
 #include "calibration.h"
+#include "flashWriter.h"
 
 /***************************************************************************************************
 ** DEFINES
@@ -43,6 +46,8 @@ extern uint32_t _FlashAddrCal;  // Starting address of calibration values in FLA
 static void setMeasurementType(int channel, int measureCurrent);
 static void channelGpioInit(FlashCalibration *cal);
 static void setDefaultCalibration(FlashCalibration *cal);
+static void printSensorTables(FlashCalibration *cal);
+static void onCalibrationStored(int status);
 
 /***************************************************************************************************
 ** PRIVATE OBJECTS
@@ -98,6 +103,44 @@ static void setDefaultCalibration(FlashCalibration *cal) {
         cal->portResCalVal[i]   = PORT_RES_CAL_VAL_DEFAULT;
         cal->measurementType[i] = 0;
     }
+
+    for (int i = 0; i < NO_CALIBRATION_CHANNELS; i++) {
+        pwlClear(&cal->sensorTable[i]);
+    }
+}
+
+/*!
+ * @brief   Prints the sensor calibration tables which are in use, as CAL commands
+ * @param   cal Calibration
+ */
+static void printSensorTables(FlashCalibration *cal) {
+    static char buf[800];
+
+    for (int ch = 0; ch < NO_CALIBRATION_CHANNELS; ch++) {
+        const PwlTable *table = &cal->sensorTable[ch];
+        if (table->noOfPoints == 0) {
+            continue;
+        }
+
+        int len = 0;
+        CA_SNPRINTF(buf, len, "Calibration table: CAL");
+        for (uint32_t i = 0; i < table->noOfPoints && i < PWL_MAX_POINTS; i++) {
+            CA_SNPRINTF(buf, len, " %d,%.10f,%.10f,%d", ch + 1, table->x[i], table->y[i],
+                        CAL_TABLE_POINT);
+        }
+        CA_SNPRINTF(buf, len, "\r\n");
+        writeUSB(buf, len);
+    }
+}
+
+/*!
+ * @brief   Called by the flash writer once the calibration is written
+ * @param   status 0 on success
+ */
+static void onCalibrationStored(int status) {
+    if (status != 0) {
+        USBnprintf("Calibration was not stored in FLASH");
+    }
 }
 
 /***************************************************************************************************
@@ -170,6 +213,8 @@ void calibrateSensor(int noOfCalibrations, const CACalibration *calibrations, Fl
     -------------------------------------------------------------------------
     CAL port,slope,offset,0         - Calibrates the sensor in voltage mode
     CAL port,slope,offset,1         - Calibrates the sensor in current mode
+    CAL port,input,value,4          - Adds a point to the sensor table
+    CAL port,0,0,5                  - Clears the sensor table
     -------------------------------------------------------------------------
     */
     for (int i = 0; i < noOfCalibrations; i++) {
@@ -178,16 +223,33 @@ void calibrateSensor(int noOfCalibrations, const CACalibration *calibrations, Fl
             continue;
         }
 
+        const int channel = calibrations[i].port - 1;
+
+        if (calibrations[i].threshold == CAL_TABLE_POINT) {
+            if (pwlAddPoint(&cal->sensorTable[channel], calibrations[i].alpha,
+                            calibrations[i].beta) != 0) {
+                USBnprintf("Calibration table of port %d is full\r\n", channel + 1);
+            }
+            continue;
+        }
+
+        if (calibrations[i].threshold == CAL_TABLE_CLEAR) {
+            pwlClear(&cal->sensorTable[channel]);
+            continue;
+        }
+
         // Make sure the measurement type has been explicitly set
         if (calibrations[i].threshold != 0 && calibrations[i].threshold != 1) {
             continue;
         }
 
-        const int channel                  = calibrations[i].port - 1;
         cal->sensorCalVal[channel * 2]     = calibrations[i].alpha;
         cal->sensorCalVal[channel * 2 + 1] = calibrations[i].beta;
-        cal->measurementType[channel]      = calibrations->threshold;
-        setMeasurementType(channel, calibrations->threshold);
+        cal->measurementType[channel]      = calibrations[i].threshold;
+        setMeasurementType(channel, calibrations[i].threshold);
+
+        // A new scalar and offset replace the table
+        pwlClear(&cal->sensorTable[channel]);
     }
     // Calibrations are stored in flash
     calibrationRW(true, cal, calSize);
@@ -202,9 +264,20 @@ void calibrateSensor(int noOfCalibrations, const CACalibration *calibrations, Fl
 void calibrationInit(CRC_HandleTypeDef *hcrc, FlashCalibration *cal, uint32_t size) {
     hcrc_ = hcrc;
 
-    // If calibration value is not stored in FLASH use default calibration
-    if (readFromFlashCRC(hcrc_, (uint32_t)FLASH_ADDR_CAL, (uint8_t *)cal, size) != 0) {
-        setDefaultCalibration(cal);
+    // If calibration value is not stored in FLASH use default calibration. A calibration stored
+    // before it was written in the background is read with readFromFlashCRC, and one stored
+    // before the sensor tables were added is kept, without tables
+    if (flashWriterRead((uint32_t)FLASH_ADDR_CAL, cal, size) != (int)size &&
+        readFromFlashCRC(hcrc_, (uint32_t)FLASH_ADDR_CAL, (uint8_t *)cal, size) != 0) {
+        if (readFromFlashCRC(hcrc_, (uint32_t)FLASH_ADDR_CAL, (uint8_t *)cal,
+                             offsetof(FlashCalibration, sensorTable)) == 0) {
+            for (int i = 0; i < NO_CALIBRATION_CHANNELS; i++) {
+                pwlClear(&cal->sensorTable[i]);
+            }
+        }
+        else {
+            setDefaultCalibration(cal);
+        }
     }
 
     // Initialise channels to measure current or voltage
@@ -219,7 +292,8 @@ void calibrationInit(CRC_HandleTypeDef *hcrc, FlashCalibration *cal, uint32_t si
  */
 void calibrationRW(bool write, FlashCalibration *cal, uint32_t size) {
     if (write) {
-        if (writeToFlashCRC(hcrc_, (uint32_t)FLASH_ADDR_CAL, (uint8_t *)cal, size) != 0) {
+        // Written in the background by the main loop: cal must stay valid until then
+        if (flashWriterStart((uint32_t)FLASH_ADDR_CAL, cal, size, onCalibrationStored) != 0) {
             USBnprintf("Calibration was not stored in FLASH");
         }
     }
@@ -234,5 +308,7 @@ void calibrationRW(bool write, FlashCalibration *cal, uint32_t size) {
         }
         CA_SNPRINTF(buf, len, "\r\n");
         writeUSB(buf, len);
+
+        printSensorTables(cal);
     }
 }
\ No newline at end of file
@@ -0,0 +1,61 @@
+/*!
+** @file    digipotBus.c
+** @brief   I2C interrupt glue between the HAL and digipotQueue.c
+** @date:   18/10/2026
+*/
+
+#include <stddef.h>
+
+#include "digipotBus.h"
+#include "digipotQueue.h"
+
+/***************************************************************************************************
+** PRIVATE VARIABLES
+***************************************************************************************************/
+
+static I2C_HandleTypeDef* bus = NULL;
+
+/***************************************************************************************************
+** PUBLIC FUNCTION DEFINITIONS
+***************************************************************************************************/
+
+void digipotBusInit(I2C_HandleTypeDef* hi2c) {
+    bus = hi2c;
+}
+
+/*!
+** @brief Starts an interrupt driven write
+**
+** @return 0 if the transfer was started
+*/
+int digipotBusWrite(uint16_t addr, uint8_t* data, uint16_t len) {
+    if (bus == NULL) {
+        return -1;
+    }
+    return (HAL_I2C_Master_Transmit_IT(bus, addr, data, len) == HAL_OK) ? 0 : -1;
+}
+
+/*!
+** @brief Drops a write which has not completed in time
+**
+** Re-initialising the peripheral also disables its interrupts, so the dropped write cannot raise
+** a callback once the next one has been started
+*/
+void digipotBusAbort() {
+    if (bus != NULL) {
+        (void) HAL_I2C_DeInit(bus);
+        (void) HAL_I2C_Init(bus);
+    }
+}
+
+void HAL_I2C_MasterTxCpltCallback(I2C_HandleTypeDef* hi2c) {
+    if (hi2c == bus) {
+        digipotQueueTxComplete();
+    }
+}
+
+void HAL_I2C_ErrorCallback(I2C_HandleTypeDef* hi2c) {
+    if (hi2c == bus) {
+        digipotQueueError();
+    }
+}
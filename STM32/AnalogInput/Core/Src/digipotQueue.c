@@ -0,0 +1,224 @@
+/*!
+** @file    digipotQueue.c
+** @brief   Non-blocking, rate limited updates of the digipot wipers
+** @date:   18/10/2026
+**
+** Each wiper only holds its latest target, so any number of commands while it is moving cost a
+** single pending update. The wipers are served round-robin, one interrupt driven write at a time.
+** A write moves a wiper by one step, and each wiper steps at most once every DIGIPOT_STEP_MS, so
+** the outputs ramp at the same rate however fast the main loop runs.
+**
+** The interrupts only record the result of the write in flight. Everything else is done by
+** digipotQueueRun in the main loop. A write which has not completed after DIGIPOT_TIMEOUT_MS is
+** aborted on the bus before it is counted as failed, so its callback cannot end the next one.
+*/
+
+#include <stddef.h>
+#include <string.h>
+
+#include "MCP4531.h"
+#include "digipotBus.h"
+#include "digipotQueue.h"
+
+/***************************************************************************************************
+** TYPEDEFS
+***************************************************************************************************/
+
+typedef enum {
+    DIGIPOT_IDLE,
+    DIGIPOT_BUSY,
+    DIGIPOT_DONE,
+    DIGIPOT_ERROR
+} DigipotXfer;
+
+typedef struct DigipotEntry {
+    bool isUsed;
+    bool hasFailed;
+    uint16_t addr;          // Device address, as given to the HAL
+    uint8_t wiperAddr;      // Register of the wiper
+    uint16_t pos;           // Position acknowledged by the device
+    uint16_t target;
+    uint32_t tick;          // Start of the last write
+} DigipotEntry;
+
+/***************************************************************************************************
+** PRIVATE VARIABLES
+***************************************************************************************************/
+
+static DigipotEntry pots[DIGIPOT_QUEUE_MAX_POTS];
+
+static int next         = 0;    // First wiper to consider for the next write
+static int current      = -1;   // Wiper being written
+static uint16_t writing = 0;    // Position being written
+static uint8_t tx[2];
+static volatile DigipotXfer xfer = DIGIPOT_IDLE;
+
+/***************************************************************************************************
+** PRIVATE FUNCTION DEFINITIONS
+***************************************************************************************************/
+
+static bool isValid(int pot) {
+    return pot >= 0 && pot < DIGIPOT_QUEUE_MAX_POTS && pots[pot].isUsed;
+}
+
+static bool isDue(const DigipotEntry* e, uint32_t now) {
+    if (e->hasFailed) {
+        return (now - e->tick) >= DIGIPOT_RETRY_MS;
+    }
+    return e->pos != e->target && (now - e->tick) >= DIGIPOT_STEP_MS;
+}
+
+/*!
+** @brief Records the result of the write in flight, if it has finished or timed out
+*/
+static void finish(uint32_t now) {
+    DigipotXfer x = xfer;
+    if (x == DIGIPOT_BUSY && (now - pots[current].tick) > DIGIPOT_TIMEOUT_MS) {
+        digipotBusAbort();
+        x = DIGIPOT_ERROR;
+    }
+    if (x != DIGIPOT_DONE && x != DIGIPOT_ERROR) {
+        return;
+    }
+
+    DigipotEntry* e = &pots[current];
+    if (x == DIGIPOT_DONE) {
+        e->pos       = writing;
+        e->hasFailed = false;
+    }
+    else {
+        e->hasFailed = true;
+    }
+
+    current = -1;
+    xfer    = DIGIPOT_IDLE;
+}
+
+static void start(int pot, uint32_t now) {
+    DigipotEntry* e = &pots[pot];
+
+    /* The position of a wiper which has failed is unknown, so it goes straight to its target */
+    if (e->hasFailed || e->target == e->pos) {
+        writing = e->target;
+    }
+    else {
+        writing = (e->target > e->pos) ? e->pos + 1 : e->pos - 1;
+    }
+
+    tx[0] = (uint8_t)(e->wiperAddr << 4) | MCP4X_WRITE_CMD | ((writing >> 8) & 0x01U);
+    tx[1] = writing & 0xFFU;
+
+    /* The state is set first, since the transfer may complete before the call returns */
+    e->tick = now;
+    current = pot;
+    xfer    = DIGIPOT_BUSY;
+    if (digipotBusWrite(e->addr, tx, sizeof(tx)) != 0) {
+        xfer = DIGIPOT_ERROR;
+    }
+}
+
+/***************************************************************************************************
+** PUBLIC FUNCTION DEFINITIONS
+***************************************************************************************************/
+
+void digipotQueueInit() {
+    memset(pots, 0, sizeof(pots));
+    next    = 0;
+    current = -1;
+    xfer    = DIGIPOT_IDLE;
+}
+
+/*!
+** @brief Adds a wiper to the queue
+**
+** @param[in] pot       Index of the wiper, from 0 to DIGIPOT_QUEUE_MAX_POTS - 1
+** @param[in] addr      Device address, as given to the HAL
+** @param[in] wiperAddr Register of the wiper (MCP4X_WIPER_0_ADDR or MCP4X_WIPER_1_ADDR)
+** @param[in] pos       Current position of the wiper, which is also its target
+** @param[in] isOk      False if the device did not answer. It is then retried, see usage
+*/
+void digipotQueueAdd(int pot, uint16_t addr, uint8_t wiperAddr, uint16_t pos, bool isOk) {
+    if (pot < 0 || pot >= DIGIPOT_QUEUE_MAX_POTS) {
+        return;
+    }
+
+    DigipotEntry* e = &pots[pot];
+    e->isUsed       = true;
+    e->hasFailed    = !isOk;
+    e->addr         = addr;
+    e->wiperAddr    = wiperAddr;
+    e->pos          = pos;
+    e->target       = pos;
+    e->tick         = 0;
+}
+
+/*!
+** @brief Sets the position the wiper moves to. Replaces any target not reached yet
+*/
+void digipotQueueSetTarget(int pot, uint16_t target) {
+    if (isValid(pot)) {
+        pots[pot].target = target;
+    }
+}
+
+/*!
+** @brief Last position written successfully to the wiper
+*/
+uint16_t digipotQueueGetPos(int pot) {
+    return isValid(pot) ? pots[pot].pos : 0;
+}
+
+/*!
+** @brief True once the wiper has reached its target and no write to it is in flight
+*/
+bool digipotQueueIsSettled(int pot) {
+    if (!isValid(pot)) {
+        return true;
+    }
+    return !pots[pot].hasFailed && pots[pot].pos == pots[pot].target && current != pot;
+}
+
+bool digipotQueueHasFailed(int pot) {
+    return isValid(pot) && pots[pot].hasFailed;
+}
+
+/*!
+** @brief Records the result of the last write and starts the next one which is due, if any
+**
+** @param[in] now Current tick in ms
+*/
+void digipotQueueRun(uint32_t now) {
+    if (current >= 0) {
+        finish(now);
+        if (current >= 0) {
+            return;
+        }
+    }
+
+    for (int i = 0; i < DIGIPOT_QUEUE_MAX_POTS; i++) {
+        int pot = (next + i) % DIGIPOT_QUEUE_MAX_POTS;
+        if (pots[pot].isUsed && isDue(&pots[pot], now)) {
+            next = (pot + 1) % DIGIPOT_QUEUE_MAX_POTS;
+            start(pot, now);
+            return;
+        }
+    }
+}
+
+/*!
+** @brief Called from the interrupt when the write in flight has finished
+*/
+void digipotQueueTxComplete() {
+    if (xfer == DIGIPOT_BUSY) {
+        xfer = DIGIPOT_DONE;
+    }
+}
+
+/*!
+** @brief Called from the interrupt when the write in flight has failed
+*/
+void digipotQueueError() {
+    if (xfer == DIGIPOT_BUSY) {
+        xfer = DIGIPOT_ERROR;
+    }
+}
@@ -14,6 +14,8 @@
 /* USER CODE BEGIN Includes */
 #include "analog_input.h"
 #include "CAProtocolStm.h"
+#include "flashRecordStm.h"
+#include "flashWriter.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -103,6 +105,7 @@ int main(void)
   MX_CRC_Init();
   MX_I2C3_Init();
   /* USER CODE BEGIN 2 */
+  flashWriterInit(&flashRecordStmOps, flashRecordStmPauseWwdg);
   analogInputInit(&hadc1, &hcrc, &hi2c3, bootMsg);
   HAL_TIM_Base_Start_IT(&htim2);
   /* USER CODE END 2 */
@@ -0,0 +1,61 @@
+/*!
+** @file    ADCWatchdog.h
+** @brief   Header file of ADCWatchdog.c
+** @date:   18/10/2026
+*/
+
+#ifndef ADC_WATCHDOG_H_
+#define ADC_WATCHDOG_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+** Usage:
+** * Initialise with the same circular DMA buffer as given to ADCMonitorInit using "adcWatchdogInit"
+** * Add a window per channel to watch using "adcWatchdogAdd". The callback is called from interrupt
+**   context the first time a channel leaves its window, so it must only do what is needed to make
+**   the outputs safe (e.g. write the output registers), and leave the rest to the main loop.
+** * Call "adcWatchdogScan" from the interrupt of the timer triggering the ADC, with the index of
+**   the last completed sample (see "adcWatchdogDmaIndex"). Every sample is checked once.
+** * "adcWatchdogScanIndex" tells which sample was being converted at the last scan, e.g. to locate
+**   an event of the main loop in the ADC buffer to within a scan period.
+** * Poll "adcWatchdogIsTripped" in the main loop, and re-arm with "adcWatchdogRearm" when handled.
+*/
+
+/***************************************************************************************************
+** DEFINES
+***************************************************************************************************/
+
+#define ADC_WATCHDOG_MAX_WATCHES 8
+
+/***************************************************************************************************
+** TYPEDEFS
+***************************************************************************************************/
+
+/*!
+** @brief Called (in interrupt context) when a watched channel leaves its window
+**
+** @param id      Watch id, as returned by adcWatchdogAdd
+** @param channel ADC channel (index in the scan sequence) which tripped
+** @param value   Raw ADC value of the sample which tripped the watch
+*/
+typedef void (*AdcWatchdogTripFn)(int id, int channel, int16_t value);
+
+/***************************************************************************************************
+** PUBLIC FUNCTION DECLARATIONS
+***************************************************************************************************/
+
+void adcWatchdogInit(const int16_t* adcBuffer, int noOfChannels, int noOfSamples);
+int adcWatchdogAdd(int channel, int16_t low, int16_t high, int debounce, AdcWatchdogTripFn onTrip);
+void adcWatchdogSetLimits(int id, int16_t low, int16_t high);
+void adcWatchdogEnable(int id, bool enable);
+
+int adcWatchdogDmaIndex(uint32_t dmaRemaining);
+void adcWatchdogScan(int writeIdx);
+int adcWatchdogScanIndex();
+
+bool adcWatchdogIsTripped(int id);
+void adcWatchdogRearm(int id);
+
+#endif /* ADC_WATCHDOG_H_ */
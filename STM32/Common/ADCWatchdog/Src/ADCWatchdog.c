@@ -0,0 +1,183 @@
+/*!
+** @file    ADCWatchdog.c
+** @brief   Per-sample threshold protection on ADC channels
+** @date:   18/10/2026
+**
+** The ADCMonitor only hands a buffer over every 100 ms, so any safety reaction based on it is up to
+** 200 ms late. This module checks every sample of selected channels against a window as soon as
+** the DMA has written it, and calls back when a channel leaves its window.
+**
+** The STM32F4 analog watchdog is not used, since it only supports one window for either one or
+** all channels of the ADC, whereas the boards need separate windows on several channels.
+*/
+
+#include <stddef.h>
+
+#include "ADCWatchdog.h"
+
+/***************************************************************************************************
+** TYPEDEFS
+***************************************************************************************************/
+
+typedef struct AdcWatch {
+    int channel;
+    int16_t low;
+    int16_t high;
+    int debounce;    // Number of consecutive samples outside the window before tripping
+    int outCount;    // Current number of consecutive samples outside the window
+    bool isEnabled;
+    volatile bool isTripped;
+    AdcWatchdogTripFn onTrip;
+} AdcWatch;
+
+/***************************************************************************************************
+** PRIVATE VARIABLES
+***************************************************************************************************/
+
+static const int16_t* buffer = NULL;
+static int noChannels        = 0;
+static int noSamples         = 0;
+static int lastIdx           = 0;
+
+static AdcWatch watches[ADC_WATCHDOG_MAX_WATCHES];
+static int noWatches = 0;
+
+/***************************************************************************************************
+** PUBLIC FUNCTION DEFINITIONS
+***************************************************************************************************/
+
+/*!
+** @brief Initialises the watchdog and removes all watches
+**
+** @param[in] adcBuffer    Circular ADC DMA buffer
+** @param[in] noOfChannels Number of interleaved channels in the buffer
+** @param[in] noOfSamples  Number of samples per channel in the whole buffer
+*/
+void adcWatchdogInit(const int16_t* adcBuffer, int noOfChannels, int noOfSamples) {
+    buffer     = adcBuffer;
+    noChannels = noOfChannels;
+    noSamples  = noOfSamples;
+    lastIdx    = 0;
+    noWatches  = 0;
+}
+
+/*!
+** @brief Adds a window to watch on a channel
+**
+** @param[in] channel  Channel (index in the ADC scan sequence) to watch
+** @param[in] low      Trips when samples are below this value
+** @param[in] high     Trips when samples are above this value
+** @param[in] debounce Number of consecutive samples outside the window required to trip (min 1)
+** @param[in] onTrip   Function called from interrupt context when tripping. May be NULL
+**
+** @return Watch id, or -1 if the watch could not be added
+*/
+int adcWatchdogAdd(int channel, int16_t low, int16_t high, int debounce, AdcWatchdogTripFn onTrip) {
+    if (noWatches >= ADC_WATCHDOG_MAX_WATCHES || channel < 0 || channel >= noChannels) {
+        return -1;
+    }
+
+    AdcWatch* w  = &watches[noWatches];
+    w->channel   = channel;
+    w->low       = low;
+    w->high      = high;
+    w->debounce  = (debounce > 0) ? debounce : 1;
+    w->outCount  = 0;
+    w->isTripped = false;
+    w->onTrip    = onTrip;
+    w->isEnabled = true;
+
+    return noWatches++;
+}
+
+/*!
+** @brief Updates the window of a watch, e.g. after a calibration change
+*/
+void adcWatchdogSetLimits(int id, int16_t low, int16_t high) {
+    if (id >= 0 && id < noWatches) {
+        watches[id].low  = low;
+        watches[id].high = high;
+    }
+}
+
+/*!
+** @brief Enables or disables a watch. A disabled watch never trips
+*/
+void adcWatchdogEnable(int id, bool enable) {
+    if (id >= 0 && id < noWatches) {
+        watches[id].outCount  = 0;
+        watches[id].isEnabled = enable;
+    }
+}
+
+/*!
+** @brief Converts the remaining number of DMA transfers into the index of the next sample
+**
+** @param[in] dmaRemaining Remaining transfers in the current DMA cycle (e.g. NDTR register)
+**
+** @return Index of the sample being written. All samples before it are complete
+*/
+int adcWatchdogDmaIndex(uint32_t dmaRemaining) {
+    if (noChannels == 0) {
+        return 0;
+    }
+
+    int written = noChannels * noSamples - (int)dmaRemaining;
+    return (written / noChannels) % noSamples;
+}
+
+/*!
+** @brief Checks all samples written since the last call against the watch windows
+**
+** @param[in] writeIdx Index of the sample currently being written (not yet complete)
+*/
+void adcWatchdogScan(int writeIdx) {
+    if (buffer == NULL || writeIdx < 0 || writeIdx >= noSamples) {
+        return;
+    }
+
+    for (; lastIdx != writeIdx; lastIdx = (lastIdx + 1) % noSamples) {
+        const int16_t* sample = &buffer[lastIdx * noChannels];
+
+        for (AdcWatch* w = watches; w < &watches[noWatches]; w++) {
+            if (!w->isEnabled || w->isTripped) {
+                continue;
+            }
+
+            int16_t value = sample[w->channel];
+            if (value >= w->low && value <= w->high) {
+                w->outCount = 0;
+            }
+            else if (++w->outCount >= w->debounce) {
+                w->isTripped = true;
+                if (w->onTrip) {
+                    w->onTrip(w - watches, w->channel, value);
+                }
+            }
+        }
+    }
+}
+
+/*!
+** @brief Index of the sample which was being written at the last scan
+*/
+int adcWatchdogScanIndex() {
+    return lastIdx;
+}
+
+/*!
+** @brief Returns true if the watch has tripped since it was last (re-)armed
+*/
+bool adcWatchdogIsTripped(int id) {
+    return (id >= 0 && id < noWatches) ? watches[id].isTripped : false;
+}
+
+/*!
+** @brief Re-arms a tripped watch, so it can trip again
+*/
+void adcWatchdogRearm(int id) {
+    if (id >= 0 && id < noWatches) {
+        watches[id].outCount  = 0;
+        watches[id].isTripped = false;
+    }
+}
@@ -0,0 +1,39 @@
+/*!
+** @file    cycleCount.h
+** @brief   Header file of cycleCount.c and cycleCountStm.c
+** @date:   19/10/2026
+*/
+
+#ifndef CYCLE_COUNT_H_
+#define CYCLE_COUNT_H_
+
+#include <stdint.h>
+
+/*
+** Usage:
+** * Call "cycleCountInit" once at start-up to start the DWT cycle counter.
+** * Read "cycleCountNow" before and after the code to measure, and give the difference to
+**   "cycleStatsAdd". The counter wraps after 2^32 cycles, so the difference stays correct for up
+**   to 44 s at 96 MHz.
+** * "cycleCountPerMs" gives the cycles per ms, to compare the measurements with a budget in time.
+*/
+
+/***************************************************************************************************
+** TYPEDEFS
+***************************************************************************************************/
+
+typedef struct CycleStats {
+    uint32_t last;  // Cycles of the last measurement
+    uint32_t max;   // Most cycles measured since start-up
+} CycleStats;
+
+/***************************************************************************************************
+** PUBLIC FUNCTION DECLARATIONS
+***************************************************************************************************/
+
+void cycleCountInit();
+uint32_t cycleCountNow();
+uint32_t cycleCountPerMs();
+void cycleStatsAdd(CycleStats* stats, uint32_t cycles);
+
+#endif /* CYCLE_COUNT_H_ */
@@ -0,0 +1,21 @@
+/*!
+** @file    cycleCount.c
+** @brief   Statistics of the cycles taken by a piece of code
+** @date:   19/10/2026
+*/
+
+#include "cycleCount.h"
+
+/***************************************************************************************************
+** PUBLIC FUNCTIONS
+***************************************************************************************************/
+
+/*!
+** @brief Adds a measurement, e.g. cycleCountNow() - start
+*/
+void cycleStatsAdd(CycleStats* stats, uint32_t cycles) {
+    stats->last = cycles;
+    if (cycles > stats->max) {
+        stats->max = cycles;
+    }
+}
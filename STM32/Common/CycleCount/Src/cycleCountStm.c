@@ -0,0 +1,35 @@
+/*!
+** @file    cycleCountStm.c
+** @brief   Cycle counter of the Cortex-M4 data watchpoint and trace unit (DWT)
+** @date:   19/10/2026
+*/
+
+#include "stm32f4xx_hal.h"
+#include "cycleCount.h"
+
+/***************************************************************************************************
+** PUBLIC FUNCTIONS
+***************************************************************************************************/
+
+/*!
+** @brief Starts the cycle counter. It runs without a debugger attached once the trace is enabled
+*/
+void cycleCountInit() {
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+/*!
+** @brief Cycles since cycleCountInit, modulo 2^32
+*/
+uint32_t cycleCountNow() {
+    return DWT->CYCCNT;
+}
+
+/*!
+** @brief Cycles per ms at the current core clock
+*/
+uint32_t cycleCountPerMs() {
+    return SystemCoreClock / 1000;
+}
@@ -0,0 +1,80 @@
+/*!
+** @file    decimator.h
+** @brief   Header file of decimator.c
+** @date:   18/10/2026
+*/
+
+#ifndef DECIMATOR_H_
+#define DECIMATOR_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+** Usage:
+** * Initialise with the layout and sample rate of the ADC buffer using "decimInit". All channels
+**   then average the samples of each half buffer, i.e. give the same result as ADCMean.
+** * Select the output rate, the compensation filter and the mains notch of a channel with
+**   "decimConfigure". A notch is only accepted if the output rate puts the zeros of the boxcar on
+**   the mains frequency and its harmonics, e.g. 50 Hz or 10 Hz for a 50 Hz notch at 4 kHz.
+** * Optionally reject short spikes on a channel with "decimSetSpikeFilter", which puts a running
+**   median in front of the boxcar.
+** * Pass every half buffer to "decimRun" from the ADCMonitor callback, then read the latest output
+**   of each channel with "decimValue", in ADC counts with a fractional part.
+*/
+
+/***************************************************************************************************
+** DEFINES
+***************************************************************************************************/
+
+#define DECIM_MAX_CHANNELS  8
+#define DECIM_MAX_BITS      16.0f   // Limit set by the noise and linearity of the ADC
+
+/***************************************************************************************************
+** TYPEDEFS
+***************************************************************************************************/
+
+/*!
+** @brief FIR run on the boxcar outputs, which sets the bandwidth for a given output rate
+*/
+typedef enum {
+    DECIM_FIR_NONE,     // Boxcar only (-3 dB at 0.44 x output rate)
+    DECIM_FIR_FLAT,     // [-1 10 -1] / 8: compensates the droop of the boxcar, widest bandwidth
+    DECIM_FIR_SMOOTH    // [1 2 1] / 4: narrowest bandwidth, lowest noise
+} DecimFir;
+
+/*!
+** @brief Running median run on each sample before the boxcar. A median of N rejects spikes of up to
+**        (N - 1) / 2 samples and delays the signal by as many samples
+*/
+typedef enum {
+    DECIM_SPIKE_NONE    = 1,
+    DECIM_SPIKE_MEDIAN3 = 3,
+    DECIM_SPIKE_MEDIAN5 = 5
+} DecimSpike;
+
+typedef enum {
+    DECIM_NOTCH_NONE    = 0x0,
+    DECIM_NOTCH_50HZ    = 0x1,
+    DECIM_NOTCH_60HZ    = 0x2,
+    DECIM_NOTCH_50_60HZ = 0x3
+} DecimNotch;
+
+/***************************************************************************************************
+** PUBLIC FUNCTION DECLARATIONS
+***************************************************************************************************/
+
+void decimInit(int noOfChannels, int samplesPerHalf, int sampleRate, int adcBits);
+bool decimConfigure(int channel, int rate, DecimFir fir, DecimNotch notch);
+bool decimSetSpikeFilter(int channel, DecimSpike spike);
+void decimRun(const int16_t* pData, int noOfSamples);
+
+float decimValue(int channel);
+int decimRate(int channel);
+float decimEffectiveBits(int channel);
+
+bool decimParseFir(const char* str, DecimFir* fir);
+bool decimParseNotch(const char* str, DecimNotch* notch);
+bool decimParseSpike(const char* str, DecimSpike* spike);
+
+#endif /* DECIMATOR_H_ */
@@ -0,0 +1,331 @@
+/*!
+** @file    decimator.c
+** @brief   Oversampling and decimation of the ADC channels
+** @date:   18/10/2026
+**
+** Each channel sums its samples over a boxcar of R = sample rate / output rate samples (a first
+** order CIC decimator) and runs a 3 tap FIR on the boxcar outputs. Both stages are computed in a
+** single pass over the interleaved buffer, with integer sums, so the cost is one add and one
+** compare per sample and channel whatever the configuration.
+**
+** Averaging R samples of white noise gains 0.5 x log2(R) bits. The boxcar has zeros at all
+** multiples of the output rate, so an output rate which divides the mains frequency also removes
+** the mains pick-up and its harmonics. The boxcar does not have to fit within a half buffer: its
+** sums carry over from one call to the next.
+**
+** A spike moves a mean by its area, which a sample of a switching transient can make large. An
+** optional running median of 3 or 5 samples in front of the boxcar removes spikes of up to 1 or 2
+** samples instead, for 3 or 7 compare-exchanges per sample, and passes steps and slow signals
+** unchanged.
+*/
+
+#include <math.h>
+#include <string.h>
+
+#include "decimator.h"
+
+/***************************************************************************************************
+** TYPEDEFS
+***************************************************************************************************/
+
+typedef struct DecimChannel {
+    int len;            // R: samples per output
+    int count;          // Samples left in the current boxcar
+    int32_t acc;        // Sum of the current boxcar
+    int32_t hist[3];    // Latest boxcar sums, newest first
+    bool isPrimed;      // False until the first boxcar sum has filled the history
+    DecimFir fir;
+    DecimSpike spike;
+    int16_t window[DECIM_SPIKE_MEDIAN5 - 1];    // Previous samples of the running median, newest first
+    bool isWindowFull;  // False until the first sample has filled the window
+    float value;        // Latest output, in ADC counts
+} DecimChannel;
+
+/***************************************************************************************************
+** PRIVATE VARIABLES
+***************************************************************************************************/
+
+static DecimChannel channels[DECIM_MAX_CHANNELS];
+static int noChannels = 0;
+static int fs         = 1;
+static int bits       = 12;
+
+/***************************************************************************************************
+** PRIVATE FUNCTION DEFINITIONS
+***************************************************************************************************/
+
+static void restart(DecimChannel* c) {
+    c->count    = c->len;
+    c->acc      = 0;
+    c->isPrimed = false;
+}
+
+static inline void sort2(int16_t* a, int16_t* b) {
+    if (*a > *b) {
+        int16_t tmp = *a;
+        *a          = *b;
+        *b          = tmp;
+    }
+}
+
+/*!
+** @brief Runs the running median on a new sample. The medians are sorting networks, so the cost
+**        does not depend on the data
+*/
+static int16_t despike(DecimChannel* c, int16_t sample) {
+    int16_t* w = c->window;
+
+    if (!c->isWindowFull) {
+        /* Starts from a steady state, so the first outputs are not pulled towards 0 */
+        for (int i = 0; i < DECIM_SPIKE_MEDIAN5 - 1; i++) {
+            w[i] = sample;
+        }
+        c->isWindowFull = true;
+    }
+
+    int16_t p[DECIM_SPIKE_MEDIAN5] = {sample, w[0], w[1], w[2], w[3]};
+    w[3]                           = w[2];
+    w[2]                           = w[1];
+    w[1]                           = w[0];
+    w[0]                           = sample;
+
+    if (c->spike == DECIM_SPIKE_MEDIAN3) {
+        sort2(&p[0], &p[1]);
+        sort2(&p[1], &p[2]);
+        sort2(&p[0], &p[1]);
+        return p[1];
+    }
+
+    sort2(&p[0], &p[1]);
+    sort2(&p[3], &p[4]);
+    sort2(&p[0], &p[3]);
+    sort2(&p[1], &p[4]);
+    sort2(&p[1], &p[2]);
+    sort2(&p[2], &p[3]);
+    sort2(&p[1], &p[2]);
+    return p[2];
+}
+
+/*!
+** @brief Runs the FIR on a new boxcar sum
+*/
+static void output(DecimChannel* c) {
+    if (!c->isPrimed) {
+        /* Starts the FIR from a steady state, so it does not ramp up from 0 */
+        c->hist[1]  = c->acc;
+        c->hist[2]  = c->acc;
+        c->isPrimed = true;
+    }
+    else {
+        c->hist[2] = c->hist[1];
+        c->hist[1] = c->hist[0];
+    }
+    c->hist[0] = c->acc;
+
+    switch (c->fir) {
+        case DECIM_FIR_FLAT:
+            c->value = (10 * c->hist[1] - c->hist[0] - c->hist[2]) / (8.0f * c->len);
+            break;
+        case DECIM_FIR_SMOOTH:
+            c->value = (c->hist[0] + 2 * c->hist[1] + c->hist[2]) / (4.0f * c->len);
+            break;
+        default:
+            c->value = (float)c->hist[0] / c->len;
+            break;
+    }
+
+    c->count = c->len;
+    c->acc   = 0;
+}
+
+/*!
+** @brief Sum of the squared FIR coefficients, i.e. the gain of the FIR for white noise
+*/
+static float noiseGain(DecimFir fir) {
+    switch (fir) {
+        case DECIM_FIR_FLAT:   return 102.0f / 64.0f;
+        case DECIM_FIR_SMOOTH: return 6.0f / 16.0f;
+        default:               return 1.0f;
+    }
+}
+
+/***************************************************************************************************
+** PUBLIC FUNCTION DEFINITIONS
+***************************************************************************************************/
+
+/*!
+** @brief Initialises all channels to average each half buffer, without FIR
+**
+** @param[in] noOfChannels   Number of interleaved channels in the buffer
+** @param[in] samplesPerHalf Number of samples per channel in each half buffer
+** @param[in] sampleRate     Sample rate (Hz) of each channel
+** @param[in] adcBits        Resolution of the ADC
+*/
+void decimInit(int noOfChannels, int samplesPerHalf, int sampleRate, int adcBits) {
+    memset(channels, 0, sizeof(channels));
+    noChannels = (noOfChannels <= DECIM_MAX_CHANNELS) ? noOfChannels : DECIM_MAX_CHANNELS;
+    fs         = (sampleRate > 0) ? sampleRate : 1;
+    bits       = adcBits;
+
+    for (int i = 0; i < noChannels; i++) {
+        channels[i].len = (samplesPerHalf > 0) ? samplesPerHalf : 1;
+        channels[i].fir   = DECIM_FIR_NONE;
+        channels[i].spike = DECIM_SPIKE_NONE;
+        restart(&channels[i]);
+    }
+}
+
+/*!
+** @brief Configures the filter of a channel. The next output is computed from the samples of the
+**        next call to decimRun onwards
+**
+** @param[in] channel Channel (index in the ADC scan sequence)
+** @param[in] rate    Output rate (Hz). Must divide the sample rate
+** @param[in] fir     FIR run on the boxcar outputs
+** @param[in] notch   Mains frequencies which must be rejected
+**
+** @return False if the configuration is not possible. The channel is then left unchanged
+*/
+bool decimConfigure(int channel, int rate, DecimFir fir, DecimNotch notch) {
+    if (channel < 0 || channel >= noChannels || rate <= 0 || rate > fs || (fs % rate) != 0 ||
+        fir < DECIM_FIR_NONE || fir > DECIM_FIR_SMOOTH) {
+        return false;
+    }
+
+    /* The boxcar rejects a frequency if it holds a whole number of its periods */
+    int len = fs / rate;
+    if (((notch & DECIM_NOTCH_50HZ) && ((50 * len) % fs) != 0) ||
+        ((notch & DECIM_NOTCH_60HZ) && ((60 * len) % fs) != 0)) {
+        return false;
+    }
+
+    DecimChannel* c = &channels[channel];
+    c->len          = len;
+    c->fir          = fir;
+    restart(c);
+    return true;
+}
+
+/*!
+** @brief Selects the running median of a channel
+**
+** @return False if the channel or the filter is not valid
+*/
+bool decimSetSpikeFilter(int channel, DecimSpike spike) {
+    if (channel < 0 || channel >= noChannels ||
+        (spike != DECIM_SPIKE_NONE && spike != DECIM_SPIKE_MEDIAN3 &&
+         spike != DECIM_SPIKE_MEDIAN5)) {
+        return false;
+    }
+
+    channels[channel].spike        = spike;
+    channels[channel].isWindowFull = false;
+    return true;
+}
+
+/*!
+** @brief Filters a block of samples
+**
+** @param[in] pData       Interleaved samples, e.g. the half buffer given to the ADCMonitor callback
+** @param[in] noOfSamples Number of samples per channel
+*/
+void decimRun(const int16_t* pData, int noOfSamples) {
+    for (int i = 0; i < noOfSamples; i++) {
+        const int16_t* sample = &pData[i * noChannels];
+
+        for (int ch = 0; ch < noChannels; ch++) {
+            DecimChannel* c = &channels[ch];
+            c->acc += (c->spike == DECIM_SPIKE_NONE) ? sample[ch] : despike(c, sample[ch]);
+            if (--c->count == 0) {
+                output(c);
+            }
+        }
+    }
+}
+
+/*!
+** @brief Latest output of a channel, in ADC counts
+*/
+float decimValue(int channel) {
+    return (channel >= 0 && channel < noChannels) ? channels[channel].value : 0.0f;
+}
+
+/*!
+** @brief Output rate (Hz) of a channel
+*/
+int decimRate(int channel) {
+    return (channel >= 0 && channel < noChannels) ? fs / channels[channel].len : 0;
+}
+
+/*!
+** @brief Resolution of the output of a channel, assuming the ADC noise is white
+*/
+float decimEffectiveBits(int channel) {
+    if (channel < 0 || channel >= noChannels) {
+        return 0.0f;
+    }
+
+    const DecimChannel* c = &channels[channel];
+    float enob            = bits + 0.5f * log2f(c->len / noiseGain(c->fir));
+    return (enob < DECIM_MAX_BITS) ? enob : DECIM_MAX_BITS;
+}
+
+/*!
+** @brief Parses the name of a FIR ("none", "flat" or "smooth")
+*/
+bool decimParseFir(const char* str, DecimFir* fir) {
+    if (strcmp(str, "none") == 0) {
+        *fir = DECIM_FIR_NONE;
+    }
+    else if (strcmp(str, "flat") == 0) {
+        *fir = DECIM_FIR_FLAT;
+    }
+    else if (strcmp(str, "smooth") == 0) {
+        *fir = DECIM_FIR_SMOOTH;
+    }
+    else {
+        return false;
+    }
+    return true;
+}
+
+/*!
+** @brief Parses a notch ("none", "50", "60" or "50/60")
+*/
+bool decimParseNotch(const char* str, DecimNotch* notch) {
+    if (strcmp(str, "none") == 0) {
+        *notch = DECIM_NOTCH_NONE;
+    }
+    else if (strcmp(str, "50") == 0) {
+        *notch = DECIM_NOTCH_50HZ;
+    }
+    else if (strcmp(str, "60") == 0) {
+        *notch = DECIM_NOTCH_60HZ;
+    }
+    else if (strcmp(str, "50/60") == 0) {
+        *notch = DECIM_NOTCH_50_60HZ;
+    }
+    else {
+        return false;
+    }
+    return true;
+}
+
+/*!
+** @brief Parses the name of a running median ("none", "median3" or "median5")
+*/
+bool decimParseSpike(const char* str, DecimSpike* spike) {
+    if (strcmp(str, "none") == 0) {
+        *spike = DECIM_SPIKE_NONE;
+    }
+    else if (strcmp(str, "median3") == 0) {
+        *spike = DECIM_SPIKE_MEDIAN3;
+    }
+    else if (strcmp(str, "median5") == 0) {
+        *spike = DECIM_SPIKE_MEDIAN5;
+    }
+    else {
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,58 @@
+/*!
+** @file    flashRecord.h
+** @brief   Header file of flashRecord.c
+** @date:   19/10/2026
+*/
+
+#ifndef FLASH_RECORD_H_
+#define FLASH_RECORD_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+** Usage:
+** * The flash writer and the key/value store keep their data in the same record format: a header
+**   (key, length, version), the data padded to whole words with 0xFF, then the CRC-32 of all of
+**   these. "flashRecordSize" gives the size of a record in flash.
+** * Compute the CRC with "flashRecordCrc", in as many pieces as needed, starting from 0.
+** * Check a record in flash with "flashRecordCheck" before its data is used. A record cut by a
+**   power failure fails the check, as its CRC is programmed last.
+** * The flash is accessed through "FlashOps", e.g. flashRecordStmOps from flashRecordStm.h on
+**   target, or a fake in the unit tests.
+*/
+
+/***************************************************************************************************
+** DEFINES
+***************************************************************************************************/
+
+#define FLASH_RECORD_ERASED_WORD 0xFFFFFFFFU
+
+/***************************************************************************************************
+** TYPEDEFS
+***************************************************************************************************/
+
+/*!
+** @brief Access to the flash. All functions return 0 on success
+*/
+typedef struct FlashOps {
+    int (*read)(uint32_t addr, void* data, uint32_t len);
+    int (*program)(uint32_t addr, const void* data, uint32_t len);  // Word aligned, whole words
+    int (*erase)(uint32_t addr);  // Erases the sector at addr. Returns once done
+} FlashOps;
+
+typedef struct FlashRecordHeader {
+    uint16_t key;
+    uint16_t len;       // Length of the data, without padding
+    uint32_t version;
+} FlashRecordHeader;
+
+/***************************************************************************************************
+** PUBLIC FUNCTION DECLARATIONS
+***************************************************************************************************/
+
+uint32_t flashRecordCrc(uint32_t crc, const void* data, uint32_t len);
+uint32_t flashRecordSize(uint16_t len);
+bool flashRecordCheck(const FlashOps* flash, uint32_t addr, const FlashRecordHeader* h);
+
+#endif /* FLASH_RECORD_H_ */
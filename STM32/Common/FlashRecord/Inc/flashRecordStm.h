@@ -0,0 +1,35 @@
+/*!
+** @file    flashRecordStm.h
+** @brief   Header file of flashRecordStm.c
+** @date:   19/10/2026
+*/
+
+#ifndef FLASH_RECORD_STM_H_
+#define FLASH_RECORD_STM_H_
+
+#include <stdbool.h>
+
+#include "flashRecord.h"
+
+/*
+** Usage:
+** * Give "flashRecordStmOps" to "flashWriterInit" or "kvInit" at start-up, with sectors reserved
+**   in the linker script. Prefer the 16K sectors 1 - 3, e.g. FLASHCAL at 0x08004000.
+** * The functions block while the flash is programmed or erased, and so does the CPU. The window
+**   watchdog must be stopped around an erase: give "flashRecordStmPauseWwdg" to "flashWriterInit"
+**   on boards which have one. The ADC DMA may still wrap during an erase.
+*/
+
+/***************************************************************************************************
+** PUBLIC OBJECTS
+***************************************************************************************************/
+
+extern const FlashOps flashRecordStmOps;
+
+/***************************************************************************************************
+** PUBLIC FUNCTION DECLARATIONS
+***************************************************************************************************/
+
+void flashRecordStmPauseWwdg(bool isStalled);
+
+#endif /* FLASH_RECORD_STM_H_ */
@@ -0,0 +1,68 @@
+/*!
+** @file    flashRecord.c
+** @brief   Record format shared by the flash writer and the key/value store
+** @date:   19/10/2026
+*/
+
+#include "flashRecord.h"
+
+/***************************************************************************************************
+** DEFINES
+***************************************************************************************************/
+
+#define CHUNK_SIZE 32  // Bytes read at a time, a multiple of a word
+
+/***************************************************************************************************
+** PUBLIC FUNCTION DEFINITIONS
+***************************************************************************************************/
+
+/*!
+** @brief CRC-32 (as used by zlib), which can be computed in pieces
+*/
+uint32_t flashRecordCrc(uint32_t crc, const void* data, uint32_t len) {
+    static const uint32_t table[16] = {0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC,
+                                       0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+                                       0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+                                       0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C};
+    const uint8_t* p = (const uint8_t*)data;
+
+    crc = ~crc;
+    while (len--) {
+        crc ^= *p++;
+        crc = (crc >> 4) ^ table[crc & 0xF];
+        crc = (crc >> 4) ^ table[crc & 0xF];
+    }
+    return ~crc;
+}
+
+/*!
+** @brief Size in flash of a record holding len bytes of data
+*/
+uint32_t flashRecordSize(uint16_t len) {
+    return sizeof(FlashRecordHeader) + ((len + 3U) & ~3U) + sizeof(uint32_t);
+}
+
+/*!
+** @brief Checks the CRC of a record
+**
+** @param[in] flash Access to the flash
+** @param[in] addr  Address of the record
+** @param[in] h     Header of the record, as read from flash
+*/
+bool flashRecordCheck(const FlashOps* flash, uint32_t addr, const FlashRecordHeader* h) {
+    uint8_t chunk[CHUNK_SIZE];
+    uint32_t dataAddr = addr + sizeof(FlashRecordHeader);
+    uint32_t dataLen  = (h->len + 3U) & ~3U;
+    uint32_t crc      = flashRecordCrc(0, h, sizeof(FlashRecordHeader));
+    uint32_t stored;
+
+    for (uint32_t done = 0; done < dataLen; done += CHUNK_SIZE) {
+        uint32_t n = (dataLen - done < CHUNK_SIZE) ? dataLen - done : CHUNK_SIZE;
+        if (flash->read(dataAddr + done, chunk, n) != 0) {
+            return false;
+        }
+        crc = flashRecordCrc(crc, chunk, n);
+    }
+
+    return flash->read(dataAddr + dataLen, &stored, sizeof(stored)) == 0 && stored == crc;
+}
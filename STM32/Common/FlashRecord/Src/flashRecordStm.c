@@ -0,0 +1,100 @@
+/*!
+** @file    flashRecordStm.c
+** @brief   Access to the internal flash of the STM32F4 for the flash records
+** @date:   19/10/2026
+**
+** The STM32F401 has a single flash bank: any fetch of code, constants or interrupt vectors from
+** flash waits while a sector is erased or a word is programmed. Starting an erase without waiting
+** for it would not let the loop or the interrupts run, so the erase simply blocks. A 16K sector takes
+** about 250 ms to erase at 3.3 V, a 128K sector about 1 s.
+*/
+
+#include <string.h>
+
+#include "stm32f4xx_hal.h"
+#include "flashRecordStm.h"
+
+/***************************************************************************************************
+** PRIVATE FUNCTION DEFINITIONS
+***************************************************************************************************/
+
+/*!
+** @brief Sector holding an address: 4 x 16K, 1 x 64K, then 128K sectors
+*/
+static uint32_t addrToSector(uint32_t addr) {
+    uint32_t offset = addr - FLASH_BASE;
+
+    if (offset < 0x10000) {
+        return offset / 0x4000;
+    }
+    if (offset < 0x20000) {
+        return 4;
+    }
+    return 5 + (offset - 0x20000) / 0x20000;
+}
+
+static int stmRead(uint32_t addr, void* data, uint32_t len) {
+    memcpy(data, (const void*)addr, len);
+    return 0;
+}
+
+static int stmProgram(uint32_t addr, const void* data, uint32_t len) {
+    const uint8_t* bytes = (const uint8_t*)data;
+    int ret              = 0;
+
+    if ((addr & 3) != 0 || (len & 3) != 0) {
+        return -1;
+    }
+
+    HAL_FLASH_Unlock();
+    for (uint32_t i = 0; i < len && ret == 0; i += sizeof(uint32_t)) {
+        uint32_t word;
+        memcpy(&word, &bytes[i], sizeof(word));
+        if (HAL_FLASH_Program(FLASH_TYPEPROGRAM_WORD, addr + i, word) != HAL_OK) {
+            ret = -1;
+        }
+    }
+    HAL_FLASH_Lock();
+    return ret;
+}
+
+static int stmErase(uint32_t addr) {
+    FLASH_EraseInitTypeDef erase = {0};
+    uint32_t sectorError         = 0;
+
+    erase.TypeErase    = FLASH_TYPEERASE_SECTORS;
+    erase.Sector       = addrToSector(addr);
+    erase.NbSectors    = 1;
+    erase.VoltageRange = FLASH_VOLTAGE_RANGE_3;
+
+    HAL_FLASH_Unlock();
+    HAL_StatusTypeDef status = HAL_FLASHEx_Erase(&erase, &sectorError);
+    HAL_FLASH_Lock();
+    return (status == HAL_OK) ? 0 : -1;
+}
+
+/***************************************************************************************************
+** PUBLIC OBJECTS
+***************************************************************************************************/
+
+const FlashOps flashRecordStmOps = {stmRead, stmProgram, stmErase};
+
+/***************************************************************************************************
+** PUBLIC FUNCTION DEFINITIONS
+***************************************************************************************************/
+
+/*!
+** @brief Stall hook stopping the window watchdog during an erase. It is only started again if it
+**        was running, e.g. not on boards which start it once the USB port is open
+*/
+void flashRecordStmPauseWwdg(bool isStalled) {
+    static bool wasRunning = false;
+
+    if (isStalled) {
+        wasRunning = __HAL_RCC_WWDG_IS_CLK_ENABLED();
+        __HAL_RCC_WWDG_CLK_DISABLE();
+    }
+    else if (wasRunning) {
+        __HAL_RCC_WWDG_CLK_ENABLE();
+    }
+}
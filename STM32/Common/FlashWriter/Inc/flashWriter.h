@@ -0,0 +1,60 @@
+/*!
+** @file    flashWriter.h
+** @brief   Header file of flashWriter.c
+** @date:   19/10/2026
+*/
+
+#ifndef FLASH_WRITER_H_
+#define FLASH_WRITER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "flashRecord.h"
+
+/*
+** Usage:
+** * Give the functions accessing the flash (e.g. flashRecordStmOps from flashRecordStm.h) to
+**   "flashWriterInit" at start-up, with the stall hook of the board, e.g. flashRecordStmPauseWwdg
+**   if it has a window watchdog.
+** * Start a write with "flashWriterStart". It returns at once, and the data must stay valid until
+**   the callback is called. Starting again while a write is in progress, e.g. after another change
+**   of the calibration, writes the data again once the current write is done.
+** * Call "flashWriterRun" from the main loop. The first call erases the sector, each of the
+**   following ones programs a few words at most, so the loop, the ADC callbacks and USB run
+**   between them. The erase stalls the CPU on the STM32F4 (see flashRecordStm.h), so the stall
+**   hook is called around it, and the data belongs in a 16K sector.
+** * The callback is called from "flashWriterRun" with 0 once the data is in flash, -1 on failure.
+** * Read the data back at start-up with "flashWriterRead". It fails if the write was not complete,
+**   e.g. after a power cut, so the caller can fall back to its default or legacy data.
+*/
+
+/***************************************************************************************************
+** DEFINES
+***************************************************************************************************/
+
+/* 16 us per word on the STM32F4 */
+#ifndef FLASH_WRITER_WORDS_PER_RUN
+#define FLASH_WRITER_WORDS_PER_RUN 32
+#endif
+
+#define FLASH_WRITER_KEY 0  // Key of the record holding the data
+
+/***************************************************************************************************
+** TYPEDEFS
+***************************************************************************************************/
+
+typedef void (*FlashWriterDone)(int status);
+typedef void (*FlashWriterStall)(bool isStalled);
+
+/***************************************************************************************************
+** PUBLIC FUNCTION DECLARATIONS
+***************************************************************************************************/
+
+void flashWriterInit(const FlashOps* ops, FlashWriterStall stall);
+int flashWriterStart(uint32_t addr, const void* data, uint32_t len, FlashWriterDone done);
+void flashWriterRun();
+bool flashWriterIsBusy();
+int flashWriterRead(uint32_t addr, void* data, uint32_t len);
+
+#endif /* FLASH_WRITER_H_ */
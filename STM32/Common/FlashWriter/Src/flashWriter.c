@@ -0,0 +1,229 @@
+/*!
+** @file    flashWriter.c
+** @brief   Writing of a block of data to a flash sector from the main loop
+** @date:   19/10/2026
+**
+** writeToFlashCRC erases the sector and programs the data in one call. Here, one call of the writer
+** erases the sector, and the data is then programmed a few words per call, so the loop, the ADC
+** callbacks and USB run between the steps of the write.
+**
+** The erase still stalls the CPU on the single bank flash of the STM32F4 (see flashRecordStm.c),
+** which is why the data belongs in a 16K sector: about 250 ms instead of 1 s for a 128K one. The
+** stall hook given at init is called around it, so the boards need not know when it happens.
+**
+** The data is kept in one flash record (see flashRecord.h) with the key FLASH_WRITER_KEY, whose
+** version counts the writes of the sector. Its CRC is programmed last, so the record is only valid
+** once complete.
+*/
+
+#include <stddef.h>
+#include <string.h>
+
+#include "flashWriter.h"
+
+/***************************************************************************************************
+** TYPEDEFS
+***************************************************************************************************/
+
+typedef enum {
+    WRITER_IDLE,
+    WRITER_ERASE,
+    WRITER_PROGRAM
+} WriterState;
+
+typedef struct FlashWriterJob {
+    uint32_t addr;
+    const uint8_t* data;
+    uint32_t len;
+    FlashWriterDone done;
+} FlashWriterJob;
+
+/***************************************************************************************************
+** PRIVATE VARIABLES
+***************************************************************************************************/
+
+static const FlashOps* flash = NULL;
+static FlashWriterStall onStall = NULL;
+static WriterState state     = WRITER_IDLE;
+static FlashWriterJob job;
+static FlashWriterJob pending;
+static bool isPending = false;
+static uint32_t written = 0;  // Bytes of data programmed
+static uint32_t crc     = 0;  // CRC of the header and the data programmed
+static uint32_t version = 0;  // Version of the record being written
+
+/***************************************************************************************************
+** PRIVATE FUNCTION DEFINITIONS
+***************************************************************************************************/
+
+/*!
+** @brief Reads the header of the record at addr. Fails if there is no complete record
+*/
+static bool readHeader(uint32_t addr, FlashRecordHeader* h) {
+    return flash->read(addr, h, sizeof(*h)) == 0 && h->key == FLASH_WRITER_KEY &&
+           flashRecordCheck(flash, addr, h);
+}
+
+static void begin(const FlashWriterJob* next) {
+    FlashRecordHeader h;
+
+    job     = *next;
+    written = 0;
+    version = readHeader(job.addr, &h) ? h.version + 1 : 1;
+    state   = WRITER_ERASE;
+}
+
+/*!
+** @brief Ends the current write, and starts the pending one if any
+*/
+static void finish(int status) {
+    FlashWriterDone done = job.done;
+
+    state = WRITER_IDLE;
+    if (done != NULL) {
+        done(status);
+    }
+
+    /* The callback may already have started a new write */
+    if (isPending && state == WRITER_IDLE) {
+        isPending = false;
+        begin(&pending);
+    }
+}
+
+/*!
+** @brief Erases the sector, and programs the header of the record
+*/
+static void eraseSector() {
+    FlashRecordHeader h = {FLASH_WRITER_KEY, (uint16_t)job.len, version};
+
+    crc = flashRecordCrc(0, &h, sizeof(h));
+    if (onStall != NULL) {
+        onStall(true);
+    }
+    int status = flash->erase(job.addr);
+    if (onStall != NULL) {
+        onStall(false);
+    }
+
+    if (status != 0 || flash->program(job.addr, &h, sizeof(h)) != 0) {
+        finish(-1);
+        return;
+    }
+    state = WRITER_PROGRAM;
+}
+
+static void programSlice() {
+    for (int i = 0; i < FLASH_WRITER_WORDS_PER_RUN && written < job.len; i++) {
+        uint32_t word = FLASH_RECORD_ERASED_WORD;
+        uint32_t n    = (job.len - written < sizeof(word)) ? job.len - written : sizeof(word);
+
+        memcpy(&word, &job.data[written], n);
+        if (flash->program(job.addr + sizeof(FlashRecordHeader) + written, &word, sizeof(word)) !=
+            0) {
+            finish(-1);
+            return;
+        }
+        crc = flashRecordCrc(crc, &word, sizeof(word));
+        written += n;
+    }
+
+    if (written < job.len) {
+        return;
+    }
+
+    uint32_t crcAddr = job.addr + flashRecordSize(job.len) - sizeof(crc);
+    finish((flash->program(crcAddr, &crc, sizeof(crc)) == 0) ? 0 : -1);
+}
+
+/***************************************************************************************************
+** PUBLIC FUNCTION DEFINITIONS
+***************************************************************************************************/
+
+/*!
+** @brief Sets the functions accessing the flash. Any write in progress is abandoned
+**
+** @param[in] ops   Functions accessing the flash
+** @param[in] stall Called with true just before a sector is erased, and with false once the erase
+**                  is done, e.g. flashRecordStmPauseWwdg. May be NULL
+*/
+void flashWriterInit(const FlashOps* ops, FlashWriterStall stall) {
+    flash     = ops;
+    onStall   = stall;
+    state     = WRITER_IDLE;
+    isPending = false;
+}
+
+/*!
+** @brief Starts writing data to a sector. The sector is erased first
+**
+** @param[in] addr Address of the sector
+** @param[in] data Data, which must stay valid until the callback
+** @param[in] len  Length of the data, up to 65535 bytes
+** @param[in] done Called once the write is complete or has failed. May be NULL
+**
+** @return 0 if the write has started or is queued, -1 if it could not be started, e.g. because
+**         another block is already queued. The callback is only called in the first case
+*/
+int flashWriterStart(uint32_t addr, const void* data, uint32_t len, FlashWriterDone done) {
+    if (flash == NULL || data == NULL || (addr & 3) != 0 || len > UINT16_MAX) {
+        return -1;
+    }
+
+    FlashWriterJob next = {addr, (const uint8_t*)data, len, done};
+    if (state != WRITER_IDLE) {
+        /* The data may have changed after its first words were programmed: written again once the
+        ** current write is done. Only one other block can be queued */
+        if (isPending && (pending.addr != addr || pending.data != next.data)) {
+            return -1;
+        }
+        pending   = next;
+        isPending = true;
+        return 0;
+    }
+    begin(&next);
+    return 0;
+}
+
+/*!
+** @brief Advances the write in progress. Call from the main loop
+*/
+void flashWriterRun() {
+    switch (state) {
+        case WRITER_ERASE:
+            eraseSector();
+            break;
+        case WRITER_PROGRAM:
+            programSlice();
+            break;
+        default:
+            break;
+    }
+}
+
+/*!
+** @brief True while a write is in progress or queued
+*/
+bool flashWriterIsBusy() {
+    return state != WRITER_IDLE || isPending;
+}
+
+/*!
+** @brief Reads data written by flashWriterStart
+**
+** @param[in]  addr Address of the sector
+** @param[out] data Data. Only the first len bytes are read if the stored data is longer
+** @param[in]  len  Size of data
+**
+** @return Length of the stored data, -1 if there is no complete record at addr
+*/
+int flashWriterRead(uint32_t addr, void* data, uint32_t len) {
+    FlashRecordHeader h;
+
+    /* The data is only copied once its CRC has been checked */
+    if (flash == NULL || !readHeader(addr, &h) ||
+        flash->read(addr + sizeof(h), data, (len < h.len) ? len : h.len) != 0) {
+        return -1;
+    }
+    return (int)h.len;
+}
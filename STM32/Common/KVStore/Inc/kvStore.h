@@ -0,0 +1,48 @@
+/*!
+** @file    kvStore.h
+** @brief   Header file of kvStore.c
+** @date:   19/10/2026
+*/
+
+#ifndef KV_STORE_H_
+#define KV_STORE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "flashRecord.h"
+
+/*
+** Usage:
+** * Reserve two flash sectors of the same size for the store, and give their addresses and the
+**   functions accessing the flash (e.g. flashRecordStmOps from flashRecordStm.h) to "kvInit" at
+**   start-up. It finds the latest version of each key, so the boot cost is one pass over the
+**   active sector.
+** * Each board defines its own keys, below KV_MAX_KEYS.
+** * Write a record with "kvWrite". Each write appends a new version of the key, so the old one is
+**   kept until the write is complete, and a sector is only erased when it is full.
+** * Read the latest version of a key with "kvRead". The RAM index makes it O(1), and the CRC of
+**   the record is checked on every read.
+** * A power cut during a write leaves the previous version of the key. A power cut during a garbage
+**   collection leaves the previous sector active.
+*/
+
+/***************************************************************************************************
+** DEFINES
+***************************************************************************************************/
+
+#define KV_MAX_KEYS 16
+
+/***************************************************************************************************
+** PUBLIC FUNCTION DECLARATIONS
+***************************************************************************************************/
+
+int kvInit(const FlashOps* ops, uint32_t sectorA, uint32_t sectorB, uint32_t size);
+int kvWrite(uint16_t key, const void* data, uint16_t len);
+int kvRead(uint16_t key, void* data, uint16_t len);
+int kvDelete(uint16_t key);
+
+uint32_t kvVersion(uint16_t key);
+uint32_t kvFree();
+
+#endif /* KV_STORE_H_ */
@@ -0,0 +1,329 @@
+/*!
+** @file    kvStore.c
+** @brief   Log structured key/value store in two flash sectors
+** @date:   19/10/2026
+**
+** Writing the calibration with writeToFlashCRC erases a whole sector every time, which is slow,
+** wears the flash, and loses the calibration if the power fails in between. Here, records are
+** appended to the active sector instead, and each one holds a key, a version, the data and a CRC.
+** The latest valid record of a key is its value, so a record cut by a power failure is simply
+** ignored at the next start-up.
+**
+** Once the active sector is full, the latest record of each key is copied into the other sector,
+** which is erased first. Its header, with the next generation number, is written last, so it only
+** becomes the active sector once the copy is complete. Each sector is erased once per fill, instead
+** of once per write.
+**
+** Sector layout: header (magic, generation, reserved, CRC), then the records (see flashRecord.h),
+** then erased flash.
+*/
+
+#include <stddef.h>
+#include <string.h>
+
+#include "kvStore.h"
+
+/***************************************************************************************************
+** DEFINES
+***************************************************************************************************/
+
+#define KV_MAGIC        0x3153564BU  // "KVS1"
+#define CHUNK_SIZE      32           // Bytes read or copied at a time, a multiple of a word
+
+/***************************************************************************************************
+** TYPEDEFS
+***************************************************************************************************/
+
+typedef struct KvSectorHeader {
+    uint32_t magic;
+    uint32_t generation;    // Incremented by each garbage collection, the highest one is active
+    uint32_t reserved;
+    uint32_t crc;           // CRC of the fields above
+} KvSectorHeader;
+
+typedef struct KvIndex {
+    uint32_t offset;        // Offset of the latest record in the active sector, 0 if none
+    uint32_t version;
+    uint16_t len;
+} KvIndex;
+
+/***************************************************************************************************
+** PRIVATE VARIABLES
+***************************************************************************************************/
+
+static const FlashOps* flash = NULL;
+static uint32_t sectors[2];
+static uint32_t sectorSize = 0;
+static int active          = -1;     // Index of the active sector, -1 if none
+static uint32_t generation = 0;
+static uint32_t writePos   = 0;      // Offset of the next record in the active sector
+static bool needsCollect   = false;  // The end of the records is not known, e.g. after a power cut
+
+static KvIndex kvIndex[KV_MAX_KEYS];
+
+/***************************************************************************************************
+** PRIVATE FUNCTION DEFINITIONS
+***************************************************************************************************/
+
+static bool readSectorHeader(int sector, uint32_t* gen) {
+    KvSectorHeader h;
+
+    if (flash->read(sectors[sector], &h, sizeof(h)) != 0 || h.magic != KV_MAGIC ||
+        h.crc != flashRecordCrc(0, &h, offsetof(KvSectorHeader, crc))) {
+        return false;
+    }
+    *gen = h.generation;
+    return true;
+}
+
+static bool isErased(uint32_t offset, uint32_t len) {
+    uint32_t chunk[CHUNK_SIZE / sizeof(uint32_t)];
+
+    for (uint32_t done = 0; done < len; done += CHUNK_SIZE) {
+        uint32_t n = (len - done < CHUNK_SIZE) ? len - done : CHUNK_SIZE;
+        if (flash->read(sectors[active] + offset + done, chunk, n) != 0) {
+            return false;
+        }
+        for (uint32_t i = 0; i < n / sizeof(uint32_t); i++) {
+            if (chunk[i] != FLASH_RECORD_ERASED_WORD) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/*!
+** @brief Builds the index from the records of the active sector. A record with a wrong CRC was
+**        cut by a power failure, and is skipped
+*/
+static void scan() {
+    uint32_t pos = sizeof(KvSectorHeader);
+
+    memset(kvIndex, 0, sizeof(kvIndex));
+    while (pos + flashRecordSize(0) <= sectorSize) {
+        FlashRecordHeader h;
+        if (flash->read(sectors[active] + pos, &h, sizeof(h)) != 0) {
+            needsCollect = true;
+            break;
+        }
+
+        if (h.key == 0xFFFF && h.len == 0xFFFF) {
+            break;  // End of the records
+        }
+
+        uint32_t size = flashRecordSize(h.len);
+        if (h.key >= KV_MAX_KEYS || pos + size > sectorSize) {
+            needsCollect = true;  // Header cut by a power failure: the end of the record is unknown
+            break;
+        }
+
+        if (flashRecordCheck(flash, sectors[active] + pos, &h)) {
+            kvIndex[h.key].offset  = pos;
+            kvIndex[h.key].version = h.version;
+            kvIndex[h.key].len     = h.len;
+        }
+        pos += size;
+    }
+
+    writePos = pos;
+}
+
+/*!
+** @brief Copies the latest record of each key into the other sector, which then becomes active.
+**        The empty record of a deleted key is copied too, so its version carries on
+*/
+static int collect() {
+    int target       = (active < 0) ? 0 : 1 - active;
+    uint32_t base    = sectors[target];
+    uint32_t pos     = sizeof(KvSectorHeader);
+    KvIndex newIndex[KV_MAX_KEYS];
+    uint8_t chunk[CHUNK_SIZE];
+
+    if (flash->erase(base) != 0) {
+        return -1;
+    }
+
+    memset(newIndex, 0, sizeof(newIndex));
+    for (int key = 0; key < KV_MAX_KEYS && active >= 0; key++) {
+        const KvIndex* idx = &kvIndex[key];
+        if (idx->offset == 0) {
+            continue;
+        }
+
+        uint32_t size = flashRecordSize(idx->len);
+        for (uint32_t done = 0; done < size; done += CHUNK_SIZE) {
+            uint32_t n = (size - done < CHUNK_SIZE) ? size - done : CHUNK_SIZE;
+            if (flash->read(sectors[active] + idx->offset + done, chunk, n) != 0 ||
+                flash->program(base + pos + done, chunk, n) != 0) {
+                return -1;
+            }
+        }
+
+        newIndex[key]        = *idx;
+        newIndex[key].offset = pos;
+        pos += size;
+    }
+
+    /* Written last: until then, the previous sector stays active */
+    KvSectorHeader h = {KV_MAGIC, generation + 1, FLASH_RECORD_ERASED_WORD, 0};
+    h.crc            = flashRecordCrc(0, &h, offsetof(KvSectorHeader, crc));
+    if (flash->program(base, &h, sizeof(h)) != 0) {
+        return -1;
+    }
+
+    active       = target;
+    generation   = h.generation;
+    writePos     = pos;
+    needsCollect = false;
+    memcpy(kvIndex, newIndex, sizeof(kvIndex));
+    return 0;
+}
+
+/***************************************************************************************************
+** PUBLIC FUNCTION DEFINITIONS
+***************************************************************************************************/
+
+/*!
+** @brief Opens the store. If neither sector holds one, e.g. on a new board, a new store is started
+**
+** @param[in] ops        Access to the flash
+** @param[in] sectorA    Address of the first sector
+** @param[in] sectorB    Address of the second sector
+** @param[in] size       Size of each sector
+**
+** @return 0 if the store can be used
+*/
+int kvInit(const FlashOps* ops, uint32_t sectorA, uint32_t sectorB, uint32_t size) {
+    uint32_t genA = 0;
+    uint32_t genB = 0;
+
+    flash        = ops;
+    sectors[0]   = sectorA;
+    sectors[1]   = sectorB;
+    sectorSize   = size;
+    active       = -1;
+    generation   = 0;
+    writePos     = 0;
+    needsCollect = false;
+    memset(kvIndex, 0, sizeof(kvIndex));
+
+    if (ops == NULL || size < sizeof(KvSectorHeader) + flashRecordSize(0)) {
+        flash = NULL;
+        return -1;
+    }
+
+    bool isValidA = readSectorHeader(0, &genA);
+    bool isValidB = readSectorHeader(1, &genB);
+    if (isValidA && isValidB) {
+        active = ((int32_t)(genB - genA) > 0) ? 1 : 0;
+    }
+    else if (isValidA || isValidB) {
+        active = isValidA ? 0 : 1;
+    }
+    else {
+        return collect();
+    }
+
+    generation = (active == 0) ? genA : genB;
+    scan();
+    return 0;
+}
+
+/*!
+** @brief Writes a new version of a key
+**
+** @param[in] key  Key, below KV_MAX_KEYS
+** @param[in] data Value
+** @param[in] len  Length of the value. 0 deletes the key
+**
+** @return 0 once the record is complete in flash. On failure, the key keeps its previous value
+*/
+int kvWrite(uint16_t key, const void* data, uint16_t len) {
+    if (flash == NULL || active < 0 || key >= KV_MAX_KEYS || (len > 0 && data == NULL)) {
+        return -1;
+    }
+
+    uint32_t size = flashRecordSize(len);
+    if (needsCollect || writePos + size > sectorSize || !isErased(writePos, size)) {
+        if (collect() != 0 || writePos + size > sectorSize) {
+            return -1;
+        }
+    }
+
+    uint32_t addr       = sectors[active] + writePos;
+    uint32_t whole      = len & ~3U;
+    FlashRecordHeader h = {key, len, kvIndex[key].version + 1};
+    uint8_t tail[4]     = {0xFF, 0xFF, 0xFF, 0xFF};
+    memcpy(tail, (const uint8_t*)data + whole, len - whole);
+
+    uint32_t crc = flashRecordCrc(0, &h, sizeof(h));
+    crc          = flashRecordCrc(crc, data, whole);
+    if (len > whole) {
+        crc = flashRecordCrc(crc, tail, sizeof(tail));
+    }
+
+    if (flash->program(addr, &h, sizeof(h)) != 0 ||
+        (whole > 0 && flash->program(addr + sizeof(h), data, whole) != 0) ||
+        (len > whole && flash->program(addr + sizeof(h) + whole, tail, sizeof(tail)) != 0) ||
+        flash->program(addr + size - sizeof(crc), &crc, sizeof(crc)) != 0) {
+        needsCollect = true;
+        return -1;
+    }
+
+    kvIndex[key].offset  = writePos;
+    kvIndex[key].version = h.version;
+    kvIndex[key].len     = len;
+    writePos += size;
+    return 0;
+}
+
+/*!
+** @brief Reads the latest version of a key
+**
+** @param[in]  key  Key
+** @param[out] data Value. Only the first len bytes are read if the value is longer
+** @param[in]  len  Size of data
+**
+** @return Length of the value, -1 if the key has no value or its record is corrupted
+*/
+int kvRead(uint16_t key, void* data, uint16_t len) {
+    if (flash == NULL || active < 0 || key >= KV_MAX_KEYS || kvIndex[key].offset == 0 ||
+        kvIndex[key].len == 0) {
+        return -1;
+    }
+
+    const KvIndex* idx  = &kvIndex[key];
+    FlashRecordHeader h = {key, idx->len, idx->version};
+    uint16_t n          = (len < idx->len) ? len : idx->len;
+
+    if (!flashRecordCheck(flash, sectors[active] + idx->offset, &h) ||
+        flash->read(sectors[active] + idx->offset + sizeof(h), data, n) != 0) {
+        return -1;
+    }
+    return idx->len;
+}
+
+/*!
+** @brief Deletes a key
+*/
+int kvDelete(uint16_t key) {
+    if (key < KV_MAX_KEYS && kvIndex[key].len == 0) {
+        return 0;  // Already without value
+    }
+    return kvWrite(key, NULL, 0);
+}
+
+/*!
+** @brief Version of the latest value of a key, 0 if it has never been written
+*/
+uint32_t kvVersion(uint16_t key) {
+    return (key < KV_MAX_KEYS) ? kvIndex[key].version : 0;
+}
+
+/*!
+** @brief Bytes left in the active sector before the next garbage collection
+*/
+uint32_t kvFree() {
+    return (active >= 0 && writePos < sectorSize) ? sectorSize - writePos : 0;
+}
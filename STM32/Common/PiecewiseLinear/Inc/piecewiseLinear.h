@@ -0,0 +1,51 @@
+/*!
+** @file    piecewiseLinear.h
+** @brief   Header file of piecewiseLinear.c
+** @date:   19/10/2026
+*/
+
+#ifndef PIECEWISE_LINEAR_H_
+#define PIECEWISE_LINEAR_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+** Usage:
+** * Clear a table with "pwlClear", then add its breakpoints with "pwlAddPoint" in any order. A
+**   point with the same x as an existing one replaces it.
+** * A table needs at least 2 points to be valid, which "pwlIsValid" checks, e.g. to fall back to
+**   another calibration.
+** * Evaluate it with "pwlEval". Inputs outside the table are extrapolated from the first or last
+**   segment.
+** * The table is a plain struct, so it can be stored in flash as it is, e.g. as part of the
+**   calibration of a board.
+*/
+
+/***************************************************************************************************
+** DEFINES
+***************************************************************************************************/
+
+#define PWL_MAX_POINTS 16
+
+/***************************************************************************************************
+** TYPEDEFS
+***************************************************************************************************/
+
+typedef struct PwlTable {
+    uint32_t noOfPoints;
+    float x[PWL_MAX_POINTS];       // Breakpoints, in increasing order
+    float y[PWL_MAX_POINTS];
+    float slope[PWL_MAX_POINTS];   // slope[i]: slope of the segment from point i to point i + 1
+} PwlTable;
+
+/***************************************************************************************************
+** PUBLIC FUNCTION DECLARATIONS
+***************************************************************************************************/
+
+void pwlClear(PwlTable* table);
+int pwlAddPoint(PwlTable* table, float x, float y);
+bool pwlIsValid(const PwlTable* table);
+float pwlEval(const PwlTable* table, float x);
+
+#endif /* PIECEWISE_LINEAR_H_ */
@@ -0,0 +1,92 @@
+/*!
+** @file    piecewiseLinear.c
+** @brief   Piecewise linear functions, e.g. for the calibration of non-linear sensors
+** @date:   19/10/2026
+**
+** The slopes of the segments are computed when a point is added, so an evaluation is a binary
+** search for the segment (4 steps for 16 points) followed by one multiply-add, with no division.
+*/
+
+#include <math.h>
+#include <string.h>
+
+#include "piecewiseLinear.h"
+
+/***************************************************************************************************
+** PRIVATE FUNCTION DEFINITIONS
+***************************************************************************************************/
+
+static void updateSlopes(PwlTable* table) {
+    for (uint32_t i = 0; i + 1 < table->noOfPoints; i++) {
+        table->slope[i] = (table->y[i + 1] - table->y[i]) / (table->x[i + 1] - table->x[i]);
+    }
+}
+
+/***************************************************************************************************
+** PUBLIC FUNCTION DEFINITIONS
+***************************************************************************************************/
+
+void pwlClear(PwlTable* table) {
+    memset(table, 0, sizeof(*table));
+}
+
+/*!
+** @brief Adds a breakpoint to a table, keeping the points sorted by x
+**
+** @return 0 on success, -1 if the table is full or the point is not a number
+*/
+int pwlAddPoint(PwlTable* table, float x, float y) {
+    if (!isfinite(x) || !isfinite(y) || table->noOfPoints > PWL_MAX_POINTS) {
+        return -1;
+    }
+
+    uint32_t i = 0;
+    while (i < table->noOfPoints && table->x[i] < x) {
+        i++;
+    }
+
+    if (i < table->noOfPoints && table->x[i] == x) {
+        table->y[i] = y;
+    }
+    else if (table->noOfPoints == PWL_MAX_POINTS) {
+        return -1;
+    }
+    else {
+        uint32_t toMove = table->noOfPoints - i;
+        memmove(&table->x[i + 1], &table->x[i], toMove * sizeof(float));
+        memmove(&table->y[i + 1], &table->y[i], toMove * sizeof(float));
+        table->x[i] = x;
+        table->y[i] = y;
+        table->noOfPoints++;
+    }
+
+    updateSlopes(table);
+    return 0;
+}
+
+/*!
+** @brief True if the table has enough points to be evaluated
+*/
+bool pwlIsValid(const PwlTable* table) {
+    return table->noOfPoints >= 2 && table->noOfPoints <= PWL_MAX_POINTS;
+}
+
+/*!
+** @brief Evaluates a valid table
+*/
+float pwlEval(const PwlTable* table, float x) {
+    /* Segment lo to lo + 1 which holds x, or the first or last segment outside of the table */
+    uint32_t lo = 0;
+    uint32_t hi = table->noOfPoints - 1;
+    while (hi - lo > 1) {
+        uint32_t mid = (lo + hi) / 2;
+        if (x < table->x[mid]) {
+            hi = mid;
+        }
+        else {
+            lo = mid;
+        }
+    }
+
+    return table->y[lo] + table->slope[lo] * (x - table->x[lo]);
+}
@@ -0,0 +1,52 @@
+/*!
+** @file    portCurrent.h
+** @brief   Header file of portCurrent.c
+** @date:   18/10/2026
+*/
+
+#ifndef PORT_CURRENT_H_
+#define PORT_CURRENT_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+** Usage:
+** * Call "pcInit" with the ADC DMA buffer once the ADC has been started.
+** * Give the position of the DMA to "pcDmaPosition" from the main loop or a timer interrupt, e.g.
+**   pcDmaPosition(__HAL_DMA_GET_COUNTER(&hdma_adc1)).
+** * Call "pcRecordPortStates" from the main loop, at least once per half buffer.
+** * Call "pcUpdate" from the ADCMonitorLoop callback, before the samples are modified.
+*/
+
+/***************************************************************************************************
+** DEFINES
+***************************************************************************************************/
+
+#define PC_MAX_PORTS         16
+#define PC_MAX_HALF_SAMPLES  400
+
+/***************************************************************************************************
+** TYPEDEFS
+***************************************************************************************************/
+
+typedef struct PortCurrentStats {
+    double onRms;     // RMS of the port current (in ADC counts) while commanded on
+    double offRms;    // RMS of the port current (in ADC counts) while commanded off
+    int onSamples;    // Number of settled samples taken while the port was commanded on
+    int offSamples;   // Number of settled samples taken while the port was commanded off
+} PortCurrentStats;
+
+/***************************************************************************************************
+** PUBLIC FUNCTION DECLARATIONS
+***************************************************************************************************/
+
+void pcInit(const int16_t* adcBuffer, int noOfPorts, int noOfChannels, int samplesPerHalf,
+            int samplesPerMs);
+void pcDmaPosition(uint32_t dmaRemaining);
+void pcRecordPortStates(uint16_t portMask);
+void pcUpdate(const int16_t* pData, int noOfChannels, int noOfSamples, const int16_t* zeroLevels,
+              PortCurrentStats* stats);
+bool pcIsMainsOn(float powerStatus);
+
+#endif /* PORT_CURRENT_H_ */
@@ -0,0 +1,177 @@
+/*!
+** @file    portCurrent.c
+** @brief   Correlates the commanded on/off state of each port with its measured current
+** @date:   18/10/2026
+**
+** The main loop records the commanded state of all ports into a bitmap with one entry per ADC
+** sample, indexed on the position of the ADC DMA in its buffer. When a half buffer is ready, the
+** current samples are split into "commanded on" and "commanded off" sets using the bitmap, so an
+** open heater element or a welded relay can be detected.
+*/
+
+#include <math.h>
+#include <string.h>
+
+#include "portCurrent.h"
+
+/***************************************************************************************************
+** DEFINES
+***************************************************************************************************/
+
+/* Samples this close to a change in commanded state are ignored, as solid state relays only
+** switch at the next zero crossing (10 ms at 50 Hz) */
+#define PC_SETTLE_MS  10
+
+/***************************************************************************************************
+** PRIVATE VARIABLES
+***************************************************************************************************/
+
+static const int16_t* adcBuf = NULL;
+static int noPorts           = 0;
+static int noChannels        = 1;
+static int halfLen           = 0;
+static int samplesMs         = 1;
+
+static uint16_t stateMap[2 * PC_MAX_HALF_SAMPLES];
+static volatile int writeIdx = 0;  // Sample being written by the DMA
+static int lastIdx           = 0;
+static uint16_t lastMask     = 0;
+
+/***************************************************************************************************
+** PUBLIC FUNCTION DEFINITIONS
+***************************************************************************************************/
+
+/*!
+** @brief Initialises the port state bitmap
+**
+** @param[in] adcBuffer      Start of the ADC DMA buffer, used to tell the two halves apart
+** @param[in] noOfPorts      Number of ports. Port x is measured on ADC channel x
+** @param[in] noOfChannels   Number of interleaved ADC channels in the buffer
+** @param[in] samplesPerHalf Number of samples per channel in each half of the ADC buffer
+** @param[in] samplesPerMs   Number of samples per channel per ms (ADC sample rate / 1000)
+*/
+void pcInit(const int16_t* adcBuffer, int noOfPorts, int noOfChannels, int samplesPerHalf,
+            int samplesPerMs) {
+    adcBuf     = adcBuffer;
+    noPorts    = (noOfPorts <= PC_MAX_PORTS) ? noOfPorts : PC_MAX_PORTS;
+    noChannels = (noOfChannels > 0) ? noOfChannels : 1;
+    halfLen    = (samplesPerHalf <= PC_MAX_HALF_SAMPLES) ? samplesPerHalf : PC_MAX_HALF_SAMPLES;
+    samplesMs  = (samplesPerMs > 0) ? samplesPerMs : 1;
+
+    memset(stateMap, 0, sizeof(stateMap));
+    writeIdx = 0;
+    lastIdx  = 0;
+    lastMask = 0;
+}
+
+/*!
+** @brief Sets the position of the ADC DMA
+**
+** @param[in] dmaRemaining Remaining transfers in the current DMA cycle (NDTR register)
+*/
+void pcDmaPosition(uint32_t dmaRemaining) {
+    int mapLen = 2 * halfLen;
+    if (mapLen == 0) {
+        return;
+    }
+
+    int written = noChannels * mapLen - (int)dmaRemaining;
+    writeIdx    = (written / noChannels) % mapLen;
+}
+
+/*!
+** @brief Records the currently commanded state of all ports
+**
+** Must be called at least once per half buffer (e.g. every main loop iteration). All samples
+** since the last call are assigned the state given in the previous call, since that was the state
+** over that interval.
+**
+** @param[in] portMask Bit x set if port x is currently commanded on
+*/
+void pcRecordPortStates(uint16_t portMask) {
+    int mapLen = 2 * halfLen;
+    if (mapLen == 0) {
+        return;
+    }
+
+    int idx = writeIdx;
+    for (int i = lastIdx; i != idx; i = (i + 1) % mapLen) {
+        stateMap[i] = lastMask;
+    }
+
+    lastIdx  = idx;
+    lastMask = portMask;
+}
+
+/*!
+** @brief Computes the on/off current statistics of each port over one half buffer
+**
+** @param[in]  pData        Start of the half buffer, as given to the ADCMonitorLoop callback
+** @param[in]  noOfChannels Number of interleaved ADC channels
+** @param[in]  noOfSamples  Number of samples per channel in the half buffer
+** @param[in]  zeroLevels   Raw ADC value corresponding to zero current, per port
+** @param[out] stats        Statistics per port. Must hold at least noOfPorts entries
+*/
+void pcUpdate(const int16_t* pData, int noOfChannels, int noOfSamples, const int16_t* zeroLevels,
+              PortCurrentStats* stats) {
+    uint64_t sumSqOn[PC_MAX_PORTS]  = {0};
+    uint64_t sumSqOff[PC_MAX_PORTS] = {0};
+    int nOn[PC_MAX_PORTS]           = {0};
+    int nOff[PC_MAX_PORTS]          = {0};
+
+    int mapLen   = 2 * halfLen;
+    int base     = (pData == adcBuf) ? 0 : halfLen;
+    int settle   = PC_SETTLE_MS * samplesMs;
+    int nPorts   = (noPorts <= noOfChannels) ? noPorts : noOfChannels;
+    int nSamples = (noOfSamples <= halfLen) ? noOfSamples : halfLen;
+
+    /* Samples since the last change of state of each port. Counted from the settling time before
+    ** the half buffer, so a port which toggled anywhere in the window is not counted */
+    int steady[PC_MAX_PORTS] = {0};
+
+    for (int i = 1 - settle; i < nSamples; i++) {
+        int idx          = (base + i + mapLen) % mapLen;
+        uint16_t state   = stateMap[idx];
+        uint16_t changed = state ^ stateMap[(idx + mapLen - 1) % mapLen];
+
+        for (int p = 0; p < nPorts; p++) {
+            steady[p] = (changed & (1U << p)) ? 0 : steady[p] + 1;
+        }
+        if (i < 0) {
+            continue;
+        }
+
+        const int16_t* sample = &pData[i * noOfChannels];
+        for (int p = 0; p < nPorts; p++) {
+            /* Only ports that have held their state for the settling time are counted */
+            if (steady[p] < settle) {
+                continue;
+            }
+
+            int32_t d   = sample[p] - zeroLevels[p];
+            uint32_t sq = (uint32_t)(d * d);
+            if (state & (1U << p)) {
+                sumSqOn[p] += sq;
+                nOn[p]++;
+            }
+            else {
+                sumSqOff[p] += sq;
+                nOff[p]++;
+            }
+        }
+    }
+
+    for (int p = 0; p < nPorts; p++) {
+        stats[p].onSamples  = nOn[p];
+        stats[p].offSamples = nOff[p];
+        stats[p].onRms      = nOn[p] ? sqrt((double)sumSqOn[p] / nOn[p]) : 0.0;
+        stats[p].offRms     = nOff[p] ? sqrt((double)sumSqOff[p] / nOff[p]) : 0.0;
+    }
+}
+
+/*!
+** @brief Returns true if the filtered power status (0 to 1) shows that mains is connected
+*/
+bool pcIsMainsOn(float powerStatus) {
+    return powerStatus > 0.5f;
+}
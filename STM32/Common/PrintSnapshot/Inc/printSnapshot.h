@@ -0,0 +1,59 @@
+/*!
+** @file    printSnapshot.h
+** @brief   Header file of printSnapshot.c
+** @date:   18/10/2026
+*/
+
+#ifndef PRINT_SNAPSHOT_H_
+#define PRINT_SNAPSHOT_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+** Usage:
+** * Initialise a SnapshotBuffer with "snapshotInit".
+** * In the timer interrupt which sets the output rate, fill in the snapshot returned by
+**   "snapshotWrite" with the values and status word to print, and publish it with
+**   "snapshotPublish". Nothing is formatted or printed in the interrupt.
+** * In the main loop, call "snapshotRead". It returns true (once) for each new snapshot, which is
+**   then formatted and sent over USB. If the main loop falls behind, only the latest snapshot is
+**   printed.
+** * Only one interrupt may write to a buffer, and only the main loop may read from it.
+*/
+
+/***************************************************************************************************
+** DEFINES
+***************************************************************************************************/
+
+#define SNAPSHOT_MAX_VALUES 12
+
+/***************************************************************************************************
+** TYPEDEFS
+***************************************************************************************************/
+
+typedef struct PrintSnapshot {
+    float values[SNAPSHOT_MAX_VALUES];
+    uint32_t status;    // Board status word (bsGetStatus) at the time of the snapshot
+} PrintSnapshot;
+
+typedef struct SnapshotBuffer {
+    PrintSnapshot slots[2];
+    volatile int latest;        // Slot holding the latest published snapshot
+    volatile int reading;       // Slot being copied by the main loop, or -1
+    volatile uint32_t seq;      // Number of snapshots published
+    uint32_t readSeq;           // Value of "seq" when the main loop last read a snapshot
+} SnapshotBuffer;
+
+/***************************************************************************************************
+** PUBLIC FUNCTION DECLARATIONS
+***************************************************************************************************/
+
+void snapshotInit(SnapshotBuffer* sb);
+
+PrintSnapshot* snapshotWrite(SnapshotBuffer* sb);
+void snapshotPublish(SnapshotBuffer* sb);
+
+bool snapshotRead(SnapshotBuffer* sb, PrintSnapshot* snapshot);
+
+#endif /* PRINT_SNAPSHOT_H_ */
@@ -0,0 +1,85 @@
+/*!
+** @file    printSnapshot.c
+** @brief   Lock-free hand over of output values from a timer interrupt to the main loop
+** @date:   18/10/2026
+**
+** Formatting floats and writing to the USB buffer takes far too long for an interrupt, and
+** USBprint is not reentrant. Instead the interrupt only copies the values to print into one of two
+** slots, and the main loop formats and sends the latest one.
+**
+** The interrupt always writes the slot the main loop is not reading, so no locking is needed. The
+** main loop confirms the slot it reads with the sequence number, in case the interrupt publishes a
+** snapshot between it looking up the latest slot and marking it as being read.
+*/
+
+#include <string.h>
+
+#include "printSnapshot.h"
+
+/***************************************************************************************************
+** DEFINES
+***************************************************************************************************/
+
+/* Stops the compiler from moving memory accesses across it. Enough on a single core MCU, where the
+** only concurrency is from interrupts */
+#define COMPILER_BARRIER() __asm__ volatile("" ::: "memory")
+
+/***************************************************************************************************
+** PUBLIC FUNCTION DEFINITIONS
+***************************************************************************************************/
+
+void snapshotInit(SnapshotBuffer* sb) {
+    memset(sb->slots, 0, sizeof(sb->slots));
+    sb->latest  = 0;
+    sb->reading = -1;
+    sb->seq     = 0;
+    sb->readSeq = 0;
+}
+
+/*!
+** @brief Returns the slot to fill in with the next snapshot. Must be called from the interrupt
+*/
+PrintSnapshot* snapshotWrite(SnapshotBuffer* sb) {
+    int reading = sb->reading;
+    return &sb->slots[1 - ((reading >= 0) ? reading : sb->latest)];
+}
+
+/*!
+** @brief Publishes the snapshot filled in after the last call to snapshotWrite
+*/
+void snapshotPublish(SnapshotBuffer* sb) {
+    int reading = sb->reading;
+    int slot    = 1 - ((reading >= 0) ? reading : sb->latest);
+
+    COMPILER_BARRIER();
+    sb->latest = slot;
+    sb->seq++;
+}
+
+/*!
+** @brief Copies the latest snapshot, if it has not been read before. Must be called from the main
+**        loop
+**
+** @return True if a new snapshot was copied
+*/
+bool snapshotRead(SnapshotBuffer* sb, PrintSnapshot* snapshot) {
+    uint32_t seq = sb->seq;
+    if (seq == sb->readSeq) {
+        return false;
+    }
+
+    int slot = 0;
+    do {
+        seq         = sb->seq;
+        slot        = sb->latest;
+        sb->reading = slot;
+    } while (seq != sb->seq);
+
+    COMPILER_BARRIER();
+    *snapshot = sb->slots[slot];
+    COMPILER_BARRIER();
+
+    sb->reading = -1;
+    sb->readSeq = seq;
+    return true;
+}
@@ -19,6 +19,7 @@
 #include "StmGpio.h"
 #include "USBprint.h"
 #include "array-math.h"
+#include "flashWriter.h"
 #include "main.h"
 #include "pcbversion.h"
 #include "pll.h"
@@ -57,6 +58,7 @@ static double adcToCurrent(double adcRMS, int channel);
 static double adcToFaultOhm(double adcValue, double adc_vsupply);
 
 static void ADCcalibrationRW(bool wr);
+static void onCalibrationStored(int status);
 static void ADCcalibration(int noOfCalibrations, const CACalibration* calibrations);
 
 static void getDirection(const int16_t *pData, int noOfChannels, int noOfSamples);
@@ -187,6 +189,12 @@ static void pDataToValues(int16_t *pData, int noOfChannels, int noOfSamples)
 
 static void updateAdcAmps()
 {
+    if (flashWriterRead((uint32_t) FLASH_ADDR_CAL, adcToAmps, sizeof(adcToAmps)) == (int) sizeof(adcToAmps))
+    {
+        return;
+    }
+
+    // Calibration stored before it was written in the background
     if (readFromFlashCRC(hcrc_, (uint32_t) FLASH_ADDR_CAL, (uint8_t*) adcToAmps, sizeof(adcToAmps)) != 0)
     {
         // set default values.
@@ -244,7 +252,7 @@ static void ADCcalibrationRW(bool wr)
 {
     if (wr)
     {
-        if (writeToFlashCRC(hcrc_, (uint32_t) FLASH_ADDR_CAL, (uint8_t *) adcToAmps, sizeof(adcToAmps)) != 0)
+        if (flashWriterStart((uint32_t) FLASH_ADDR_CAL, adcToAmps, sizeof(adcToAmps), onCalibrationStored) != 0)
         {
             USBnprintf("Calibration was not stored in FLASH\r\n");
         }
@@ -259,6 +267,14 @@ static void ADCcalibrationRW(bool wr)
     }
 }
 
+static void onCalibrationStored(int status)
+{
+    if (status != 0)
+    {
+        USBnprintf("Calibration was not stored in FLASH\r\n");
+    }
+}
+
 static void ADCcalibration(int noOfCalibrations, const CACalibration* calibrations)
 {
     for (int count = 0; count < noOfCalibrations; count++)
@@ -438,5 +454,6 @@ void currentAppLoop(const char* bootMsg)
 {
     CAhandleUserInputs(&caProto, bootMsg);
     ADCMonitorLoop(adcCbFunc);
+    flashWriterRun();
     updateBoardStatus();
 }
@@ -25,6 +25,8 @@
 /* USER CODE BEGIN Includes */
 #include <CurrentApp.h>
 #include "CAProtocolStm.h"
+#include "flashRecordStm.h"
+#include "flashWriter.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -111,6 +113,7 @@ int main(void)
   MX_WWDG_Init();
   MX_CRC_Init();
   /* USER CODE BEGIN 2 */
+  flashWriterInit(&flashRecordStmOps, flashRecordStmPauseWwdg);
   currentAppInit(&hadc1, &htim2, &hcrc);
   HAL_GPIO_WritePin(GPIOB, Fault_Switch_Pin, GPIO_PIN_SET);
   /* USER CODE END 2 */
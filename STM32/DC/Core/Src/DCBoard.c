@@ -11,6 +11,7 @@
 #include <stdbool.h>
 #include <inttypes.h>
 #include <stdio.h>
+#include <math.h>
 
 #include "main.h"
 #include "USBprint.h"
@@ -23,6 +24,7 @@
 #include "time32.h"
 #include "StmGpio.h"
 #include "pcbversion.h"
+#include "ADCWatchdog.h"
 
 /***************************************************************************************************
 ** DEFINES
@@ -30,7 +32,7 @@
 
 #define ADC_CHANNELS    7               // Order: Hall1 - Hall6, 24V sense
 #define ACTUATIONPORTS 6
-#define ADC_CHANNEL_BUF_SIZE    400
+#define ADC_CHANNEL_BUF_SIZE    100     // 1 sample per PWM period (1 kHz), so 100 ms per buffer half
 #define INPUT_V_CHANNEL_IDX    6
 
 // PWM control
@@ -46,6 +48,19 @@
 
 #define UNDER_VOLTAGE_THRESHOLD 10
 #define OVER_VOLTAGE_THRESHOLD  27
+#define OVER_VOLTAGE_DEBOUNCE    4  // Consecutive samples above the threshold before all ports are cut
+
+/* ADC to current calibration values */
+#define CURRENT_SCALAR  ((float)((3.3 / 4096.0) / 0.264))   // From ACS725LLCTR-05AB datasheet
+#define CURRENT_BIAS    (-6.25f)                            // Offset calibrated to USB hubs.
+
+#define PORT_OVER_CURRENT           5.0 // Sensor range is ±5A
+#define PORT_OVER_CURRENT_DEBOUNCE  2   // Consecutive samples above the limit before a port is cut
+
+/* Conversion of the input voltage sense (quadratic fit, see adcToInputVoltage) */
+#define VOLTAGE_QUAD    -1.31e-5f
+#define VOLTAGE_SCALAR    0.0373f
+#define VOLTAGE_BIAS        3.17f
 
 /***************************************************************************************************
 ** PRIVATE FUNCTION DECLARATIONS
@@ -54,11 +69,18 @@
 static void DCInputHandler(const char* input);
 static void CAallOn(bool isOn, int duration_ms);
 static void CAportState(int port, bool state, int percent, int duration);
-static volatile uint32_t* getTimerCCR(int pinNumber);
 static void printDcStatus();
 static void updateBoardStatus();
 static double meanCurrent(const int16_t *pData, uint16_t channel);
+static double peakCurrent(const int16_t *pData, int noOfSamples, uint16_t channel);
+static double dutyFraction(int port);
+static int16_t currentToADC(double current);
+static void portOverCurrentTrip(int id, int channel, int16_t value);
+static void overCurrentLoop();
 static double adcToInputVoltage(double adcMean);
+static int16_t inputVoltageToADC(double voltage);
+static void overVoltageTrip(int id, int channel, int16_t value);
+static void overVoltageLoop();
 static void printResult(int16_t *pBuffer, int noOfChannels, int noOfSamples);
 static void setPWMPin(int pinNumber, int pwmState, int duration);
 static void allOn(int duration);
@@ -67,6 +89,8 @@ static void turnOnPin(int pinNumber);
 static void turnOnPinDuration(int pinNumber, int duration);
 static void turnOffPin(int pinNumber);
 static void gpioInit();
+static void initPorts();
+static void writePorts(const uint32_t duty[ACTUATIONPORTS]);
 static void handlePorts();
 static void autoOff();
 static void handleButtonPress();
@@ -101,6 +125,15 @@ static uint32_t actuationStart[ACTUATIONPORTS] = { 0 };
 static uint32_t port_state[ACTUATIONPORTS] = { 0 };
 static uint32_t ccr_states[ACTUATIONPORTS] = { 0 };
 
+/* Map of DC ports to Timer CCR registers - tested and confirmed on a V3.2 board */
+static volatile uint32_t* const portCCR[ACTUATIONPORTS] = { &(TIM2->CCR1), &(TIM1->CCR2), 
+                                                            &(TIM1->CCR3), &(TIM1->CCR1), 
+                                                            &(TIM2->CCR2), &(TIM2->CCR3) };
+static TIM_TypeDef* const portTimers[] = { TIM1, TIM2 };
+
+/* Duty cycle last written to each CCR register, so only changes are written */
+static uint32_t ccrShadow[ACTUATIONPORTS] = { 0 };
+
 /* Button ports */
 static GPIO_TypeDef *button_ports[] = { Btn_1_GPIO_Port, Btn_2_GPIO_Port, Btn_3_GPIO_Port, 
                                         Btn_4_GPIO_Port, Btn_5_GPIO_Port, Btn_6_GPIO_Port};
@@ -110,6 +143,19 @@ static StmGpio buttonGpio[ACTUATIONPORTS] = {};
 
 static float inputVoltage = 24;
 
+static int overVoltageWatchId = -1;
+static volatile int16_t overVoltageAdc = 0;
+
+/* The over current watch of port x is on ADC channel x */
+static int overCurrentWatchIds[ACTUATIONPORTS] = { -1, -1, -1, -1, -1, -1 };
+static bool portOverCurrent[ACTUATIONPORTS] = { false };
+
+/* Set from the watchdog interrupts when a port is cut, until the main loop has handled the trip */
+static volatile bool portTripped[ACTUATIONPORTS] = { false };
+
+/* Highest current of each port in a PWM period, over the last buffer half */
+static double portPeakCurrent[ACTUATIONPORTS] = { 0 };
+
 /***************************************************************************************************
 ** PRIVATE FUNCTION DEFINITIONS
 ***************************************************************************************************/
@@ -131,8 +177,9 @@ static void printDcStatus()
     int len = 0;
 
     for (int i = 0; i < ACTUATIONPORTS; i++) {
-        CA_SNPRINTF(buf, len, "Port %d: On: %" PRIu32 ", PWM percent: %" PRIu32 "\r\n", i,
-                    port_state[i], *getTimerCCR(i));
+        CA_SNPRINTF(buf, len, "Port %d: On: %" PRIu32 ", PWM percent: %" PRIu32 
+                    ", Peak current: %.2f A\r\n", i, port_state[i], ccrShadow[i], 
+                    portPeakCurrent[i]);
     }
 
     writeUSB(buf, len);
@@ -149,7 +196,8 @@ static void updateBoardStatus()
     /* If a port is turned on or not */
     for(int i = 0; i < ACTUATIONPORTS; i++)
     {
-        *getTimerCCR(i) != TURNOFFPWM ? bsSetField(DC_BOARD_PORT_x_STATUS_Msk(i)) : bsClearField(DC_BOARD_PORT_x_STATUS_Msk(i));
+        ccrShadow[i] != TURNOFFPWM ? bsSetField(DC_BOARD_PORT_x_STATUS_Msk(i)) : bsClearField(DC_BOARD_PORT_x_STATUS_Msk(i));
+        portOverCurrent[i] ? bsSetError(DC_BOARD_PORT_x_OVER_CURRENT_Msk(i)) : bsClearField(DC_BOARD_PORT_x_OVER_CURRENT_Msk(i));
     }
 
     if (inputVoltage < UNDER_VOLTAGE_THRESHOLD) {
@@ -171,13 +219,52 @@ static void updateBoardStatus()
     bsClearError(DC_BOARD_No_Error_Msk);
 }
 
+/*!
+** @brief Mean current of a port over the buffer
+**
+** The ADC is triggered at the centre of the PWM pulses, so the samples are the current while the
+** port is on. The mean current is this scaled by the duty cycle. Ports which are off are reported 
+** as measured, so a sensor offset or leakage is still visible.
+*/
 static double meanCurrent(const int16_t *pData, uint16_t channel)
 {
-    // ADC to current calibration values
-    const float CURRENT_SCALAR = ((3.3 / 4096.0) / 0.264); // From ACS725LLCTR-05AB datasheet
-    const float CURRENT_BIAS   = - 6.25;                        // Offset calibrated to USB hubs.
+    return (CURRENT_SCALAR * ADCMean(pData, channel) + CURRENT_BIAS) * dutyFraction(channel);
+}
 
-    return CURRENT_SCALAR * ADCMean(pData, channel) + CURRENT_BIAS;
+/*!
+** @brief Highest current of a port in any PWM period of the buffer
+**
+** There is one sample per PWM period, taken while the port is on, so this is the peak of the 
+** per period currents. It is not scaled by the duty cycle.
+*/
+static double peakCurrent(const int16_t *pData, int noOfSamples, uint16_t channel)
+{
+    int16_t peak = INT16_MIN;
+    for (int i = 0; i < noOfSamples; i++)
+    {
+        if (pData[i * ADC_CHANNELS + channel] > peak)
+        {
+            peak = pData[i * ADC_CHANNELS + channel];
+        }
+    }
+
+    return CURRENT_SCALAR * (double)peak + CURRENT_BIAS;
+}
+
+/*!
+** @brief Fraction of each PWM period the port is on. Off ports are treated as always on
+*/
+static double dutyFraction(int port)
+{
+    return (ccrShadow[port] == TURNOFFPWM) ? 1.0 : (double)ccrShadow[port] / MAX_PWM;
+}
+
+/*!
+** @brief Inverse of the current conversion in meanCurrent (without duty cycle)
+*/
+static int16_t currentToADC(double current)
+{
+    return (int16_t)((current - CURRENT_BIAS) / CURRENT_SCALAR);
 }
 
 static double adcToInputVoltage(double adcMean)
@@ -188,13 +275,26 @@ static double adcToInputVoltage(double adcMean)
     ** NOTE: Calibration values can vary alot from board to board meaning voltage calculation
     **       can be as high as ±2V in the high range. Hence, the input voltage is not very 
     **       accurate and the output should inspected more carefully if used for diagnostics. */
-    const float VOLTAGE_QUAD = -1.31e-5;
-    const float VOLTAGE_SCALAR = 0.0373;
-    const float VOLTAGE_BIAS = 3.17;
-
     return (VOLTAGE_QUAD * adcMean + VOLTAGE_SCALAR) * adcMean + VOLTAGE_BIAS;
 }
 
+/*!
+** @brief Inverse of adcToInputVoltage
+**
+** The fit peaks at ~29.7V (ADC value ~1420), so only the rising part of it (the lower root) is 
+** used, which covers the normal operating range of the board.
+*/
+static int16_t inputVoltageToADC(double voltage)
+{
+    double discriminant = VOLTAGE_SCALAR * VOLTAGE_SCALAR - 4 * VOLTAGE_QUAD * (VOLTAGE_BIAS - voltage);
+    if (discriminant < 0)
+    {
+        return INT16_MAX;
+    }
+
+    return (int16_t)((-VOLTAGE_SCALAR + sqrt(discriminant)) / (2 * VOLTAGE_QUAD));
+}
+
 WWDG_HandleTypeDef* hwwdg_ = NULL;
 static void printResult(int16_t *pBuffer, int noOfChannels, int noOfSamples)
 {
@@ -230,6 +330,11 @@ static void printResult(int16_t *pBuffer, int noOfChannels, int noOfSamples)
     inputVoltage = adcToInputVoltage(ADCMean(pBuffer, INPUT_V_CHANNEL_IDX));
     setBoardVoltage(inputVoltage);
 
+    for (int i = 0; i < ACTUATIONPORTS; i++)
+    {
+        portPeakCurrent[i] = peakCurrent(pBuffer, noOfSamples, i);
+    }
+
     USBnprintf("%.2f, %.2f, %.2f, %.2f, %.2f, %.2f, 0x%08x\r\n",
             meanCurrent(pBuffer, 0), meanCurrent(pBuffer, 1),
             meanCurrent(pBuffer, 2), meanCurrent(pBuffer, 3),
@@ -341,13 +446,20 @@ static void actuatePins(ActuationInfo actuationInfo)
     }
 }
 
+/* A new command for a port acknowledges its over current error */
 static void CAallOn(bool isOn, int duration)
 {
+    for (int i = 0; i < ACTUATIONPORTS; i++) {
+        portOverCurrent[i] = false;
+    }
     (isOn) ? allOn(1000*duration) : allOff();
 }
 
 static void CAportState(int port, bool state, int percent, int duration)
 {
+    if (port >= 1 && port <= ACTUATIONPORTS) {
+        portOverCurrent[port - 1] = false;
+    }
     actuatePins((ActuationInfo) { port - 1, percent, 1000*duration});
 }
 
@@ -400,24 +512,69 @@ static void checkButtonPress()
 }
 
 /*!
-** @brief Returns a pointer to the correct CCR register
+** @brief Called from the ADC trigger timer interrupt when the input voltage exceeds the threshold
+**
+** Only cuts the outputs. The rest is handled by overVoltageLoop in the main loop
+*/
+static void overVoltageTrip(int id, int channel, int16_t value)
+{
+    overVoltageAdc = value;
+    for (int i = 0; i < ACTUATIONPORTS; i++) {
+        portTripped[i] = true;
+        *portCCR[i]  = TURNOFFPWM;
+        ccrShadow[i] = TURNOFFPWM;
+    }
+}
+
+/*!
+** @brief Turns off all ports if the input voltage watchdog has tripped
 **
-** @param[in] pinNumber Number of DC port to get corresponding timer for
+** The input voltage is set to the tripping sample until the next ADC buffer is ready, so the over 
+** voltage error is reported even if the spike is too short to show in the mean.
+*/
+static void overVoltageLoop()
+{
+    if (adcWatchdogIsTripped(overVoltageWatchId))
+    {
+        allOff();
+        inputVoltage = adcToInputVoltage(overVoltageAdc);
+        adcWatchdogRearm(overVoltageWatchId);
+        for (int i = 0; i < ACTUATIONPORTS; i++) {
+            portTripped[i] = false;
+        }
+    }
+}
+
+/*!
+** @brief Called from the ADC trigger timer interrupt when the current of a port exceeds the limit
 **
-** @return Address of CCR register, or 0 if an incorrect pinNumber is given
+** Only cuts the port. The rest is handled by overCurrentLoop in the main loop
 */
-static volatile uint32_t* getTimerCCR(int pinNumber)
+static void portOverCurrentTrip(int id, int channel, int16_t value)
 {
-    /* The map of DC ports to Timer CCR registers has been tested and confirmed on a V3.2 board */
-    switch (pinNumber)
+    portTripped[channel] = true;
+    *portCCR[channel]  = TURNOFFPWM;
+    ccrShadow[channel] = TURNOFFPWM;
+}
+
+/*!
+** @brief Turns off ports whose over current watch has tripped
+**
+** The port is held off and the error reported until the port is commanded again. Button presses
+** do not turn it back on either.
+*/
+static void overCurrentLoop()
+{
+    for (int i = 0; i < ACTUATIONPORTS; i++)
     {
-        case 0: return &(TIM2->CCR1);
-        case 1: return &(TIM1->CCR2);
-        case 2: return &(TIM1->CCR3);
-        case 3: return &(TIM1->CCR1);
-        case 4: return &(TIM2->CCR2);
-        case 5: return &(TIM2->CCR3);
-        default: return (uint32_t*)0x00000000;
+        if (adcWatchdogIsTripped(overCurrentWatchIds[i]))
+        {
+            turnOffPin(i);
+            portOverCurrent[i] = true;
+            adcWatchdogRearm(overCurrentWatchIds[i]);
+            adcWatchdogEnable(overCurrentWatchIds[i], false);
+            portTripped[i] = false;
+        }
     }
 }
 
@@ -430,24 +587,83 @@ static void gpioInit () {
     }
 }
 
+/*!
+** @brief Turns all ports off and synchronises the shadow registers with the hardware
+*/
+static void initPorts() {
+    for(int i = 0; i < ACTUATIONPORTS; i++) {
+        *portCCR[i]  = TURNOFFPWM;
+        ccrShadow[i] = TURNOFFPWM;
+        portTripped[i] = false;
+        portPeakCurrent[i] = 0;
+    }
+}
+
+/*!
+** @brief Writes the duty cycles which have changed to the CCR registers
+**
+** The CCR registers are preloaded (set by HAL_TIM_PWM_ConfigChannel), and update events are 
+** disabled while writing, so all changes on a timer take effect together at its next period.
+** The over current watch of a port is only enabled while it is on.
+**
+** A watchdog interrupt can cut a port at any time, also after handlePorts has read the trip flags.
+** The flag is checked again after writing, while the new value is still only in the preload
+** register, so a tripped port is never switched back on.
+*/
+static void writePorts(const uint32_t duty[ACTUATIONPORTS]) {
+    bool isChanged = false;
+    for(int i = 0; i < ACTUATIONPORTS; i++) {
+        isChanged |= (duty[i] != ccrShadow[i]);
+    }
+
+    if(!isChanged) {
+        return;
+    }
+
+    for(unsigned t = 0; t < sizeof(portTimers) / sizeof(portTimers[0]); t++) {
+        portTimers[t]->CR1 |= TIM_CR1_UDIS;
+    }
+
+    for(int i = 0; i < ACTUATIONPORTS; i++) {
+        if(duty[i] != ccrShadow[i]) {
+            *portCCR[i]  = duty[i];
+            ccrShadow[i] = duty[i];
+            if(portTripped[i]) {
+                *portCCR[i]  = TURNOFFPWM;
+                ccrShadow[i] = TURNOFFPWM;
+            }
+            adcWatchdogEnable(overCurrentWatchIds[i], ccrShadow[i] != TURNOFFPWM);
+        }
+    }
+
+    for(unsigned t = 0; t < sizeof(portTimers) / sizeof(portTimers[0]); t++) {
+        portTimers[t]->CR1 &= ~TIM_CR1_UDIS;
+    }
+}
+
 /*!
 ** @brief Uses port_state and ccr_state variables to determine if a pin should be on or not
 */
 static void handlePorts() {
     if(!(bsGetStatus() & BS_VERSION_ERROR_Msk)) {
+        uint32_t duty[ACTUATIONPORTS];
         for(int i = 0; i < ACTUATIONPORTS; i++) {
-            if(port_state[i]) {
+            if(portOverCurrent[i] || portTripped[i]) {
+                duty[i] = TURNOFFPWM;
+            }
+            else if(port_state[i]) {
                 if(port_state[i] & PORT_STATE_ON_BTN) {
-                    *getTimerCCR(i) = TURNONPWM;
+                    duty[i] = TURNONPWM;
                 }
                 else {
-                    *getTimerCCR(i) = ccr_states[i];
+                    duty[i] = ccr_states[i];
                 }
             }
             else {
-                *getTimerCCR(i) = 0;
+                duty[i] = TURNOFFPWM;
             }
         }
+        writePorts(duty);
     }
 }
 
@@ -462,10 +678,24 @@ void DCBoardInit(ADC_HandleTypeDef *_hadc, WWDG_HandleTypeDef* hwwdg)
     initCAProtocol(&caProto, usbRx);
 
     gpioInit();
+    initPorts();
 
     static int16_t ADCBuffer[ADC_CHANNELS * ADC_CHANNEL_BUF_SIZE * 2];
     ADCMonitorInit(_hadc, ADCBuffer, sizeof(ADCBuffer) / sizeof(ADCBuffer[0]));
     hwwdg_ = hwwdg;
+
+    /* Cut all ports within a few ms of an over voltage on the input, instead of waiting for the 
+    ** mean, and single ports within a few ms of an over current */
+    adcWatchdogInit(ADCBuffer, ADC_CHANNELS, 2 * ADC_CHANNEL_BUF_SIZE);
+    overVoltageWatchId = adcWatchdogAdd(INPUT_V_CHANNEL_IDX, INT16_MIN, 
+                                        inputVoltageToADC(OVER_VOLTAGE_THRESHOLD),
+                                        OVER_VOLTAGE_DEBOUNCE, overVoltageTrip);
+    for (int i = 0; i < ACTUATIONPORTS; i++)
+    {
+        overCurrentWatchIds[i] = adcWatchdogAdd(i, INT16_MIN, currentToADC(PORT_OVER_CURRENT),
+                                                PORT_OVER_CURRENT_DEBOUNCE, portOverCurrentTrip);
+        adcWatchdogEnable(overCurrentWatchIds[i], false);
+    }
 }
 
 /*!
@@ -473,11 +703,13 @@ void DCBoardInit(ADC_HandleTypeDef *_hadc, WWDG_HandleTypeDef* hwwdg)
 ** 
 ** * Responds to user input
 ** * Checks for ADC buffer switches (the ADC sample rate is synchronised with USB print rate - the 
-**   USB print rate should be 10 Hz, so every 400 ADC samples the buffer switches). 
+**   USB print rate should be 10 Hz, so every 100 ADC samples the buffer switches). 
 */
 void DCBoardLoop(const char* bootMsg)
 {
     CAhandleUserInputs(&caProto, bootMsg);
+    overVoltageLoop();
+    overCurrentLoop();
     updateBoardStatus();
 
     ADCMonitorLoop(printResult);
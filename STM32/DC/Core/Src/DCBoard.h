@@ -20,8 +20,12 @@
 #define DC_BOARD_PORT_x_STATUS_Msk(x)  (1U << (x))
 #define DC_BOARD_PORTS_STATUS_Msk     ((1U << 5U) - 1U)
 
+/* Each of the 6 ports can be cut by its over current protection */
+#define DC_BOARD_PORT_x_OVER_CURRENT_Msk(x)  (1U << (6U + (x)))
+#define DC_BOARD_PORTS_OVER_CURRENT_Msk     (((1U << 6U) - 1U) << 6U)
+
 /* Define showing which bits are "errors" and which are only for information */
-#define DC_BOARD_No_Error_Msk         (BS_SYSTEM_ERRORS_Msk)
+#define DC_BOARD_No_Error_Msk         (BS_SYSTEM_ERRORS_Msk | DC_BOARD_PORTS_OVER_CURRENT_Msk)
 
 /***************************************************************************************************
 ** PUBLIC FUNCTIONS
@@ -0,0 +1,53 @@
+/*!
+** @file    flowTotaliser.h
+** @brief   Header file of flowTotaliser.c
+** @date:   18/10/2026
+*/
+
+#ifndef FLOW_TOTALISER_H_
+#define FLOW_TOTALISER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+** Usage:
+** * Initialise the totaliser with "flowTotInit".
+** * Give it every flow sample with the tick it was taken at, oldest first, with "flowTotAdd". If
+**   samples have been lost (e.g. the sensor did not answer), call "flowTotRestart" first, so the
+**   flow is not interpolated across the gap.
+** * Call "flowTotWindow" once per output period. It returns the time weighted mean flow since the
+**   last call. "flowTotTotal" returns the total volume, which "flowTotReset" sets back to 0.
+*/
+
+/***************************************************************************************************
+** TYPEDEFS
+***************************************************************************************************/
+
+typedef struct FlowTotaliser {
+    float deadband;         // Flows within +/- this (SLPM) are not added to the total
+
+    bool hasSample;
+    uint32_t lastTick;
+    float lastFlow;         // SLPM
+
+    double total;           // SLPM * ms
+
+    /* Current window */
+    uint32_t samples;
+    uint32_t duration;      // ms
+    double integral;        // SLPM * ms
+} FlowTotaliser;
+
+/***************************************************************************************************
+** PUBLIC FUNCTION DECLARATIONS
+***************************************************************************************************/
+
+void flowTotInit(FlowTotaliser* tot, float deadband);
+void flowTotRestart(FlowTotaliser* tot);
+void flowTotAdd(FlowTotaliser* tot, uint32_t tick, float flow);
+bool flowTotWindow(FlowTotaliser* tot, float* mean);
+double flowTotTotal(const FlowTotaliser* tot);
+void flowTotReset(FlowTotaliser* tot);
+
+#endif /* FLOW_TOTALISER_H_ */
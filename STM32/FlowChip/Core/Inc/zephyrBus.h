@@ -0,0 +1,47 @@
+/*!
+** @file    zephyrBus.h
+** @brief   Header file of zephyrBus.c
+** @date:   18/10/2026
+*/
+
+#ifndef ZEPHYR_BUS_H_
+#define ZEPHYR_BUS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "stm32f4xx_hal.h"
+
+/***************************************************************************************************
+** DEFINES
+***************************************************************************************************/
+
+#define ZEPHYR_I2C_ADDR         (0x49 << 1)
+#define ZEPHYR_BUS_TIMEOUT_MS   10          // A 2 byte read takes 0.3 ms at 100 kHz
+
+/* Digital output of the unidirectional sensors: flow / full scale = (code / 2^14 - 0.1) / 0.8 */
+#define ZEPHYR_CODE_RANGE       16384.0f
+#define ZEPHYR_CODE_OFFSET      0.1f
+#define ZEPHYR_CODE_SPAN        0.8f
+#define ZEPHYR_CODE_STATUS_Msk  0xC000U     // Must be 0 in flow readings
+
+/***************************************************************************************************
+** TYPEDEFS
+***************************************************************************************************/
+
+typedef enum {
+    ZEPHYR_BUS_IDLE,
+    ZEPHYR_BUS_BUSY,
+    ZEPHYR_BUS_DONE,
+    ZEPHYR_BUS_ERROR
+} ZephyrBusState;
+
+/***************************************************************************************************
+** PUBLIC FUNCTION DECLARATIONS
+***************************************************************************************************/
+
+void zephyrBusInit(I2C_HandleTypeDef* hi2c);
+bool zephyrBusStartRead();
+ZephyrBusState zephyrBusPoll(uint16_t* code);
+
+#endif /* ZEPHYR_BUS_H_ */
@@ -16,9 +16,20 @@
 #include "USBprint.h"
 #include "time32.h"
 
+#include "flashWriter.h"
 #include "flowChip.h"
+#include "flowTotaliser.h"
 #include "honeywellZephyrI2C.h"
 #include "pcbversion.h"
+#include "zephyrBus.h"
+
+/***************************************************************************************************
+** DEFINES
+***************************************************************************************************/
+
+#define ZEPHYR_SAMPLE_MS    1       // Response time of the sensor
+#define FLOW_DEADBAND       0.02f   // SLPM
+#define FLOW_ERROR_VALUE    10000   // Output in case of error
 
 /***************************************************************************************************
 ** PRIVATE FUNCTION DECLARATIONS
@@ -28,6 +39,7 @@ static void flowChipUsr(const char *input);
 static void flowChipStatus();
 static void calibrateSensor(int noOfCalibrations, const CACalibration* calibrations);
 static void calibrationRW(bool write);
+static void onCalibrationStored(int status);
 
 // Local variables
 static I2C_HandleTypeDef *hi2c = NULL;
@@ -35,10 +47,14 @@ static WWDG_HandleTypeDef *hwwdg_ = NULL;
 static CRC_HandleTypeDef *hcrc_ = NULL;
 
 static uint16_t SLPM = 0;
-static double accumulatedFlow = 0;
 static float offset = 0;
 const  uint16_t validSLPM[] = { 10, 15, 20, 50, 100, 200, 300 };
 
+static FlowTotaliser totaliser;
+static uint32_t readTick = 0;       // Tick the read in flight was started at
+static float lastFlowData = 0;      // Latest reading as a fraction of full scale
+static bool isFlowValid = false;    // False if the latest read failed
+
 static CAProtocolCtx caProto =
 {
         .undefined = flowChipUsr,
@@ -74,42 +90,69 @@ static void flowChipStatus() {
 static void flowChipUsr(const char *inputBuffer)
 {
     if (strncmp("reset", inputBuffer, 5) == 0)
-        accumulatedFlow = 0;
+        flowTotReset(&totaliser);
     else
         HALundefined(inputBuffer);
 }
 
-void uploadData()
+/*!
+** @brief Collects the read in flight and starts the next one once the sensor has a new value
+**
+** Each sample is integrated over the ticks since the previous one, so the total does not depend on
+** how often this is called. A failed read is not bridged.
+*/
+static void sampleSensor()
 {
-    assert(hi2c != NULL);
+    uint16_t code = 0;
+    ZephyrBusState state = zephyrBusPoll(&code);
 
-    float flowData = 0;
+    if (state == ZEPHYR_BUS_BUSY) {
+        return;
+    }
+    else if (state == ZEPHYR_BUS_DONE && (code & ZEPHYR_CODE_STATUS_Msk) == 0) {
+        lastFlowData = (code / ZEPHYR_CODE_RANGE - ZEPHYR_CODE_OFFSET) / ZEPHYR_CODE_SPAN;
+        isFlowValid = true;
+        flowTotAdd(&totaliser, readTick, lastFlowData * SLPM + offset);
+    }
+    else if (state != ZEPHYR_BUS_IDLE) {
+        /* Failed or timed out read, or a sensor reporting a fault in the status bits */
+        isFlowValid = false;
+        flowTotRestart(&totaliser);
+    }
 
+    uint32_t now = HAL_GetTick();
+    if (tdiff_u32(now, readTick) >= ZEPHYR_SAMPLE_MS && zephyrBusStartRead()) {
+        readTick = now;
+    }
+}
+
+/*!
+** @brief Prints the mean flow since the last print and the total
+*/
+void uploadData(float flow)
+{
     if ((BS_VERSION_ERROR_Msk | FLOWCHIP_ERROR_WRONG_OTP_Msk) & bsGetStatus()) {
         USBnprintf("0x%08" PRIx32, bsGetStatus());
         return;
     }
 
-    HAL_StatusTypeDef ret = honeywellZephyrRead(hi2c, &flowData);
-    
-    double flow = 10000; /* Default value in case of error */
-    
-    if (ret == HAL_OK)
-    {
-        flow = flowData * SLPM + offset;
-
-        if (fabs(flow) > 0.02)
-            accumulatedFlow += flow/600.0; // L/PM. This loop is called every 1/10sec => divide by 600.
-    }
     /* No board status output as this error is captured by the flow going to 10000 */
-
-    USBnprintf("%0.2f, %0.2f, 0x%08" PRIx32, flow, accumulatedFlow, bsGetStatus()); // print over USB
+    USBnprintf("%0.2f, %0.2f, 0x%08" PRIx32, flow, flowTotTotal(&totaliser), bsGetStatus());
 }
 
-// Read calibration offset from FLASH
+// Read calibration offset from FLASH. One written by an earlier firmware is moved once
 void calibrationInit()
 {
-    if (readFromFlashCRC(hcrc_, (uint32_t) FLASH_ADDR_CAL, (uint8_t*) &offset, sizeof(offset)) != 0)
+    if (flashWriterRead((uint32_t) FLASH_ADDR_CAL, &offset, sizeof(offset)) == (int) sizeof(offset))
+    {
+        return;
+    }
+
+    if (readFromFlashCRC(hcrc_, (uint32_t) FLASH_ADDR_CAL_LEGACY, (uint8_t*) &offset, sizeof(offset)) == 0)
+    {
+        calibrationRW(true);
+    }
+    else
     {
         bsSetField(FLOWCHIP_WARNING_NO_CAL_Msk);
     }
@@ -124,17 +167,14 @@ static void calibrateSensor(int noOfCalibrations, const CACalibration* calibrati
         return;
     }
 
-    // Get latest flow reading
-    float flow = 0;
-    HAL_StatusTypeDef ret = honeywellZephyrRead(hi2c, &flow);
-
-    if (ret != HAL_OK)
+    // Use the latest flow reading
+    if (!isFlowValid)
     {
         USBnprintf("Could not communicate with sensor. Try again...");
         return;
     }
 
-    offset += calibrations[0].alpha - flow;
+    offset += calibrations[0].alpha - lastFlowData;
 
     calibrationRW(true); 
 }
@@ -143,10 +183,9 @@ static void calibrateSensor(int noOfCalibrations, const CACalibration* calibrati
 static void calibrationRW(bool write)
 {
     if (write) {
-        if (writeToFlashCRC(hcrc_, (uint32_t) FLASH_ADDR_CAL, (uint8_t*) &offset, sizeof(offset)) == 0)
+        if (flashWriterStart((uint32_t) FLASH_ADDR_CAL, &offset, sizeof(offset), onCalibrationStored) != 0)
         {
             USBnprintf("Calibration was not stored in FLASH");
-            bsClearField(FLOWCHIP_WARNING_NO_CAL_Msk);
         }
     }
     else {
@@ -154,6 +193,16 @@ static void calibrationRW(bool write)
     }
 }
 
+static void onCalibrationStored(int status)
+{
+    if (status == 0) {
+        bsClearField(FLOWCHIP_WARNING_NO_CAL_Msk);
+    }
+    else {
+        USBnprintf("Calibration was not stored in FLASH");
+    }
+}
+
 HAL_StatusTypeDef flowChipInit(I2C_HandleTypeDef *hi2c_, WWDG_HandleTypeDef *hwwdg, CRC_HandleTypeDef *hcrc)
 {
     hi2c = hi2c_;
@@ -167,6 +216,12 @@ HAL_StatusTypeDef flowChipInit(I2C_HandleTypeDef *hi2c_, WWDG_HandleTypeDef *hww
     HAL_StatusTypeDef ret = honeywellZephyrSerial(hi2c, &serialNB);
     if (ret); // TBD: What should be done with the serial??. Why read it during init ??
 
+    /* The flow is read with interrupts from here on */
+    zephyrBusInit(hi2c);
+    flowTotInit(&totaliser, FLOW_DEADBAND);
+    readTick = HAL_GetTick();
+    isFlowValid = false;
+
     if(-1 == boardSetup(GasFlow, (pcbVersion){BREAKING_MAJOR, BREAKING_MINOR})) {
         return HAL_BUSY;
     }
@@ -195,14 +250,19 @@ void flowChipLoop(const char* bootMsg)
     static const uint32_t tsUpload = 100;
 
     CAhandleUserInputs(&caProto, bootMsg); // always allow DFU upload.
+    sampleSensor();
+    flashWriterRun();
 
     // Upload data every "tsUpload" ms.
     if (tdiff_u32(HAL_GetTick(), timeStamp) >= tsUpload)
     {
         timeStamp = HAL_GetTick();
 
+        float flow = FLOW_ERROR_VALUE;
+        (void) flowTotWindow(&totaliser, &flow);
+
         if (isUsbPortOpen()) {
-            uploadData();
+            uploadData(flow);
         }
     }
 }
@@ -10,8 +10,10 @@
 
 #include "stm32f4xx_hal.h"
 
-extern uint32_t _FlashAddrCal;   // Variable defined in ld linker script.
+extern uint32_t _FlashAddrCal;        // Variable defined in ld linker script.
+extern uint32_t _FlashAddrCalLegacy;  // Calibration written by firmware using the 128K sector
 #define FLASH_ADDR_CAL ((uintptr_t) &_FlashAddrCal)
+#define FLASH_ADDR_CAL_LEGACY ((uintptr_t) &_FlashAddrCalLegacy)
 
 #define FLOWCHIP_WARNING_NO_CAL_Msk     0x00000001U
 #define FLOWCHIP_ERROR_WRONG_OTP_Msk    0x00000002U
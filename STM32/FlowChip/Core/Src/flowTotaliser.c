@@ -0,0 +1,107 @@
+/*!
+** @file    flowTotaliser.c
+** @brief   Trapezoidal integration of flow samples over their actual time stamps
+** @date:   18/10/2026
+**
+** The volume between two samples is their mean flow times the ticks between them. The total is
+** therefore correct however irregularly the samples arrive, e.g. when the main loop is late, as
+** long as the flow does not change faster than the samples are taken.
+**
+** The deadband is applied to each sample before it is added to the total, so that the offset of an
+** idle sensor does not accumulate. The mean of a window is not deadbanded.
+*/
+
+#include <math.h>
+#include <string.h>
+
+#include "flowTotaliser.h"
+
+/***************************************************************************************************
+** PRIVATE FUNCTION DEFINITIONS
+***************************************************************************************************/
+
+static float deadbanded(const FlowTotaliser* tot, float flow) {
+    return (fabsf(flow) > tot->deadband) ? flow : 0.0f;
+}
+
+/***************************************************************************************************
+** PUBLIC FUNCTION DEFINITIONS
+***************************************************************************************************/
+
+/*!
+** @brief Initialises a totaliser with a total of 0
+**
+** @param[in] deadband Flows within +/- this (SLPM) are not added to the total
+*/
+void flowTotInit(FlowTotaliser* tot, float deadband) {
+    memset(tot, 0, sizeof(*tot));
+    tot->deadband = deadband;
+}
+
+/*!
+** @brief Makes the next sample start a new segment, e.g. after samples have been lost
+*/
+void flowTotRestart(FlowTotaliser* tot) {
+    tot->hasSample = false;
+}
+
+/*!
+** @brief Adds a sample. Samples must be given in order
+**
+** @param[in] tick Tick (ms) the sample was taken at
+** @param[in] flow Flow in SLPM
+*/
+void flowTotAdd(FlowTotaliser* tot, uint32_t tick, float flow) {
+    if (tot->hasSample) {
+        /* Wraps correctly when the tick rolls over */
+        uint32_t dt = tick - tot->lastTick;
+
+        tot->total    += 0.5 * (deadbanded(tot, tot->lastFlow) + deadbanded(tot, flow)) * dt;
+        tot->integral += 0.5 * ((double) tot->lastFlow + flow) * dt;
+        tot->duration += dt;
+    }
+
+    tot->samples++;
+    tot->hasSample = true;
+    tot->lastTick  = tick;
+    tot->lastFlow  = flow;
+}
+
+/*!
+** @brief Ends the current window
+**
+** @param[out] mean Time weighted mean flow (SLPM) of the window
+**
+** @return False if there were no samples in the window
+*/
+bool flowTotWindow(FlowTotaliser* tot, float* mean) {
+    bool hasSamples = (tot->samples > 0);
+
+    if (tot->duration > 0) {
+        *mean = (float) (tot->integral / tot->duration);
+    }
+    else if (hasSamples) {
+        /* A single sample after a restart */
+        *mean = tot->lastFlow;
+    }
+
+    tot->samples  = 0;
+    tot->duration = 0;
+    tot->integral = 0;
+
+    return hasSamples;
+}
+
+/*!
+** @brief Total volume in standard litres
+*/
+double flowTotTotal(const FlowTotaliser* tot) {
+    return tot->total / 60000.0;
+}
+
+/*!
+** @brief Sets the total back to 0
+*/
+void flowTotReset(FlowTotaliser* tot) {
+    tot->total = 0;
+}
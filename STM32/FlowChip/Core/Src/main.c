@@ -25,6 +25,8 @@
 /* USER CODE BEGIN Includes */
 #include "CAProtocolStm.h"
 #include "flowChip.h"
+#include "flashRecordStm.h"
+#include "flashWriter.h"
 
 /* USER CODE END Includes */
 
@@ -111,6 +113,7 @@ int main(void)
   MX_CRC_Init();
   MX_IWDG_Init();
   /* USER CODE BEGIN 2 */
+  flashWriterInit(&flashRecordStmOps, flashRecordStmPauseWwdg);
   flowChipInit(&hi2c1, &hwwdg, &hcrc);
 
   /* USER CODE END 2 */
@@ -0,0 +1,89 @@
+/*!
+** @file    zephyrBus.c
+** @brief   Interrupt driven reads of the Honeywell Zephyr flow sensor
+** @date:   18/10/2026
+**
+** The sensor updates its output every millisecond and returns the latest flow on every 2 byte read,
+** so no command has to be sent first. The interrupts only store the result, which the main loop
+** collects with "zephyrBusPoll". A read that never completes, e.g. as the sensor holds the clock
+** low, is given up after ZEPHYR_BUS_TIMEOUT_MS and the peripheral is re-initialised.
+*/
+
+#include <stddef.h>
+
+#include "time32.h"
+#include "zephyrBus.h"
+
+/***************************************************************************************************
+** PRIVATE VARIABLES
+***************************************************************************************************/
+
+static I2C_HandleTypeDef* bus = NULL;
+static uint8_t rx[2];
+static uint32_t startTick = 0;
+static volatile ZephyrBusState state = ZEPHYR_BUS_IDLE;
+
+/***************************************************************************************************
+** PUBLIC FUNCTION DEFINITIONS
+***************************************************************************************************/
+
+void zephyrBusInit(I2C_HandleTypeDef* hi2c) {
+    bus   = hi2c;
+    state = ZEPHYR_BUS_IDLE;
+}
+
+/*!
+** @brief Starts an interrupt driven read of the flow
+**
+** @return False if a read is still in flight or could not be started
+*/
+bool zephyrBusStartRead() {
+    if (bus == NULL || state != ZEPHYR_BUS_IDLE) {
+        return false;
+    }
+
+    state     = ZEPHYR_BUS_BUSY;
+    startTick = HAL_GetTick();
+    if (HAL_I2C_Master_Receive_IT(bus, ZEPHYR_I2C_ADDR, rx, sizeof(rx)) != HAL_OK) {
+        state = ZEPHYR_BUS_IDLE;
+        return false;
+    }
+    return true;
+}
+
+/*!
+** @brief Checks the read in flight. DONE and ERROR are only returned once, after which the bus is
+**        IDLE again. A read that has timed out is returned as ERROR
+**
+** @param[out] code Raw output of the sensor, if DONE
+*/
+ZephyrBusState zephyrBusPoll(uint16_t* code) {
+    ZephyrBusState s = state;
+
+    if (s == ZEPHYR_BUS_BUSY && tdiff_u32(HAL_GetTick(), startTick) >= ZEPHYR_BUS_TIMEOUT_MS) {
+        /* Also drops the transfer of the HAL and disables the interrupts, so no late callback
+        ** can complete the next read */
+        (void) HAL_I2C_DeInit(bus);
+        (void) HAL_I2C_Init(bus);
+        s = ZEPHYR_BUS_ERROR;
+    }
+    if (s == ZEPHYR_BUS_DONE) {
+        *code = ((uint16_t) rx[0] << 8) | rx[1];
+    }
+    if (s == ZEPHYR_BUS_DONE || s == ZEPHYR_BUS_ERROR) {
+        state = ZEPHYR_BUS_IDLE;
+    }
+    return s;
+}
+
+void HAL_I2C_MasterRxCpltCallback(I2C_HandleTypeDef* hi2c) {
+    if (hi2c == bus) {
+        state = ZEPHYR_BUS_DONE;
+    }
+}
+
+void HAL_I2C_ErrorCallback(I2C_HandleTypeDef* hi2c) {
+    if (hi2c == bus) {
+        state = ZEPHYR_BUS_ERROR;
+    }
+}
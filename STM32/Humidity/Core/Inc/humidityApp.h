@@ -23,6 +23,12 @@
 #define MAX_TEMP_BEFORE_HEATING       80 // Maximum temperature before heating
 #define BURN_IN_TIME             4800000 // 80 minutes
 
+// Maximum execution times of the SHT45 commands (datasheet table 4), rounded up to whole ms
+#define SHT45_SERIAL_MS                1
+#define SHT45_MEASURE_HIGHREP_MS       9 // 8.3 ms
+#define SHT45_HEATER_100MS_MS        110 // Heater pulse and the measurement following it
+#define SHT45_HEATER_1S_MS          1100
+
 #define SHT45_ERROR_Msk(x)		(1U << (x))
 #define HUMIDITY_NO_ERROR_Msk   (BS_SYSTEM_ERRORS_Msk | 0x03)
 
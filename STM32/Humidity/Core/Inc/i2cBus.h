@@ -0,0 +1,23 @@
+/*!
+** @file    i2cBus.h
+** @brief   Header file of i2cBus.c
+** @date:   18/10/2026
+*/
+
+#ifndef I2C_BUS_H_
+#define I2C_BUS_H_
+
+#include <stdint.h>
+
+#include "stm32f4xx_hal.h"
+
+/***************************************************************************************************
+** PUBLIC FUNCTION DECLARATIONS
+***************************************************************************************************/
+
+void i2cBusInit(int bus, I2C_HandleTypeDef* hi2c);
+
+int i2cBusWrite(int bus, uint16_t addr, uint8_t* data, uint16_t len);
+int i2cBusRead(int bus, uint16_t addr, uint8_t* data, uint16_t len);
+
+#endif /* I2C_BUS_H_ */
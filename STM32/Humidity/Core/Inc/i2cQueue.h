@@ -0,0 +1,71 @@
+/*!
+** @file    i2cQueue.h
+** @brief   Header file of i2cQueue.c
+** @date:   18/10/2026
+*/
+
+#ifndef I2C_QUEUE_H_
+#define I2C_QUEUE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+** Usage:
+** * Initialise with "i2cQueueInit" and register the HAL handle of each bus with "i2cBusInit".
+** * Queue command/response transactions on a bus with "i2cQueuePush". The response is read
+**   "waitMs" after the command was written, so devices which NACK until a conversion is done are
+**   never polled. The buses run independently of each other.
+** * Call "i2cQueueTxComplete", "i2cQueueRxComplete" and "i2cQueueError" from the I2C interrupts
+**   (see i2cBus.c), and "i2cQueueRun" from the main loop. The "done" callback of a transaction is
+**   called from "i2cQueueRun", i.e. never in interrupt context.
+** * A failed transaction fails all transactions queued after it on the same bus. Use
+**   "i2cQueueFlush" before resetting the I2C peripheral.
+*/
+
+/***************************************************************************************************
+** DEFINES
+***************************************************************************************************/
+
+#define I2C_QUEUE_MAX_BUSES   2
+#define I2C_QUEUE_LEN         4   // Transactions per bus
+#define I2C_QUEUE_MAX_RX      6   // Bytes
+#define I2C_QUEUE_TIMEOUT_MS  20  // A transfer of a few bytes at 50 kHz takes about 1.5 ms
+
+/***************************************************************************************************
+** TYPEDEFS
+***************************************************************************************************/
+
+/*!
+** @brief Called from i2cQueueRun when a transaction has finished
+**
+** @param bus   Bus the transaction ran on
+** @param isOk  False if a transfer failed or timed out
+** @param rx    Received bytes. Only valid during the call
+** @param rxLen Number of received bytes
+*/
+typedef void (*I2cDoneFn)(int bus, bool isOk, const uint8_t* rx, int rxLen);
+
+typedef struct I2cTransaction {
+    uint16_t addr;      // Device address, as given to the HAL
+    uint8_t cmd;        // Command byte written to the device
+    uint8_t rxLen;      // Number of bytes to read after "waitMs". 0 for a write only
+    uint16_t waitMs;    // Time the device needs to execute the command
+    I2cDoneFn done;     // May be NULL
+} I2cTransaction;
+
+/***************************************************************************************************
+** PUBLIC FUNCTION DECLARATIONS
+***************************************************************************************************/
+
+void i2cQueueInit();
+bool i2cQueuePush(int bus, const I2cTransaction* transaction);
+void i2cQueueFlush(int bus);
+bool i2cQueueIsIdle(int bus);
+void i2cQueueRun(uint32_t now);
+
+void i2cQueueTxComplete(int bus, uint32_t now);
+void i2cQueueRxComplete(int bus);
+void i2cQueueError(int bus);
+
+#endif /* I2C_QUEUE_H_ */
@@ -17,8 +17,12 @@
 #include "USBprint.h"
 #include "time32.h"
 #include "sht45.h"
+#include "crc.h"
 #include "HAL_otp.h"
 #include "pcbversion.h"
+#include "i2cBus.h"
+#include "i2cQueue.h"
+#include "printSnapshot.h"
 
 /***************************************************************************************************
 ** PRIVATE OBJECTS
@@ -27,9 +31,12 @@
 static WWDG_HandleTypeDef* hwwdg_ = NULL;
 
 static Measurement mvgMeasurement[NUM_SENSORS] = {{0},{0}};
-static int reset_avg_filter[NUM_SENSORS] = {0};
+// The first measurement after start-up or a reconnection is output directly
+static int reset_avg_filter[NUM_SENSORS] = {1, 1};
 static int error_count[NUM_SENSORS] = {0};
 
+static SnapshotBuffer printBuffer;
+
 static int inDecontaminationMode = 0;
 static uint32_t decontaminationStartTime = 0;
 
@@ -63,6 +70,10 @@ typedef struct sht45_heating_state
 
 sht45_heating_state heating_state[2];
 
+/* WAIT_FOR_CONVERSION is left when the I2C transaction in progress calls back (see i2cQueue.c),
+** which is at the end of the execution time of the command according to the datasheet */
+static sht_state state[NUM_SENSORS] = {MEASURE_HUMIDITY, MEASURE_HUMIDITY};
+
 /***************************************************************************************************
 ** PRIVATE FUNCTION PROTOTYPES
 ***************************************************************************************************/
@@ -70,12 +81,18 @@ sht45_heating_state heating_state[2];
 typedef sht_state (*humidityCb)(sht4x_handle_t* dev, int channel);
 
 static void HumidityPrintStatus();
+static void printMeasurements();
 static void userInputs(const char *input);
 static void setMeasurementError(int channel);
 static void resetI2C(sht4x_handle_t* dev, int channel);
 static void clearI2CBus(I2C_HandleTypeDef* hi2c, uint16_t scl);
+static uint16_t commandTime(uint8_t command);
+static sht_state queueCommand(sht4x_handle_t* dev, int channel, uint8_t command, I2cDoneFn done);
+static int isCrcValid(const uint8_t* rx);
+static void convertMeasurement(sht4x_handle_t* dev, const uint8_t* rx);
+static void serialDone(int channel, bool isOk, const uint8_t* rx, int rxLen);
+static void measurementDone(int channel, bool isOk, const uint8_t* rx, int rxLen);
 static sht_state startConversion(sht4x_handle_t* dev, int channel);
-static sht_state getConversion(sht4x_handle_t* dev, int channel);
 static sht_state updateHumidity(sht4x_handle_t* dev, int channel);
 static sht_state startHeating(sht4x_handle_t* dev, int channel, uint8_t heating_program);
 static sht_state monitorTempInBurnin(sht4x_handle_t* dev, int channel);
@@ -126,6 +143,26 @@ static void HumidityPrintStatus()
     writeUSB(buf, len);
 }
 
+/*!
+** @brief Prints the latest measurements taken by the print timer interrupt, if any.
+*/
+static void printMeasurements()
+{
+    PrintSnapshot s;
+    if (!snapshotRead(&printBuffer, &s) || !isUsbPortOpen()) { return; }
+
+    if (s.status & BS_VERSION_ERROR_Msk)
+    {
+        USBnprintf("0x%08" PRIx32 "\r\n", s.status);
+        return;
+    }
+
+    USBnprintf("%.2f, %.2f, %.2f, %.2f, %.2f, %.2f, 0x%08" PRIx32 "\r\n",
+                s.values[0], s.values[1], s.values[2],
+                s.values[3], s.values[4], s.values[5],
+                s.status);
+}
+
 /*!
 ** @brief User input handler that allows to go into burn-in mode.
 */
@@ -190,7 +227,7 @@ static void clearI2CBus(I2C_HandleTypeDef* hi2c, uint16_t scl)
 }
 
 /*!
-** @brief Resets and re-initialises I2C connection.
+** @brief Resets and re-initialises I2C connection. Transactions queued on the bus are dropped.
 */
 static void resetI2C(sht4x_handle_t* dev, int channel)
 {
@@ -198,6 +235,7 @@ static void resetI2C(sht4x_handle_t* dev, int channel)
     static const uint16_t SCLs[NUM_SENSORS] = {GPIO_PIN_6, GPIO_PIN_10};
     static const uint16_t SDAs[NUM_SENSORS] = {GPIO_PIN_7, GPIO_PIN_3};
 
+    i2cQueueFlush(channel);
     HAL_I2C_DeInit(dev->hi2c);
 
     // If SDA is forced low by the SHT45, clear the I2C bus to release it.
@@ -210,32 +248,33 @@ static void resetI2C(sht4x_handle_t* dev, int channel)
 }
 
 /*!
-** @brief Initiates a new humidity measurement if a valid connection is established. Otherwise,
-**        it tries to re-establish a connection.
+** @brief Returns the time the SHT45 needs to execute a command before its response can be read.
 */
-static sht_state startConversion(sht4x_handle_t* dev, int channel)
-{    
-    // In case of error reset I2C and try to re-establish connection.
-    if (bsGetField(SHT45_ERROR_Msk(channel)))
+static uint16_t commandTime(uint8_t command)
+{
+    switch (command)
     {
-        // Reset I2C handle
-        resetI2C(dev, channel);
-
-        // Try to establish connection again. If successful then initiate a new measurement. 
-        if (sht4x_get_serial(dev) == HAL_OK) 
-        { 
-            bsClearField(SHT45_ERROR_Msk(channel));
-        }
-        else 
-        {
-            bsSetError(SHT45_ERROR_Msk(channel)); 
-            setMeasurementError(channel);
-            return MEASURE_HUMIDITY;
-        }
+        case SHT4X_MEASURE_HIGHREP:    return SHT45_MEASURE_HIGHREP_MS;
+        case SHT4X_HEATER_200mW_100ms: return SHT45_HEATER_100MS_MS;
+        case SHT4X_HEATER_110mW_1s:    return SHT45_HEATER_1S_MS;
+        default:                       return SHT45_SERIAL_MS;
     }
-        
-    // Initiate new measurement
-    if (sht4x_initiate_measurement(dev, SHT4X_MEASURE_HIGHREP) != HAL_OK)
+}
+
+/*!
+** @brief Queues a command with a 6 byte response on the bus of a sensor.
+*/
+static sht_state queueCommand(sht4x_handle_t* dev, int channel, uint8_t command, I2cDoneFn done)
+{
+    I2cTransaction transaction = {
+        .addr = dev->device_address,
+        .cmd = command,
+        .rxLen = 6,
+        .waitMs = commandTime(command),
+        .done = done
+    };
+
+    if (!i2cQueuePush(channel, &transaction))
     {
         bsSetError(SHT45_ERROR_Msk(channel));
         setMeasurementError(channel);
@@ -244,31 +283,83 @@ static sht_state startConversion(sht4x_handle_t* dev, int channel)
     return WAIT_FOR_CONVERSION;
 }
 
+/*!
+** @brief Checks the CRC of both 16 bit words in a response.
+*/
+static int isCrcValid(const uint8_t* rx)
+{
+    static const uint8_t SHT45_CRC_INIT = 0xFF;
+    static const uint8_t SHT45_CRC_POLY = 0x31;
+
+    initCrc8(SHT45_CRC_INIT, SHT45_CRC_POLY);
+    return crc8Calculate(rx, 2) == rx[2] && crc8Calculate(rx + 3, 2) == rx[5];
+}
 
 /*!
-** @brief Gets the conversion result from the sensor. If the sensor has not yet converted the sample
-**        it will retry until the conversion is ready.
+** @brief Called when the serial number has been read after a reconnection.
 */
-static sht_state getConversion(sht4x_handle_t* dev, int channel)
+static void serialDone(int channel, bool isOk, const uint8_t* rx, int rxLen)
 {
-    sht4x_get_measurement(dev);
-    if (dev->hi2c->ErrorCode)
+    if (!isOk || rxLen < 6 || !isCrcValid(rx))
     {
-        /* The datasheet specifies that the maximum time for a high repition conversion is max 8.3 ms. 
-           If the sensor has not yet fully converted the sample it will respond with a NACK.
-           As soon as a new measurement is ready the NACK flag will go low. 
-           On any other errors reset the I2C peripheral and soft reset SHT45. */
-        if (dev->hi2c->ErrorCode == HAL_I2C_ERROR_AF)
-        {
-            return WAIT_FOR_CONVERSION;
-        }
+        bsSetError(SHT45_ERROR_Msk(channel));
+        setMeasurementError(channel);
+        state[channel] = MEASURE_HUMIDITY;
+        return;
+    }
 
-        // Set error value for sensor and initiate new measurement.
+    humiditySensors[channel].serial_number = ((uint32_t)rx[0] << 24) | ((uint32_t)rx[1] << 16) |
+                                             ((uint32_t)rx[3] << 8)  | rx[4];
+    bsClearField(SHT45_ERROR_Msk(channel));
+    state[channel] = MEASURE_HUMIDITY;
+}
+
+/*!
+** @brief Converts a measurement response into the data of the sensor handle, as 
+**        sht4x_get_measurement does after its blocking read.
+*/
+static void convertMeasurement(sht4x_handle_t* dev, const uint8_t* rx)
+{
+    float temp = -45.0f + 175.0f * (float)(((uint16_t)rx[0] << 8) | rx[1]) / 65535.0f;
+    float rh   = -6.0f + 125.0f * (float)(((uint16_t)rx[3] << 8) | rx[4]) / 65535.0f;
+
+    // Absolute humidity in g/m3 from the saturation vapour pressure (Magnus formula)
+    dev->data.temperature = temp;
+    dev->data.relative_humidity = rh;
+    dev->data.absolute_humidity = 
+        6.112f * expf(17.67f * temp / (temp + 243.5f)) * rh * 2.1674f / (273.15f + temp);
+}
+
+/*!
+** @brief Called when a measurement (or heating cycle) has finished and its result has been read.
+*/
+static void measurementDone(int channel, bool isOk, const uint8_t* rx, int rxLen)
+{
+    // On errors the I2C peripheral is reset and the connection re-established
+    if (!isOk || rxLen < 6 || !isCrcValid(rx))
+    {
         bsSetError(SHT45_ERROR_Msk(channel));
-        return MEASURE_HUMIDITY;
+        state[channel] = MEASURE_HUMIDITY;
+        return;
     }
 
-    return UPDATE_HUMIDITY;
+    convertMeasurement(&humiditySensors[channel], rx);
+    state[channel] = UPDATE_HUMIDITY;
+}
+
+/*!
+** @brief Queues a new humidity measurement if a valid connection is established. Otherwise,
+**        it resets the bus and queues a read of the serial number to re-establish a connection.
+*/
+static sht_state startConversion(sht4x_handle_t* dev, int channel)
+{
+    if (bsGetField(SHT45_ERROR_Msk(channel)))
+    {
+        resetI2C(dev, channel);
+        return queueCommand(dev, channel, SHT4X_READ_SERIAL, serialDone);
+    }
+
+    return queueCommand(dev, channel, SHT4X_MEASURE_HIGHREP, measurementDone);
 }
 
 
@@ -329,15 +420,9 @@ static sht_state startHeating(sht4x_handle_t* dev, int channel, uint8_t heating_
     ** the temperature has settled to previous level */
     heating_state[channel].tempBeforeHeating = mvgMeasurement[channel].temp;
 
-    // After a heating cycle a new conversion is ready.  
-    if (sht4x_turn_on_heater(dev, heating_program) != HAL_OK)
-    {        
-        bsSetError(SHT45_ERROR_Msk(channel));
-        return MEASURE_HUMIDITY;
-    }
+    // After a heating cycle a new conversion is ready.
     heating_state[channel].lastHeating = HAL_GetTick();
-
-    return WAIT_FOR_CONVERSION;
+    return queueCommand(dev, channel, heating_program, measurementDone);
 }
 
 /*!
@@ -383,8 +468,9 @@ static sht_state monitorTempInBurnin(sht4x_handle_t* dev, int channel)
 */
 static void humidityStateMachine()
 {
-    static sht_state state[NUM_SENSORS] = {MEASURE_HUMIDITY, MEASURE_HUMIDITY};
-    
+    // Runs the I2C transfers of both sensors and calls back the finished transactions
+    i2cQueueRun(HAL_GetTick());
+
     /* If the board is in decontamination mode, the sensor is heated to 110C for 80 minutes.
     ** The humidity readings are not valid in decontamination mode */
     humidityRead = (inDecontaminationMode) ? monitorTempInBurnin : updateHumidity;
@@ -403,7 +489,6 @@ static void humidityStateMachine()
                 break;
             }
             case WAIT_FOR_CONVERSION: {
-                state[i] = getConversion(&humiditySensors[i], i);
                 break;
             }
             case UPDATE_HUMIDITY: {
@@ -427,7 +512,8 @@ static void initHumiditySensors(I2C_HandleTypeDef* hi2c1, I2C_HandleTypeDef* hi2
     humiditySensors[0].hi2c = hi2c1;
     humiditySensors[1].hi2c = hi2c2;
 
-    // Read serial to ensure connection can be established
+    // Read serial to ensure connection can be established. This is the only blocking transfer,
+    // after it the sensors are only accessed through the I2C queue.
     for (int i = 0; i < NUM_SENSORS; i++)
     {
         if (sht4x_get_serial(&humiditySensors[i]) != HAL_OK)
@@ -438,7 +524,13 @@ static void initHumiditySensors(I2C_HandleTypeDef* hi2c1, I2C_HandleTypeDef* hi2
         heating_state[i].isFirstHeatingCycle = 1;
         heating_state[i].tempBeforeHeating = 0;
         heating_state[i].lastHeating = 0;
+        reset_avg_filter[i] = 1;
+        state[i] = MEASURE_HUMIDITY;
     }
+
+    i2cQueueInit();
+    i2cBusInit(0, hi2c1);
+    i2cBusInit(1, hi2c2);
 }
 
 /***************************************************************************************************
@@ -446,24 +538,22 @@ static void initHumiditySensors(I2C_HandleTypeDef* hi2c1, I2C_HandleTypeDef* hi2
 ***************************************************************************************************/
 
 /*!
-** @brief Timer interrupt with an interrupt frequency of 10 Hz. The function is responsible for 
-**        printing measurement data and board status over USB.
+** @brief Timer interrupt with an interrupt frequency of 10 Hz. The function takes a snapshot of the
+**        measurement data and board status, which is printed over USB by the main loop.
 */
 void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim)
 {
     HAL_WWDG_Refresh(hwwdg_);
-    if (!isUsbPortOpen()) { return; }
 
-    if (bsGetField(BS_VERSION_ERROR_Msk))
+    PrintSnapshot* s = snapshotWrite(&printBuffer);
+    for (int i = 0; i < NUM_SENSORS; i++)
     {
-        USBnprintf("0x%08" PRIx32 "\r\n", bsGetStatus());
-        return;
+        s->values[3 * i + 0] = mvgMeasurement[i].temp;
+        s->values[3 * i + 1] = mvgMeasurement[i].rh;
+        s->values[3 * i + 2] = mvgMeasurement[i].ah;
     }
-
-    USBnprintf("%.2f, %.2f, %.2f, %.2f, %.2f, %.2f, 0x%08" PRIx32 "\r\n", 
-                mvgMeasurement[0].temp, mvgMeasurement[0].rh, mvgMeasurement[0].ah,
-                mvgMeasurement[1].temp, mvgMeasurement[1].rh, mvgMeasurement[1].ah,
-                bsGetStatus());
+    s->status = bsGetStatus();
+    snapshotPublish(&printBuffer);
 }
 
 
@@ -471,12 +561,14 @@ void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim)
 ** @brief Loop function called repeatedly in main loop
 ** 
 ** * Responds to user input
-** * Initiates measurements, waits in a non-blocking manner for conversions 
-**   to finish and gets new measurements depending on current sensor state.
+** * Prints the measurements taken by the print timer
+** * Queues measurements on both I2C buses, which run concurrently. The results are read 
+**   when the conversion time has passed, and update the outputs through callbacks.
 */
 void LoopHumidity(const char* bootMsg)
 {
     CAhandleUserInputs(&caProto, bootMsg);
+    printMeasurements();
     humidityStateMachine();
 }
 
@@ -489,6 +581,7 @@ void LoopHumidity(const char* bootMsg)
 void InitHumidity(I2C_HandleTypeDef* hi2c1, I2C_HandleTypeDef* hi2c2, WWDG_HandleTypeDef* hwwdg)
 {
     initCAProtocol(&caProto, usbRx);
+    snapshotInit(&printBuffer);
     hwwdg_ = hwwdg;
 
     // PCB V1.6 of the humidity board uses SHT45 i.e. not functional on older PCB versions.
@@ -0,0 +1,75 @@
+/*!
+** @file    i2cBus.c
+** @brief   I2C interrupt glue between the HAL and i2cQueue.c
+** @date:   18/10/2026
+*/
+
+#include <stddef.h>
+
+#include "i2cBus.h"
+#include "i2cQueue.h"
+
+/***************************************************************************************************
+** PRIVATE VARIABLES
+***************************************************************************************************/
+
+static I2C_HandleTypeDef* handles[I2C_QUEUE_MAX_BUSES] = {NULL};
+
+/***************************************************************************************************
+** PRIVATE FUNCTION DEFINITIONS
+***************************************************************************************************/
+
+static int busOf(const I2C_HandleTypeDef* hi2c) {
+    for (int i = 0; i < I2C_QUEUE_MAX_BUSES; i++) {
+        if (handles[i] == hi2c) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/***************************************************************************************************
+** PUBLIC FUNCTION DEFINITIONS
+***************************************************************************************************/
+
+void i2cBusInit(int bus, I2C_HandleTypeDef* hi2c) {
+    if (bus >= 0 && bus < I2C_QUEUE_MAX_BUSES) {
+        handles[bus] = hi2c;
+    }
+}
+
+/*!
+** @brief Starts an interrupt driven write
+**
+** @return 0 if the transfer was started
+*/
+int i2cBusWrite(int bus, uint16_t addr, uint8_t* data, uint16_t len) {
+    if (handles[bus] == NULL) {
+        return -1;
+    }
+    return (HAL_I2C_Master_Transmit_IT(handles[bus], addr, data, len) == HAL_OK) ? 0 : -1;
+}
+
+/*!
+** @brief Starts an interrupt driven read
+**
+** @return 0 if the transfer was started
+*/
+int i2cBusRead(int bus, uint16_t addr, uint8_t* data, uint16_t len) {
+    if (handles[bus] == NULL) {
+        return -1;
+    }
+    return (HAL_I2C_Master_Receive_IT(handles[bus], addr, data, len) == HAL_OK) ? 0 : -1;
+}
+
+void HAL_I2C_MasterTxCpltCallback(I2C_HandleTypeDef* hi2c) {
+    i2cQueueTxComplete(busOf(hi2c), HAL_GetTick());
+}
+
+void HAL_I2C_MasterRxCpltCallback(I2C_HandleTypeDef* hi2c) {
+    i2cQueueRxComplete(busOf(hi2c));
+}
+
+void HAL_I2C_ErrorCallback(I2C_HandleTypeDef* hi2c) {
+    i2cQueueError(busOf(hi2c));
+}
@@ -0,0 +1,223 @@
+/*!
+** @file    i2cQueue.c
+** @brief   Non-blocking command/response transactions on several I2C buses
+** @date:   18/10/2026
+**
+** Each bus has a FIFO of transactions. A transaction writes a command byte with an interrupt
+** driven transfer, waits the execution time of the command given by the caller (e.g. the maximum
+** conversion time from the datasheet) and then reads the response. The interrupts only move the
+** transaction at the head of the queue to its next phase. Everything else, including starting the
+** transfers and calling back the owner, is done by i2cQueueRun in the main loop.
+*/
+
+#include <stddef.h>
+#include <string.h>
+
+#include "i2cBus.h"
+#include "i2cQueue.h"
+
+/***************************************************************************************************
+** TYPEDEFS
+***************************************************************************************************/
+
+typedef enum {
+    I2C_QUEUED,     // Not started
+    I2C_WRITING,    // Command being written
+    I2C_WAITING,    // Device executing the command
+    I2C_READING,    // Response being read
+    I2C_DONE,
+    I2C_FAILED
+} I2cPhase;
+
+typedef struct I2cEntry {
+    I2cTransaction t;
+    volatile I2cPhase phase;
+    volatile uint32_t tick;     // Start of the current phase
+    uint8_t rx[I2C_QUEUE_MAX_RX];
+} I2cEntry;
+
+typedef struct I2cBusQueue {
+    I2cEntry entries[I2C_QUEUE_LEN];
+    int head;
+    int count;
+} I2cBusQueue;
+
+/***************************************************************************************************
+** PRIVATE VARIABLES
+***************************************************************************************************/
+
+static I2cBusQueue queues[I2C_QUEUE_MAX_BUSES];
+
+/***************************************************************************************************
+** PRIVATE FUNCTION DEFINITIONS
+***************************************************************************************************/
+
+static I2cEntry* head(int bus) {
+    I2cBusQueue* q = &queues[bus];
+    return (q->count > 0) ? &q->entries[q->head] : NULL;
+}
+
+static void startWrite(int bus, I2cEntry* e, uint32_t now) {
+    // The phase is set first, since the transfer may complete before the call returns
+    e->tick  = now;
+    e->phase = I2C_WRITING;
+    if (i2cBusWrite(bus, e->t.addr, &e->t.cmd, 1) != 0) {
+        e->phase = I2C_FAILED;
+    }
+}
+
+static void startRead(int bus, I2cEntry* e, uint32_t now) {
+    e->tick  = now;
+    e->phase = I2C_READING;
+    if (i2cBusRead(bus, e->t.addr, e->rx, e->t.rxLen) != 0) {
+        e->phase = I2C_FAILED;
+    }
+}
+
+/*!
+** @brief Moves the transaction at the head of a bus on to its next phase, if it is due
+**
+** @return Phase of the transaction after the update
+*/
+static I2cPhase advance(int bus, I2cEntry* e, uint32_t now) {
+    I2cPhase phase = e->phase;
+
+    switch (phase) {
+        case I2C_QUEUED:
+            startWrite(bus, e, now);
+            break;
+
+        case I2C_WAITING:
+            if ((now - e->tick) >= e->t.waitMs) {
+                if (e->t.rxLen == 0) {
+                    e->phase = I2C_DONE;
+                }
+                else {
+                    startRead(bus, e, now);
+                }
+            }
+            break;
+
+        case I2C_WRITING:
+        case I2C_READING:
+            if ((now - e->tick) > I2C_QUEUE_TIMEOUT_MS) {
+                e->phase = I2C_FAILED;
+            }
+            break;
+
+        default:
+            break;
+    }
+
+    return e->phase;
+}
+
+/***************************************************************************************************
+** PUBLIC FUNCTION DEFINITIONS
+***************************************************************************************************/
+
+void i2cQueueInit() {
+    memset(queues, 0, sizeof(queues));
+}
+
+/*!
+** @brief Queues a transaction. It is started by the next call to i2cQueueRun
+**
+** @return False if the bus is invalid or its queue is full
+*/
+bool i2cQueuePush(int bus, const I2cTransaction* transaction) {
+    if (bus < 0 || bus >= I2C_QUEUE_MAX_BUSES || transaction->rxLen > I2C_QUEUE_MAX_RX) {
+        return false;
+    }
+
+    I2cBusQueue* q = &queues[bus];
+    if (q->count >= I2C_QUEUE_LEN) {
+        return false;
+    }
+
+    I2cEntry* e = &q->entries[(q->head + q->count) % I2C_QUEUE_LEN];
+    e->t        = *transaction;
+    e->phase    = I2C_QUEUED;
+    q->count++;
+    return true;
+}
+
+/*!
+** @brief Drops all transactions on a bus without calling them back
+**
+** A transfer in flight is not aborted, so the peripheral must be reset (or the transfer allowed
+** to finish) before queueing new transactions.
+*/
+void i2cQueueFlush(int bus) {
+    if (bus >= 0 && bus < I2C_QUEUE_MAX_BUSES) {
+        queues[bus].head  = 0;
+        queues[bus].count = 0;
+    }
+}
+
+bool i2cQueueIsIdle(int bus) {
+    return (bus < 0 || bus >= I2C_QUEUE_MAX_BUSES) || queues[bus].count == 0;
+}
+
+/*!
+** @brief Starts the transfers which are due and calls back the finished transactions
+**
+** @param[in] now Current tick in ms
+*/
+void i2cQueueRun(uint32_t now) {
+    for (int bus = 0; bus < I2C_QUEUE_MAX_BUSES; bus++) {
+        I2cBusQueue* q = &queues[bus];
+        bool isFailed  = false;
+
+        for (I2cEntry* e = head(bus); e != NULL; e = head(bus)) {
+            I2cPhase phase = isFailed ? I2C_FAILED : advance(bus, e, now);
+            if (phase != I2C_DONE && phase != I2C_FAILED) {
+                break;
+            }
+
+            // Removed from the queue before the callback, so it can queue the next transaction
+            I2cTransaction t = e->t;
+            uint8_t rx[I2C_QUEUE_MAX_RX];
+            memcpy(rx, e->rx, sizeof(rx));
+            q->head = (q->head + 1) % I2C_QUEUE_LEN;
+            q->count--;
+
+            // The transactions after a failed one are failed too, as the bus must be reset
+            isFailed = (phase == I2C_FAILED);
+            if (t.done) {
+                t.done(bus, !isFailed, rx, isFailed ? 0 : t.rxLen);
+            }
+        }
+    }
+}
+
+/*!
+** @brief Called from the interrupt when the command of the transaction in flight has been written
+*/
+void i2cQueueTxComplete(int bus, uint32_t now) {
+    I2cEntry* e = (bus >= 0 && bus < I2C_QUEUE_MAX_BUSES) ? head(bus) : NULL;
+    if (e != NULL && e->phase == I2C_WRITING) {
+        e->tick  = now;
+        e->phase = I2C_WAITING;
+    }
+}
+
+/*!
+** @brief Called from the interrupt when the response of the transaction in flight has been read
+*/
+void i2cQueueRxComplete(int bus) {
+    I2cEntry* e = (bus >= 0 && bus < I2C_QUEUE_MAX_BUSES) ? head(bus) : NULL;
+    if (e != NULL && e->phase == I2C_READING) {
+        e->phase = I2C_DONE;
+    }
+}
+
+/*!
+** @brief Called from the interrupt when the transfer in flight failed (e.g. NACK or bus error)
+*/
+void i2cQueueError(int bus) {
+    I2cEntry* e = (bus >= 0 && bus < I2C_QUEUE_MAX_BUSES) ? head(bus) : NULL;
+    if (e != NULL && (e->phase == I2C_WRITING || e->phase == I2C_READING)) {
+        e->phase = I2C_FAILED;
+    }
+}
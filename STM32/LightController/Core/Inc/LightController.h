@@ -33,5 +33,6 @@ void LightControllerInit(ADC_HandleTypeDef *hadc, TIM_HandleTypeDef *htim1,
                          TIM_HandleTypeDef *htim2, TIM_HandleTypeDef *htim3,
                          TIM_HandleTypeDef *htim4);
 void LightControllerLoop(const char* bootMsg);
+void LightControllerFadeTick();
 
 #endif /* INC_LIGHTCONTROLLER_H_ */
@@ -0,0 +1,40 @@
+/*!
+** @file    ledFade.h
+** @brief   Header file of ledFade.c
+** @date:   18/10/2026
+*/
+
+#ifndef LED_FADE_H_
+#define LED_FADE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+** Usage:
+** * Initialise with the compare (CCR) registers of all outputs using "fadeInit"
+** * Start a transition of an output with "fadeStart" from the main loop. The update interrupt of
+**   the ramp timer must be disabled while doing so.
+** * Call "fadeTick" from the update interrupt of the ramp timer. The interrupt can be disabled
+**   when it returns false, since no outputs are changing any more.
+*/
+
+/***************************************************************************************************
+** DEFINES
+***************************************************************************************************/
+
+#define FADE_MAX_OUTPUTS  12
+
+/***************************************************************************************************
+** PUBLIC FUNCTION DECLARATIONS
+***************************************************************************************************/
+
+void fadeInit(volatile uint32_t* const ccrs[], int noOfOutputs);
+void fadeStart(int output, uint8_t target, uint32_t durationTicks);
+bool fadeTick();
+
+bool fadeIsActive();
+uint8_t fadeTarget(int output);
+uint8_t fadeLevel(int output);
+
+#endif /* LED_FADE_H_ */
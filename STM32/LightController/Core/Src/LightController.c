@@ -19,6 +19,7 @@
 #include "CAProtocol.h"
 #include "CAProtocolStm.h"
 #include "LightController.h"
+#include "ledFade.h"
 #include "StmGpio.h"
 #include "USBprint.h"
 #include "pcbversion.h"
@@ -34,17 +35,19 @@
 #define ANALOG_REF_VOLTAGE   3.3f  // [V]
 #define ADC_RATIO            (ANALOG_REF_VOLTAGE / (ADC_MAX + 1))
 
+#define MAX_FADE_MS          60000 // Longest colour transition accepted
+
 /***************************************************************************************************
 ** PRIVATE FUNCTION DECLARATIONS
 ***************************************************************************************************/
 
 static void LightControllerStatus();
 static void LightControllerStatusDef();
-static bool isInputValid(const char *input, int *channel, unsigned int *rgb);
+static bool isInputValid(const char *input, int *channel, unsigned int *rgb, uint32_t *fadeMs);
 static int handleInput(unsigned int rgb, uint8_t *red, uint8_t *green, uint8_t *blue);
 
 static void updateLEDCtrl(int channel, unsigned int red, unsigned int green, unsigned int blue,
-                          int whiteOn);
+                          int whiteOn, uint32_t fadeMs);
 static void controlLEDStrip(const char *input);
 static void updateLEDs();
 static void checkTimeOut();
@@ -69,7 +72,11 @@ static float voltage24V = 0;
 static TIM_HandleTypeDef *timers[LED_CHANNELS*NO_COLORS];
 static uint32_t channels[LED_CHANNELS*NO_COLORS];
 
+// Timer driving the colour transitions. Updates at 1 kHz, so one tick per ms
+static TIM_HandleTypeDef *fadeTimer = NULL;
+
 static uint32_t rgbwControl[LED_CHANNELS*NO_COLORS] = {0};
+static uint32_t fadeTimes[LED_CHANNELS*NO_COLORS] = {0};
 static uint32_t rgbs[LED_CHANNELS] = {0, 0, 0};
 
 // For timeout
@@ -129,7 +136,7 @@ static void LightControllerStatusDef() {
     writeUSB(buf, len);
 }
 
-static bool isInputValid(const char *input, int *channel, unsigned int *rgb)
+static bool isInputValid(const char *input, int *channel, unsigned int *rgb, uint32_t *fadeMs)
 {
     // If test command is entered start the colour test
     // If any other input is entered stop it again
@@ -151,19 +158,35 @@ static bool isInputValid(const char *input, int *channel, unsigned int *rgb)
     if (*channel <= 0 || *channel > LED_CHANNELS)
         return false;
 
+    // Optional transition time in ms after the colour, e.g. "p1 FF0000 500"
+    char* idx = strchr((char*)input, ' ');
+    if (idx == NULL)
+        return false;
+
+    char* fadeIdx = strchr(&idx[1], ' ');
+    *fadeMs = 0;
+    if (fadeIdx != NULL)
+    {
+        char* end = NULL;
+        unsigned long ms = strtoul(&fadeIdx[1], &end, 10);
+        if (!isdigit((unsigned char)fadeIdx[1]) || *end != '\0' || ms > MAX_FADE_MS)
+            return false;
+        *fadeMs = ms;
+    }
+
     // If rgb is 0 shut off all colors 
     if (*rgb == 0)
         return true;
 
     // Check the RGB format is exactly 6 hex characters long
-    char* idx = strchr((char*)input, ' ');
-    if (strlen(&idx[1]) != 6)
+    size_t rgbLen = (fadeIdx != NULL) ? (size_t)(fadeIdx - &idx[1]) : strlen(&idx[1]);
+    if (rgbLen != 6)
         return false;
 
     // Check input is valid hex format
     for (int i = 0; i<6; i++)
     {
-        if(!isxdigit((unsigned char)input[3+i]))
+        if(!isxdigit((unsigned char)idx[1+i]))
         {
             return false;
         }
@@ -182,8 +205,14 @@ static int handleInput(unsigned int rgb, uint8_t *red, uint8_t *green, uint8_t *
 }
 
 
-static void updateLEDCtrl(int channel, unsigned int red, unsigned int green, unsigned int blue, int whiteOn)
+static void updateLEDCtrl(int channel, unsigned int red, unsigned int green, unsigned int blue, 
+                          int whiteOn, uint32_t fadeMs)
 {
+    for (int i = 0; i < NO_COLORS; i++)
+    {
+        fadeTimes[channel*NO_COLORS + i] = fadeMs;
+    }
+
     if (whiteOn)
     {
         rgbwControl[channel*NO_COLORS] 	   = 0;
@@ -204,6 +233,7 @@ static void controlLEDStrip(const char *input)
 {
     int port = 1;
     unsigned int rgb = 0x000000;
+    uint32_t fadeMs = 0;
 
     // If the SW Version does not match,
     // do not allow user to control PWMs.
@@ -213,7 +243,7 @@ static void controlLEDStrip(const char *input)
         return;
     }
 
-    if (!isInputValid(input, &port, &rgb))
+    if (!isInputValid(input, &port, &rgb, &fadeMs))
     {
         HALundefined(input);
         return;
@@ -223,15 +253,33 @@ static void controlLEDStrip(const char *input)
     uint8_t red, green, blue;
     int ret = handleInput(rgb, &red, &green, &blue);
     
-    updateLEDCtrl(channel, red, green, blue, ret);
+    updateLEDCtrl(channel, red, green, blue, ret, fadeMs);
     (rgb != 0x0) ? bsSetField(LIGHT_PORT_STATUS_Msk(channel)) : bsClearField(LIGHT_PORT_STATUS_Msk(channel));
     rgbs[channel] = rgb;
 }
 
+/*!
+** @brief Starts a transition of the outputs whose requested colour has changed
+**
+** The transitions run from the fade timer update interrupt, which is only enabled while any output 
+** is changing. It is disabled while starting transitions, so it does not see a half updated output.
+*/
 static void updateLEDs() {
+    bool isChanged = false;
+
     for (uint32_t i = 0; i < LED_CHANNELS * NO_COLORS; i++) {
-        // Directly applies 8 bit value as PWM resolution (ARR) is 255
-        __HAL_TIM_SET_COMPARE(timers[i], channels[i], rgbwControl[i]);
+        if (rgbwControl[i] != fadeTarget(i)) {
+            if (!isChanged) {
+                __HAL_TIM_DISABLE_IT(fadeTimer, TIM_IT_UPDATE);
+                isChanged = true;
+            }
+            // 8 bit value as PWM resolution (ARR) is 255
+            fadeStart(i, rgbwControl[i], fadeTimes[i]);
+        }
+    }
+
+    if (isChanged && fadeIsActive()) {
+        __HAL_TIM_ENABLE_IT(fadeTimer, TIM_IT_UPDATE);
     }
 }
 
@@ -240,6 +288,7 @@ static void checkTimeOut() {
     if ((HAL_GetTick() - lastCmdTime) >= ACTUATION_TIMEOUT) {
         for (uint32_t i = 0; i < LED_CHANNELS * NO_COLORS; i++) {
             rgbwControl[i] = 0;
+            fadeTimes[i]   = 0;
 
             if (i < LED_CHANNELS) {
                 rgbs[i] = 0;
@@ -308,8 +357,7 @@ static bool controlLightTest()
     if (testState == OFF){
         testState = RED;
         for (int i = 0; i < 3; i++){
-            //updateLEDCtrl(channel,red,green,blue,whiteon)
-            updateLEDCtrl(i, 0xFF, 0, 0, false);
+            updateLEDCtrl(i, 0xFF, 0, 0, false, 0);
         };
         return true;
     }
@@ -317,8 +365,7 @@ static bool controlLightTest()
     else if (testState == RED){
         testState = GREEN;   
         for (int i = 0; i < 3; i++){
-            //updateLEDCtrl(channel,red,green,blue,whiteon)
-            updateLEDCtrl(i, 0, 0xFF, 0, false);
+            updateLEDCtrl(i, 0, 0xFF, 0, false, 0);
         };
         return true; 
     }
@@ -326,8 +373,7 @@ static bool controlLightTest()
     else if (testState == GREEN){
         testState = BLUE;
         for (int i = 0; i < 3; i++){
-            //updateLEDCtrl(channel,red,green,blue,whiteon)
-            updateLEDCtrl(i, 0, 0, 0xFF, false);
+            updateLEDCtrl(i, 0, 0, 0xFF, false, 0);
         };
         return true;
     }
@@ -335,8 +381,7 @@ static bool controlLightTest()
     else if (testState == BLUE){
         testState = WHITE;
         for (int i = 0; i < 3; i++){
-            //updateLEDCtrl(channel,red,green,blue,whiteon)
-            updateLEDCtrl(i, 0, 0, 0, true);
+            updateLEDCtrl(i, 0, 0, 0, true, 0);
         };
         return true;
     }
@@ -345,8 +390,7 @@ static bool controlLightTest()
         testState = OFF;
         isInTest = false;
         for (int i = 0; i < 3; i++){
-            //updateLEDCtrl(channel,red,green,blue,whiteon)
-            updateLEDCtrl(i, 0, 0, 0, false);
+            updateLEDCtrl(i, 0, 0, 0, false, 0);
         };
         return true;
     }
@@ -386,6 +430,15 @@ static void initPWMs(TIM_HandleTypeDef *htim1, TIM_HandleTypeDef *htim2, TIM_Han
     channels[10] = TIM_CHANNEL_4;
     channels[11] = TIM_CHANNEL_1;
 
+    /* The compare registers are consecutive, as used by __HAL_TIM_SET_COMPARE */
+    volatile uint32_t* ccrs[LED_CHANNELS * NO_COLORS];
+    for (uint32_t i = 0; i < LED_CHANNELS * NO_COLORS; i++)
+    {
+        ccrs[i] = &(timers[i]->Instance->CCR1) + (channels[i] >> 2U);
+    }
+    fadeInit(ccrs, LED_CHANNELS * NO_COLORS);
+    fadeTimer = htim2;
+
     for (uint32_t i = 0; i < LED_CHANNELS * NO_COLORS; i++)
     {
         HAL_TIM_PWM_Start(timers[i], channels[i]);
@@ -445,6 +498,15 @@ void LightControllerInit(ADC_HandleTypeDef *hadc, TIM_HandleTypeDef *htim1,
     initPWMs(htim1, htim2, htim3, htim4);
 }
 
+/*!
+** @brief Advances the colour transitions. Called from the TIM2 update interrupt
+*/
+void LightControllerFadeTick() {
+    if (!fadeTick()) {
+        __HAL_TIM_DISABLE_IT(fadeTimer, TIM_IT_UPDATE);
+    }
+}
+
 // Main loop - Board only reacts on user inputs
 void LightControllerLoop(const char *bootMsg) {
     CAhandleUserInputs(&caProto, bootMsg); // Always allow DFU upload
@@ -0,0 +1,172 @@
+/*!
+** @file    ledFade.c
+** @brief   Timed transitions of the LED outputs with gamma correction
+** @date:   18/10/2026
+**
+** Each output ramps linearly in brightness (the 8 bit colour value given by the user) from its
+** current level to a target over a number of timer ticks. The brightness is gamma corrected
+** before it is written to the PWM compare register, so the ramps look even to the eye.
+**
+** The ramps are advanced from the update interrupt of a timer, and a compare register is only
+** written when its value changes. When no output is changing, nothing needs to run at all.
+*/
+
+#include <stddef.h>
+
+#include "ledFade.h"
+
+/***************************************************************************************************
+** TYPEDEFS
+***************************************************************************************************/
+
+typedef struct FadeOutput {
+    volatile uint32_t* ccr;
+    uint8_t start;       // Level at the start of the ramp
+    uint8_t target;      // Level at the end of the ramp
+    uint8_t level;       // Current level (before gamma correction)
+    uint32_t duration;   // Length of the ramp in ticks
+    uint32_t elapsed;    // Ticks since the start of the ramp
+    uint32_t written;    // Last value written to the compare register
+    bool isActive;
+} FadeOutput;
+
+/***************************************************************************************************
+** PRIVATE VARIABLES
+***************************************************************************************************/
+
+/* Gamma correction (2.2) of an 8 bit level to the 8 bit PWM compare value. Levels above zero give
+** at least 1, so dim colours do not turn off completely */
+static const uint8_t gammaTable[256] = {
+      0,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,
+      1,   1,   1,   1,   1,   1,   1,   1,   1,   2,   2,   2,   2,   2,   2,   2,
+      3,   3,   3,   3,   3,   4,   4,   4,   4,   5,   5,   5,   5,   6,   6,   6,
+      6,   7,   7,   7,   8,   8,   8,   9,   9,   9,  10,  10,  11,  11,  11,  12,
+     12,  13,  13,  13,  14,  14,  15,  15,  16,  16,  17,  17,  18,  18,  19,  19,
+     20,  20,  21,  22,  22,  23,  23,  24,  25,  25,  26,  26,  27,  28,  28,  29,
+     30,  30,  31,  32,  33,  33,  34,  35,  35,  36,  37,  38,  39,  39,  40,  41,
+     42,  43,  43,  44,  45,  46,  47,  48,  49,  49,  50,  51,  52,  53,  54,  55,
+     56,  57,  58,  59,  60,  61,  62,  63,  64,  65,  66,  67,  68,  69,  70,  71,
+     73,  74,  75,  76,  77,  78,  79,  81,  82,  83,  84,  85,  87,  88,  89,  90,
+     91,  93,  94,  95,  97,  98,  99, 100, 102, 103, 105, 106, 107, 109, 110, 111,
+    113, 114, 116, 117, 119, 120, 121, 123, 124, 126, 127, 129, 130, 132, 133, 135,
+    137, 138, 140, 141, 143, 145, 146, 148, 149, 151, 153, 154, 156, 158, 159, 161,
+    163, 165, 166, 168, 170, 172, 173, 175, 177, 179, 181, 182, 184, 186, 188, 190,
+    192, 194, 196, 197, 199, 201, 203, 205, 207, 209, 211, 213, 215, 217, 219, 221,
+    223, 225, 227, 229, 231, 234, 236, 238, 240, 242, 244, 246, 248, 251, 253, 255
+};
+
+static FadeOutput outputs[FADE_MAX_OUTPUTS];
+static int noOutputs = 0;
+
+/***************************************************************************************************
+** PRIVATE FUNCTION DEFINITIONS
+***************************************************************************************************/
+
+/*!
+** @brief Sets the level of an output, and writes the compare register if the value has changed
+*/
+static void setLevel(FadeOutput* o, uint8_t level) {
+    o->level = level;
+
+    uint32_t value = gammaTable[level];
+    if (value != o->written) {
+        *o->ccr    = value;
+        o->written = value;
+    }
+}
+
+/***************************************************************************************************
+** PUBLIC FUNCTION DEFINITIONS
+***************************************************************************************************/
+
+/*!
+** @brief Initialises the outputs and turns them all off
+**
+** @param[in] ccrs        Compare register of each output
+** @param[in] noOfOutputs Number of outputs (max FADE_MAX_OUTPUTS)
+*/
+void fadeInit(volatile uint32_t* const ccrs[], int noOfOutputs) {
+    noOutputs = (noOfOutputs <= FADE_MAX_OUTPUTS) ? noOfOutputs : FADE_MAX_OUTPUTS;
+
+    for (int i = 0; i < noOutputs; i++) {
+        outputs[i] = (FadeOutput){.ccr = ccrs[i]};
+        *outputs[i].ccr = 0;
+    }
+}
+
+/*!
+** @brief Starts a transition of an output from its current level
+**
+** @param[in] output        Output index
+** @param[in] target        Level at the end of the transition
+** @param[in] durationTicks Length of the transition in timer ticks. 0 changes the level at once
+*/
+void fadeStart(int output, uint8_t target, uint32_t durationTicks) {
+    if (output < 0 || output >= noOutputs) {
+        return;
+    }
+
+    FadeOutput* o = &outputs[output];
+    o->start      = o->level;
+    o->target     = target;
+    o->duration   = durationTicks;
+    o->elapsed    = 0;
+    o->isActive   = (durationTicks != 0) && (target != o->level);
+
+    if (!o->isActive) {
+        setLevel(o, target);
+    }
+}
+
+/*!
+** @brief Advances all active transitions by one tick
+**
+** @return True if any transition is still active
+*/
+bool fadeTick() {
+    bool isActive = false;
+
+    for (FadeOutput* o = outputs; o < &outputs[noOutputs]; o++) {
+        if (!o->isActive) {
+            continue;
+        }
+
+        if (++o->elapsed >= o->duration) {
+            o->isActive = false;
+            setLevel(o, o->target);
+        }
+        else {
+            int32_t delta = (int32_t)o->target - o->start;
+            setLevel(o, o->start + (delta * (int32_t)o->elapsed) / (int32_t)o->duration);
+            isActive = true;
+        }
+    }
+
+    return isActive;
+}
+
+/*!
+** @brief Returns true if any output is in a transition
+*/
+bool fadeIsActive() {
+    for (int i = 0; i < noOutputs; i++) {
+        if (outputs[i].isActive) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*!
+** @brief Returns the level an output is at, or is transitioning to
+*/
+uint8_t fadeTarget(int output) {
+    return (output >= 0 && output < noOutputs) ? outputs[output].target : 0;
+}
+
+/*!
+** @brief Returns the current level of an output (before gamma correction)
+*/
+uint8_t fadeLevel(int output) {
+    return (output >= 0 && output < noOutputs) ? outputs[output].level : 0;
+}
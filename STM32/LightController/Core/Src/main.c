@@ -565,7 +565,16 @@ static void MX_GPIO_Init(void)
 }
 
 /* USER CODE BEGIN 4 */
-
+/*!
+** @brief Advances the LED colour transitions. TIM2 also triggers the ADC
+*/
+void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim)
+{
+  if (htim->Instance == TIM2)
+  {
+    LightControllerFadeTick();
+  }
+}
 /* USER CODE END 4 */
 
 /**
@@ -11,6 +11,7 @@
 #include "CAProtocol.h"
 #include "CAProtocolStm.h"
 #include "main.h"
+#include "piecewiseLinear.h"
 
 /***************************************************************************************************
 ** DEFINES
@@ -30,11 +31,17 @@
 #define V_REF                   3.3    // ADC internal voltage reference
 #define VOLTAGE_SCALING         MAX_VIN / 5.0  // Necessary because LoopControl assumes [0V, 5V]
 
+// CAL thresholds of the sensor calibration tables, which replace the scalar and offset of a sensor
+// once they hold 2 points or more. The input is the ADC value assuming the [0V, 5V] range
+#define CAL_TABLE_POINT 4  // CAL port,input,pressure,4 - Adds or replaces a point
+#define CAL_TABLE_CLEAR 5  // CAL port,0,0,5            - Clears the table
+
 // Variables that need to be stored in flash memory.
 typedef struct FlashCalibration {
     float sensorCalVal[NO_CHANNELS * 2];
     float portCalVal[NO_CHANNELS];
     int measurementType[NO_CHANNELS];
+    PwlTable sensorTable[NO_CALIBRATION_CHANNELS];  // Must be last, see calibrationInit
 } FlashCalibration;
 
 /***************************************************************************************************
@@ -0,0 +1,80 @@
+/*!
+** @file    transient.h
+** @brief   Header file of transient.c
+** @date:   19/10/2026
+*/
+
+#ifndef TRANSIENT_H_
+#define TRANSIENT_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+** Usage:
+** * Initialise with the layout of the ADC buffer using "transientInit". The first "noOfPorts"
+**   channels of each sample are kept in a ring of TRANSIENT_RING_SAMPLES raw samples.
+** * Set the capture window with "transientSetWindow", and the trigger of each port with
+**   "transientSetTrigger". A port triggers when its samples cross a level upwards, or when two
+**   consecutive samples differ by more than a rate.
+** * Pass every half buffer to "transientRun" from the ADCMonitor callback. The ring and the
+**   triggers are updated on every sample.
+** * Once a capture is complete, "transientIsReady" returns true and the ring is frozen. Read the
+**   block (a TransientHeader followed by the samples) with "transientRead", in pieces of any size,
+**   from the main loop. When it has all been read, the ring restarts and the triggers are re-armed.
+**   To only mark a piece as read once it has been sent, use "transientPeek" and then
+**   "transientAdvance" instead. A block which cannot be sent is dropped with "transientDiscard".
+*/
+
+/***************************************************************************************************
+** DEFINES
+***************************************************************************************************/
+
+/* Size of the ring. The default, 24 kB, holds 500 ms of 6 ports at 4 kHz */
+#ifndef TRANSIENT_RING_SAMPLES
+#define TRANSIENT_RING_SAMPLES 12000
+#endif
+
+#define TRANSIENT_MAX_PORTS 8
+
+/***************************************************************************************************
+** TYPEDEFS
+***************************************************************************************************/
+
+typedef enum {
+    TRANSIENT_TRIGGER_OFF,
+    TRANSIENT_TRIGGER_LEVEL,    // Sample goes from below the threshold to at or above it
+    TRANSIENT_TRIGGER_RATE      // Two consecutive samples differ by the threshold or more
+} TransientTrigger;
+
+/*!
+** @brief Start of a block. Followed by (preSamples + postSamples) x noOfPorts raw samples (int16),
+**        in time order and interleaved by port. All fields are little endian
+*/
+typedef struct TransientHeader {
+    uint32_t tick;          // Time (ms) of the trigger
+    uint16_t sampleRate;    // Hz, per port
+    uint16_t preSamples;    // Samples per port before the trigger
+    uint16_t postSamples;   // Samples per port from the trigger sample on
+    uint8_t noOfPorts;
+    uint8_t port;           // Port which triggered, from 1
+} TransientHeader;
+
+/***************************************************************************************************
+** PUBLIC FUNCTION DECLARATIONS
+***************************************************************************************************/
+
+void transientInit(int noOfPorts, int noOfChannels, int sampleRate);
+bool transientSetWindow(int preMs, int postMs);
+bool transientSetTrigger(int port, TransientTrigger trigger, int threshold);
+void transientRun(const int16_t* pData, int noOfSamples, uint32_t tick);
+
+bool transientIsReady();
+int transientRead(uint8_t* buf, int len);
+int transientPeek(uint8_t* buf, int len);
+void transientAdvance(int len);
+void transientDiscard();
+
+bool transientParseTrigger(const char* str, TransientTrigger* trigger);
+
+#endif /* TRANSIENT_H_ */
@@ -6,6 +6,7 @@
  */
 
 #include <math.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <string.h>
 
@@ -13,14 +14,17 @@
 #include "StmGpio.h"
 #include "USBprint.h"
 #include "calibration.h"
+#include "flashWriter.h"
 
 /***************************************************************************************************
 ** DEFINES
 ***************************************************************************************************/
 
 // Extern value defined in .ld linker script
-extern uint32_t _FlashAddrCal;  // Starting address of calibration values in FLASH
-#define FLASH_ADDR_CAL ((uintptr_t) & _FlashAddrCal)
+extern uint32_t _FlashAddrCal;        // Starting address of calibration values in FLASH
+extern uint32_t _FlashAddrCalLegacy;  // Calibration written by firmware using the 128K sector
+#define FLASH_ADDR_CAL        ((uintptr_t) & _FlashAddrCal)
+#define FLASH_ADDR_CAL_LEGACY ((uintptr_t) & _FlashAddrCalLegacy)
 
 /***************************************************************************************************
 ** PRIVATE PROTOTYPE FUNCTIONS
@@ -29,6 +33,9 @@ extern uint32_t _FlashAddrCal;  // Starting address of calibration values in FLA
 static void setMeasurementType(int channel, int measureCurrent);
 static void channelGpioInit(FlashCalibration *cal);
 static void setDefaultCalibration(FlashCalibration *cal);
+static void printSensorTables(FlashCalibration *cal);
+static int readLegacyCalibration(FlashCalibration *cal, uint32_t size);
+static void onCalibrationStored(int status);
 
 /***************************************************************************************************
 ** PRIVATE OBJECTS
@@ -87,6 +94,66 @@ static void setDefaultCalibration(FlashCalibration *cal) {
         cal->portCalVal[i]      = PORTCALVAL_DEFAULT;
         cal->measurementType[i] = 0;
     }
+
+    for (int i = 0; i < NO_CALIBRATION_CHANNELS; i++) {
+        pwlClear(&cal->sensorTable[i]);
+    }
+}
+
+/*!
+ * @brief   Prints the sensor calibration tables which are in use, as CAL commands
+ * @param   cal Calibration
+ */
+static void printSensorTables(FlashCalibration *cal) {
+    static char buf[800];
+
+    for (int ch = 0; ch < NO_CALIBRATION_CHANNELS; ch++) {
+        const PwlTable *table = &cal->sensorTable[ch];
+        if (table->noOfPoints == 0) {
+            continue;
+        }
+
+        int len = 0;
+        CA_SNPRINTF(buf, len, "Calibration table: CAL");
+        for (uint32_t i = 0; i < table->noOfPoints && i < PWL_MAX_POINTS; i++) {
+            CA_SNPRINTF(buf, len, " %d,%.10f,%.10f,%d", ch + 1, table->x[i], table->y[i],
+                        CAL_TABLE_POINT);
+        }
+        CA_SNPRINTF(buf, len, "\r\n");
+        writeUSB(buf, len);
+    }
+}
+
+/*!
+ * @brief   Read a calibration written by an earlier firmware. One stored before the sensor tables
+ *          were added is kept, without tables
+ * @param   cal Calibration
+ * @param   size Calibration size
+ * @return  0 if a calibration was read
+ */
+static int readLegacyCalibration(FlashCalibration *cal, uint32_t size) {
+    if (readFromFlashCRC(hcrc_, (uint32_t)FLASH_ADDR_CAL_LEGACY, (uint8_t *)cal, size) == 0) {
+        return 0;
+    }
+
+    if (readFromFlashCRC(hcrc_, (uint32_t)FLASH_ADDR_CAL_LEGACY, (uint8_t *)cal,
+                         offsetof(FlashCalibration, sensorTable)) != 0) {
+        return -1;
+    }
+    for (int i = 0; i < NO_CALIBRATION_CHANNELS; i++) {
+        pwlClear(&cal->sensorTable[i]);
+    }
+    return 0;
+}
+
+/*!
+ * @brief   Called by the flash writer once the calibration is written
+ * @param   status 0 on success
+ */
+static void onCalibrationStored(int status) {
+    if (status != 0) {
+        USBnprintf("Calibration was not stored in FLASH\r\n");
+    }
 }
 
 /***************************************************************************************************
@@ -139,16 +206,33 @@ void calibrateSensor(int noOfCalibrations, const CACalibration *calibrations, Fl
             continue;
         }
 
+        const int channel = calibrations[i].port - 1;
+
+        if (calibrations[i].threshold == CAL_TABLE_POINT) {
+            if (pwlAddPoint(&cal->sensorTable[channel], calibrations[i].alpha,
+                            calibrations[i].beta) != 0) {
+                USBnprintf("Calibration table of port %d is full\r\n", channel + 1);
+            }
+            continue;
+        }
+
+        if (calibrations[i].threshold == CAL_TABLE_CLEAR) {
+            pwlClear(&cal->sensorTable[channel]);
+            continue;
+        }
+
         // Make sure the measurement type has been explicitly set
         if (calibrations[i].threshold != 0 && calibrations[i].threshold != 1) {
             continue;
         }
 
-        const int channel                  = calibrations[i].port - 1;
         cal->sensorCalVal[channel * 2]     = calibrations[i].alpha;
         cal->sensorCalVal[channel * 2 + 1] = calibrations[i].beta;
-        cal->measurementType[channel]      = calibrations->threshold;
-        setMeasurementType(channel, calibrations->threshold);
+        cal->measurementType[channel]      = calibrations[i].threshold;
+        setMeasurementType(channel, calibrations[i].threshold);
+
+        // A new scalar and offset replace the table
+        pwlClear(&cal->sensorTable[channel]);
     }
     // Calibrations are stored in flash
     calibrationRW(true, cal, calSize);
@@ -163,9 +247,15 @@ void calibrateSensor(int noOfCalibrations, const CACalibration *calibrations, Fl
 void calibrationInit(CRC_HandleTypeDef *hcrc, FlashCalibration *cal, uint32_t size) {
     hcrc_ = hcrc;
 
-    // If calibration value is not stored in FLASH use default calibration
-    if (readFromFlashCRC(hcrc_, (uint32_t)FLASH_ADDR_CAL, (uint8_t *)cal, size) != 0) {
-        setDefaultCalibration(cal);
+    // If calibration value is not stored in FLASH use default calibration. One written by an
+    // earlier firmware is moved to the calibration sector once
+    if (flashWriterRead((uint32_t)FLASH_ADDR_CAL, cal, size) != (int)size) {
+        if (readLegacyCalibration(cal, size) == 0) {
+            calibrationRW(true, cal, size);
+        }
+        else {
+            setDefaultCalibration(cal);
+        }
     }
 
     // Initialise channels to measure current or voltage
@@ -180,7 +270,8 @@ void calibrationInit(CRC_HandleTypeDef *hcrc, FlashCalibration *cal, uint32_t si
  */
 void calibrationRW(bool write, FlashCalibration *cal, uint32_t size) {
     if (write) {
-        if (writeToFlashCRC(hcrc_, (uint32_t)FLASH_ADDR_CAL, (uint8_t *)cal, size) != 0) {
+        // Written in the background by the main loop: cal must stay valid until then
+        if (flashWriterStart((uint32_t)FLASH_ADDR_CAL, cal, size, onCalibrationStored) != 0) {
             USBnprintf("Calibration was not stored in FLASH\r\n");
         }
     }
@@ -194,5 +285,7 @@ void calibrationRW(bool write, FlashCalibration *cal, uint32_t size) {
         }
         CA_SNPRINTF(buf, len, "\r\n");
         writeUSB(buf, len);
+
+        printSensorTables(cal);
     }
 }
\ No newline at end of file
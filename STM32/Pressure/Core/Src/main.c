@@ -14,6 +14,8 @@
 /* USER CODE BEGIN Includes */
 #include "pressure.h"
 #include "CAProtocolStm.h"
+#include "flashRecordStm.h"
+#include "flashWriter.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -98,6 +100,7 @@ int main(void)
   MX_WWDG_Init();
   MX_CRC_Init();
   /* USER CODE BEGIN 2 */
+  flashWriterInit(&flashRecordStmOps, flashRecordStmPauseWwdg);
   pressureInit(&hadc1, &hcrc);
   HAL_TIM_Base_Start_IT(&htim2);
   /* USER CODE END 2 */
@@ -15,9 +15,13 @@
 #include "CAProtocolStm.h"
 #include "StmGpio.h"
 #include "USBprint.h"
+#include "cycleCount.h"
+#include "decimator.h"
+#include "flashWriter.h"
 #include "pcbversion.h"
 #include "pressure.h"
 #include "systemInfo.h"
+#include "transient.h"
 
 /***************************************************************************************************
 ** DEFINES
@@ -25,6 +29,15 @@
 
 #define ADC_CHANNELS         8    // Channels: Pressure 1 - 6, FB_5V, FB_VBUS
 #define ADC_CHANNEL_BUF_SIZE 400  // 4kHz sampling rate
+#define ADC_SAMPLE_RATE      4000
+#define ADC_BITS             12
+
+#define TRANSIENT_FRAME_START 0x02  // Not printable, so frames cannot be mistaken for text
+#define TRANSIENT_CHUNK_BYTES 256
+#define TRANSIENT_SEND_TIMEOUT_MS 1000  // A block is dropped if no piece of it could be sent for this long
+
+/* The filtering and calibration may take 5 ms of the 100 ms between ADC callbacks */
+#define ADC_CALLBACK_BUDGET_MS 5
 
 /***************************************************************************************************
 ** PRIVATE PROTOTYPE FUNCTIONS
@@ -41,6 +54,8 @@ static void ADCtoVolt(float *adcMeans, int noOfChannels);
 static void printPorts(float *portValues);
 static void updateBoardStatus();
 static void adcCallback(int16_t *pData, int noOfChannels, int noOfSamples);
+static void pressureCommandHandler(const char *input);
+static void sendTransient();
 
 /***************************************************************************************************
 ** PRIVATE OBJECTS
@@ -54,11 +69,14 @@ static float volts[ADC_CHANNELS];        // port voltage readings
 static float ADCMeans[ADC_CHANNELS];     // ADC mean readings adjusted with portCalVal
 static float ADCMeansRaw[ADC_CHANNELS];  // ADC mean readings
 
+static CycleStats decimCycles;  // Cycles taken by decimRun in the ADC callback
+static CycleStats calCycles;    // Cycles taken by the calibration in the ADC callback
+
 FlashCalibration cal;
 
 static int loggingMode = 0;
 
-static CAProtocolCtx caProto = {.undefined        = HALundefined,
+static CAProtocolCtx caProto = {.undefined        = pressureCommandHandler,
                                 .printHeader      = printHeader,
                                 .printStatus      = printPressureStatus,
                                 .printStatusDef   = printPressureStatusDef,
@@ -73,6 +91,72 @@ static CAProtocolCtx caProto = {.undefined        = HALundefined,
 ** PRIVATE FUNCTIONS
 ***************************************************************************************************/
 
+/*!
+** @brief Handles communication from the serial interface
+*/
+static void pressureCommandHandler(const char *input) {
+    int channel   = 0;
+    int rate      = 0;
+    char notch[8] = {0};
+    char fir[8]   = {0};
+    DecimNotch decimNotch;
+    DecimFir decimFir;
+    char spike[8] = {0};
+    DecimSpike decimSpike;
+    char trigger[8] = {0};
+    TransientTrigger transientTrigger;
+    int threshold = 0;
+    int preMs     = 0;
+    int postMs    = 0;
+
+    if (sscanf(input, "p%d filter %d %7s %7s", &channel, &rate, notch, fir) == 4) {
+        /* e.g. "p1 filter 50 50 flat": 50 Hz output rate, 50 Hz notch, droop compensation */
+        if (channel >= 1 && channel <= NO_CALIBRATION_CHANNELS &&
+            decimParseNotch(notch, &decimNotch) && decimParseFir(fir, &decimFir) &&
+            decimConfigure(channel - 1, rate, decimFir, decimNotch)) {
+            USBnprintf("Port %d: %d Hz, %.1f effective bits\r\n", channel, decimRate(channel - 1),
+                       decimEffectiveBits(channel - 1));
+        }
+        else {
+            HALundefined(input);
+        }
+    }
+    else if (sscanf(input, "p%d spike %7s", &channel, spike) == 2) {
+        /* e.g. "p1 spike median3": rejects spikes of one sample */
+        if (channel < 1 || channel > NO_CALIBRATION_CHANNELS ||
+            !decimParseSpike(spike, &decimSpike) || !decimSetSpikeFilter(channel - 1, decimSpike)) {
+            HALundefined(input);
+        }
+    }
+    else if (sscanf(input, "p%d trigger %7s %d", &channel, trigger, &threshold) >= 2) {
+        /* e.g. "p1 trigger level 3000" or "p1 trigger rate 200", in ADC counts (per sample), or
+        ** "p1 trigger off" */
+        if (channel < 1 || channel > NO_CALIBRATION_CHANNELS ||
+            !transientParseTrigger(trigger, &transientTrigger) ||
+            !transientSetTrigger(channel - 1, transientTrigger, threshold)) {
+            HALundefined(input);
+        }
+    }
+    else if (sscanf(input, "transient %d %d", &preMs, &postMs) == 2) {
+        /* e.g. "transient 100 200": keeps 100 ms before and 200 ms after a trigger */
+        if (transientSetWindow(preMs, postMs)) {
+            USBnprintf("Transient: %d ms before, %d ms after\r\n", preMs, postMs);
+        }
+        else {
+            HALundefined(input);
+        }
+    }
+    else if (strcmp(input, "cycles") == 0) {
+        USBnprintf("Filter: %" PRIu32 " cycles (max %" PRIu32 "), calibration: %" PRIu32
+                   " cycles (max %" PRIu32 "), budget: %" PRIu32 " cycles\r\n",
+                   decimCycles.last, decimCycles.max, calCycles.last, calCycles.max,
+                   ADC_CALLBACK_BUDGET_MS * cycleCountPerMs());
+    }
+    else {
+        HALundefined(input);
+    }
+}
+
 /*!
  * @brief   Definition of what is printed when the 'Serial' command is received
  */
@@ -104,6 +188,12 @@ static void printPressureStatus() {
     if (bsGetField(VCC_RAW_ERROR_Msk)) {
         CA_SNPRINTF(buf, len, "VCC raw is: %.2f. It should be >=4.6V \r\n", volts[7]);
     }
+
+    if (decimCycles.max + calCycles.max > ADC_CALLBACK_BUDGET_MS * cycleCountPerMs()) {
+        CA_SNPRINTF(buf, len, "Filter and calibration took up to %" PRIu32 " cycles of %" PRIu32
+                    "\r\n", decimCycles.max + calCycles.max,
+                    ADC_CALLBACK_BUDGET_MS * cycleCountPerMs());
+    }
     writeUSB(buf, len);
 }
 
@@ -153,6 +243,8 @@ static void calibrateSensorOrBoard(int noOfCalibrations, const CACalibration *ca
     // and board calibration mode.
     //		calibrations->threshold == 0 -> sensor calibration
     // 		calibrations->threshold == 1 -> board port calibration
+    //		calibrations->threshold == 4 -> add a point to the sensor calibration table
+    //		calibrations->threshold == 5 -> clear the sensor calibration table
     if (calibrations->threshold == 2) {
         if (loggingMode != 1) {
             USBnprintf("To calibrate board, first enter voltLogging mode by typing: 'LOG p1'\r\n");
@@ -175,10 +267,18 @@ static void ADCtoPressure(float *adcMeans, int noOfChannels) {
     cal.sensorCalVal[channel*2]     - Scale assuming [0V, 5V] range
     VOLTAGE_SCALING                 - To go to real [0V, 5.112V] range
     cal.sensorCalVal[channel*2+1]   - Pressure bias
+    cal.sensorTable[channel]        - Replaces scale and bias when it holds 2 points or more
     */
     for (int channel = 0; channel < noOfChannels; channel++) {
-        pressure[channel] = adcMeans[channel] * VOLTAGE_SCALING * cal.sensorCalVal[channel * 2] +
-                            cal.sensorCalVal[channel * 2 + 1];
+        float adcScaled = adcMeans[channel] * VOLTAGE_SCALING;
+
+        if (channel < NO_CALIBRATION_CHANNELS && pwlIsValid(&cal.sensorTable[channel])) {
+            pressure[channel] = pwlEval(&cal.sensorTable[channel], adcScaled);
+        }
+        else {
+            pressure[channel] =
+                adcScaled * cal.sensorCalVal[channel * 2] + cal.sensorCalVal[channel * 2 + 1];
+        }
     }
 }
 
@@ -242,6 +342,54 @@ static void updateBoardStatus() {
     bsClearError(PRESSURE_ERROR_Msk);
 }
 
+/*!
+ * @brief   Sends the next piece of a captured transient, if any
+ * @note    A piece is sent as a frame: TRANSIENT_FRAME_START, 'T', the length of the data (uint16,
+ *          little endian) and up to TRANSIENT_CHUNK_BYTES of data. The frames go in between the
+ *          10 Hz lines, one per ms at most, so the lines are not delayed. A piece is only marked
+ *          as read once it has been written, so a piece which does not fit in the USB buffer is
+ *          sent again. A block which cannot be sent is dropped, so the triggers are re-armed.
+ */
+static void sendTransient() {
+    static uint8_t frame[4 + TRANSIENT_CHUNK_BYTES];
+    static uint32_t lastTick  = 0;
+    static uint32_t lastSent  = 0;     // Time the last piece was written, or the block was ready
+    static bool     isSending = false;
+
+    if (!transientIsReady()) {
+        isSending = false;
+        return;
+    }
+
+    uint32_t tick = HAL_GetTick();
+    if (!isSending) {
+        isSending = true;
+        lastSent  = tick;
+    }
+
+    if (!isUsbPortOpen() || bsGetField(BS_VERSION_ERROR_Msk) || 
+        (tick - lastSent) > TRANSIENT_SEND_TIMEOUT_MS) {
+        transientDiscard();
+        isSending = false;
+        return;
+    }
+
+    if (tick == lastTick) {
+        return;
+    }
+    lastTick = tick;
+
+    int len  = transientPeek(&frame[4], TRANSIENT_CHUNK_BYTES);
+    frame[0] = TRANSIENT_FRAME_START;
+    frame[1] = 'T';
+    frame[2] = len & 0xFF;
+    frame[3] = (len >> 8) & 0xFF;
+    if (writeUSB(frame, 4 + len) == 4 + len) {
+        transientAdvance(len);
+        lastSent = tick;
+    }
+}
+
 /*!
  * @brief   Callback called when ADC circular buffer is half full or full
  * @param   pData ADC buffer
@@ -249,6 +397,12 @@ static void updateBoardStatus() {
  * @param   noOfSamples Number of ADC samples in buffer per channel
  */
 static void adcCallback(int16_t *pData, int noOfChannels, int noOfSamples) {
+    /* Always run, as the boxcars may span several buffers */
+    uint32_t start = cycleCountNow();
+    decimRun(pData, noOfSamples);
+    cycleStatsAdd(&decimCycles, cycleCountNow() - start);
+    transientRun(pData, noOfSamples, HAL_GetTick());
+
     if (!isUsbPortOpen()) {
         return;
     }
@@ -259,14 +413,16 @@ static void adcCallback(int16_t *pData, int noOfChannels, int noOfSamples) {
         return;
     }
 
+    start = cycleCountNow();
     for (int channel = 0; channel < noOfChannels; channel++) {
-        ADCMeansRaw[channel] = ADCMean(pData, channel);
+        ADCMeansRaw[channel] = decimValue(channel);
         ADCMeans[channel]    = ADCMeansRaw[channel] * cal.portCalVal[channel];
     }
 
     // We exclude the last two channels (VCC and VCC raw) when converting the ADC to pressure.
     ADCtoPressure(ADCMeans, noOfChannels - 2);
     ADCtoVolt(ADCMeans, noOfChannels);
+    cycleStatsAdd(&calCycles, cycleCountNow() - start);
 
     if (loggingMode == 0) {
         printPorts(pressure);
@@ -295,6 +451,9 @@ void pressureInit(ADC_HandleTypeDef *hadc, CRC_HandleTypeDef *hcrc) {
     boardSetup(Pressure, (pcbVersion){BREAKING_MAJOR, BREAKING_MINOR}, PRESSURE_ERROR_Msk);
 
     ADCMonitorInit(hadc, ADCBuffer, sizeof(ADCBuffer) / sizeof(int16_t));
+    cycleCountInit();
+    decimInit(ADC_CHANNELS, ADC_CHANNEL_BUF_SIZE, ADC_SAMPLE_RATE, ADC_BITS);
+    transientInit(NO_CALIBRATION_CHANNELS, ADC_CHANNELS, ADC_SAMPLE_RATE);
     calibrationInit(hcrc, &cal, sizeof(cal));
 }
 
@@ -306,4 +465,6 @@ void pressureLoop(const char *bootMsg) {
     CAhandleUserInputs(&caProto, bootMsg);
     updateBoardStatus();
     ADCMonitorLoop(adcCallback);
+    sendTransient();
+    flashWriterRun();
 }
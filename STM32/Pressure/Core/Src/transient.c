@@ -0,0 +1,309 @@
+/*!
+** @file    transient.c
+** @brief   Capture of pressure transients around a trigger
+** @date:   19/10/2026
+**
+** Surges which last tens of milliseconds vanish in the 10 Hz means. The raw samples of the ports
+** are therefore copied into a ring on every sample, and each sample is checked against the trigger
+** of its port. On a trigger, the ring keeps running until the samples after the trigger have been
+** written, then freezes until the block has been read. The cost is one copy and one compare per
+** sample and port.
+*/
+
+#include <string.h>
+
+#include "transient.h"
+
+/***************************************************************************************************
+** DEFINES
+***************************************************************************************************/
+
+#define DEFAULT_PRE_MS  100
+#define DEFAULT_POST_MS 100
+
+/***************************************************************************************************
+** TYPEDEFS
+***************************************************************************************************/
+
+typedef enum {
+    TRANSIENT_ARMED,    // Waiting for a trigger
+    TRANSIENT_POST,     // Writing the samples after the trigger
+    TRANSIENT_READY     // Frozen until the block has been read
+} TransientState;
+
+typedef struct TransientPort {
+    TransientTrigger trigger;
+    int threshold;      // ADC counts, or ADC counts per sample
+    int16_t last;       // Previous sample
+    bool hasLast;
+} TransientPort;
+
+/***************************************************************************************************
+** PRIVATE VARIABLES
+***************************************************************************************************/
+
+static int16_t ring[TRANSIENT_RING_SAMPLES];
+static TransientPort ports[TRANSIENT_MAX_PORTS];
+
+static int noPorts  = 0;
+static int stride   = 1;    // Channels per sample in the ADC buffer
+static int fs       = 1;
+static int capacity = 0;    // Samples per port in the ring
+
+static int preSamples  = 0;
+static int postSamples = 1;
+
+static volatile TransientState state = TRANSIENT_ARMED;
+static int head     = 0;    // Ring index (per port) written next
+static int filled   = 0;    // Samples per port written since the ring was restarted
+static int postLeft = 0;
+static int start    = 0;    // Ring index of the first sample of the block
+static int readPos  = 0;    // Bytes of the block already read
+static TransientHeader header;
+
+/***************************************************************************************************
+** PRIVATE FUNCTION DEFINITIONS
+***************************************************************************************************/
+
+static void rearm() {
+    for (int i = 0; i < noPorts; i++) {
+        ports[i].hasLast = false;
+    }
+    filled = 0;
+    state  = TRANSIENT_ARMED;
+}
+
+/*!
+** @brief Checks the triggers on a sample
+**
+** @return The first port which triggered, or -1
+*/
+static int checkTriggers(const int16_t* sample) {
+    int triggered = -1;
+
+    for (int i = 0; i < noPorts; i++) {
+        TransientPort* p = &ports[i];
+        int16_t value    = sample[i];
+
+        if (p->hasLast && triggered < 0) {
+            if ((p->trigger == TRANSIENT_TRIGGER_LEVEL && p->last < p->threshold &&
+                 value >= p->threshold) ||
+                (p->trigger == TRANSIENT_TRIGGER_RATE &&
+                 (value - p->last >= p->threshold || p->last - value >= p->threshold))) {
+                triggered = i;
+            }
+        }
+        p->last    = value;
+        p->hasLast = true;
+    }
+    return triggered;
+}
+
+/***************************************************************************************************
+** PUBLIC FUNCTION DEFINITIONS
+***************************************************************************************************/
+
+/*!
+** @brief Initialises the ring, with a window of 100 ms before and after a trigger and all
+**        triggers off
+**
+** @param[in] noOfPorts    Number of channels captured, from the first one of each sample
+** @param[in] noOfChannels Number of interleaved channels in the ADC buffer
+** @param[in] sampleRate   Sample rate (Hz) of each channel
+*/
+void transientInit(int noOfPorts, int noOfChannels, int sampleRate) {
+    memset(ports, 0, sizeof(ports));
+    noPorts  = (noOfPorts <= TRANSIENT_MAX_PORTS) ? noOfPorts : TRANSIENT_MAX_PORTS;
+    noPorts  = (noPorts <= noOfChannels) ? noPorts : noOfChannels;
+    stride   = noOfChannels;
+    fs       = (sampleRate > 0) ? sampleRate : 1;
+    capacity = (noPorts > 0) ? TRANSIENT_RING_SAMPLES / noPorts : 0;
+    head     = 0;
+
+    if (!transientSetWindow(DEFAULT_PRE_MS, DEFAULT_POST_MS)) {
+        preSamples  = 0;
+        postSamples = (capacity > 0) ? capacity : 1;
+    }
+    rearm();
+}
+
+/*!
+** @brief Sets the time kept before and after a trigger. Both must fit in the ring together
+**
+** @return False if the window does not fit, or if a capture is in progress
+*/
+bool transientSetWindow(int preMs, int postMs) {
+    int pre  = preMs * fs / 1000;
+    int post = postMs * fs / 1000;
+
+    if (state != TRANSIENT_ARMED || pre < 0 || post < 1 || pre + post > capacity ||
+        pre > UINT16_MAX || post > UINT16_MAX) {
+        return false;
+    }
+
+    preSamples  = pre;
+    postSamples = post;
+    return true;
+}
+
+/*!
+** @brief Sets the trigger of a port
+**
+** @param[in] port      Port, from 0
+** @param[in] trigger   Type of trigger
+** @param[in] threshold Level (ADC counts) or rate (ADC counts per sample). Must be positive unless
+**                      the trigger is off
+*/
+bool transientSetTrigger(int port, TransientTrigger trigger, int threshold) {
+    if (port < 0 || port >= noPorts || trigger < TRANSIENT_TRIGGER_OFF ||
+        trigger > TRANSIENT_TRIGGER_RATE || (trigger != TRANSIENT_TRIGGER_OFF && threshold <= 0)) {
+        return false;
+    }
+
+    ports[port].trigger   = trigger;
+    ports[port].threshold = threshold;
+    return true;
+}
+
+/*!
+** @brief Writes a block of samples to the ring and checks the triggers
+**
+** @param[in] pData       Interleaved samples, e.g. the half buffer given to the ADCMonitor callback
+** @param[in] noOfSamples Number of samples per channel
+** @param[in] tick        Time (ms) of the last sample
+*/
+void transientRun(const int16_t* pData, int noOfSamples, uint32_t tick) {
+    for (int i = 0; i < noOfSamples && state != TRANSIENT_READY; i++) {
+        const int16_t* sample = &pData[i * stride];
+        memcpy(&ring[head * noPorts], sample, noPorts * sizeof(int16_t));
+
+        if (state == TRANSIENT_ARMED) {
+            int port = checkTriggers(sample);
+            if (port >= 0) {
+                int pre            = (filled < preSamples) ? filled : preSamples;
+                start              = (head - pre + capacity) % capacity;
+                header.tick        = tick - (uint32_t)((noOfSamples - 1 - i) * 1000 / fs);
+                header.sampleRate  = fs;
+                header.preSamples  = pre;
+                header.postSamples = postSamples;
+                header.noOfPorts   = noPorts;
+                header.port        = port + 1;
+                postLeft           = postSamples;
+                state              = TRANSIENT_POST;
+            }
+        }
+
+        if (state == TRANSIENT_POST && --postLeft == 0) {
+            readPos = 0;
+            state   = TRANSIENT_READY;
+        }
+
+        head = (head + 1) % capacity;
+        if (filled < capacity) {
+            filled++;
+        }
+    }
+}
+
+/*!
+** @brief True when a block has been captured and is waiting to be read
+*/
+bool transientIsReady() {
+    return state == TRANSIENT_READY;
+}
+
+/*!
+** @brief Copies the next part of the captured block, without marking it as read
+**
+** @param[out] buf Destination
+** @param[in]  len Size of buf. Only whole samples are copied, so an odd size is rounded down
+**
+** @return Number of bytes copied, 0 if there is no block
+*/
+int transientPeek(uint8_t* buf, int len) {
+    if (state != TRANSIENT_READY) {
+        return 0;
+    }
+
+    const int headerSize = sizeof(TransientHeader);
+    const int total = headerSize + (header.preSamples + header.postSamples) * noPorts * 2;
+    int pos         = readPos;
+    int n           = 0;
+
+    len &= ~1;
+    while (n < len && pos < total) {
+        if (pos < headerSize) {
+            buf[n++] = ((const uint8_t*)&header)[pos++];
+            continue;
+        }
+
+        int s     = (pos - headerSize) / 2;
+        int16_t v = ring[((start + s / noPorts) % capacity) * noPorts + s % noPorts];
+        buf[n++]  = (uint8_t)(v & 0xFF);
+        buf[n++]  = (uint8_t)((v >> 8) & 0xFF);
+        pos += 2;
+    }
+
+    return n;
+}
+
+/*!
+** @brief Marks the next part of the captured block as read. Once it has all been read, the ring 
+**        restarts
+**
+** @param[in] len Number of bytes, as returned by transientPeek
+*/
+void transientAdvance(int len) {
+    if (state != TRANSIENT_READY || len <= 0) {
+        return;
+    }
+
+    const int total = sizeof(TransientHeader) + (header.preSamples + header.postSamples) * noPorts * 2;
+
+    readPos += len;
+    if (readPos >= total) {
+        rearm();
+    }
+}
+
+/*!
+** @brief Reads the next part of the captured block. Once it has all been read, the ring restarts
+**
+** @param[out] buf Destination
+** @param[in]  len Size of buf. Only whole samples are read, so an odd size is rounded down
+**
+** @return Number of bytes read, 0 if there is no block
+*/
+int transientRead(uint8_t* buf, int len) {
+    int n = transientPeek(buf, len);
+    transientAdvance(n);
+    return n;
+}
+
+/*!
+** @brief Drops the captured block, if any, and restarts the ring
+*/
+void transientDiscard() {
+    if (state == TRANSIENT_READY) {
+        rearm();
+    }
+}
+
+/*!
+** @brief Parses the name of a trigger ("off", "level" or "rate")
+*/
+bool transientParseTrigger(const char* str, TransientTrigger* trigger) {
+    if (strcmp(str, "off") == 0) {
+        *trigger = TRANSIENT_TRIGGER_OFF;
+    }
+    else if (strcmp(str, "level") == 0) {
+        *trigger = TRANSIENT_TRIGGER_LEVEL;
+    }
+    else if (strcmp(str, "rate") == 0) {
+        *trigger = TRANSIENT_TRIGGER_RATE;
+    }
+    else {
+        return false;
+    }
+    return true;
+}
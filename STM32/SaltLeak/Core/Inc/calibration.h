@@ -19,6 +19,8 @@
 
 #define NO_OF_SENSORS 6
 
+#define KV_KEY_CALIBRATION 1  // Key of the calibration in the key/value store
+
 typedef struct sensorCalibration {
     float resP1;    // kOhm     - Resistance in series with P1 terminal
     float resP2;    // kOhm     - Resistance in series with P2 terminal
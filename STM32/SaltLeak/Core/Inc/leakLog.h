@@ -0,0 +1,63 @@
+/*!
+** @file    leakLog.h
+** @brief   Header file of leakLog.c
+** @date:   19/10/2026
+*/
+
+#ifndef LEAK_LOG_H_
+#define LEAK_LOG_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+** Usage:
+** * Clear a log with "leakLogClear", and call "leakLogStartBoot" once at start-up, so the events of
+**   each boot can be told apart although the tick restarts from 0.
+** * Record each change of state of a sensor with "leakLogAdd". Once the log is full, the oldest
+**   events are overwritten.
+** * Read the events from the oldest with "leakLogCount" and "leakLogGet".
+** * The log is a plain struct, so it can be stored in flash as it is, e.g. as a record of the
+**   key/value store.
+*/
+
+/***************************************************************************************************
+** DEFINES
+***************************************************************************************************/
+
+#define LEAK_LOG_SIZE 32
+
+/***************************************************************************************************
+** TYPEDEFS
+***************************************************************************************************/
+
+typedef struct LeakEvent {
+    uint32_t tick;          // ms since the start of the boot
+    float resistance;       // kOhm
+    uint16_t boot;          // Boot in which the event happened
+    uint8_t sensor;         // From 1
+    uint8_t state;          // New state of the sensor
+    uint8_t prevState;      // State of the sensor before the event
+    uint8_t reserved[3];
+} LeakEvent;
+
+typedef struct LeakLog {
+    uint32_t noOfEvents;    // Events recorded since the log was cleared, including overwritten ones
+    uint16_t boot;
+    uint16_t reserved;
+    LeakEvent events[LEAK_LOG_SIZE];
+} LeakLog;
+
+/***************************************************************************************************
+** PUBLIC FUNCTION DECLARATIONS
+***************************************************************************************************/
+
+void leakLogClear(LeakLog* log);
+void leakLogStartBoot(LeakLog* log);
+void leakLogAdd(LeakLog* log, uint32_t tick, int sensor, int prevState, int state,
+                float resistance);
+
+int leakLogCount(const LeakLog* log);
+const LeakEvent* leakLogGet(const LeakLog* log, int idx);
+
+#endif /* LEAK_LOG_H_ */
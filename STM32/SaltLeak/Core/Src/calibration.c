@@ -12,11 +12,12 @@
 #include "FLASH_readwrite.h"
 #include "USBprint.h"
 #include "calibration.h"
+#include "kvStore.h"
 #include "stm32f4xx_hal.h"
 
 // Extern value defined in .ld linker script
-extern uint32_t _FlashAddrCal;  // Starting address of calibration values in FLASH
-#define FLASH_ADDR_CAL ((uintptr_t) & _FlashAddrCal)
+extern uint32_t _FlashAddrCalLegacy;  // Calibration written by firmware using the 128K sector
+#define FLASH_ADDR_CAL_LEGACY ((uintptr_t) & _FlashAddrCalLegacy)
 
 /***************************************************************************************************
 ** DEFINES
@@ -157,7 +158,15 @@ void calibration(int noOfCalibrations, const CACalibration *calibrations, FlashC
 void calibrationInit(CRC_HandleTypeDef *hcrc, FlashCalibration_t *cal, uint32_t size) {
     hcrc_ = hcrc;
 
-    if (readFromFlashCRC(hcrc, (uint32_t)FLASH_ADDR_CAL, (uint8_t *)cal, size) != 0) {
+    if (kvRead(KV_KEY_CALIBRATION, cal, size) == (int)size) {
+        return;
+    }
+
+    // A calibration written by an earlier firmware is moved to the key/value store once
+    if (readFromFlashCRC(hcrc, (uint32_t)FLASH_ADDR_CAL_LEGACY, (uint8_t *)cal, size) == 0) {
+        calibrationRW(true, cal, size);
+    }
+    else {
         setDefaultCalibration(cal);
     }
 }
@@ -170,7 +179,7 @@ void calibrationInit(CRC_HandleTypeDef *hcrc, FlashCalibration_t *cal, uint32_t
  */
 void calibrationRW(bool write, FlashCalibration_t *cal, uint32_t size) {
     if (write) {
-        if (writeToFlashCRC(hcrc_, (uint32_t)FLASH_ADDR_CAL, (uint8_t *)cal, size) != 0) {
+        if (kvWrite(KV_KEY_CALIBRATION, cal, size) != 0) {
             USBnprintf("Calibration was not stored in FLASH\r\n");
         }
     }
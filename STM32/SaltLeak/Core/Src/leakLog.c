@@ -0,0 +1,76 @@
+/*!
+** @file    leakLog.c
+** @brief   History of the changes of state of the salt leak sensors
+** @date:   19/10/2026
+*/
+
+#include <string.h>
+
+#include "leakLog.h"
+
+/***************************************************************************************************
+** PUBLIC FUNCTION DEFINITIONS
+***************************************************************************************************/
+
+/*!
+** @brief Removes all events
+*/
+void leakLogClear(LeakLog* log) {
+    uint16_t boot = log->boot;
+
+    memset(log, 0, sizeof(LeakLog));
+    log->boot = boot;
+}
+
+/*!
+** @brief Starts a new boot. The events recorded from now on are marked with it
+*/
+void leakLogStartBoot(LeakLog* log) {
+    log->boot++;
+}
+
+/*!
+** @brief Records an event, overwriting the oldest one if the log is full
+**
+** @param[in] tick       Time (ms) of the event
+** @param[in] sensor     Sensor, from 1
+** @param[in] prevState  State before the event
+** @param[in] state      New state
+** @param[in] resistance Resistance (kOhm) measured with the new state
+*/
+void leakLogAdd(LeakLog* log, uint32_t tick, int sensor, int prevState, int state,
+                float resistance) {
+    LeakEvent* e = &log->events[log->noOfEvents % LEAK_LOG_SIZE];
+
+    memset(e, 0, sizeof(LeakEvent));
+    e->tick       = tick;
+    e->resistance = resistance;
+    e->boot       = log->boot;
+    e->sensor     = sensor;
+    e->state      = state;
+    e->prevState  = prevState;
+
+    log->noOfEvents++;
+}
+
+/*!
+** @brief Number of events held by the log
+*/
+int leakLogCount(const LeakLog* log) {
+    return (log->noOfEvents < LEAK_LOG_SIZE) ? (int)log->noOfEvents : LEAK_LOG_SIZE;
+}
+
+/*!
+** @brief Event held by the log, from the oldest (0)
+**
+** @return NULL if idx is out of range
+*/
+const LeakEvent* leakLogGet(const LeakLog* log, int idx) {
+    int count = leakLogCount(log);
+    if (idx < 0 || idx >= count) {
+        return NULL;
+    }
+
+    uint32_t oldest = log->noOfEvents - count;
+    return &log->events[(oldest + idx) % LEAK_LOG_SIZE];
+}
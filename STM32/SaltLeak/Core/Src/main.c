@@ -25,6 +25,9 @@
 /* USER CODE BEGIN Includes */
 #include "saltleakLoop.h"
 #include "CAProtocolStm.h"
+#include "ADCWatchdog.h"
+#include "flashRecordStm.h"
+#include "kvStore.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -34,6 +37,8 @@
 
 /* Private define ------------------------------------------------------------*/
 /* USER CODE BEGIN PD */
+#define FLASH_ADDR_KV       ((uint32_t)&_FlashAddrKv)
+#define FLASH_KV_SECTOR     ((uint32_t)&_FlashKvSectorSize)
 /* USER CODE END PD */
 
 /* Private macro -------------------------------------------------------------*/
@@ -52,7 +57,9 @@ IWDG_HandleTypeDef hiwdg;
 TIM_HandleTypeDef htim2;
 
 /* USER CODE BEGIN PV */
-
+// Extern values defined in .ld linker script
+extern uint32_t _FlashAddrKv;         // Starting address of the key/value store in FLASH
+extern uint32_t _FlashKvSectorSize;   // Size of each of its two sectors
 /* USER CODE END PV */
 
 /* Private function prototypes -----------------------------------------------*/
@@ -112,6 +119,7 @@ int main(void)
   /* Initialize interrupts */
   MX_NVIC_Init();
   /* USER CODE BEGIN 2 */
+  kvInit(&flashRecordStmOps, FLASH_ADDR_KV, FLASH_ADDR_KV + FLASH_KV_SECTOR, FLASH_KV_SECTOR);
   saltleakInit(&hadc1, &hcrc);
   HAL_TIM_Base_Start_IT(&htim2);
   /* USER CODE END 2 */
@@ -445,7 +453,16 @@ static void MX_GPIO_Init(void)
 }
 
 /* USER CODE BEGIN 4 */
-
+/*!
+** @brief Checks the ADC samples written since the last trigger against the ADC watchdog windows
+*/
+void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim)
+{
+  if (htim->Instance == TIM2)
+  {
+    adcWatchdogScan(adcWatchdogDmaIndex(__HAL_DMA_GET_COUNTER(&hdma_adc1)));
+  }
+}
 /* USER CODE END 4 */
 
 /**
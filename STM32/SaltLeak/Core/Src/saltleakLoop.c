@@ -12,11 +12,14 @@
 #include <string.h>
 
 #include "ADCMonitor.h"
+#include "ADCWatchdog.h"
 #include "CAProtocol.h"
 #include "CAProtocolStm.h"
 #include "StmGpio.h"
 #include "USBprint.h"
 #include "calibration.h"
+#include "kvStore.h"
+#include "leakLog.h"
 #include "main.h"
 #include "pcbversion.h"
 #include "saltleakLoop.h"
@@ -29,11 +32,18 @@
 
 #define ADC_CHANNELS          8     // Number of ADC channels used on the STM32
 #define ADC_CHANNEL_BUF_SIZE 400   // 4 kHz sampling  rate -> 10 Hz
+#define ADC_SAMPLES_PER_MS    4
 #define ADC_MAX               4095  // 12-bits
 #define ANALOG_REF_VOLTAGE    3.3   // V
 
 #define NO_OF_SENSORS  6     // Number of salt leak sensors
 #define LEAK_THRESHOLD 10.0  // kOhm  - Leak threshold (to be tuned)
+#define LEAK_DEBOUNCE  20    // Consecutive samples (5 ms) below the leak threshold to latch a leak
+
+#define LEAK_LOG_SAVE_INTERVAL 60000  // ms - Minimum time between two writes of the leak log
+#define KV_KEY_LEAK_LOG        0      // Key of the leak log in the key/value store
+
+#define BOOST_SETTLE_DEFAULT 20  // ms - Time excluded from the measurements after a boost toggle
 
 #define V_BOOST_NOMINAL 48.0  // V  - Nominal boost voltage
 #define V_BOOST_MIN     45.0  // V  - Minimum boost voltage
@@ -70,11 +80,22 @@ static void saltLeakLogging(int port);
 static void userInput(const char *input);
 static void updateBoardStatus();
 static void updateSensorStates();
+static void setSensorState(uint8_t sensor, sensorState_t state, uint32_t tick, float resistance);
+static void onLeakTrip(int id, int channel, int16_t value);
+static void handleLeakTrips();
+static void saveLeakLog();
+static void printLeakLog();
 
+static float senseToResistance(const sensorCalibration_t *sc, float vSense, float vBoost);
 static void voltageToResistance();
-static void adcToFloat(int16_t *pData);
+static int16_t leakThresholdToAdc(const sensorCalibration_t *sc, float vBoost);
+static void updateLeakWatches();
+static int firstValidSample(const int16_t *pData, int noOfSamples);
+static double meanOfSamples(const int16_t *pData, int channel, int first, int noOfSamples);
+static void adcToFloat(int16_t *pData, int first, int noOfSamples);
 static void adcCallback(int16_t *pData, int noOfChannels, int noOfSamples);
 
+static void setBoostPin(bool on);
 static void toggleBoostPin();
 static void updateBoostMode();
 
@@ -102,6 +123,11 @@ static struct {
     bool inSwitchBoostMode;
 } boostController = {0, 0, 0, false};
 
+// Measurements are only made from samples taken once the boost has settled after a toggle
+static int boostSettleSamples = BOOST_SETTLE_DEFAULT * ADC_SAMPLES_PER_MS;
+static int boostToggleIdx     = -1;  // Sample converted when the boost was toggled, -1 if none
+static int boostSettleLeft    = 0;   // Settling samples left at the start of the next half buffer
+
 // GPIO to activate boost converter
 static StmGpio BoostEn;
 
@@ -111,6 +137,22 @@ static int16_t ADCbuffer[ADC_CHANNELS * ADC_CHANNEL_BUF_SIZE * 2];
 // Calibration
 static FlashCalibration_t cal;
 
+// Per-sample leak detection, so leaks shorter than an ADC buffer are not averaged away
+static int leakWatchIds[NO_OF_SENSORS];
+static bool isLeakWatchActive = false;
+
+// Leaks caught by the watches in the timer interrupt, recorded by the main loop
+static volatile bool isTripPending[NO_OF_SENSORS];
+static volatile uint32_t tripTicks[NO_OF_SENSORS];
+static volatile int16_t tripValues[NO_OF_SENSORS];
+
+// Leak log, stored apart from the calibration, and the latest state of each sensor recorded in it,
+// INACTIVE_STATE until it has been measured
+static LeakLog leakLog;
+static sensorState_t loggedStates[NO_OF_SENSORS];
+static bool isLeakLogDirty      = false;
+static uint32_t leakLogSaveTick = 0;
+
 // CA protocol handling
 static CAProtocolCtx caProto = {.undefined        = userInput,
                                 .printHeader      = saltLeakPrintHeader,
@@ -200,18 +242,36 @@ static void saltLeakLogging(int port) {
  * @param   input Pointer to the message received
  */
 static void userInput(const char *input) {
-    static int onTime;
-    static int offTime;
-
-    if (sscanf(input, "boost %d %d", &onTime, &offTime) == 2) {
-        // Input in seconds, but comparison in milliseconds
-        boostController.boostOnTime       = onTime * 1000;
-        boostController.boostOffTime      = offTime * 1000;
+    static float onTime;
+    static float offTime;
+    static int settleTime;
+
+    if (sscanf(input, "boost settle %d", &settleTime) == 1) {
+        // Must leave valid samples in each half buffer
+        if (settleTime >= 0 && settleTime * ADC_SAMPLES_PER_MS < ADC_CHANNEL_BUF_SIZE) {
+            boostSettleSamples = settleTime * ADC_SAMPLES_PER_MS;
+            USBnprintf("Boost settling time: %d ms\r\n", settleTime);
+        }
+        else {
+            HALundefined(input);
+        }
+    }
+    else if (sscanf(input, "boost %f %f", &onTime, &offTime) == 2) {
+        // Input in seconds, with a resolution of 0.1 s, but comparison in milliseconds
+        boostController.boostOnTime       = lroundf(onTime * 1000);
+        boostController.boostOffTime      = lroundf(offTime * 1000);
         boostController.inSwitchBoostMode = true;
     }
     else if (strncmp(input, "switch off", 10) == 0) {
         boostController.inSwitchBoostMode = false;
     }
+    else if (strncmp(input, "history clear", 13) == 0) {
+        leakLogClear(&leakLog);
+        isLeakLogDirty = true;
+    }
+    else if (strncmp(input, "history", 7) == 0) {
+        printLeakLog();
+    }
     else {
         HALundefined(input);
     }
@@ -239,72 +299,250 @@ static void updateBoardStatus() {
  */
 static void updateSensorStates() {
     for (uint8_t i = 0; i < NO_OF_SENSORS; i++) {
+        sensorState_t state;
+
         if (!bsGetField(BS_BOOST_PIN_Msk)) {
-            sensorStates[i] = INACTIVE_STATE;
+            state = INACTIVE_STATE;
         }
         else if (bsGetField(BS_BOOST_ERROR_Msk)) {
-            sensorStates[i] = BOOST_ERROR_STATE;
+            state = BOOST_ERROR_STATE;
         }
         else if (sensorVoltages[i] < BROKEN_NC_LIM * voltageBoost) {
-            sensorStates[i] = NC_OR_BROKEN_STATE;
+            state = NC_OR_BROKEN_STATE;
         }
         else if (sensorVoltages[i] < BROKEN_OK_LOW_LIM * voltageBoost ||
                  sensorVoltages[i] > BROKEN_OK_HIGH_LIM * voltageBoost) {
-            sensorStates[i] = BROKEN_STATE;
+            state = BROKEN_STATE;
         }
-        else if (sensorResistances[i] < LEAK_THRESHOLD) {
-            sensorStates[i] = LEAK_STATE;
+        else if (sensorResistances[i] < LEAK_THRESHOLD || adcWatchdogIsTripped(leakWatchIds[i])) {
+            state = LEAK_STATE;
         }
         else {
-            sensorStates[i] = NOMINAL_STATE;
+            state = NOMINAL_STATE;
         }
+        setSensorState(i, state, HAL_GetTick(), sensorResistances[i]);
+
+        // A latched leak has been reported, so it can be latched again
+        adcWatchdogRearm(leakWatchIds[i]);
+    }
+}
+
+/*!
+ * @brief   Sets the state of a sensor, and records it in the leak log when it has changed
+ * @note    The boost being off or out of range says nothing about the sensor, so these states are
+ *          not recorded. Neither is the first state measured after start-up, unless it is a leak
+ * @param   sensor Sensor, from 0
+ * @param   state New state
+ * @param   tick Time (ms) at which the state was measured
+ * @param   resistance Resistance (kOhm) measured
+ */
+static void setSensorState(uint8_t sensor, sensorState_t state, uint32_t tick, float resistance) {
+    sensorStates[sensor] = state;
+
+    if (state == INACTIVE_STATE || state == BOOST_ERROR_STATE || state == loggedStates[sensor]) {
+        return;
+    }
+
+    if (loggedStates[sensor] != INACTIVE_STATE || state == LEAK_STATE) {
+        leakLogAdd(&leakLog, tick, sensor + 1, loggedStates[sensor], state, resistance);
+        isLeakLogDirty = true;
+    }
+    loggedStates[sensor] = state;
+}
+
+/*!
+ * @brief   Called from the timer interrupt when a sense voltage has been above the leak threshold
+ *          for LEAK_DEBOUNCE samples. Only takes note of the sample, for the main loop
+ */
+static void onLeakTrip(int id, int channel, int16_t value) {
+    (void)id;
+
+    if (channel >= 0 && channel < NO_OF_SENSORS) {
+        tripTicks[channel]     = HAL_GetTick();
+        tripValues[channel]    = value;
+        isTripPending[channel] = true;
+    }
+}
+
+/*!
+ * @brief   Enters the leak state as soon as a watch has tripped, rather than at the next 10 Hz
+ *          update, and records the time and resistance of the sample which tripped it
+ * @note    Only sensors which were nominal are changed. A broken sensor also exceeds the leak
+ *          threshold, and is left to updateSensorStates
+ */
+static void handleLeakTrips() {
+    for (uint8_t i = 0; i < NO_OF_SENSORS; i++) {
+        if (!isTripPending[i]) {
+            continue;
+        }
+        isTripPending[i] = false;
+
+        if (isLeakWatchActive && sensorStates[i] == NOMINAL_STATE) {
+            const sensorCalibration_t *sc = &cal.sensorCal[i];
+            float resistance = senseToResistance(sc, tripValues[i] * sc->vScalar, voltageBoost);
+            setSensorState(i, LEAK_STATE, tripTicks[i], resistance);
+        }
+    }
+}
+
+/*!
+ * @brief   Saves the leak log to flash once it has changed
+ * @note    A write appends a record to the key/value store, which only erases a sector once the
+ *          other one is full. The first event after a quiet period is saved at once, while a sensor
+ *          going back and forth costs one record per LEAK_LOG_SAVE_INTERVAL
+ */
+static void saveLeakLog() {
+    if (isLeakLogDirty && HAL_GetTick() - leakLogSaveTick >= LEAK_LOG_SAVE_INTERVAL) {
+        if (kvWrite(KV_KEY_LEAK_LOG, &leakLog, sizeof(leakLog)) != 0) {
+            USBnprintf("Leak history was not stored in FLASH\r\n");
+        }
+        leakLogSaveTick = HAL_GetTick();
+        isLeakLogDirty  = false;
+    }
+}
+
+/*!
+ * @brief   Prints the leak log, from the oldest event, when the 'history' command is received
+ */
+static void printLeakLog() {
+    int count = leakLogCount(&leakLog);
+
+    USBnprintf("Leak history: %d of %" PRIu32 " events\r\n", count, leakLog.noOfEvents);
+    for (int i = 0; i < count; i++) {
+        const LeakEvent *e = leakLogGet(&leakLog, i);
+        USBnprintf("Boot %u, %" PRIu32 " ms: sensor %u, %u -> %u, %0.2f kOhm\r\n", e->boot, e->tick,
+                   e->sensor, e->prevState, e->state, e->resistance);
     }
 }
 
+/*!
+ * @brief   Computes the raw sense voltage above which the sensor resistance is below the threshold
+ * @param   sc Calibration of the sensor
+ * @param   vBoost Boost voltage applied to the sensor
+ * @return  ADC value of the sense voltage at the leak threshold
+ */
+static int16_t leakThresholdToAdc(const sensorCalibration_t *sc, float vBoost) {
+    // Inverse of voltageToResistance, with the leak resistance in parallel with P2
+    float resLeak = LEAK_THRESHOLD * sc->resP2 / (LEAK_THRESHOLD + sc->resP2);
+    float vLeak   = sc->resN1 * vBoost / (sc->resP1 + sc->resN1 + resLeak);
+
+    return (int16_t)(vLeak / sc->vScalar);
+}
+
+/*!
+ * @brief   Follows the leak thresholds with the measured boost voltage and calibration
+ *
+ * The watches are disabled when the boost converter is off or out of range, since the sense
+ * voltages do not say anything about the sensors then.
+ */
+static void updateLeakWatches() {
+    bool isActive = bsGetField(BS_BOOST_PIN_Msk) && !bsGetField(BS_BOOST_ERROR_Msk);
+
+    for (uint8_t i = 0; i < NO_OF_SENSORS; i++) {
+        if (isActive) {
+            adcWatchdogSetLimits(leakWatchIds[i], INT16_MIN,
+                                 leakThresholdToAdc(&cal.sensorCal[i], voltageBoost));
+        }
+        if (isActive != isLeakWatchActive) {
+            adcWatchdogEnable(leakWatchIds[i], isActive);
+        }
+    }
+
+    isLeakWatchActive = isActive;
+}
+
+/*!
+ * @brief   Estimates the resistance between the electrodes of a sensor
+ * @param   sc Calibration of the sensor
+ * @param   vSense Sense voltage
+ * @param   vBoost Boost voltage applied to the sensor
+ * @return  Resistance in kOhm. -1 if there is no sense voltage, <= 0 if the sensor is NC/broken
+ */
+static float senseToResistance(const sensorCalibration_t *sc, float vSense, float vBoost) {
+    if (vSense == 0.0) {
+        return -1.0;  // Incorrect resistance value
+    }
+
+    // Formulas derived from resistors network
+    float num = sc->resP2 * (sc->resP1 + sc->resN1 - (sc->resN1 * vBoost / vSense));
+    float den = sc->resN1 * vBoost / vSense - (sc->resP1 + sc->resP2 + sc->resN1);
+
+    if (den == 0.0) {
+        return 1e6;
+    }
+    return num / den;
+}
+
 /*!
  * @brief   Estimates the resistance between the electrodes based on the sense voltage
  */
 static void voltageToResistance() {
     for (uint8_t i = 0; i < NO_OF_SENSORS; i++) {
-        sensorCalibration_t *sc = &cal.sensorCal[i];
+        sensorResistances[i] =
+            senseToResistance(&cal.sensorCal[i], sensorVoltages[i], voltageBoost);
+    }
+}
 
-        if (sensorVoltages[i] == 0.0) {
-            sensorResistances[i] = -1.0;  // Incorrect resistance value
-            continue;
+/*!
+ * @brief   Finds the first sample of a half buffer taken once the boost has settled
+ * @note    The boost is toggled by the ADC callback, while the DMA fills the next half buffer, so
+ *          the toggle is normally found in the next half buffer. The samples before it are from
+ *          the previous boost state, and are excluded too
+ * @param   pData Pointer to the latest ADC values
+ * @param   noOfSamples Number of samples per channel
+ * @return  Index of the first valid sample, noOfSamples if there is none
+ */
+static int firstValidSample(const int16_t *pData, int noOfSamples) {
+    int first = boostSettleLeft;
+
+    if (boostToggleIdx >= 0) {
+        int offset = boostToggleIdx - (pData - ADCbuffer) / ADC_CHANNELS;
+        if (offset < 0 || offset >= noOfSamples) {
+            offset = 0;  // Toggle not located, e.g. the timer is not scanning
         }
+        first          = offset + boostSettleSamples;
+        boostToggleIdx = -1;
+    }
 
-        // Formulas derived from resistors network
-        float num =
-            sc->resP2 * (sc->resP1 + sc->resN1 - (sc->resN1 * voltageBoost / sensorVoltages[i]));
-        float den =
-            sc->resN1 * voltageBoost / sensorVoltages[i] - (sc->resP1 + sc->resP2 + sc->resN1);
+    boostSettleLeft = (first > noOfSamples) ? first - noOfSamples : 0;
+    return (first < noOfSamples) ? first : noOfSamples;
+}
 
-        if (den == 0.0) {
-            sensorResistances[i] = 1e6;
-            continue;
-        }
+/*!
+ * @brief   Mean of a channel over part of a half buffer
+ * @param   pData Pointer to the latest ADC values
+ * @param   channel ADC channel
+ * @param   first First sample of the mean
+ * @param   noOfSamples Number of samples per channel
+ */
+static double meanOfSamples(const int16_t *pData, int channel, int first, int noOfSamples) {
+    int32_t sum = 0;
 
-        // Resistance <= 0 means that the sensor is NC/broken
-        sensorResistances[i] = num / den;
+    for (int i = first; i < noOfSamples; i++) {
+        sum += pData[i * ADC_CHANNELS + channel];
     }
+    return (double)sum / (noOfSamples - first);
 }
 
 /*!
  * @brief   Conversion of ADC values into physical values
  * @param   pData Pointer to the latest ADC values
+ * @param   first First sample taken once the boost has settled
+ * @param   noOfSamples Number of samples per channel
  */
-static void adcToFloat(int16_t *pData) {
+static void adcToFloat(int16_t *pData, int first, int noOfSamples) {
     // From voltage divider on PCB - in V
     static const float VCC_SCALAR = ANALOG_REF_VOLTAGE * (15e3 + 21.5e3) / 21.5e3 / (ADC_MAX + 1);
 
-    // Voltage feedbacks
-    voltageBoost = ADCMean(pData, 6) * cal.boostScalar;
-    voltageVCC   = ADCMean(pData, 7) * VCC_SCALAR;
+    // Voltage feedbacks. The boost and sense voltages are averaged over the same samples, so their
+    // ratio is not skewed by a boost toggle
+    voltageBoost = meanOfSamples(pData, 6, first, noOfSamples) * cal.boostScalar;
+    voltageVCC   = meanOfSamples(pData, 7, first, noOfSamples) * VCC_SCALAR;
     setBoardVoltage(voltageVCC);
 
     // Sense voltages
     for (uint8_t i = 0; i < NO_OF_SENSORS; i++) {
-        sensorVoltages[i] = ADCMean(pData, i) * cal.sensorCal[i].vScalar;
+        sensorVoltages[i] = meanOfSamples(pData, i, first, noOfSamples) * cal.sensorCal[i].vScalar;
     }
 
     // Resistance estimation
@@ -327,9 +565,14 @@ static void adcCallback(int16_t *pData, int noOfChannels, int noOfSamples) {
         return;
     }
 
-    adcToFloat(pData);
-    updateBoardStatus();
-    updateSensorStates();
+    // A half buffer within the settling time keeps the previous measurements and states
+    int first = firstValidSample(pData, noOfSamples);
+    if (first < noOfSamples) {
+        adcToFloat(pData, first, noOfSamples);
+        updateBoardStatus();
+        updateSensorStates();
+        updateLeakWatches();
+    }
     updateBoostMode();
 
     int len = 0;
@@ -355,6 +598,17 @@ static void adcCallback(int16_t *pData, int noOfChannels, int noOfSamples) {
     writeUSB(buff, len);
 }
 
+/*!
+ * @brief   Sets the boost pin, and notes which sample was being converted if it changed
+ * @param   on New state of the pin
+ */
+static void setBoostPin(bool on) {
+    if ((bool)stmGetGpio(BoostEn) != on) {
+        stmSetGpio(BoostEn, on);
+        boostToggleIdx = adcWatchdogScanIndex();
+    }
+}
+
 /*!
  * @brief   Turn on and off boost module after user defined time interval
  */
@@ -365,7 +619,7 @@ static void toggleBoostPin() {
 
     if (HAL_GetTick() - boostController.timeStamp >= switchTime) {
         boostController.timeStamp = HAL_GetTick();
-        stmSetGpio(BoostEn, switchControl);
+        setBoostPin(switchControl);
     }
 }
 
@@ -377,7 +631,7 @@ static void updateBoostMode() {
         toggleBoostPin();
     }
     else {
-        stmSetGpio(BoostEn, true);
+        setBoostPin(true);
     }
 }
 
@@ -404,6 +658,27 @@ void saltleakInit(ADC_HandleTypeDef *hadc1, CRC_HandleTypeDef *hcrc) {
     // Calibration
     calibrationInit(hcrc, &cal, sizeof(cal));
 
+    // Leak log, saved at once for the first event
+    if (kvRead(KV_KEY_LEAK_LOG, &leakLog, sizeof(leakLog)) != (int)sizeof(leakLog)) {
+        leakLogClear(&leakLog);
+    }
+    leakLogStartBoot(&leakLog);
+    for (uint8_t i = 0; i < NO_OF_SENSORS; i++) {
+        loggedStates[i]  = INACTIVE_STATE;
+        isTripPending[i] = false;
+    }
+    isLeakLogDirty  = false;
+    leakLogSaveTick = HAL_GetTick() - LEAK_LOG_SAVE_INTERVAL;
+
+    // Leak watches start disabled until the boost voltage has been measured
+    adcWatchdogInit(ADCbuffer, ADC_CHANNELS, ADC_CHANNEL_BUF_SIZE * 2);
+    for (uint8_t i = 0; i < NO_OF_SENSORS; i++) {
+        int16_t high    = leakThresholdToAdc(&cal.sensorCal[i], V_BOOST_NOMINAL);
+        leakWatchIds[i] = adcWatchdogAdd(i, INT16_MIN, high, LEAK_DEBOUNCE, onLeakTrip);
+        adcWatchdogEnable(leakWatchIds[i], false);
+    }
+    isLeakWatchActive = false;
+
     // GPIO
     stmGpioInit(&BoostEn, BOOST_EN_GPIO_Port, BOOST_EN_Pin, STM_GPIO_OUTPUT);
     stmSetGpio(BoostEn, true);  // Activates boost converter by default
@@ -415,5 +690,7 @@ void saltleakInit(ADC_HandleTypeDef *hadc1, CRC_HandleTypeDef *hcrc) {
  */
 void saltleakLoop(const char *bootMsg) {
     CAhandleUserInputs(&caProto, bootMsg);
+    handleLeakTrips();
     ADCMonitorLoop(adcCallback);
+    saveLeakLog();
 }
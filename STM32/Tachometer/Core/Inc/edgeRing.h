@@ -0,0 +1,51 @@
+/*!
+** @file    edgeRing.h
+** @brief   Header file of edgeRing.c
+** @date:   18/10/2026
+*/
+
+#ifndef EDGE_RING_H_
+#define EDGE_RING_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+** Usage:
+** * Initialise a ring per channel with "edgeRingInit". The buffer is either the destination of a
+**   circular input capture DMA, or written from the EXTI interrupt with "edgeRingPush".
+** * Call "edgeRingRead" from the main loop with the index the writer will write next: either
+**   "edgeRingDmaIndex" of the DMA NDTR register, or "swIdx" of the ring for EXTI channels.
+** * Up to (length - 2) edges can be written between two reads. If more are written, the read
+**   reports an overrun and only returns the newest timestamp, so the period must be restarted.
+*/
+
+/***************************************************************************************************
+** DEFINES
+***************************************************************************************************/
+
+#define EDGE_RING_EMPTY 0xFFFFFFFFU     // Value of the entries which have been read
+
+/***************************************************************************************************
+** TYPEDEFS
+***************************************************************************************************/
+
+typedef struct EdgeRing {
+    uint32_t* buf;
+    uint16_t len;
+    volatile uint16_t swIdx;    // Next entry written by edgeRingPush
+    uint16_t readIdx;           // Next entry to read
+    uint32_t overruns;          // Number of reads which found the ring lapped by the writer
+} EdgeRing;
+
+/***************************************************************************************************
+** PUBLIC FUNCTION DECLARATIONS
+***************************************************************************************************/
+
+void edgeRingInit(EdgeRing* ring, uint32_t* buf, uint16_t len);
+void edgeRingPush(EdgeRing* ring, uint32_t timestamp);
+
+uint16_t edgeRingDmaIndex(const EdgeRing* ring, uint32_t dmaRemaining);
+int edgeRingRead(EdgeRing* ring, uint16_t writeIdx, uint32_t* timestamps, bool* isOverrun);
+
+#endif /* EDGE_RING_H_ */
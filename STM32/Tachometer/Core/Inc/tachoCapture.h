@@ -0,0 +1,23 @@
+/*!
+** @file    tachoCapture.h
+** @brief   Header file of tachoCapture.c
+** @date:   18/10/2026
+*/
+
+#ifndef TACHO_CAPTURE_H_
+#define TACHO_CAPTURE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "stm32f4xx_hal.h"
+
+/***************************************************************************************************
+** PUBLIC FUNCTION DECLARATIONS
+***************************************************************************************************/
+
+void tachoCaptureInit(TIM_HandleTypeDef* htim);
+bool tachoCaptureStart(uint32_t timChannel, uint16_t pin, uint32_t* buf, uint16_t len);
+uint32_t tachoCaptureRemaining(uint32_t timChannel);
+
+#endif /* TACHO_CAPTURE_H_ */
@@ -0,0 +1,84 @@
+/*!
+** @file    tachoEstimator.h
+** @brief   Header file of tachoEstimator.c
+** @date:   18/10/2026
+*/
+
+#ifndef TACHO_ESTIMATOR_H_
+#define TACHO_ESTIMATOR_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+** Usage:
+** * Initialise an estimator per channel with "tachoEstInit".
+** * Give it every edge timestamp, oldest first, with "tachoEstEdge". If edges have been lost, call
+**   "tachoEstRestart" first, so no period is measured across the gap.
+** * Call "tachoEstUpdate" once per window (e.g. print period). It returns the frequency per
+**   revolution and latches the period statistics of the window, see "tachoEstStats".
+*/
+
+/***************************************************************************************************
+** DEFINES
+***************************************************************************************************/
+
+#define TACHO_EST_MAX_PPR 1000
+
+/***************************************************************************************************
+** TYPEDEFS
+***************************************************************************************************/
+
+typedef enum {
+    TACHO_EST_AUTO,     // Whole periods timed from edge to edge over the window
+    TACHO_EST_PERIOD,   // Last period only
+    TACHO_EST_COUNT,    // Number of edges in the window
+    TACHO_EST_NO_MODES
+} TachoEstMode;
+
+typedef struct TachoEstConfig {
+    TachoEstMode mode;
+    float tickHz;           // Frequency of the edge timestamps
+    uint32_t timeoutTicks;  // Time without edges before reporting 0
+} TachoEstConfig;
+
+/* Statistics of the periods between edges (not divided by the pulses per revolution) */
+typedef struct TachoPeriodStats {
+    uint32_t count;
+    uint32_t min;       // Ticks
+    uint32_t max;       // Ticks
+    float mean;         // Ticks
+    float stddev;       // Ticks
+} TachoPeriodStats;
+
+typedef struct TachoEstimator {
+    uint16_t ppr;           // Pulses per revolution
+
+    bool hasEdge;
+    uint32_t lastEdge;
+    uint32_t lastPeriod;
+    uint32_t windowStart;   // Timestamp of the start of the current window
+
+    /* Current window */
+    uint32_t edges;
+    uint32_t periods;
+    uint32_t minPeriod;
+    uint32_t maxPeriod;
+    uint64_t sum;
+    uint64_t sumSq;
+
+    float freq;             // Edges per second, before the pulses per revolution
+    TachoPeriodStats stats; // Of the last window
+} TachoEstimator;
+
+/***************************************************************************************************
+** PUBLIC FUNCTION DECLARATIONS
+***************************************************************************************************/
+
+void tachoEstInit(TachoEstimator* est, uint16_t ppr, uint32_t now);
+void tachoEstRestart(TachoEstimator* est);
+void tachoEstEdge(TachoEstimator* est, uint32_t timestamp, const TachoEstConfig* cfg);
+float tachoEstUpdate(TachoEstimator* est, uint32_t now, const TachoEstConfig* cfg);
+const TachoPeriodStats* tachoEstStats(const TachoEstimator* est);
+
+#endif /* TACHO_ESTIMATOR_H_ */
@@ -0,0 +1,106 @@
+/*!
+** @file    edgeRing.c
+** @brief   Rings of edge timestamps written by input capture DMA or by the EXTI interrupt
+** @date:   18/10/2026
+**
+** The writer (DMA or interrupt) only stores the timer count of each edge. The main loop reads all
+** new timestamps in one go and marks the entries it has read as empty. Since the writer can't tell
+** the reader that it has lapped it, the entry after the one being written next is checked instead:
+** it is only non-empty if the writer has gone round the whole ring since the last read.
+*/
+
+#include <stddef.h>
+
+#include "edgeRing.h"
+
+/***************************************************************************************************
+** PUBLIC FUNCTION DEFINITIONS
+***************************************************************************************************/
+
+/*!
+** @brief Initialises a ring and marks all its entries as empty
+**
+** @param[in] buf Buffer of at least 3 entries. Must be given to the DMA after this call
+** @param[in] len Number of entries in the buffer
+*/
+void edgeRingInit(EdgeRing* ring, uint32_t* buf, uint16_t len) {
+    ring->buf      = buf;
+    ring->len      = len;
+    ring->swIdx    = 0;
+    ring->readIdx  = 0;
+    ring->overruns = 0;
+
+    for (int i = 0; i < len; i++) {
+        buf[i] = EDGE_RING_EMPTY;
+    }
+}
+
+/*!
+** @brief Stores a timestamp. Called from the EXTI interrupt of channels without input capture
+*/
+void edgeRingPush(EdgeRing* ring, uint32_t timestamp) {
+    uint16_t idx   = ring->swIdx;
+    ring->buf[idx] = timestamp;
+    ring->swIdx    = (idx + 1 < ring->len) ? idx + 1 : 0;
+}
+
+/*!
+** @brief Converts the remaining number of DMA transfers into the index of the next entry
+**
+** @param[in] dmaRemaining Remaining transfers in the current DMA cycle (e.g. NDTR register)
+*/
+uint16_t edgeRingDmaIndex(const EdgeRing* ring, uint32_t dmaRemaining) {
+    if (ring->len == 0 || dmaRemaining > ring->len) {
+        return 0;
+    }
+    return (ring->len - dmaRemaining) % ring->len;
+}
+
+/*!
+** @brief Reads all timestamps written since the last call, oldest first
+**
+** @param[in]  writeIdx   Index of the entry the writer will write next
+** @param[out] timestamps Must hold the length of the ring
+** @param[out] isOverrun  True if the writer lapped the ring. Only the newest timestamp is returned
+**
+** @return Number of timestamps
+*/
+int edgeRingRead(EdgeRing* ring, uint16_t writeIdx, uint32_t* timestamps, bool* isOverrun) {
+    *isOverrun = false;
+    if (ring->buf == NULL || ring->len < 3 || writeIdx >= ring->len) {
+        return 0;
+    }
+
+    uint16_t len = ring->len;
+    int n        = 0;
+
+    /* An edge may be written at writeIdx while this runs, but never at the entry after it unless
+    ** the writer has lapped the reader */
+    if (ring->buf[(writeIdx + 1) % len] != EDGE_RING_EMPTY) {
+        *isOverrun = true;
+        ring->overruns++;
+
+        uint32_t newest = ring->buf[(writeIdx + len - 1) % len];
+        for (int i = 0; i < len; i++) {
+            ring->buf[i] = EDGE_RING_EMPTY;
+        }
+        ring->readIdx = writeIdx;
+
+        if (newest != EDGE_RING_EMPTY) {
+            timestamps[n++] = newest;
+        }
+        return n;
+    }
+
+    for (; ring->readIdx != writeIdx; ring->readIdx = (ring->readIdx + 1) % len) {
+        uint32_t t = ring->buf[ring->readIdx];
+        ring->buf[ring->readIdx] = EDGE_RING_EMPTY;
+
+        /* Only empty if it was cleared by an overrun while the writer was storing it */
+        if (t != EDGE_RING_EMPTY) {
+            timestamps[n++] = t;
+        }
+    }
+
+    return n;
+}
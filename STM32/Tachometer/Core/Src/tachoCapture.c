@@ -0,0 +1,113 @@
+/*!
+** @file    tachoCapture.c
+** @brief   TIM2 input capture of tachometer edges into circular DMA buffers
+** @date:   18/10/2026
+**
+** The DMA streams are set up here rather than in CubeMX, since which pins can be captured depends
+** on the PCB version. No DMA interrupts are used: the main loop finds the position of the DMA from
+** its NDTR register.
+*/
+
+#include <stddef.h>
+
+#include "tachoCapture.h"
+
+/***************************************************************************************************
+** PRIVATE VARIABLES
+***************************************************************************************************/
+
+/* DMA1 streams of the TIM2 capture/compare requests (all on DMA channel 3), per TIM2 channel */
+static const struct {
+    DMA_Stream_TypeDef* stream;
+    uint16_t dmaId;
+} CAPTURE_DMA[4] = {
+    {DMA1_Stream5, TIM_DMA_ID_CC1},
+    {DMA1_Stream6, TIM_DMA_ID_CC2},
+    {DMA1_Stream1, TIM_DMA_ID_CC3},
+    {DMA1_Stream7, TIM_DMA_ID_CC4},
+};
+
+static TIM_HandleTypeDef* tim = NULL;
+static DMA_HandleTypeDef hdma[4];
+
+/***************************************************************************************************
+** PUBLIC FUNCTION DEFINITIONS
+***************************************************************************************************/
+
+/*!
+** @brief Sets up the channels of the (already initialised) timer for input capture
+*/
+void tachoCaptureInit(TIM_HandleTypeDef* htim) {
+    tim = htim;
+    __HAL_RCC_DMA1_CLK_ENABLE();
+    (void) HAL_TIM_IC_Init(tim);
+}
+
+/*!
+** @brief Captures the rising edges of a pin on port A into a circular buffer
+**
+** @param[in] timChannel TIM2 channel of the pin (TIM_CHANNEL_x)
+** @param[in] pin        Pin on port A with TIM2 as alternate function 1
+**
+** @return False if the capture could not be started, in which case the EXTI must be used
+*/
+bool tachoCaptureStart(uint32_t timChannel, uint16_t pin, uint32_t* buf, uint16_t len) {
+    uint32_t idx = timChannel >> 2;
+    if (tim == NULL || idx >= 4) {
+        return false;
+    }
+
+    DMA_HandleTypeDef* h = &hdma[idx];
+
+    h->Instance                 = CAPTURE_DMA[idx].stream;
+    h->Init.Channel             = DMA_CHANNEL_3;
+    h->Init.Direction           = DMA_PERIPH_TO_MEMORY;
+    h->Init.PeriphInc           = DMA_PINC_DISABLE;
+    h->Init.MemInc              = DMA_MINC_ENABLE;
+    h->Init.PeriphDataAlignment = DMA_PDATAALIGN_WORD;
+    h->Init.MemDataAlignment    = DMA_MDATAALIGN_WORD;
+    h->Init.Mode                = DMA_CIRCULAR;
+    h->Init.Priority            = DMA_PRIORITY_HIGH;
+    h->Init.FIFOMode            = DMA_FIFOMODE_DISABLE;
+    if (HAL_DMA_Init(h) != HAL_OK) {
+        return false;
+    }
+    __HAL_LINKDMA(tim, hdma[CAPTURE_DMA[idx].dmaId], *h);
+
+    TIM_IC_InitTypeDef ic = {0};
+    ic.ICPolarity  = TIM_INPUTCHANNELPOLARITY_RISING;
+    ic.ICSelection = TIM_ICSELECTION_DIRECTTI;
+    ic.ICPrescaler = TIM_ICPSC_DIV1;
+    ic.ICFilter    = 0;
+    if (HAL_TIM_IC_ConfigChannel(tim, &ic, timChannel) != HAL_OK) {
+        return false;
+    }
+
+    /* HAL_GPIO_Init only changes the EXTI for EXTI modes, so the line armed by initGpio() is
+    ** cleared before the pin is switched to its alternate function */
+    HAL_GPIO_DeInit(GPIOA, pin);
+    GPIO_InitTypeDef gpio = {0};
+    gpio.Pin       = pin;
+    gpio.Mode      = GPIO_MODE_AF_PP;
+    gpio.Pull      = GPIO_NOPULL;
+    gpio.Speed     = GPIO_SPEED_FREQ_LOW;
+    gpio.Alternate = GPIO_AF1_TIM2;
+    HAL_GPIO_Init(GPIOA, &gpio);
+
+    if (HAL_TIM_IC_Start_DMA(tim, timChannel, buf, len) != HAL_OK) {
+        gpio.Mode      = GPIO_MODE_IT_RISING;
+        gpio.Alternate = 0;
+        HAL_GPIO_Init(GPIOA, &gpio);
+        return false;
+    }
+
+    return true;
+}
+
+/*!
+** @brief Remaining transfers before the DMA of a channel wraps round its buffer
+*/
+uint32_t tachoCaptureRemaining(uint32_t timChannel) {
+    uint32_t idx = timChannel >> 2;
+    return (idx < 4 && hdma[idx].Instance != NULL) ? __HAL_DMA_GET_COUNTER(&hdma[idx]) : 0;
+}
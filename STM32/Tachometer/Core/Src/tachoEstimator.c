@@ -0,0 +1,160 @@
+/*!
+** @file    tachoEstimator.c
+** @brief   Frequency estimation and period statistics from edge timestamps
+** @date:   18/10/2026
+**
+** Averaging the frequencies of single periods overweights the short periods, and a single period
+** only resolves one timer tick in that period. In the AUTO mode the frequency is instead the number
+** of whole periods which ended in the window divided by their total length, measured from edge to
+** edge. Below one edge per window this is a period measurement over the last period, and above it
+** an edge count over the window with a gate aligned to the edges, i.e. without the +/- 1 edge
+** error of a fixed gate. The resolution is therefore one tick over the longer of the period and
+** the window at all speeds.
+**
+** Each edge only costs a few integer operations. The divisions and the square root are done once
+** per window.
+*/
+
+#include <math.h>
+#include <string.h>
+
+#include "tachoEstimator.h"
+
+/***************************************************************************************************
+** PRIVATE FUNCTION DEFINITIONS
+***************************************************************************************************/
+
+static void resetWindow(TachoEstimator* est) {
+    est->edges     = 0;
+    est->periods   = 0;
+    est->minPeriod = UINT32_MAX;
+    est->maxPeriod = 0;
+    est->sum       = 0;
+    est->sumSq     = 0;
+}
+
+static void latchStats(TachoEstimator* est) {
+    TachoPeriodStats* s = &est->stats;
+    uint64_t n          = est->periods;
+
+    memset(s, 0, sizeof(*s));
+    s->count = est->periods;
+    if (n == 0) {
+        return;
+    }
+
+    s->min  = est->minPeriod;
+    s->max  = est->maxPeriod;
+    s->mean = (float) ((double) est->sum / n);
+
+    /* n * sum(p^2) - sum(p)^2 is exact in integers, so there is no cancellation */
+    if (n > 1) {
+        double var = (double) (n * est->sumSq - est->sum * est->sum) / (double) (n * (n - 1));
+        s->stddev  = sqrtf((float) var);
+    }
+}
+
+/***************************************************************************************************
+** PUBLIC FUNCTION DEFINITIONS
+***************************************************************************************************/
+
+/*!
+** @brief Initialises an estimator
+**
+** @param[in] ppr Pulses per revolution (1 to TACHO_EST_MAX_PPR)
+** @param[in] now Current timestamp, i.e. start of the first window
+*/
+void tachoEstInit(TachoEstimator* est, uint16_t ppr, uint32_t now) {
+    memset(est, 0, sizeof(*est));
+    est->ppr         = (ppr >= 1 && ppr <= TACHO_EST_MAX_PPR) ? ppr : 1;
+    est->windowStart = now;
+    resetWindow(est);
+}
+
+/*!
+** @brief Makes the next edge start a new period, e.g. after edges have been lost
+*/
+void tachoEstRestart(TachoEstimator* est) {
+    est->hasEdge = false;
+}
+
+/*!
+** @brief Adds an edge to the current window. Edges must be given in order
+*/
+void tachoEstEdge(TachoEstimator* est, uint32_t timestamp, const TachoEstConfig* cfg) {
+    est->edges++;
+
+    if (est->hasEdge) {
+        /* Wraps correctly when the timer rolls over. A period longer than the timeout is a restart
+        ** rather than a measurement */
+        uint32_t period = timestamp - est->lastEdge;
+        if (period > 0 && period <= cfg->timeoutTicks) {
+            est->lastPeriod = period;
+            est->periods++;
+            est->sum   += period;
+            est->sumSq += (uint64_t) period * period;
+            est->minPeriod = (period < est->minPeriod) ? period : est->minPeriod;
+            est->maxPeriod = (period > est->maxPeriod) ? period : est->maxPeriod;
+        }
+    }
+
+    est->hasEdge  = true;
+    est->lastEdge = timestamp;
+}
+
+/*!
+** @brief Ends the current window
+**
+** @param[in] now Timestamp of the end of the window. Later edges must be given after this call
+**
+** @return Revolutions per second
+*/
+float tachoEstUpdate(TachoEstimator* est, uint32_t now, const TachoEstConfig* cfg) {
+    uint32_t window = now - est->windowStart;
+    float f         = est->freq;
+
+    switch (cfg->mode) {
+        case TACHO_EST_PERIOD:
+            if (est->periods > 0) {
+                f = cfg->tickHz / est->lastPeriod;
+            }
+            break;
+
+        case TACHO_EST_COUNT:
+            f = (window > 0) ? cfg->tickHz * est->edges / window : 0.0f;
+            break;
+
+        default:
+            if (est->periods > 0) {
+                f = cfg->tickHz * est->periods / (float) est->sum;
+            }
+            break;
+    }
+
+    /* Without a new period, the frequency can at most be one period since the last edge. It decays
+    ** as the edges stop, and reads 0 after the timeout */
+    if (cfg->mode != TACHO_EST_COUNT && est->periods == 0) {
+        uint32_t elapsed = now - est->lastEdge;
+        if (!est->hasEdge || elapsed > cfg->timeoutTicks) {
+            f = 0.0f;
+        }
+        else if (elapsed > est->lastPeriod) {
+            float bound = cfg->tickHz / elapsed;
+            f = (bound < f) ? bound : f;
+        }
+    }
+
+    latchStats(est);
+    resetWindow(est);
+    est->windowStart = now;
+    est->freq        = f;
+
+    return f / est->ppr;
+}
+
+/*!
+** @brief Statistics of the periods which ended in the last window
+*/
+const TachoPeriodStats* tachoEstStats(const TachoEstimator* est) {
+    return &est->stats;
+}
@@ -8,6 +8,8 @@
 #include <inttypes.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdio.h>
+#include <string.h>
 
 #include "stm32f4xx_hal.h"
 #include "tachometer.h"
@@ -16,6 +18,10 @@
 #include "CAProtocolStm.h"
 #include "CAProtocol.h"
 #include "pcbversion.h"
+#include "edgeRing.h"
+#include "tachoCapture.h"
+#include "tachoEstimator.h"
+#include "printSnapshot.h"
 
 /***************************************************************************************************
 ** DEFINES
@@ -24,14 +30,20 @@
 #define TIMCLOCK    64000000
 #define PRESCALAR   64
 
-/* Minimum frequency is arbitrary, and could be lowered if there is a demand. It exists to ensure it 
-** is possible to timeout to 0 Hz if edges stop coming */
-#define MIN_FREQ    1.0
+/* Time without edges before a channel reads 0 Hz. Until then the frequency decays, as it can be at
+** most one period since the last edge. Configurable with the "mode" command */
+#define DEFAULT_TIMEOUT_MS  10000
+#define MIN_TIMEOUT_MS      100
+#define MAX_TIMEOUT_MS      60000
 
 /* Maximum frequency is limited by hardware on the board. As of V3.2, this is ~1.5 kHz */
 
 #define NUM_CHANNELS 6
 
+/* Timestamps per channel. Up to TACHO_EDGE_RING_LEN - 2 edges can arrive between two runs of the
+** main loop, i.e. 62 kHz per channel with the loop running every ms */
+#define TACHO_EDGE_RING_LEN 64
+
 /* Macro to make setting pin layouts quicker */
 #define SET_GPIO_PINS(x, a, b, c, d, e, f) \
     do { \
@@ -43,15 +55,29 @@
         x[5] = f; \
     } while(0)
 
+/***************************************************************************************************
+** PRIVATE FUNCTION DECLARATIONS
+***************************************************************************************************/
+
+static void processEdges(bool isWindowEnd, uint32_t windowEnd);
+static void printFrequencies(uint32_t status);
+static void printSettings();
+static void printPeriodStats();
+static void tachoInputHandler(const char* input);
+static void initGpio(void);
+static void initCapture(void);
+
 /***************************************************************************************************
 ** PRIVATE OBJECTS
 ***************************************************************************************************/
 
 static float freq[NUM_CHANNELS] = {0};
+static SnapshotBuffer printBuffer;
+static volatile uint32_t printTimCount = 0;  // Timer count at the end of the print period
 
 static CAProtocolCtx caProto =
 {
-    .undefined = HALundefined,
+    .undefined = tachoInputHandler,
     .printHeader = CAPrintHeader,
     .printStatus = NULL,
     .jumpToBootLoader = HALJumpToBootloader,
@@ -62,19 +88,38 @@ static CAProtocolCtx caProto =
     .otpWrite = NULL
 };
 
-static struct {
-    bool        notFirstEdge;
-    uint32_t    prevTimCount;
-    uint32_t    nowTimCount;
-    float       avgFreq;
-    uint32_t    numSamples;
-} timData[NUM_CHANNELS] = {0};
+/* Settings are kept in RAM only, and reset to these defaults (1 pulse per revolution) at boot */
+static TachoEstConfig estCfg = {
+    .mode         = TACHO_EST_AUTO,
+    .tickHz       = TIMCLOCK / PRESCALAR,
+    .timeoutTicks = DEFAULT_TIMEOUT_MS * (TIMCLOCK / PRESCALAR / 1000),
+};
+static TachoEstimator estimators[NUM_CHANNELS];
+
+static const char* const MODE_NAMES[TACHO_EST_NO_MODES] = {"auto", "period", "count"};
+
+/* Edge timestamps of each channel, written by the TIM2 input capture DMA where the pin of the
+** channel has a TIM2 input, and by the EXTI interrupt otherwise */
+static uint32_t edgeBuf[NUM_CHANNELS][TACHO_EDGE_RING_LEN];
+static EdgeRing edges[NUM_CHANNELS];
+static int captureChannels[NUM_CHANNELS];   // TIM_CHANNEL_x, or -1 for EXTI
+static int8_t extiChannels[16];             // Channel of each EXTI line, or -1
+
+/* TIM2 inputs (alternate function 1) on the tachometer pins of port A. PA0 and PA5 share CH1 */
+static const struct {
+    uint16_t pin;
+    uint32_t timChannel;
+} TIM2_INPUTS[] = {
+    {GPIO_PIN_0, TIM_CHANNEL_1},
+    {GPIO_PIN_1, TIM_CHANNEL_2},
+    {GPIO_PIN_2, TIM_CHANNEL_3},
+    {GPIO_PIN_3, TIM_CHANNEL_4},
+    {GPIO_PIN_5, TIM_CHANNEL_1},
+};
 
 TIM_HandleTypeDef* _printTim = NULL;
 TIM_HandleTypeDef* _tachoTim = NULL;
 
-static const float REF_CLOCK = TIMCLOCK / PRESCALAR;
-
 static const BoardType  BOARD = Tachometer;
 static const pcbVersion PCB   = {BREAKING_MAJOR, BREAKING_MINOR};
 
@@ -82,89 +127,139 @@ static const pcbVersion PCB   = {BREAKING_MAJOR, BREAKING_MINOR};
 /* Channels are different on different board versions */ 
 static pcbVersion ver;
 static uint8_t gpio_pins[NUM_CHANNELS] = {0};
-
-/***************************************************************************************************
-** PRIVATE FUNCTION DECLARATIONS
-***************************************************************************************************/
-
-static void computeTachoFrequency(int channel);
-static void printFrequencies();
-static void resetFlow();
-static void initGpio(void);
+static GPIO_TypeDef* gpio_ports[NUM_CHANNELS] = {0};
 
 /***************************************************************************************************
 ** PRIVATE FUNCTION DEFINITIONS
 ***************************************************************************************************/
 
-static void computeTachoFrequency(int channel)
+/*!
+** @brief Passes all edges timestamped since the last call to the estimators
+**
+** @param[in] isWindowEnd True if the print period has ended, in which case the frequencies are
+**                        updated with the edges up to windowEnd
+*/
+static void processEdges(bool isWindowEnd, uint32_t windowEnd)
 {
-    /* On the first edge, don't do anything, as a real frequency cannot be calculated with just one 
-    ** edge */
-    if (!timData[channel].notFirstEdge)
-    {
+    uint32_t timestamps[TACHO_EDGE_RING_LEN];
 
-        timData[channel].prevTimCount = __HAL_TIM_GET_COUNTER(_tachoTim);
-        timData[channel].notFirstEdge = true;    
-    }
-    /* On subsequent edges, the calculate the frequency based on the time difference between the last
-    ** edge and this one. Update a rolling average with the new frequency information. The average is 
-    ** reset at every print so that the device remains responsive at low frequencies. The minimum 
-    ** frequency is set to 1 Hz. */
-    else
+    for (int i = 0; i < NUM_CHANNELS; i++)
     {
-        timData[channel].nowTimCount = __HAL_TIM_GET_COUNTER(_tachoTim);
-
-        uint32_t diff = 0;
-        if (timData[channel].nowTimCount >= timData[channel].prevTimCount) {
-            diff = timData[channel].nowTimCount - timData[channel].prevTimCount;
-        }
-        else {
-            diff = (0xFFFFFFFF - timData[channel].prevTimCount) + timData[channel].nowTimCount;
+        uint16_t writeIdx = edges[i].swIdx;
+        if (captureChannels[i] >= 0) {
+            writeIdx = edgeRingDmaIndex(&edges[i], tachoCaptureRemaining(captureChannels[i]));
         }
 
-        /* Prevent divide by 0 */
-        diff = diff != 0 ? diff : 1;
+        bool isOverrun = false;
+        int n = edgeRingRead(&edges[i], writeIdx, timestamps, &isOverrun);
+
+        /* Edges have been lost, so restart from the newest one */
+        if (isOverrun) {
+            tachoEstRestart(&estimators[i]);
+        }
 
-        float nextFreq = REF_CLOCK / diff;
-        timData[channel].avgFreq = (timData[channel].avgFreq * timData[channel].numSamples + nextFreq) / (timData[channel].numSamples + 1);
-        freq[channel] = timData[channel].avgFreq;
+        bool isUpdated = !isWindowEnd;
+        for (int j = 0; j < n; j++)
+        {
+            /* Edges after the end of the print period belong to the next one */
+            if (!isUpdated && (int32_t) (timestamps[j] - windowEnd) > 0) {
+                freq[i]   = tachoEstUpdate(&estimators[i], windowEnd, &estCfg);
+                isUpdated = true;
+            }
+            tachoEstEdge(&estimators[i], timestamps[j], &estCfg);
+        }
 
-        /* Save the last edge for the next calculation */
-        timData[channel].prevTimCount = timData[channel].nowTimCount;
-        timData[channel].numSamples++;
+        if (!isUpdated) {
+            freq[i] = tachoEstUpdate(&estimators[i], windowEnd, &estCfg);
+        }
     }
 }
 
-static void printFrequencies()
+static void printFrequencies(uint32_t status)
 {
     if (!isUsbPortOpen())
         return;
 
-    if(bsGetStatus() & BS_VERSION_ERROR_Msk) {
-        USBnprintf("0x%08" PRIx32 "\r\n", bsGetStatus());
+    if(status & BS_VERSION_ERROR_Msk) {
+        USBnprintf("0x%08" PRIx32 "\r\n", status);
         return;
     }
 
-    USBnprintf("%.2f, %.2f, %.2f, %.2f, %.2f, %.2f, 0x%08" PRIx32 "\r\n", freq[0], freq[1], freq[2], freq[3], freq[4], freq[5], bsGetStatus());
+    const float* f = freq;
+    USBnprintf("%.2f, %.2f, %.2f, %.2f, %.2f, %.2f, 0x%08" PRIx32 "\r\n", f[0], f[1], f[2], f[3], f[4], f[5], status);
 }
 
-static void resetFlow()
+static void printSettings()
+{
+    USBnprintf("Mode: %s, timeout %" PRIu32 " ms, ppr %u %u %u %u %u %u\r\n",
+               MODE_NAMES[estCfg.mode], estCfg.timeoutTicks / (TIMCLOCK / PRESCALAR / 1000),
+               estimators[0].ppr, estimators[1].ppr, estimators[2].ppr, estimators[3].ppr,
+               estimators[4].ppr, estimators[5].ppr);
+}
+
+/*!
+** @brief Prints the statistics of the periods between edges in the last print period, in us
+*/
+static void printPeriodStats()
 {
+    static const float US_PER_TICK = 1000000.0f / (TIMCLOCK / PRESCALAR);
+
     for (int i = 0; i < NUM_CHANNELS; i++)
     {
-        /* Resets the frequency to 0 if it falls below the minimum frequency. This is to prevent 
-        ** the tachometer getting stuck if the edges stop */
-        uint32_t now    = __HAL_TIM_GET_COUNTER(_tachoTim);
-        float currFreq  = REF_CLOCK / (now - timData[i].prevTimCount);
-        
-        if(currFreq < MIN_FREQ) {
-            freq[i] = 0;
+        const TachoPeriodStats* s = tachoEstStats(&estimators[i]);
+        USBnprintf("Port %d: %" PRIu32 " periods, min %.1f, max %.1f, mean %.1f, stddev %.2f us"
+                   "\r\n", i + 1, s->count, s->min * US_PER_TICK, s->max * US_PER_TICK,
+                   s->mean * US_PER_TICK, s->stddev * US_PER_TICK);
+    }
+}
+
+/*!
+** @brief Handles the tachometer settings
+**
+** "mode <auto|period|count> <timeout ms>" selects the estimator and the time without edges before
+** reading 0 Hz ("mode" alone prints the settings). "ppr <port> <pulses>" sets the pulses per
+** revolution of a port, so it reads revolutions per second. "stats" prints the period statistics
+** of the last print period.
+*/
+static void tachoInputHandler(const char* input)
+{
+    char mode[8]         = {0};
+    unsigned int timeout = 0;
+    unsigned int port    = 0;
+    unsigned int pulses  = 0;
+
+    int n = sscanf(input, "mode %7s %u", mode, &timeout);
+    if (n == 2)
+    {
+        int m = 0;
+        while (m < TACHO_EST_NO_MODES && strcmp(mode, MODE_NAMES[m]) != 0) {
+            m++;
         }
 
-        /* Maintains the previous average so that slow freq are not lost at each print 
-        ** interval, but minimises its weight against any subsequent measurements for fast 
-        ** measurements */
-        timData[i].numSamples = 1;
+        if (m == TACHO_EST_NO_MODES || timeout < MIN_TIMEOUT_MS || timeout > MAX_TIMEOUT_MS) {
+            HALundefined(input);
+            return;
+        }
+
+        estCfg.mode         = (TachoEstMode) m;
+        estCfg.timeoutTicks = timeout * (TIMCLOCK / PRESCALAR / 1000);
+    }
+    else if (n == EOF && strncmp(input, "mode", 4) == 0) {
+        printSettings();
+    }
+    else if (sscanf(input, "ppr %u %u", &port, &pulses) == 2)
+    {
+        if (port < 1 || port > NUM_CHANNELS || pulses < 1 || pulses > TACHO_EST_MAX_PPR) {
+            HALundefined(input);
+            return;
+        }
+        estimators[port - 1].ppr = pulses;
+    }
+    else if (strncmp(input, "stats", 5) == 0) {
+        printPeriodStats();
+    }
+    else {
+        HALundefined(input);
     }
 }
 
@@ -184,14 +279,17 @@ static void initGpio(void)
     if(ver.major == 3 && ver.minor == 1) {
         GPIO_InitStruct.Pin = GPIO_PIN_0|GPIO_PIN_1|GPIO_PIN_2|GPIO_PIN_3|GPIO_PIN_4|GPIO_PIN_5;
         SET_GPIO_PINS(gpio_pins, GPIO_PIN_0, GPIO_PIN_1, GPIO_PIN_2, GPIO_PIN_3, GPIO_PIN_4, GPIO_PIN_5);
+        SET_GPIO_PINS(gpio_ports, GPIOA, GPIOA, GPIOA, GPIOA, GPIOA, GPIOA);
     }
     else if(ver.major == 3 && ver.minor == 2) {
         GPIO_InitStruct.Pin = GPIO_PIN_0|GPIO_PIN_1|GPIO_PIN_2|GPIO_PIN_3|GPIO_PIN_4|GPIO_PIN_5;
         SET_GPIO_PINS(gpio_pins, GPIO_PIN_5, GPIO_PIN_4, GPIO_PIN_3, GPIO_PIN_2, GPIO_PIN_1, GPIO_PIN_0);
+        SET_GPIO_PINS(gpio_ports, GPIOA, GPIOA, GPIOA, GPIOA, GPIOA, GPIOA);
     }
     else if(ver.major == 3 && ver.minor >= 3) {
         GPIO_InitStruct.Pin = GPIO_PIN_2|GPIO_PIN_3|GPIO_PIN_4|GPIO_PIN_6|GPIO_PIN_7;
         SET_GPIO_PINS(gpio_pins, GPIO_PIN_1, GPIO_PIN_7, GPIO_PIN_6, GPIO_PIN_4, GPIO_PIN_3, GPIO_PIN_2);
+        SET_GPIO_PINS(gpio_ports, GPIOB, GPIOA, GPIOA, GPIOA, GPIOA, GPIOA);
     }
     else {
         bsSetError(BS_VERSION_ERROR_Msk);
@@ -230,6 +328,43 @@ static void initGpio(void)
     HAL_NVIC_EnableIRQ(EXTI9_5_IRQn);
 }
 
+/*!
+** @brief Moves the channels whose pin is a TIM2 input from the EXTI to input capture with DMA
+**
+** The other pins are either not timer inputs (PA4), only inputs of the 16 bit TIM3 (PA6, PA7,
+** PB1) or share their TIM2 channel with another pin (PA0/PA5 on V3.1/V3.2), so they keep the EXTI.
+*/
+static void initCapture(void)
+{
+    uint32_t usedChannels = 0;
+
+    tachoCaptureInit(_tachoTim);
+
+    for (int i = 0; i < NUM_CHANNELS; i++)
+    {
+        captureChannels[i] = -1;
+
+        for (unsigned j = 0; j < sizeof(TIM2_INPUTS) / sizeof(TIM2_INPUTS[0]); j++)
+        {
+            uint32_t timChannel = TIM2_INPUTS[j].timChannel;
+            if (gpio_ports[i] != GPIOA || gpio_pins[i] != TIM2_INPUTS[j].pin ||
+                (usedChannels & (1U << (timChannel >> 2)))) {
+                continue;
+            }
+
+            if (tachoCaptureStart(timChannel, gpio_pins[i], edgeBuf[i], TACHO_EDGE_RING_LEN)) {
+                captureChannels[i] = (int) timChannel;
+                usedChannels |= 1U << (timChannel >> 2);
+            }
+            break;
+        }
+
+        if (captureChannels[i] < 0 && gpio_pins[i] != 0) {
+            extiChannels[__builtin_ctz(gpio_pins[i])] = i;
+        }
+    }
+}
+
 /***************************************************************************************************
 ** PUBLIC FUNCTION DEFINITIONS
 ***************************************************************************************************/
@@ -238,27 +373,41 @@ void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef* htim)
 {
     if (htim == _printTim)
     {
-        resetFlow();
-        printFrequencies();
+        /* Only the end of the print period and the status are recorded here. The frequencies are 
+        ** computed up to that point and printed by tachoInputLoop */
+        printTimCount = __HAL_TIM_GET_COUNTER(_tachoTim);
+        PrintSnapshot* s = snapshotWrite(&printBuffer);
+        s->status = bsGetStatus();
+        snapshotPublish(&printBuffer);
     }
 }
 
+/*!
+** @brief Timestamps an edge on a channel without input capture. The period is computed later in
+**        the main loop, so this is kept as short as possible
+*/
 void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin) {
-    int channel = 0;
-    
-    for(int i = 0; i < NUM_CHANNELS; i++) {
-        if (gpio_pins[i] == GPIO_Pin) {
-            channel = i;
-            break;
-        }
-    }
+    uint32_t now = __HAL_TIM_GET_COUNTER(_tachoTim);
+    int channel  = (GPIO_Pin != 0) ? extiChannels[__builtin_ctz(GPIO_Pin)] : -1;
 
-    computeTachoFrequency(channel);
+    if (channel >= 0) {
+        edgeRingPush(&edges[channel], now);
+    }
 }
 
 void tachoInputLoop(const char* bootMsg)
 {
     CAhandleUserInputs(&caProto, bootMsg);
+
+    uint32_t windowEnd = printTimCount;
+    PrintSnapshot s;
+    bool isWindowEnd = snapshotRead(&printBuffer, &s);
+
+    processEdges(isWindowEnd, windowEnd);
+
+    if (isWindowEnd) {
+        printFrequencies(s.status);
+    }
 }
 
 void tachoInputInit(TIM_HandleTypeDef* htimIC, TIM_HandleTypeDef* printTim)
@@ -267,14 +416,29 @@ void tachoInputInit(TIM_HandleTypeDef* htimIC, TIM_HandleTypeDef* printTim)
     (void) boardSetup(BOARD, PCB, BS_SYSTEM_ERRORS_Msk);
     initCAProtocol(&caProto, usbRx);
 
+    memset(freq, 0, sizeof(freq));
+    snapshotInit(&printBuffer);
+
+    /* No EXTI line is mapped to a channel until initCapture has run */
+    memset(extiChannels, -1, sizeof(extiChannels));
+    for (int i = 0; i < NUM_CHANNELS; i++) {
+        edgeRingInit(&edges[i], edgeBuf[i], TACHO_EDGE_RING_LEN);
+    }
+
     /* If this fails, the version error flag will have been set previously */
     (void) getPcbVersion(&ver);
 
-    initGpio();
-
     _tachoTim = htimIC;
+    initGpio();
+    initCapture();
     HAL_TIM_Base_Start(_tachoTim);
 
+    estCfg.mode         = TACHO_EST_AUTO;
+    estCfg.timeoutTicks = DEFAULT_TIMEOUT_MS * (TIMCLOCK / PRESCALAR / 1000);
+    for (int i = 0; i < NUM_CHANNELS; i++) {
+        tachoEstInit(&estimators[i], 1, __HAL_TIM_GET_COUNTER(_tachoTim));
+    }
+
     _printTim = printTim;
     HAL_TIM_Base_Start_IT(_printTim);
 }
@@ -18,8 +18,10 @@
 ***************************************************************************************************/
 
 // Extern value defined in .ld linker script
-extern uint32_t _FlashAddrCal;  // Starting address of calibration values in FLASH
-#define FLASH_ADDR_CAL ((uintptr_t) & _FlashAddrCal)
+extern uint32_t _FlashAddrCal;        // Starting address of calibration values in FLASH
+extern uint32_t _FlashAddrCalLegacy;  // Calibration written by firmware using the 128K sector
+#define FLASH_ADDR_CAL        ((uintptr_t) & _FlashAddrCal)
+#define FLASH_ADDR_CAL_LEGACY ((uintptr_t) & _FlashAddrCalLegacy)
 
 // Industry standard values. Can be found in
 // https://datasheets.maximintegrated.com/en/ds/MAX31855.pdf
@@ -27,6 +29,13 @@ extern uint32_t _FlashAddrCal;  // Starting address of calibration values in FLA
 #define TYPE_J_CJ_DELTA 0.000052136  // Sensitivity at cold-junction in V/C
 #define TYPE_K_DELTA    0.000041276
 #define TYPE_K_CJ_DELTA 0.00004073
+#define TYPE_N_DELTA    0.000036256
+#define TYPE_N_CJ_DELTA 0.000027171
+#define TYPE_T_DELTA    0.00005218
+#define TYPE_T_CJ_DELTA 0.00004156
+
+// Ports calibrated with one of the sensitivities above are converted with the NIST ITS-90
+// functions of that type (see thermocouple.c). Other values are used as a linear calibration.
 
 // ---- Temperature board status register definitions ----
 
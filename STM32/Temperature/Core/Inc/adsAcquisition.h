@@ -0,0 +1,72 @@
+/*!
+** @file    adsAcquisition.h
+** @brief   Header file of adsAcquisition.c
+** @date:   18/10/2026
+*/
+
+#ifndef ADS_ACQUISITION_H_
+#define ADS_ACQUISITION_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+** Usage:
+** * Initialise with "acqInit". The engine starts locked, so the chips can be configured with
+**   blocking SPI transfers. Optionally set the data rate and inputs with "acqConfigure", start
+**   conversions on each working chip with "acqStart", and hand the bus over with "acqUnlock".
+** * Call "acqDataReady" from the DRDY interrupt of a chip and "acqTransferComplete" (or
+**   "acqTransferError") from the SPI DMA interrupt. These must run at the same interrupt priority.
+** * Read the latest conversions at any time with "acqGetResults". This never blocks.
+** * To use the bus from the main loop (e.g. to reconfigure a chip), call "acqLock" until it returns
+**   true, and "acqUnlock" when done.
+*/
+
+/***************************************************************************************************
+** DEFINES
+***************************************************************************************************/
+
+#define ACQ_MAX_CHIPS       5
+#define ACQ_FRAME_LEN       6   // Bytes exchanged with a chip per conversion
+#define ACQ_DEFAULT_RATE    45  // SPS
+
+/***************************************************************************************************
+** TYPEDEFS
+***************************************************************************************************/
+
+typedef enum {
+    ACQ_CH_A,       // Thermocouple on AIN0/AIN1
+    ACQ_CH_B,       // Thermocouple on AIN2/AIN3
+    ACQ_INTERNAL,   // Internal temperature sensor (cold junction). Converted before ACQ_CH_A
+    ACQ_NO_INPUTS
+} AcqInput;
+
+typedef struct AcqResults {
+    int16_t code[ACQ_MAX_CHIPS][ACQ_NO_INPUTS];     // Latest raw conversion result
+    uint32_t sum[ACQ_MAX_CHIPS][ACQ_NO_INPUTS];     // Running (wrapping) sum of the results
+    uint32_t count[ACQ_MAX_CHIPS][ACQ_NO_INPUTS];   // Number of conversions completed
+} AcqResults;
+
+/***************************************************************************************************
+** PUBLIC FUNCTION DECLARATIONS
+***************************************************************************************************/
+
+void acqInit(int noOfChips);
+bool acqIsValidRate(uint16_t sps);
+void acqConfigure(int chip, uint16_t sps, bool chA, bool chB);
+void acqStart(int chip);
+void acqStop(int chip);
+
+bool acqLock();
+void acqUnlock();
+
+void acqDataReady(int chip);
+void acqTransferComplete();
+void acqTransferError();
+
+void acqGetResults(AcqResults* results);
+
+float acqCodeToVoltage(float code);
+float acqCodeToInternalTemp(float code);
+
+#endif /* ADS_ACQUISITION_H_ */
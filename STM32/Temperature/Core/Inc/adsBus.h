@@ -0,0 +1,25 @@
+/*!
+** @file    adsBus.h
+** @brief   Header file of adsBus.c
+** @date:   18/10/2026
+*/
+
+#ifndef ADS_BUS_H_
+#define ADS_BUS_H_
+
+#include <stdint.h>
+
+#include "stm32f4xx_hal.h"
+#include "StmGpio.h"
+
+/***************************************************************************************************
+** PUBLIC FUNCTION DECLARATIONS
+***************************************************************************************************/
+
+void adsBusInit(SPI_HandleTypeDef* hspi);
+void adsBusAddChip(int chip, StmGpio cs, GPIO_TypeDef* drdyPort, uint16_t drdyPin);
+
+int adsBusTransfer(int chip, const uint8_t* tx, uint8_t* rx, uint16_t len);
+void adsBusRelease(int chip);
+
+#endif /* ADS_BUS_H_ */
@@ -0,0 +1,44 @@
+/*!
+** @file    thermocouple.h
+** @brief   Header file of thermocouple.c
+** @date:   18/10/2026
+*/
+
+#ifndef THERMOCOUPLE_H_
+#define THERMOCOUPLE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+** Usage:
+** * Find the thermocouple type of a port from its calibrated sensitivity with
+**   "tcTypeFromSensitivity". Ports with a custom sensitivity are TC_TYPE_UNKNOWN and must use the
+**   linear conversion.
+** * Convert a measured thermocouple voltage to the hot junction temperature with "tcCompensate",
+**   given the cold junction temperature.
+*/
+
+/***************************************************************************************************
+** TYPEDEFS
+***************************************************************************************************/
+
+typedef enum {
+    TC_TYPE_K,
+    TC_TYPE_J,
+    TC_TYPE_N,
+    TC_TYPE_T,
+    TC_TYPE_UNKNOWN
+} TcType;
+
+/***************************************************************************************************
+** PUBLIC FUNCTION DECLARATIONS
+***************************************************************************************************/
+
+TcType tcTypeFromSensitivity(float delta);
+
+float tcVoltage(TcType type, float temp);
+float tcTemperature(TcType type, float mV);
+float tcCompensate(TcType type, float mV, float cjTemp);
+
+#endif /* THERMOCOUPLE_H_ */
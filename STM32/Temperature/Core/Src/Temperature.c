@@ -6,9 +6,11 @@
  */
 
 #include <inttypes.h>
+#include <math.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "ADS1120.h"
 #include "CAProtocol.h"
@@ -17,6 +19,10 @@
 #include "StmGpio.h"
 #include "Temperature.h"
 #include "USBprint.h"
+#include "adsAcquisition.h"
+#include "adsBus.h"
+#include "flashWriter.h"
+#include "thermocouple.h"
 #include "main.h"
 #include "pcbversion.h"
 #include "stm32f4xx_hal.h"
@@ -31,11 +37,33 @@
 #define NO_SPI_DEVICES 5
 #define CALIMEMSIZE    (NO_SPI_DEVICES * 2)
 
+// A chip converts at least every 50 ms. If it has not delivered anything for this long it is
+// reconnected
+#define CONVERSION_TIMEOUT_MS   500
+#define CONVERSION_TIMEOUT_ERR  0x01
+
+#define ALL_PORTS_Msk   ((1U << (NO_SPI_DEVICES * 2)) - 1U)
+#define MIN_PRINT_MS    10
+#define MAX_PRINT_MS    10000
+
 typedef struct _gpio {
     GPIO_TypeDef* port;
     uint16_t pin;
 } gpio_t;
 
+typedef struct TempSettings {
+    uint16_t dataRate;  // ADS1120 data rate in SPS
+    uint16_t printMs;   // Output period in ms
+    uint16_t portMask;  // Bit x set if port x + 1 is measured
+    uint16_t average;   // Non-zero to output the mean of the conversions in each period
+} TempSettings;
+
+// Stored in FLASH. Versions before the settings were added only stored portCalVal
+typedef struct TempCalibration {
+    float portCalVal[NO_SPI_DEVICES * 2][2];
+    TempSettings settings;
+} TempCalibration;
+
 /***************************************************************************************************
 ** PRIVATE FUNCTION DECLARATIONS
 ***************************************************************************************************/
@@ -47,19 +75,26 @@ static void printTempStatusDef();
 static void initPinLayout(pcbVersion ver);
 static void initConnection(ADS1120Device* ads1120, int channel);
 static void initSpiDevices(SPI_HandleTypeDef* hspi);
+static bool isChipEnabled(int chip);
+static void startConversions(int chip);
+static void applySettings();
+static void printSettings();
+static void temperatureInputHandler(const char* input);
 static void monitorBoardStatus();
+static void updateTemperatures(int chip, const AcqResults* res);
 static void getPeripheralTemperatures();
 static float getInternalTemperature();
 static void enableWWDG();
 static void initSensorCalibration();
 static void calibrateTypeInput(int noOfCalibrations, const CACalibration* calibrations);
 static void calibrateReadWrite(bool write);
+static void onCalibrationStored(int status);
 
 /***************************************************************************************************
 ** PRIVATE OBJECTS
 ***************************************************************************************************/
 
-static CAProtocolCtx caProto = {.undefined        = HALundefined,
+static CAProtocolCtx caProto = {.undefined        = temperatureInputHandler,
                                 .printHeader      = printTempHeader,
                                 .printStatus      = printTempStatus,
                                 .printStatusDef   = printTempStatusDef,
@@ -71,7 +106,8 @@ static CAProtocolCtx caProto = {.undefined        = HALundefined,
                                 .otpWrite         = NULL};
 
 static ADS1120Device ads1120[NO_SPI_DEVICES];
-static float portCalVal[NO_SPI_DEVICES * 2][2];
+static TempCalibration cal;
+static bool isSettingsChanged = false;  // The settings must be applied to the chips
 static char buf[600] = {0};  // Shared by printTempStatus and printTempStatusDef
 
 static SPI_HandleTypeDef* hspi   = NULL;
@@ -81,6 +117,9 @@ static CRC_HandleTypeDef* hcrc   = NULL;
 static gpio_t cs[NO_SPI_DEVICES];
 static gpio_t drdy[NO_SPI_DEVICES];
 
+static AcqResults lastResults;                  // Conversions already applied to ads1120[].data
+static uint32_t conversionTick[NO_SPI_DEVICES]; // Last time a chip delivered a conversion
+
 /***************************************************************************************************
 ** PRIVATE FUNCTION DEFINITIONS
 ***************************************************************************************************/
@@ -156,6 +195,11 @@ static void initConnection(ADS1120Device* ads1120, int channel) {
 }
 
 static void initSpiDevices(SPI_HandleTypeDef* hspi) {
+    // The engine starts locked, so the chips can be configured with blocking transfers
+    acqInit(NO_SPI_DEVICES);
+    adsBusInit(hspi);
+    memset(&lastResults, 0, sizeof(lastResults));
+
     for (int i = 0; i < NO_SPI_DEVICES; i++) {
         // Initialise Chip Select pin
         stmGpioInit(&ads1120[i].cs, cs[i].port, cs[i].pin, STM_GPIO_OUTPUT);
@@ -165,6 +209,8 @@ static void initSpiDevices(SPI_HandleTypeDef* hspi) {
 
         stmSetGpio(ads1120[i].cs, true);  // CS selects chip when low
         ads1120[i].hspi = hspi;
+
+        adsBusAddChip(i, ads1120[i].cs, drdy[i].port, drdy[i].pin);
     }
 
     // Write 2 dummy byte on SPI wire. Yes, this seems VERY strange
@@ -180,6 +226,94 @@ static void initSpiDevices(SPI_HandleTypeDef* hspi) {
     for (int i = 0; i < NO_SPI_DEVICES; i++) {
         initConnection(&ads1120[i], i);
     }
+
+    // Starts the conversions and hands the bus over to the acquisition engine
+    isSettingsChanged = true;
+    applySettings();
+}
+
+static bool isChipEnabled(int chip) {
+    return (cal.settings.portMask & (0x3U << (chip * 2))) != 0;
+}
+
+// Must be called while holding the acquisition lock
+static void startConversions(int chip) {
+    if (isChipEnabled(chip)) {
+        conversionTick[chip] = HAL_GetTick();
+        acqStart(chip);
+    }
+}
+
+/*!
+** @brief Configures the chips with the current settings, once the bus is free
+*/
+static void applySettings() {
+    if (!isSettingsChanged) {
+        return;
+    }
+
+    if (acqLock()) {
+        for (int i = 0; i < NO_SPI_DEVICES; i++) {
+            bool chA = (cal.settings.portMask & (1U << (i * 2))) != 0;
+            bool chB = (cal.settings.portMask & (1U << (i * 2 + 1))) != 0;
+            acqConfigure(i, cal.settings.dataRate, chA, chB);
+
+            // Ports which are not measured are printed as nan
+            ads1120[i].data.chA = chA ? ads1120[i].data.chA : NAN;
+            ads1120[i].data.chB = chB ? ads1120[i].data.chB : NAN;
+
+            if (!isChipEnabled(i)) {
+                acqStop(i);
+            }
+            else if ((bsGetStatus() & TEMP_ADS1120_x_Error_Msk(i)) == 0) {
+                startConversions(i);
+            }
+        }
+        isSettingsChanged = false;
+    }
+    acqUnlock();
+}
+
+static void printSettings() {
+    USBnprintf("Mode: %u SPS, %u ms, average %u, ports 0x%03x\r\n", cal.settings.dataRate,
+               cal.settings.printMs, cal.settings.average, cal.settings.portMask);
+}
+
+/*!
+** @brief Handles "mode <SPS> <print period ms> <average 0/1> [port mask in hex]"
+**
+** E.g. "mode 1200 10 0 0x003" prints ports 1 and 2 at 100 Hz, and "mode 20 1000 1" prints the mean
+** of all conversions once a second. "mode" alone prints the current settings. The settings are
+** stored in FLASH along with the calibration.
+*/
+static void temperatureInputHandler(const char* input) {
+    unsigned int rate    = 0;
+    unsigned int period  = 0;
+    unsigned int average = 0;
+    unsigned int mask    = ALL_PORTS_Msk;
+
+    int n = sscanf(input, "mode %u %u %u %x", &rate, &period, &average, &mask);
+    if (n >= 3) {
+        if (!acqIsValidRate(rate) || period < MIN_PRINT_MS || period > MAX_PRINT_MS ||
+            average > 1 || mask == 0 || (mask & ~ALL_PORTS_Msk) != 0) {
+            HALundefined(input);
+            return;
+        }
+
+        cal.settings.dataRate = rate;
+        cal.settings.printMs  = period;
+        cal.settings.average  = average;
+        cal.settings.portMask = mask;
+        isSettingsChanged     = true;
+
+        calibrateReadWrite(true);
+    }
+    else if (n == EOF && strncmp(input, "mode", 4) == 0) {
+        printSettings();
+    }
+    else {
+        HALundefined(input);
+    }
 }
 
 static void monitorBoardStatus() {
@@ -187,7 +321,16 @@ static void monitorBoardStatus() {
         // Try to re-establish connection to ADS1120.
         // if the connection is broken
         if ((bsGetStatus() & TEMP_ADS1120_x_Error_Msk(i)) != 0) {
-            initConnection(&ads1120[i], i);
+            // The bus is shared with the acquisition engine. If a transfer is in flight, retry on
+            // the next loop.
+            if (acqLock()) {
+                initConnection(&ads1120[i], i);
+                if ((bsGetStatus() & TEMP_ADS1120_x_Error_Msk(i)) == 0) {
+                    startConversions(i);
+                }
+            }
+            acqUnlock();
+
             // If there are no more errors left then clear the error bit.
             if ((bsGetStatus() & TEMP_ERRORS_Msk) == 0) {
                 bsClearField(BS_ERROR_Msk);
@@ -196,23 +339,78 @@ static void monitorBoardStatus() {
     }
 }
 
+// Latest conversion result, or the mean of the results since the last call when averaging
+static float conversionCode(const AcqResults* res, int chip, int in) {
+    uint32_t n = res->count[chip][in] - lastResults.count[chip][in];
+    if (!cal.settings.average || n == 0) {
+        return res->code[chip][in];
+    }
+    return (float)(int32_t)(res->sum[chip][in] - lastResults.sum[chip][in]) / n;
+}
+
+// Applies the conversions a chip has delivered since the last call
+static void updateTemperatures(int chip, const AcqResults* res) {
+    ADS1120Device* dev = &ads1120[chip];
+
+    if (res->count[chip][ACQ_INTERNAL] != lastResults.count[chip][ACQ_INTERNAL]) {
+        dev->data.internalTemp = acqCodeToInternalTemp(conversionCode(res, chip, ACQ_INTERNAL));
+    }
+
+    // The thermocouple voltage is compensated for the cold junction, which is at the temperature
+    // of the chip. Custom calibrations are linear: T = (V + cjDelta * Tcj) / delta
+    for (int in = ACQ_CH_A; in <= ACQ_CH_B; in++) {
+        if (res->count[chip][in] == lastResults.count[chip][in]) {
+            continue;
+        }
+
+        float* tc   = cal.portCalVal[chip * 2 + in];
+        float volts = acqCodeToVoltage(conversionCode(res, chip, in));
+        TcType type = tcTypeFromSensitivity(tc[0]);
+        float temp  = 0.0f;
+        if (type != TC_TYPE_UNKNOWN) {
+            temp = tcCompensate(type, volts * 1000.0f, dev->data.internalTemp);
+        }
+        else {
+            temp = (volts + tc[1] * dev->data.internalTemp) / tc[0];
+        }
+        if (in == ACQ_CH_A) {
+            dev->data.chA = temp;
+        }
+        else {
+            dev->data.chB = temp;
+        }
+    }
+}
+
 static void getPeripheralTemperatures() {
+    AcqResults res;
+    acqGetResults(&res);
+
     for (int i = 0; i < NO_SPI_DEVICES; i++) {
-        // Try to re-establish connection to ADS1120.
-        // If the connection is broken
-        if ((bsGetStatus() & TEMP_ADS1120_x_Error_Msk(i)) != 0) {
+        // Reconnection is handled in monitorBoardStatus()
+        if ((bsGetStatus() & TEMP_ADS1120_x_Error_Msk(i)) != 0 || !isChipEnabled(i)) {
             continue;
         }
 
-        // Get measurements
-        float* calPtr = &portCalVal[i * 2][0];
-        int ret       = ADS1120Loop(&ads1120[i], calPtr);
+        uint32_t prevCount = 0;
+        uint32_t count     = 0;
+        for (int in = 0; in < ACQ_NO_INPUTS; in++) {
+            prevCount += lastResults.count[i][in];
+            count += res.count[i][in];
+        }
 
-        // If the return value is different from 0 - set an error.
-        if (ret != 0) {
-            bsSetErrorRange(ret << (i * 2), TEMP_ADS1120_x_Error_Msk(i));
+        if (count != prevCount) {
+            conversionTick[i] = HAL_GetTick();
+            updateTemperatures(i, &res);
+        }
+        else if (tdiff_u32(HAL_GetTick(), conversionTick[i]) > CONVERSION_TIMEOUT_MS) {
+            // The chip no longer signals DRDY
+            acqStop(i);
+            bsSetErrorRange(CONVERSION_TIMEOUT_ERR << (i * 2), TEMP_ADS1120_x_Error_Msk(i));
         }
     }
+
+    lastResults = res;
 }
 
 static float getInternalTemperature() {
@@ -222,7 +420,7 @@ static float getInternalTemperature() {
         // Do not include internal temperature of chip if
         // connection could not be established to ADS1120 chip.
         // Reconnection is handled in updateTempAndStates()
-        if ((bsGetStatus() & TEMP_ADS1120_x_Error_Msk(i)) != 0) {
+        if ((bsGetStatus() & TEMP_ADS1120_x_Error_Msk(i)) != 0 || !isChipEnabled(i)) {
             continue;
         }
 
@@ -241,33 +439,43 @@ static void enableWWDG() {
 }
 
 static void initSensorCalibration() {
-    if (readFromFlashCRC(hcrc, (uint32_t)FLASH_ADDR_CAL, (uint8_t*)portCalVal,
-                         sizeof(portCalVal)) != 0) {
-        // If nothing is stored in FLASH default to type K thermocouple
-        for (int i = 0; i < NO_SPI_DEVICES * 2; i++) {
-            portCalVal[i][0] = TYPE_K_DELTA;
-            portCalVal[i][1] = TYPE_K_CJ_DELTA;
+    if (flashWriterRead((uint32_t)FLASH_ADDR_CAL, &cal, sizeof(cal)) == (int)sizeof(cal) &&
+        acqIsValidRate(cal.settings.dataRate)) {
+        return;
+    }
+
+    // Calibration written by an earlier firmware is moved to the calibration sector once. The
+    // oldest only holds the thermocouple calibrations
+    if (readFromFlashCRC(hcrc, (uint32_t)FLASH_ADDR_CAL_LEGACY, (uint8_t*)&cal, sizeof(cal)) != 0 ||
+        !acqIsValidRate(cal.settings.dataRate)) {
+        cal.settings = (TempSettings){ACQ_DEFAULT_RATE, 100, ALL_PORTS_Msk, 0};
+        if (readFromFlashCRC(hcrc, (uint32_t)FLASH_ADDR_CAL_LEGACY, (uint8_t*)cal.portCalVal,
+                             sizeof(cal.portCalVal)) != 0) {
+            // If nothing is stored in FLASH default to type K thermocouple
+            for (int i = 0; i < NO_SPI_DEVICES * 2; i++) {
+                cal.portCalVal[i][0] = TYPE_K_DELTA;
+                cal.portCalVal[i][1] = TYPE_K_CJ_DELTA;
+            }
+            return;
         }
     }
+    calibrateReadWrite(true);
 }
 
 static void calibrateTypeInput(int noOfCalibrations, const CACalibration* calibrations) {
-    __HAL_RCC_WWDG_CLK_DISABLE();
     for (int count = 0; count < noOfCalibrations; count++) {
         if (1 <= calibrations[count].port && calibrations[count].port <= 10) {
-            portCalVal[calibrations[count].port - 1][0] = calibrations[count].alpha;
-            portCalVal[calibrations[count].port - 1][1] = calibrations[count].beta;
+            cal.portCalVal[calibrations[count].port - 1][0] = calibrations[count].alpha;
+            cal.portCalVal[calibrations[count].port - 1][1] = calibrations[count].beta;
         }
     }
     // Update automatically when receiving new calibration values
     calibrateReadWrite(true);
-    __HAL_RCC_WWDG_CLK_ENABLE();
 }
 
 static void calibrateReadWrite(bool write) {
     if (write) {
-        if (writeToFlashCRC(hcrc, (uint32_t)FLASH_ADDR_CAL, (uint8_t*)portCalVal,
-                            sizeof(portCalVal)) != 0) {
+        if (flashWriterStart((uint32_t)FLASH_ADDR_CAL, &cal, sizeof(cal), onCalibrationStored) != 0) {
             USBnprintf("Calibration was not stored in FLASH\r\n");
         }
     }
@@ -279,13 +487,22 @@ static void calibrateReadWrite(bool write) {
                 CA_SNPRINTF(buf, len, "Calibration: CAL");
             }
             CA_SNPRINTF(buf, len, " %d,%.10f,%.10f", i + 1,
-                            portCalVal[i][0], portCalVal[i][1]);
+                            cal.portCalVal[i][0], cal.portCalVal[i][1]);
         }
         CA_SNPRINTF(buf, len, "\r\n");
         writeUSB(buf, len);
     }
 }
 
+/*!
+** @brief Called by the flash writer once the calibration is written
+*/
+static void onCalibrationStored(int status) {
+    if (status != 0) {
+        USBnprintf("Calibration was not stored in FLASH\r\n");
+    }
+}
+
 /***************************************************************************************************
 ** PUBLIC FUNCTION DEFINITIONS
 ***************************************************************************************************/
@@ -308,29 +525,40 @@ void InitTemperature(SPI_HandleTypeDef* hspi_, WWDG_HandleTypeDef* hwwdg_,
 }
 
 void LoopTemperature(const char* bootMsg) {
-    static uint32_t timeStamp      = 0;
-    static const uint32_t tsUpload = 100;
+    static uint32_t timeStamp        = 0;
+    static uint32_t printStamp       = 0;
+    static const uint32_t tsWatchdog = 100;
 
     CAhandleUserInputs(&caProto, bootMsg);
+    flashWriterRun();
 
     // Check the status off the board
     monitorBoardStatus();
-    // Measure temperatures
-    getPeripheralTemperatures();
-    float internalTemp = getInternalTemperature();
+    applySettings();
 
-    // Upload data every "tsUpload" ms.
-    if (tdiff_u32(HAL_GetTick(), timeStamp) >= tsUpload) {
+    // The window watchdog must be refreshed every 100 ms, whatever the print period
+    if (tdiff_u32(HAL_GetTick(), timeStamp) >= tsWatchdog) {
         timeStamp = HAL_GetTick();
         HAL_WWDG_Refresh(hwwdg);
 
+        // Enable wwdg now that print frequency has stabilised.
+        if (isUsbPortOpen()) {
+            enableWWDG();
+        }
+    }
+
+    // Upload data every "printMs" ms.
+    if (tdiff_u32(HAL_GetTick(), printStamp) >= cal.settings.printMs) {
+        printStamp = HAL_GetTick();
+
+        // The conversions are read in the background by the acquisition engine
+        getPeripheralTemperatures();
+        float internalTemp = getInternalTemperature();
+
         if (!isUsbPortOpen()) {
             return;
         }
 
-        // Enable wwdg now that print frequency has stabilised.
-        enableWWDG();
-
         USBnprintf(
             "%.2f, %.2f, %.2f, %.2f, %.2f, %.2f, %.2f, %.2f, %.2f, %.2f, %.2f, 0x%08" PRIx32 "\r\n",
             ads1120[0].data.chA, ads1120[0].data.chB, ads1120[1].data.chA, ads1120[1].data.chB,
@@ -0,0 +1,394 @@
+/*!
+** @file    adsAcquisition.c
+** @brief   Interrupt driven acquisition of the ADS1120 conversions over a shared SPI bus
+** @date:   18/10/2026
+**
+** Each ADS1120 runs in single-shot mode and signals a finished conversion on its DRDY pin. The DRDY
+** interrupt only marks the chip as pending. Pending chips are served one at a time (round robin)
+** with a single DMA transfer, which reads the finished conversion and in the same frame configures
+** the next input and starts the next conversion:
+**
+**   | data MSB | data LSB | WREG reg 0-1 | reg 0 | reg 1 | START |
+**
+** The enabled thermocouple inputs alternate, with a conversion of the internal temperature sensor
+** (the cold junction) at a fixed minimum rate. So every chip delivers all its values without the
+** main loop touching the bus, and the cold junction temperature is always recent. At the default
+** 45 SPS the cycle is internal temperature -> A -> B. Results are published in a double buffered table guarded
+** by a sequence counter, so the main loop can take a consistent copy without disabling interrupts.
+**
+** All acquisition interrupts (DRDY and SPI DMA) must run at the same priority, so they never
+** preempt each other. The main loop only touches the engine state through acqLock/acqUnlock.
+*/
+
+#include <stddef.h>
+#include <string.h>
+
+#include "adsAcquisition.h"
+#include "adsBus.h"
+
+/***************************************************************************************************
+** DEFINES
+***************************************************************************************************/
+
+#define ADS_CMD_WREG_0_1    0x41    // Write 2 registers starting from register 0
+#define ADS_CMD_START       0x08
+
+#define ADS_MUX_AIN0_AIN1   (0x0 << 4)
+#define ADS_MUX_AIN2_AIN3   (0x5 << 4)
+#define ADS_GAIN_32         (0x5 << 1)
+#define ADS_DR_Pos          5
+#define ADS_MODE_TURBO      (0x2 << 3)  // Doubles the data rate of every DR setting
+#define ADS_TS_MODE         (0x1 << 1)  // Internal temperature sensor
+
+#define ACQ_CJ_RATE_HZ      20          // Cold junction conversion rate at high data rates
+
+#define ADS_VREF            2.048f
+#define ADS_GAIN            32.0f
+#define ADS_FULL_SCALE      32768.0f
+#define ADS_TS_RESOLUTION   0.03125f    // Degrees per LSB of the 14 bit temperature result
+
+/***************************************************************************************************
+** TYPEDEFS
+***************************************************************************************************/
+
+typedef struct AcqChip {
+    volatile bool isPending;    // DRDY seen, but the conversion has not been read yet
+    volatile bool isActive;
+    bool isPrimed;              // False until the first frame has configured the chip
+    AcqInput input;             // Input of the conversion in progress
+    AcqInput next;              // Input configured by the frame in flight
+    uint8_t inputs;             // Thermocouple inputs to convert (bit per AcqInput)
+    uint8_t rateBits;           // Data rate and mode bits of register 1
+    int cjEvery;                // Thermocouple conversions between cold junction conversions
+    int sinceCj;                // Thermocouple conversions since the last cold junction conversion
+} AcqChip;
+
+/***************************************************************************************************
+** PRIVATE VARIABLES
+***************************************************************************************************/
+
+static const uint8_t inputRegs[ACQ_NO_INPUTS][2] = {
+    [ACQ_CH_A]     = {ADS_MUX_AIN0_AIN1 | ADS_GAIN_32, 0},
+    [ACQ_CH_B]     = {ADS_MUX_AIN2_AIN3 | ADS_GAIN_32, 0},
+    [ACQ_INTERNAL] = {ADS_MUX_AIN0_AIN1 | ADS_GAIN_32, ADS_TS_MODE},
+};
+
+// Data rates in SPS for each DR setting. Turbo mode doubles them
+static const uint16_t dataRates[] = {20, 45, 90, 175, 330, 600, 1000};
+#define NO_DATA_RATES ((int)(sizeof(dataRates) / sizeof(dataRates[0])))
+
+static AcqChip chips[ACQ_MAX_CHIPS];
+static int noChips = 0;
+
+static volatile bool isBusy   = false;
+static volatile bool isLocked = true;
+static int current            = -1;  // Chip with a transfer in flight
+static int lastServed         = 0;
+
+static uint8_t txFrame[ACQ_FRAME_LEN];
+static uint8_t rxFrame[ACQ_FRAME_LEN];
+
+static AcqResults results[2];
+static volatile int published     = 0;
+static volatile uint32_t sequence = 0;
+
+/***************************************************************************************************
+** PRIVATE FUNCTION DEFINITIONS
+***************************************************************************************************/
+
+/*!
+** @brief Returns the register 1 bits for a data rate, or -1 if the ADS1120 does not support it
+*/
+static int rateBits(uint16_t sps) {
+    for (int i = 0; i < NO_DATA_RATES; i++) {
+        if (dataRates[i] == sps) {
+            return i << ADS_DR_Pos;
+        }
+    }
+    for (int i = 0; i < NO_DATA_RATES; i++) {
+        if (2 * dataRates[i] == sps) {
+            return (i << ADS_DR_Pos) | ADS_MODE_TURBO;
+        }
+    }
+    return -1;
+}
+
+/*!
+** @brief Selects the input to convert after the current one
+**
+** The enabled thermocouple inputs alternate, with a cold junction conversion every "cjEvery"
+** thermocouple conversions. At high data rates that is about ACQ_CJ_RATE_HZ, and at low data rates
+** once per cycle through the enabled inputs.
+*/
+static AcqInput nextInput(const AcqChip* chip) {
+    if (chip->sinceCj >= chip->cjEvery) {
+        return ACQ_INTERNAL;
+    }
+    if (chip->input == ACQ_CH_A && (chip->inputs & (1U << ACQ_CH_B))) {
+        return ACQ_CH_B;
+    }
+    return (chip->inputs & (1U << ACQ_CH_A)) ? ACQ_CH_A : ACQ_CH_B;
+}
+
+/*!
+** @brief Starts the transfer of the next pending chip, if no transfer is in flight
+**
+** Only called from the acquisition interrupts while unlocked, or from the main loop while locked.
+*/
+static void serveNext() {
+    if (isBusy) {
+        return;
+    }
+
+    for (int k = 1; k <= noChips; k++) {
+        int c         = (lastServed + k) % noChips;
+        AcqChip* chip = &chips[c];
+
+        if (!chip->isPending) {
+            continue;
+        }
+        chip->isPending = false;
+        if (!chip->isActive) {
+            continue;
+        }
+
+        AcqInput next = nextInput(chip);
+        chip->next    = next;
+        txFrame[0]    = 0x00;
+        txFrame[1]    = 0x00;
+        txFrame[2]    = ADS_CMD_WREG_0_1;
+        txFrame[3]    = inputRegs[next][0];
+        txFrame[4]    = inputRegs[next][1] | chip->rateBits;
+        txFrame[5]    = ADS_CMD_START;
+
+        isBusy     = true;
+        current    = c;
+        lastServed = c;
+        if (adsBusTransfer(c, txFrame, rxFrame, ACQ_FRAME_LEN) != 0) {
+            // Retried on the next event
+            adsBusRelease(c);
+            chip->isPending = true;
+            isBusy          = false;
+            current         = -1;
+        }
+        return;
+    }
+}
+
+static void publish(int chip, AcqInput input, int16_t code) {
+    int w = published ^ 1;
+
+    memcpy(&results[w], &results[published], sizeof(AcqResults));
+    results[w].code[chip][input] = code;
+    results[w].sum[chip][input] += code;
+    results[w].count[chip][input]++;
+
+    published = w;
+    sequence++;
+}
+
+static void startNext() {
+    if (!isLocked) {
+        serveNext();
+    }
+}
+
+static bool isAnyPending() {
+    for (int c = 0; c < noChips; c++) {
+        if (chips[c].isPending) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/***************************************************************************************************
+** PUBLIC FUNCTION DEFINITIONS
+***************************************************************************************************/
+
+/*!
+** @brief Resets the engine. It is left locked, so the chips can be set up with blocking transfers
+**
+** @param[in] noOfChips Number of chips on the bus (max ACQ_MAX_CHIPS)
+*/
+void acqInit(int noOfChips) {
+    noChips    = (noOfChips <= ACQ_MAX_CHIPS) ? noOfChips : ACQ_MAX_CHIPS;
+    isBusy     = false;
+    isLocked   = true;
+    current    = -1;
+    lastServed = noChips - 1;
+
+    memset(chips, 0, sizeof(chips));
+    memset(results, 0, sizeof(results));
+    published = 0;
+    sequence  = 0;
+
+    for (int c = 0; c < noChips; c++) {
+        acqConfigure(c, ACQ_DEFAULT_RATE, true, true);
+    }
+}
+
+/*!
+** @brief Returns true if the ADS1120 supports a data rate (in normal or turbo mode)
+*/
+bool acqIsValidRate(uint16_t sps) {
+    return rateBits(sps) >= 0;
+}
+
+/*!
+** @brief Sets the data rate and the thermocouple inputs of a chip
+**
+** Takes effect from the next conversion. The internal temperature sensor is always converted (see
+** nextInput).
+**
+** @param[in] chip Chip index
+** @param[in] sps  Data rate in SPS. See acqIsValidRate
+** @param[in] chA  Convert channel A
+** @param[in] chB  Convert channel B
+*/
+void acqConfigure(int chip, uint16_t sps, bool chA, bool chB) {
+    int bits = rateBits(sps);
+    if (chip < 0 || chip >= noChips || bits < 0) {
+        return;
+    }
+
+    int noInputs = (chA ? 1 : 0) + (chB ? 1 : 0);
+    int cjEvery  = sps / ACQ_CJ_RATE_HZ;
+
+    AcqChip* c  = &chips[chip];
+    c->rateBits = (uint8_t)bits;
+    c->inputs   = (chA ? (1U << ACQ_CH_A) : 0) | (chB ? (1U << ACQ_CH_B) : 0);
+    c->cjEvery  = (cjEvery > noInputs) ? cjEvery : noInputs;
+}
+
+/*!
+** @brief Starts the conversion cycle of a chip. Must be called while holding the lock
+*/
+void acqStart(int chip) {
+    if (chip < 0 || chip >= noChips) {
+        return;
+    }
+
+    // The cold junction is converted first, so it is known before the thermocouples
+    chips[chip].isPrimed  = false;
+    chips[chip].sinceCj   = chips[chip].cjEvery;
+    chips[chip].isActive  = true;
+    chips[chip].isPending = true;
+}
+
+/*!
+** @brief Stops serving a chip, e.g. when it no longer signals DRDY
+*/
+void acqStop(int chip) {
+    if (chip >= 0 && chip < noChips) {
+        chips[chip].isActive = false;
+    }
+}
+
+/*!
+** @brief Takes the bus from the engine, so it can be used with blocking transfers
+**
+** The DRDY interrupts are still registered while locked, and served after unlocking.
+**
+** @return True if the bus is free. Otherwise a transfer is in flight: call again later
+*/
+bool acqLock() {
+    isLocked = true;
+    return !isBusy;
+}
+
+/*!
+** @brief Hands the bus back to the engine and serves the chips which became ready meanwhile
+*/
+void acqUnlock() {
+    serveNext();
+    isLocked = false;
+
+    // A DRDY registered between the start above and the unlock would otherwise never be served
+    for (int i = 0; i < noChips && !isBusy && isAnyPending(); i++) {
+        if (acqLock()) {
+            serveNext();
+        }
+        isLocked = false;
+    }
+}
+
+/*!
+** @brief Called from the DRDY interrupt of a chip
+*/
+void acqDataReady(int chip) {
+    if (chip < 0 || chip >= noChips) {
+        return;
+    }
+
+    chips[chip].isPending = true;
+    startNext();
+}
+
+/*!
+** @brief Called from the SPI DMA interrupt when a frame has been exchanged
+*/
+void acqTransferComplete() {
+    if (!isBusy) {
+        return;
+    }
+
+    int c = current;
+    adsBusRelease(c);
+
+    AcqChip* chip = &chips[c];
+    if (chip->isActive) {
+        // The first frame after a start reads a conversion of an unknown input
+        if (chip->isPrimed) {
+            publish(c, chip->input, (int16_t)((rxFrame[0] << 8) | rxFrame[1]));
+        }
+        chip->isPrimed = true;
+        chip->input    = chip->next;
+        chip->sinceCj  = (chip->next == ACQ_INTERNAL) ? 0 : chip->sinceCj + 1;
+    }
+
+    current = -1;
+    isBusy  = false;
+    startNext();
+}
+
+/*!
+** @brief Called from the SPI DMA interrupt when a transfer failed. The frame is sent again
+*/
+void acqTransferError() {
+    if (!isBusy) {
+        return;
+    }
+
+    adsBusRelease(current);
+    chips[current].isPending = true;
+    current = -1;
+    isBusy  = false;
+    startNext();
+}
+
+/*!
+** @brief Copies the latest conversion results. Safe to call while the engine is running
+*/
+void acqGetResults(AcqResults* res) {
+    uint32_t seq;
+    do {
+        seq = sequence;
+        memcpy(res, &results[published], sizeof(AcqResults));
+    } while (seq != sequence);
+}
+
+/*!
+** @brief Converts a thermocouple conversion result (or a mean of results) to the input voltage in V
+*/
+float acqCodeToVoltage(float code) {
+    return code * (ADS_VREF / ADS_GAIN) / ADS_FULL_SCALE;
+}
+
+/*!
+** @brief Converts an internal temperature sensor result (or a mean of results) to degrees C
+*/
+float acqCodeToInternalTemp(float code) {
+    // The 14 bit result is left justified
+    return code / 4.0f * ADS_TS_RESOLUTION;
+}
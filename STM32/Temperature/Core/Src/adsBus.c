@@ -0,0 +1,113 @@
+/*!
+** @file    adsBus.c
+** @brief   SPI DMA and DRDY interrupt glue between the HAL and adsAcquisition.c
+** @date:   18/10/2026
+*/
+
+#include <stdbool.h>
+
+#include "adsAcquisition.h"
+#include "adsBus.h"
+
+/***************************************************************************************************
+** PRIVATE VARIABLES
+***************************************************************************************************/
+
+static SPI_HandleTypeDef* hspi = NULL;
+
+static StmGpio cs[ACQ_MAX_CHIPS];
+static uint16_t drdyPins[ACQ_MAX_CHIPS];
+static int noChips = 0;
+
+/***************************************************************************************************
+** PRIVATE FUNCTION DEFINITIONS
+***************************************************************************************************/
+
+static IRQn_Type exti(uint16_t pin) {
+    if (pin >= GPIO_PIN_10) {
+        return EXTI15_10_IRQn;
+    }
+    if (pin >= GPIO_PIN_5) {
+        return EXTI9_5_IRQn;
+    }
+
+    static const IRQn_Type lines[] = {EXTI0_IRQn, EXTI1_IRQn, EXTI2_IRQn, EXTI3_IRQn, EXTI4_IRQn};
+    int line = 0;
+    while ((pin >> line) != 1U) {
+        line++;
+    }
+    return lines[line];
+}
+
+/***************************************************************************************************
+** PUBLIC FUNCTION DEFINITIONS
+***************************************************************************************************/
+
+void adsBusInit(SPI_HandleTypeDef* hspi_) {
+    hspi    = hspi_;
+    noChips = 0;
+}
+
+/*!
+** @brief Registers the chip select and DRDY pins of a chip, and enables its DRDY interrupt
+**
+** The DRDY pins depend on the PCB version, so the EXTI lines are set up here rather than in
+** MX_GPIO_Init. The interrupt priority matches the SPI DMA interrupts (see adsAcquisition.c).
+*/
+void adsBusAddChip(int chip, StmGpio cs_, GPIO_TypeDef* drdyPort, uint16_t drdyPin) {
+    if (chip < 0 || chip >= ACQ_MAX_CHIPS) {
+        return;
+    }
+
+    cs[chip]       = cs_;
+    drdyPins[chip] = drdyPin;
+    if (chip >= noChips) {
+        noChips = chip + 1;
+    }
+
+    GPIO_InitTypeDef init = {0};
+    init.Pin              = drdyPin;
+    init.Mode             = GPIO_MODE_IT_FALLING;
+    init.Pull             = GPIO_NOPULL;
+    HAL_GPIO_Init(drdyPort, &init);
+
+    HAL_NVIC_SetPriority(exti(drdyPin), 0, 0);
+    HAL_NVIC_EnableIRQ(exti(drdyPin));
+}
+
+/*!
+** @brief Selects a chip and starts a DMA transfer
+**
+** @return 0 if the transfer was started
+*/
+int adsBusTransfer(int chip, const uint8_t* tx, uint8_t* rx, uint16_t len) {
+    stmSetGpio(cs[chip], false);
+    return (HAL_SPI_TransmitReceive_DMA(hspi, (uint8_t*)tx, rx, len) == HAL_OK) ? 0 : -1;
+}
+
+/*!
+** @brief Deselects a chip at the end of a transfer
+*/
+void adsBusRelease(int chip) {
+    stmSetGpio(cs[chip], true);
+}
+
+void HAL_GPIO_EXTI_Callback(uint16_t pin) {
+    for (int i = 0; i < noChips; i++) {
+        if (drdyPins[i] == pin) {
+            acqDataReady(i);
+        }
+    }
+}
+
+void HAL_SPI_TxRxCpltCallback(SPI_HandleTypeDef* hspi_) {
+    if (hspi_ == hspi) {
+        acqTransferComplete();
+    }
+}
+
+void HAL_SPI_ErrorCallback(SPI_HandleTypeDef* hspi_) {
+    if (hspi_ == hspi) {
+        acqTransferError();
+    }
+}
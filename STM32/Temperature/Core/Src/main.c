@@ -27,6 +27,8 @@
 /* USER CODE BEGIN Includes */
 #include "CAProtocolStm.h"
 #include "Temperature.h"
+#include "flashRecordStm.h"
+#include "flashWriter.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -50,6 +52,8 @@ CRC_HandleTypeDef hcrc;
 IWDG_HandleTypeDef hiwdg;
 
 SPI_HandleTypeDef hspi1;
+DMA_HandleTypeDef hdma_spi1_rx;
+DMA_HandleTypeDef hdma_spi1_tx;
 
 WWDG_HandleTypeDef hwwdg;
 
@@ -59,6 +63,7 @@ WWDG_HandleTypeDef hwwdg;
 /* Private function prototypes -----------------------------------------------*/
 void SystemClock_Config(void);
 static void MX_GPIO_Init(void);
+static void MX_DMA_Init(void);
 static void MX_SPI1_Init(void);
 static void MX_WWDG_Init(void);
 static void MX_IWDG_Init(void);
@@ -100,6 +105,7 @@ int main(void)
 
   /* Initialize all configured peripherals */
   MX_GPIO_Init();
+  MX_DMA_Init();
   MX_USB_DEVICE_Init();
   MX_SPI1_Init();
   MX_WWDG_Init();
@@ -109,6 +115,7 @@ int main(void)
   // Disable wwdg until print frequency has stabilised after first run.
   // Enabled again in LoopTemperature.
   __HAL_RCC_WWDG_CLK_DISABLE();
+  flashWriterInit(&flashRecordStmOps, flashRecordStmPauseWwdg);
   InitTemperature(&hspi1, &hwwdg, &hcrc);
   /* USER CODE END 2 */
 
@@ -250,7 +257,7 @@ static void MX_SPI1_Init(void)
   hspi1.Init.CLKPolarity = SPI_POLARITY_LOW;
   hspi1.Init.CLKPhase = SPI_PHASE_2EDGE;
   hspi1.Init.NSS = SPI_NSS_SOFT;
-  hspi1.Init.BaudRatePrescaler = SPI_BAUDRATEPRESCALER_64;
+  hspi1.Init.BaudRatePrescaler = SPI_BAUDRATEPRESCALER_16;
   hspi1.Init.FirstBit = SPI_FIRSTBIT_MSB;
   hspi1.Init.TIMode = SPI_TIMODE_DISABLE;
   hspi1.Init.CRCCalculation = SPI_CRCCALCULATION_DISABLE;
@@ -295,6 +302,25 @@ static void MX_WWDG_Init(void)
 
 }
 
+/**
+  * Enable DMA controller clock
+  */
+static void MX_DMA_Init(void)
+{
+
+  /* DMA controller clock enable */
+  __HAL_RCC_DMA2_CLK_ENABLE();
+
+  /* DMA interrupt init */
+  /* DMA2_Stream0_IRQn interrupt configuration */
+  HAL_NVIC_SetPriority(DMA2_Stream0_IRQn, 0, 0);
+  HAL_NVIC_EnableIRQ(DMA2_Stream0_IRQn);
+  /* DMA2_Stream3_IRQn interrupt configuration */
+  HAL_NVIC_SetPriority(DMA2_Stream3_IRQn, 0, 0);
+  HAL_NVIC_EnableIRQ(DMA2_Stream3_IRQn);
+
+}
+
 /**
   * @brief GPIO Initialization Function
   * @param None
@@ -0,0 +1,217 @@
+/*!
+** @file    thermocouple.c
+** @brief   NIST ITS-90 thermocouple conversions
+** @date:   18/10/2026
+**
+** The reference functions and their inverses are piecewise polynomials, with coefficients from the
+** NIST ITS-90 thermocouple database (NIST Monograph 175). Voltages are in mV and temperatures in
+** degrees C. The polynomials are evaluated in single precision with Horner's scheme, which keeps
+** the error well below the accuracy of the inverse functions (0.1 C at most) and the cost at a few
+** microseconds per conversion.
+**
+** Cold junction compensation is done in the voltage domain: the voltage of the cold junction
+** temperature is added to the measured voltage before converting it back to a temperature.
+*/
+
+#include <math.h>
+
+#include "thermocouple.h"
+
+/***************************************************************************************************
+** DEFINES
+***************************************************************************************************/
+
+#define TC_MAX_COEFS        15
+#define TC_SENSITIVITY_TOL  1e-3f   // Relative tolerance when matching a sensitivity to a type
+
+/***************************************************************************************************
+** TYPEDEFS
+***************************************************************************************************/
+
+typedef struct TcPoly {
+    float upper;    // Upper end of the input range of the polynomial
+    int n;          // Number of coefficients
+    float c[TC_MAX_COEFS];
+} TcPoly;
+
+typedef struct TcTables {
+    float sensitivity;  // Sensitivity in V/C, as used in the port calibration
+    const TcPoly* fwd;  // Temperature to voltage, ordered by range
+    int nFwd;
+    const TcPoly* inv;  // Voltage to temperature, ordered by range
+    int nInv;
+} TcTables;
+
+/***************************************************************************************************
+** PRIVATE VARIABLES
+***************************************************************************************************/
+
+static const TcPoly typeKFwd[] = {
+    {0.0f, 11, {0.0f, 3.94501280250e-02f, 2.36223735980e-05f, -3.28589067840e-07f,
+                -4.99048287770e-09f, -6.75090591730e-11f, -5.74103274280e-13f,
+                -3.10888728940e-15f, -1.04516093650e-17f, -1.98892668780e-20f,
+                -1.63226974860e-23f}},
+    {1372.0f, 10, {-1.76004136860e-02f, 3.89212049750e-02f, 1.85587700320e-05f,
+                   -9.94575928740e-08f, 3.18409457190e-10f, -5.60728448890e-13f,
+                   5.60750590590e-16f, -3.20207200030e-19f, 9.71511471520e-23f,
+                   -1.21047212750e-26f}},
+};
+
+static const TcPoly typeKInv[] = {
+    {0.0f, 9, {0.0f, 2.5173462e+01f, -1.1662878e+00f, -1.0833638e+00f, -8.9773540e-01f,
+               -3.7342377e-01f, -8.6632643e-02f, -1.0450598e-02f, -5.1920577e-04f}},
+    {20.644f, 10, {0.0f, 2.508355e+01f, 7.860106e-02f, -2.503131e-01f, 8.315270e-02f,
+                   -1.228034e-02f, 9.804036e-04f, -4.413030e-05f, 1.057734e-06f,
+                   -1.052755e-08f}},
+    {54.886f, 7, {-1.318058e+02f, 4.830222e+01f, -1.646031e+00f, 5.464731e-02f,
+                  -9.650715e-04f, 8.802193e-06f, -3.110810e-08f}},
+};
+
+// Type K has an additional term a0 * exp(a1 * (t - a2)^2) above 0 C
+static const float typeKExp[3] = {1.185976e-01f, -1.183432e-04f, 1.269686e+02f};
+
+static const TcPoly typeJFwd[] = {
+    {760.0f, 9, {0.0f, 5.03811878150e-02f, 3.04758369300e-05f, -8.56810657200e-08f,
+                 1.32281952950e-10f, -1.70529583370e-13f, 2.09480906970e-16f,
+                 -1.25383953360e-19f, 1.56317256970e-23f}},
+    {1200.0f, 6, {2.96456256810e+02f, -1.49761277860e+00f, 3.17871039240e-03f,
+                  -3.18476867010e-06f, 1.57208190040e-09f, -3.06913690560e-13f}},
+};
+
+static const TcPoly typeJInv[] = {
+    {0.0f, 9, {0.0f, 1.9528268e+01f, -1.2286185e+00f, -1.0752178e+00f, -5.9086933e-01f,
+               -1.7256713e-01f, -2.8131513e-02f, -2.3963370e-03f, -8.3823321e-05f}},
+    {42.919f, 8, {0.0f, 1.978425e+01f, -2.001204e-01f, 1.036969e-02f, -2.549687e-04f,
+                  3.585153e-06f, -5.344285e-08f, 5.099890e-10f}},
+    {69.553f, 6, {-3.11358187e+03f, 3.00543684e+02f, -9.94773230e+00f, 1.70276630e-01f,
+                  -1.43033468e-03f, 4.73886084e-06f}},
+};
+
+static const TcPoly typeNFwd[] = {
+    {0.0f, 9, {0.0f, 2.61591059620e-02f, 1.09574842280e-05f, -9.38411115540e-08f,
+               -4.64120397590e-11f, -2.63033577160e-12f, -2.26534380030e-14f,
+               -7.60893007910e-17f, -9.34196678350e-20f}},
+    {1300.0f, 11, {0.0f, 2.59293946010e-02f, 1.57101418800e-05f, 4.38256272370e-08f,
+                   -2.52611697940e-10f, 6.43118193390e-13f, -1.00634715190e-15f,
+                   9.97453389920e-19f, -6.08632456070e-22f, 2.08492293390e-25f,
+                   -3.06821961510e-29f}},
+};
+
+static const TcPoly typeNInv[] = {
+    {0.0f, 10, {0.0f, 3.8436847e+01f, 1.1010485e+00f, 5.2229312e+00f, 7.2060525e+00f,
+                5.8488586e+00f, 2.7754916e+00f, 7.7075166e-01f, 1.1582665e-01f,
+                7.3138868e-03f}},
+    {20.613f, 8, {0.0f, 3.86896e+01f, -1.08267e+00f, 4.70205e-02f, -2.12169e-06f,
+                  -1.17272e-04f, 5.39280e-06f, -7.98156e-08f}},
+    {47.513f, 6, {1.972485e+01f, 3.300943e+01f, -3.915159e-01f, 9.855391e-03f,
+                  -1.274371e-04f, 7.767022e-07f}},
+};
+
+static const TcPoly typeTFwd[] = {
+    {0.0f, 15, {0.0f, 3.87481063640e-02f, 4.41944343470e-05f, 1.18443231050e-07f,
+                2.00329735540e-08f, 9.01380195590e-10f, 2.26511565930e-11f,
+                3.60711542050e-13f, 3.84939398830e-15f, 2.82135219250e-17f,
+                1.42515947790e-19f, 4.87686622860e-22f, 1.07955392700e-24f,
+                1.39450270620e-27f, 7.97951539270e-31f}},
+    {400.0f, 9, {0.0f, 3.87481063640e-02f, 3.32922278800e-05f, 2.06182434040e-07f,
+                 -2.18822568460e-09f, 1.09968809280e-11f, -3.08157587720e-14f,
+                 4.54791352900e-17f, -2.75129016730e-20f}},
+};
+
+static const TcPoly typeTInv[] = {
+    {0.0f, 8, {0.0f, 2.5949192e+01f, -2.1316967e-01f, 7.9018692e-01f, 4.2527777e-01f,
+               1.3304473e-01f, 2.0241446e-02f, 1.2668171e-03f}},
+    {20.872f, 7, {0.0f, 2.592800e+01f, -7.602961e-01f, 4.637791e-02f, -2.165394e-03f,
+                  6.048144e-05f, -7.293422e-07f}},
+};
+
+#define TC_TABLES(sens, fwd, inv) \
+    {sens, fwd, sizeof(fwd) / sizeof(fwd[0]), inv, sizeof(inv) / sizeof(inv[0])}
+
+// Sensitivities match the TYPE_x_DELTA values of the port calibration
+static const TcTables tables[TC_TYPE_UNKNOWN] = {
+    [TC_TYPE_K] = TC_TABLES(0.000041276f, typeKFwd, typeKInv),
+    [TC_TYPE_J] = TC_TABLES(0.000057953f, typeJFwd, typeJInv),
+    [TC_TYPE_N] = TC_TABLES(0.000036256f, typeNFwd, typeNInv),
+    [TC_TYPE_T] = TC_TABLES(0.00005218f, typeTFwd, typeTInv),
+};
+
+/***************************************************************************************************
+** PRIVATE FUNCTION DEFINITIONS
+***************************************************************************************************/
+
+/*!
+** @brief Evaluates the piecewise polynomial covering x. Inputs outside the table are extrapolated
+*/
+static float evaluate(const TcPoly* polys, int n, float x) {
+    const TcPoly* p = polys;
+    while (p < &polys[n - 1] && x > p->upper) {
+        p++;
+    }
+
+    float y = p->c[p->n - 1];
+    for (int i = p->n - 2; i >= 0; i--) {
+        y = y * x + p->c[i];
+    }
+    return y;
+}
+
+/***************************************************************************************************
+** PUBLIC FUNCTION DEFINITIONS
+***************************************************************************************************/
+
+/*!
+** @brief Finds the thermocouple type with the given sensitivity
+**
+** @param[in] delta Sensitivity in V/C (e.g. TYPE_K_DELTA)
+**
+** @return Thermocouple type, or TC_TYPE_UNKNOWN for a custom sensitivity
+*/
+TcType tcTypeFromSensitivity(float delta) {
+    for (int t = 0; t < TC_TYPE_UNKNOWN; t++) {
+        if (fabsf(delta - tables[t].sensitivity) < tables[t].sensitivity * TC_SENSITIVITY_TOL) {
+            return (TcType)t;
+        }
+    }
+    return TC_TYPE_UNKNOWN;
+}
+
+/*!
+** @brief Thermocouple voltage (in mV) with the reference junction at 0 C
+*/
+float tcVoltage(TcType type, float temp) {
+    if (type >= TC_TYPE_UNKNOWN) {
+        return NAN;
+    }
+
+    const TcTables* t = &tables[type];
+    float mV          = evaluate(t->fwd, t->nFwd, temp);
+    if (type == TC_TYPE_K && temp > 0.0f) {
+        float d = temp - typeKExp[2];
+        mV += typeKExp[0] * expf(typeKExp[1] * d * d);
+    }
+    return mV;
+}
+
+/*!
+** @brief Temperature of a thermocouple giving mV with the reference junction at 0 C
+*/
+float tcTemperature(TcType type, float mV) {
+    if (type >= TC_TYPE_UNKNOWN) {
+        return NAN;
+    }
+
+    const TcTables* t = &tables[type];
+    return evaluate(t->inv, t->nInv, mV);
+}
+
+/*!
+** @brief Temperature of the hot junction of a thermocouple
+**
+** @param[in] type   Thermocouple type
+** @param[in] mV     Measured thermocouple voltage in mV
+** @param[in] cjTemp Temperature of the cold junction in C
+*/
+float tcCompensate(TcType type, float mV, float cjTemp) {
+    return tcTemperature(type, mV + tcVoltage(type, cjTemp));
+}
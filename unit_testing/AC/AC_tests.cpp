@@ -26,6 +26,8 @@
 #define FLASH_ADDR_FAULT ((uint32_t) 0U)
 
 #include "flashHandler.c"
+#include "portCurrent.c"
+#include "ADCWatchdog.c"
 
 /* UUT */
 #include "ACBoard.c"
@@ -65,9 +67,17 @@ class ACBoard: public CaBoardUnitTest
                     HAL_ADC_ConvHalfCpltCallback(&hadc);
                 }
             }
+            simDmaPosition();
             ACBoardLoop(bootMsg);
         }
 
+        /* The DMA writes ADC_SAMPLES_PER_MS samples per tick, and wraps every 200 ticks */
+        void simDmaPosition()
+        {
+            int written = (tickCounter % 200) * ADC_SAMPLES_PER_MS;
+            pcDmaPosition((2 * ADC_CHANNEL_BUF_SIZE - written) * ADC_CHANNELS);
+        }
+
         void setPowerStatus(bool state)
         {
             ACBoardInit(&hadc);
@@ -78,6 +88,15 @@ class ACBoard: public CaBoardUnitTest
             }
         }
 
+        /* Fills a current channel with a square wave of the given amplitude. The zero current level
+        ** is calibrated from the first buffer, which is all zeros in simulation */
+        void setCurrentChannel(int ch, int16_t amplitude)
+        {
+            for(unsigned i = 0; i < hadc.dma_length / hadc.Init.NbrOfConversion; i++) {
+                *((int16_t*)hadc.dma_address + ch + ADC_CHANNELS*i) = (i % 2) ? amplitude : -amplitude;
+            }
+        }
+
         /*******************************************************************************************
         ** MEMBERS
         *******************************************************************************************/
@@ -133,8 +152,16 @@ TEST_F(ACBoard, printStatus) {
 }
 
 TEST_F(ACBoard, printStatusDef) {
-    statusDefPrintoutTest(sst, "0x7e000020,System errors\r", 
-                          {"0x00000020,Mains not-connected error\r", 
+    statusDefPrintoutTest(sst, "0x7e007fa0,System errors\r", 
+                          {"0x00004000,Port 4 off but drawing current\r",
+                           "0x00002000,Port 3 off but drawing current\r",
+                           "0x00001000,Port 2 off but drawing current\r",
+                           "0x00000800,Port 1 off but drawing current\r",
+                           "0x00000400,Port 4 on but not drawing current\r",
+                           "0x00000200,Port 3 on but not drawing current\r",
+                           "0x00000100,Port 2 on but not drawing current\r",
+                           "0x00000080,Port 1 on but not drawing current\r",
+                           "0x00000020,Mains not-connected error\r", 
                            "0x00000010,Port 4 switching state\r", 
                            "0x00000008,Port 3 switching state\r", 
                            "0x00000004,Port 2 switching state\r", 
@@ -340,14 +367,86 @@ TEST_F(ACBoard, heatsinkLoop)
     EXPECT_FLUSH_USB(Contains("-0.0100, -0.0100, -0.0100, -0.0100, 48.98, -50.00, -50.00, -50.00, 0x00000001\r"));
     EXPECT_FALSE(stmGetGpio(fanCtrl));
 
-    /* Fill the temperature buffer with ~71 degC - fan should turn on and PWM of heaters should be reduced */
+    /* Fill the temperature buffer with ~71 degC - fan should turn on and PWM of heaters should be reduced 
+    ** Note: Port 1 draws no current while on, so it is also flagged (0x80) */
     writeBoardMessage("p1 on 10\n");
     for(unsigned i = 0; i < hadc.dma_length / hadc.Init.NbrOfConversion; i++) *((int16_t*)hadc.dma_address + TEMP_CHANNEL +  ADC_CHANNELS*i) = 1500;
     goToTick(600);
-    EXPECT_FLUSH_USB(Contains("-0.0100, -0.0100, -0.0100, -0.0100, 70.90, -50.00, -50.00, -50.00, 0xc0000003\r"));
+    EXPECT_FLUSH_USB(Contains("-0.0100, -0.0100, -0.0100, -0.0100, 70.90, -50.00, -50.00, -50.00, 0xc0000083\r"));
     EXPECT_TRUE(stmGetGpio(fanCtrl));
 }
 
+TEST_F(ACBoard, portCurrentMismatch)
+{
+    setPowerStatus(true);
+    ACBoardLoop(bootMsg);
+
+    for(int ch = 0; ch < NUM_CURRENT_CHANNELS; ch++) setCurrentChannel(ch, 0);
+    goToTick(100);
+    EXPECT_FALSE(bsGetField(AC_PORTS_CURRENT_ERROR_Msk));
+
+    /* Port on, but no current (e.g. open heater element) */
+    writeBoardMessage("p1 on 10\n");
+    goToTick(300);
+    EXPECT_TRUE(bsGetField(AC_PORT_x_NO_CURRENT_Msk(1)));
+    EXPECT_FALSE(bsGetField(AC_PORT_x_OFF_CURRENT_Msk(1)));
+    EXPECT_FALSE(bsGetField(AC_PORT_x_NO_CURRENT_Msk(2)));
+
+    /* Current starts flowing - fault clears */
+    setCurrentChannel(0, 400);
+    goToTick(500);
+    EXPECT_FALSE(bsGetField(AC_PORTS_CURRENT_ERROR_Msk));
+
+    /* Port off, but current keeps flowing (e.g. welded relay) */
+    writeBoardMessage("p1 off\n");
+    goToTick(700);
+    EXPECT_TRUE(bsGetField(AC_PORT_x_OFF_CURRENT_Msk(1)));
+    EXPECT_FALSE(bsGetField(AC_PORT_x_NO_CURRENT_Msk(1)));
+
+    setCurrentChannel(0, 0);
+    goToTick(900);
+    EXPECT_FALSE(bsGetField(AC_PORTS_CURRENT_ERROR_Msk));
+}
+
+TEST_F(ACBoard, heatsinkTrip)
+{
+    setPowerStatus(true);
+    ACBoardLoop(bootMsg);
+
+    const int TEMP_CHANNEL = 5;
+    int16_t* adcBuffer = (int16_t*)hadc.dma_address;
+    for(unsigned i = 0; i < hadc.dma_length / hadc.Init.NbrOfConversion; i++) adcBuffer[TEMP_CHANNEL + ADC_CHANNELS*i] = 1000;
+
+    writeBoardMessage("p1 on 10\n");
+    EXPECT_TRUE(stmGetGpio(heaterPorts[0].heater));
+
+    /* Over temperature spike in the middle of a half buffer (~87 degC) */
+    for(int i = 300; i < 300 + HEATSINK_TRIP_DEBOUNCE; i++) adcBuffer[TEMP_CHANNEL + ADC_CHANNELS*i] = 1700;
+
+    /* Not enough samples above the trip temperature yet */
+    adcWatchdogScan(300 + HEATSINK_TRIP_DEBOUNCE - 1);
+    EXPECT_TRUE(stmGetGpio(heaterPorts[0].heater));
+
+    /* Heater is switched off directly from the interrupt, without waiting for the ADC buffer */
+    adcWatchdogScan(300 + HEATSINK_TRIP_DEBOUNCE);
+    EXPECT_FALSE(stmGetGpio(heaterPorts[0].heater));
+
+    /* Main loop makes sure it stays off and reports over temperature until the next buffer */
+    ACBoardLoop(bootMsg);
+    EXPECT_TRUE(bsGetField(BS_OVER_TEMPERATURE_Msk));
+    writeBoardMessage("p1 on 10\n");
+    EXPECT_FALSE(stmGetGpio(heaterPorts[0].heater));
+    goToTick(50);
+    EXPECT_FALSE(stmGetGpio(heaterPorts[0].heater));
+
+    /* Temperature back to normal - ports can be turned on again */
+    for(int i = 300; i < 300 + HEATSINK_TRIP_DEBOUNCE; i++) adcBuffer[TEMP_CHANNEL + ADC_CHANNELS*i] = 1000;
+    goToTick(200);
+    EXPECT_FALSE(bsGetField(BS_OVER_TEMPERATURE_Msk));
+    writeBoardMessage("p1 on 10\n");
+    EXPECT_TRUE(stmGetGpio(heaterPorts[0].heater));
+}
+
 TEST_F(ACBoard, faultInfoPrintout) {
     faultInfo_t tmp = {.fault = HARD_FAULT};
     writeToFlash(FLASH_ADDR_FAULT, (uint8_t*)&tmp, sizeof(faultInfo_t));
@@ -17,6 +17,7 @@
 #include "ADCmonitor.c"
 #include "CAProtocol.c"
 #include "CAProtocolStm.c"
+#include "portCurrent.c"
 
 /* UUT */
 #include "ACTenChannel.c"
@@ -55,9 +56,16 @@ class ACTenCh: public CaBoardUnitTest
                     HAL_ADC_ConvHalfCpltCallback(&hadc1);
                 }
             }
+            simDmaPosition();
             ACTenChannelLoop(bootMsg);
         }
 
+        /* The DMA writes ADC_SAMPLES_PER_MS samples per tick, and wraps every 200 ticks */
+        void simDmaPosition() {
+            int written = (tickCounter % 200) * ADC_SAMPLES_PER_MS;
+            pcDmaPosition((2 * ADC_CHANNEL_BUF_SIZE - written) * ADC_CHANNELS);
+        }
+
         void setAdcBufferChannel(int ch, int16_t val) {
             /* According to default calibration, 2048 yields ~0 current */
             int n = hadc1.Init.NbrOfConversion;
@@ -68,6 +76,17 @@ class ACTenCh: public CaBoardUnitTest
             }
         }
 
+        /* Fills a channel with a square wave of the given amplitude. The zero current level is
+        ** calibrated from the first buffer, which is all zeros in simulation */
+        void setAdcBufferChannelSquare(int ch, int16_t amplitude) {
+            int n = hadc1.Init.NbrOfConversion;
+            int ch_dma_len = ADC_CHANNEL_BUF_SIZE * 2;
+
+            for(int i = 0; i < ch_dma_len; i++) {
+                ((int16_t*)hadc1.dma_address)[ch + i * n] = (i % 2) ? amplitude : -amplitude;
+            }
+        }
+
         /*******************************************************************************************
         ** MEMBERS
         *******************************************************************************************/
@@ -101,7 +120,19 @@ TEST_F(ACTenCh, goldenPath)
 }
 
 TEST_F(ACTenCh, printStatusDef) {
-    statusDefPrintoutTest(sst, "0x7e000800,System errors\r", {
+    statusDefPrintoutTest(sst, "0x7efff800,System errors\r", {
+        "0x00800000,Port off but drawing current\r",
+        "0x00400000,Port on but not drawing current\r",
+        "0x00200000,Port 9 current mismatch\r",
+        "0x00100000,Port 8 current mismatch\r",
+        "0x00080000,Port 7 current mismatch\r",
+        "0x00040000,Port 6 current mismatch\r",
+        "0x00020000,Port 5 current mismatch\r",
+        "0x00010000,Port 4 current mismatch\r",
+        "0x00008000,Port 3 current mismatch\r",
+        "0x00004000,Port 2 current mismatch\r",
+        "0x00002000,Port 1 current mismatch\r",
+        "0x00001000,Port 0 current mismatch\r",
         "0x00000800,Mains not-connected error\r", 
         "0x00000400,Fan state\r", 
         "0x00000001,Port 0 switching state\r", 
@@ -195,3 +226,39 @@ TEST_F(ACTenCh, UsbTimeout)
         }
     }
 }
+
+TEST_F(ACTenCh, portCurrentMismatch)
+{
+    const uint32_t ALL_CURRENT_ERRORS = AC_TEN_CH_PORTS_CURRENT_ERROR_Msk | 
+                                        AC_TEN_CH_NO_CURRENT_Msk | AC_TEN_CH_OFF_CURRENT_Msk;
+
+    for(int ch = 0; ch < ADC_CHANNELS; ch++) setAdcBufferChannelSquare(ch, 0);
+
+    /* Allow powerstatus buffer to fill for simulation */
+    simTicks(1000);
+    EXPECT_FALSE(bsGetField(ALL_CURRENT_ERRORS));
+
+    /* Port on, but no current (e.g. open heater element) */
+    writeBoardMessage("p3 on 10\n");
+    simTicks(200);
+    EXPECT_TRUE(bsGetField(AC_TEN_CH_PORT_x_CURRENT_ERROR_Msk(2)));
+    EXPECT_TRUE(bsGetField(AC_TEN_CH_NO_CURRENT_Msk));
+    EXPECT_FALSE(bsGetField(AC_TEN_CH_OFF_CURRENT_Msk));
+    EXPECT_FALSE(bsGetField(AC_TEN_CH_PORT_x_CURRENT_ERROR_Msk(3)));
+
+    /* Current starts flowing - fault clears */
+    setAdcBufferChannelSquare(2, 400);
+    simTicks(200);
+    EXPECT_FALSE(bsGetField(ALL_CURRENT_ERRORS));
+
+    /* Port off, but current keeps flowing (e.g. welded relay) */
+    writeBoardMessage("p3 off\n");
+    simTicks(200);
+    EXPECT_TRUE(bsGetField(AC_TEN_CH_PORT_x_CURRENT_ERROR_Msk(2)));
+    EXPECT_TRUE(bsGetField(AC_TEN_CH_OFF_CURRENT_Msk));
+    EXPECT_FALSE(bsGetField(AC_TEN_CH_NO_CURRENT_Msk));
+
+    setAdcBufferChannelSquare(2, 0);
+    simTicks(200);
+    EXPECT_FALSE(bsGetField(ALL_CURRENT_ERRORS));
+}
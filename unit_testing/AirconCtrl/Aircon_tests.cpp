@@ -7,15 +7,26 @@
 #include <gtest/gtest.h>
 #include <gmock/gmock.h>
 
+extern "C" {
+    uint32_t _FlashAddrCal = 0;
+}
+
 /* Fakes */
 #include "fake_StmGpio.h"
+#include "fake_flashWriter.h"
+#include "fake_irDma.h"
 #include "fake_stm32xxxx_hal.h"
 #include "fake_USBprint.h"
 
 /* Real supporting units */
 #include "transmitterIR.c"
+#include "irReceiver.c"
+#include "irLearn.c"
+#include "printSnapshot.c"
 #include "CAProtocol.c"
 #include "CAProtocolStm.c"
+#include "flashRecord.c"
+#include "flashWriter.c"
 
 /* UUT */
 #include "airconCtrl.c"
@@ -24,6 +35,7 @@ using ::testing::AnyOf;
 using ::testing::AllOf;
 using ::testing::Contains;
 using ::testing::ElementsAre;
+using ::testing::HasSubstr;
 using ::testing::IsEmpty;
 using namespace std;
 
@@ -43,6 +55,7 @@ class AirconBoard: public ::testing::Test
             HAL_otpWrite(&bi);
             forceTick(0);
             hostUSBConnect();
+            fakeFlashWriterInit(ERASE_MS);
         }
 
         void writeAcMessage(const char * msg)
@@ -56,10 +69,12 @@ class AirconBoard: public ::testing::Test
             for(int i = tickCounter + 1; i <= tickCounter + numTicks; i++) 
             {
                 forceTick(i);
-                if(i != 0 && (i % 100 == 0)) {
-                    HAL_TIM_PeriodElapsedCallback(&hlooptim);
-                }
-                airconCtrlLoop(bootMsg);
+                fakeFlashTick([this, i] {
+                    if(i != 0 && (i % 100 == 0)) {
+                        HAL_TIM_PeriodElapsedCallback(&hlooptim);
+                    }
+                    airconCtrlLoop(bootMsg);
+                });
             }
             tickCounter = tickCounter + numTicks;
         }
@@ -70,6 +85,102 @@ class AirconBoard: public ::testing::Test
             }
         }
 
+        /* Checks one period of the signal timer. The mark must be a whole number of carrier 
+        ** periods, as close as possible to the interval it is given for */
+        void expectTiming(const IrTiming& t, uint32_t period, uint32_t interval)
+        {
+            EXPECT_EQ(t.arr, period);
+            EXPECT_EQ(t.reserved, 0);
+            EXPECT_EQ(t.ccr % CARRIER_MARK_STEP, 0);
+            EXPECT_LE(abs((int) t.ccr - (int) interval), CARRIER_MARK_STEP / 2);
+            EXPECT_LT(t.ccr, t.arr);
+        }
+
+        /* Checks a frame from index 'idx' of the last transmission, and returns the index after 
+        ** it */
+        size_t expectFrame(const vector<IrTiming>& t, size_t idx, const vector<uint32_t>& words, 
+                           bool isAC2, uint32_t gap)
+        {
+            int lenBits = !isAC2 ? MSG_LEN_BITS : AC2_MSG_LEN_BITS;
+            EXPECT_GE(t.size(), idx + lenBits + 3);
+            if (t.size() < idx + lenBits + 3) {
+                return t.size();
+            }
+
+            !isAC2 ? expectTiming(t[idx++], START_BIT_ARR, START_BIT_CCR) :
+                     expectTiming(t[idx++], START_BIT_ARR_AC2, START_BIT_CCR_AC2);
+
+            for (int bit = 0; bit < lenBits; bit++) {
+                bool isHigh = words[bit / 32] & (1UL << (31 - bit % 32));
+                if (!isAC2) {
+                    isHigh ? expectTiming(t[idx++], HIGH_BIT_ARR, HIGH_BIT_CCR) :
+                             expectTiming(t[idx++], LOW_BIT_ARR, LOW_BIT_CCR);
+                }
+                else {
+                    isHigh ? expectTiming(t[idx++], HIGH_BIT_ARR_AC2, HIGH_BIT_CCR_AC2) :
+                             expectTiming(t[idx++], LOW_BIT_ARR_AC2, LOW_BIT_CCR_AC2);
+                }
+            }
+
+            /* Stop mark and silence */
+            !isAC2 ? expectTiming(t[idx++], LOW_BIT_ARR, LOW_BIT_CCR) :
+                     expectTiming(t[idx++], LOW_BIT_ARR_AC2, LOW_BIT_CCR_AC2);
+            EXPECT_EQ(t[idx].arr, gap);
+            EXPECT_EQ(t[idx].ccr, 0);
+            return idx + 1;
+        }
+
+        /* Words of a command for the second aircon remote, in the order they are sent */
+        vector<uint32_t> ac2Words(uint16_t fan, uint16_t temp)
+        {
+            return {((uint32_t) AC2_TEMP_COMMAND << 16) | fan, (uint32_t) temp << 16};
+        }
+
+        /* Checks the whole last transmission: the first remote's frames followed by the second 
+        ** remote's pairs of frames */
+        void expectTransmission(const vector<uint32_t>& ac1, const vector<uint32_t>& ac2)
+        {
+            vector<IrTiming> t = fakeIrDmaTimings();
+            ASSERT_EQ(t.size(), IR_MAX_TIMINGS);
+
+            size_t idx = 0;
+            for (int i = 0; i < NUM_COMMAND_REPEATS; i++) {
+                idx = expectFrame(t, idx, ac1, false, FRAME_GAP_ARR);
+            }
+            for (int i = 0; i < NUM_COMMAND_REPEATS; i++) {
+                idx = expectFrame(t, idx, ac2, true, START_BIT_REST_AC2);
+                idx = expectFrame(t, idx, ac2, true, FRAME_GAP_ARR);
+            }
+            EXPECT_EQ(idx, t.size());
+        }
+
+        /* Generates the edges of the IR receiver for the periods [from, to) of a transmission, 
+        ** then runs the loop once the receiver has been silent for long enough. The edges in 
+        ** 'missed' (counted from the first edge) are not seen by the receiver */
+        void receiveIR(const vector<IrTiming>& t, size_t from, size_t to, vector<int> missed = {})
+        {
+            uint32_t tick = rxTick;
+            int edge = 0;
+            for (size_t i = from; i < to; i++) {
+                /* Both edges of the mark, if there is one */
+                for (uint32_t at : {tick, tick + t[i].ccr / LEARNT_TICK_COUNTS}) {
+                    hctxtim.Instance->CNT = (uint16_t) at;
+                    bool isMissed = find(missed.begin(), missed.end(), edge++) != missed.end();
+                    if (t[i].ccr != 0 && !isMissed) {
+                        HAL_GPIO_EXTI_Callback(GPIO_PIN_7);
+                    }
+                }
+                tick += t[i].arr / LEARNT_TICK_COUNTS;
+
+                /* The main loop runs during the burst too */
+                airconCtrlLoop(bootMsg);
+            }
+
+            rxTick = tick + IR_RX_GAP_TICKS + 1;
+            hctxtim.Instance->CNT = (uint16_t) rxTick;
+            airconCtrlLoop(bootMsg);
+        }
+
         /*******************************************************************************************
         ** MEMBERS
         *******************************************************************************************/
@@ -90,14 +201,26 @@ class AirconBoard: public ::testing::Test
         };
 
         TIM_HandleTypeDef hlooptim = {
-            .Instance = TIM2,
+            .Instance = TIM5,
         };
         TIM_HandleTypeDef hctxtim = {
             .Instance = TIM1,
         };
         WWDG_HandleTypeDef hwwdg;
+        TIM_HandleTypeDef hcarrier1 = {
+            .Instance = TIM4,
+        };
+        TIM_HandleTypeDef hcarrier2 = {
+            .Instance = TIM3,
+        };
+        TIM_HandleTypeDef hsignaltim = {
+            .Instance = TIM2,
+        };
+        static const int ERASE_MS = 250;   // 16K sector
+
         const char * bootMsg = "Boot Unit Test";
         int tickCounter = 0;
+        uint32_t rxTick = 0;
 };
 
 /***************************************************************************************************
@@ -177,3 +300,200 @@ TEST_F(AirconBoard, printSerial)
         "PCB Version: 1.8\r"
     ));
 }
+
+TEST_F(AirconBoard, temperatureFrames) 
+{
+    airconCtrlInit(&hctxtim, &hlooptim, &hwwdg);
+    initTransmitterIR(&hcarrier1, &hcarrier2, &hsignaltim);
+    airconCtrlLoop(bootMsg);
+    writeAcMessage("temp 22\n");
+
+    EXPECT_EQ(fakeIrDmaStarts(), 1);
+    expectTransmission({IR_ADDRESS, TEMP_22, FAN_HIGH, CRC22}, 
+                       ac2Words(AC2_FAN_MODE_2, AC2_TEMP_22));
+
+    int temp = 0;
+    getACStates(&temp);
+    EXPECT_EQ(temp, 22);
+
+    /* A new command replaces the transmission in progress, which is stopped before its frames are 
+    ** overwritten */
+    ASSERT_TRUE(irDmaIsBusy());
+    writeAcMessage("temp 30\n");
+    EXPECT_EQ(fakeIrDmaStarts(), 2);
+    EXPECT_FALSE(fakeIrDmaChangedWhileBusy());
+    expectTransmission({IR_ADDRESS, TEMP_30, FAN_HIGH, CRC30}, 
+                       ac2Words(AC2_FAN_MODE_2, AC2_TEMP_30));
+}
+
+TEST_F(AirconBoard, offFrames) 
+{
+    airconCtrlInit(&hctxtim, &hlooptim, &hwwdg);
+    initTransmitterIR(&hcarrier1, &hcarrier2, &hsignaltim);
+    airconCtrlLoop(bootMsg);
+    writeAcMessage("off\n");
+
+    EXPECT_EQ(fakeIrDmaStarts(), 1);
+    expectTransmission({IR_ADDRESS, AC_OFF, FAN_HIGH, CRC_OFF}, 
+                       ac2Words(AC2_OFF, AC2_OFF_SWING_END));
+}
+
+TEST_F(AirconBoard, lowestTemperatureFrames) 
+{
+    airconCtrlInit(&hctxtim, &hlooptim, &hwwdg);
+    initTransmitterIR(&hcarrier1, &hcarrier2, &hsignaltim);
+    airconCtrlLoop(bootMsg);
+    writeAcMessage("temp 5\n");
+
+    /* The second aircon goes to its lowest setting instead */
+    EXPECT_EQ(fakeIrDmaStarts(), 1);
+    expectTransmission({IR_ADDRESS, TEMP_5, FAN_HIGH_5, CRC5}, 
+                       ac2Words(AC2_FAN_MODE_2, AC2_TEMP_17));
+
+    int temp = 0;
+    getACStates(&temp);
+    EXPECT_EQ(temp, 5);
+}
+
+TEST_F(AirconBoard, invalidTemperature) 
+{
+    airconCtrlInit(&hctxtim, &hlooptim, &hwwdg);
+    initTransmitterIR(&hcarrier1, &hcarrier2, &hsignaltim);
+    airconCtrlLoop(bootMsg);
+    writeAcMessage("temp 26\n");
+
+    EXPECT_EQ(fakeIrDmaStarts(), 0);
+}
+
+TEST_F(AirconBoard, receiveCode) 
+{
+    airconCtrlInit(&hctxtim, &hlooptim, &hwwdg);
+    initTransmitterIR(&hcarrier1, &hcarrier2, &hsignaltim);
+    airconCtrlLoop(bootMsg);
+
+    /* First frame of the first aircon remote */
+    updateTemperatureIR(22);
+    vector<IrTiming> t = fakeIrDmaTimings();
+    receiveIR(t, 0, MSG_LEN_BITS + 3);
+
+    EXPECT_READ_USB(Contains(AllOf(HasSubstr("IR code: 1x112 bits"), 
+                                   HasSubstr("c4d3648000240060a00000000022"))));
+
+    /* Missed edges swap marks and spaces */
+    receiveIR(t, 0, MSG_LEN_BITS + 3, {21, 40});
+    EXPECT_READ_USB(Contains(HasSubstr("IR code: not recognised")));
+}
+
+TEST_F(AirconBoard, learnAndSendCode) 
+{
+    airconCtrlInit(&hctxtim, &hlooptim, &hwwdg);
+    initTransmitterIR(&hcarrier1, &hcarrier2, &hsignaltim);
+    airconCtrlLoop(bootMsg);
+
+    /* First pair of frames of the second aircon remote */
+    updateTemperatureIR(22);
+    vector<IrTiming> sent = fakeIrDmaTimings();
+    size_t ac2Start = NUM_COMMAND_REPEATS * (MSG_LEN_BITS + 3);
+    size_t ac2Len   = 2 * (AC2_MSG_LEN_BITS + 3);
+
+    writeAcMessage("learn 3\n");
+    receiveIR(sent, ac2Start, ac2Start + ac2Len);
+    EXPECT_READ_USB(AllOf(Contains(AllOf(HasSubstr("IR code: 2x48 bits"), 
+                                         HasSubstr("b24d3fc0708fb24d3fc0708f"))),
+                          Contains("Learnt code 3")));
+    EXPECT_EQ(learnt.codes[3].frames, 2);
+
+    /* The learnt code is sent with the timings it was received with, give or take a tick of the 
+    ** receiver and the rounding of the marks. The stop marks and the silences after them are 
+    ** sent as one period */
+    vector<IrTiming> expected;
+    for (size_t i = ac2Start; i < ac2Start + ac2Len; i++) {
+        if (sent[i].ccr == 0) {
+            expected.back().arr += sent[i].arr;
+        }
+        else {
+            expected.push_back(sent[i]);
+        }
+    }
+
+    writeAcMessage("send 3\n");
+    EXPECT_FALSE(fakeIrDmaChangedWhileBusy());
+    vector<IrTiming> t = fakeIrDmaTimings();
+    ASSERT_EQ(t.size(), NUM_COMMAND_REPEATS * expected.size());
+
+    const int TOLERANCE = 2 * LEARNT_TICK_COUNTS + CARRIER_MARK_STEP / 2;
+    for (size_t i = 0; i < t.size(); i++) {
+        const IrTiming& e = expected[i % expected.size()];
+
+        EXPECT_EQ(t[i].ccr % CARRIER_MARK_STEP, 0);
+        EXPECT_LE(abs((int) t[i].ccr - (int) e.ccr), TOLERANCE) << i;
+
+        /* Except for the silence at the end of the burst */
+        if ((i + 1) % expected.size() != 0) {
+            EXPECT_LE(abs((int) t[i].arr - (int) e.arr), TOLERANCE) << i;
+        }
+        else {
+            EXPECT_GE(t[i].arr, FRAME_GAP_ARR);
+        }
+    }
+
+    /* Empty slots are not sent */
+    writeAcMessage("send 4\n");
+    EXPECT_EQ(fakeIrDmaStarts(), 2);
+}
+
+TEST_F(AirconBoard, learntCodeStored) 
+{
+    airconCtrlInit(&hctxtim, &hlooptim, &hwwdg);
+    initTransmitterIR(&hcarrier1, &hcarrier2, &hsignaltim);
+    airconCtrlLoop(bootMsg);
+
+    updateTemperatureIR(22);
+    vector<IrTiming> sent = fakeIrDmaTimings();
+    writeAcMessage("learn 3\n");
+    receiveIR(sent, 0, MSG_LEN_BITS + 3);
+    EXPECT_READ_USB(Contains("Learnt code 3"));
+
+    /* Written by the loop, which does not run during the erase */
+    EXPECT_TRUE(flashWriterIsBusy());
+    goToTick(ERASE_MS - 1);
+    EXPECT_TRUE(flashWriterIsBusy());
+
+    goToTick(ERASE_MS + 10);
+    EXPECT_FALSE(flashWriterIsBusy());
+
+    /* Loaded again after a restart */
+    memset(&learnt, 0, sizeof(learnt));
+    airconCtrlInit(&hctxtim, &hlooptim, &hwwdg);
+    EXPECT_EQ(learnt.codes[3].frames, 1);
+    EXPECT_EQ(learnt.codes[3].frameBits, 112);
+}
+
+TEST_F(AirconBoard, learnCodeWithoutHeader) 
+{
+    /* 16 bits of 0x5A3C, with some jitter */
+    vector<uint16_t> d;
+    uint16_t word = 0x5A3C;
+    for (int i = 0; i < 16; i++) {
+        d.push_back(56 + i % 3);
+        d.push_back((word & (0x8000 >> i)) ? 168 - i % 4 : 56 + i % 2);
+    }
+    d.push_back(57);
+
+    IrLearntCode code;
+    ASSERT_TRUE(irLearnDecode(d.data(), d.size(), &code));
+    EXPECT_EQ(code.frames, 1);
+    EXPECT_EQ(code.frameBits, 16);
+    EXPECT_EQ(code.headerMark, 0);
+    EXPECT_NEAR(code.bitMark, 57, 1);
+    EXPECT_NEAR(code.zeroSpace, 56, 1);
+    EXPECT_NEAR(code.oneSpace, 166, 1);
+    EXPECT_EQ(code.bits[0], 0x5A);
+    EXPECT_EQ(code.bits[1], 0x3C);
+
+    /* All spaces the same length: not a pulse distance code */
+    for (size_t i = 1; i < d.size(); i += 2) {
+        d[i] = 56;
+    }
+    EXPECT_FALSE(irLearnDecode(d.data(), d.size(), &code));
+}
@@ -0,0 +1,90 @@
+/*!
+** @file   fake_irDma.cpp
+** @brief  Fake of the DMA driven IR transmission
+** @date   18/10/2026
+**
+** Keeps a copy of the sequence of each transmission. A transmission is in progress until it is
+** completed with fakeIrDmaComplete or stopped with irDmaStop. The array given to irDmaStart is
+** checked against the copy whenever the DMA would still be reading it.
+*/
+
+#include <string.h>
+
+
+#include "fake_irDma.h"
+
+/***************************************************************************************************
+** PRIVATE VARIABLES
+***************************************************************************************************/
+
+static std::vector<IrTiming> timings;
+static const IrTiming* source = NULL;
+static bool busy = false;
+static int starts = 0;
+static bool isChangedWhileBusy = false;
+
+/***************************************************************************************************
+** PRIVATE FUNCTION DEFINITIONS
+***************************************************************************************************/
+
+static void checkSource() {
+    if (busy && memcmp(source, timings.data(), timings.size() * sizeof(IrTiming)) != 0) {
+        isChangedWhileBusy = true;
+    }
+}
+
+/***************************************************************************************************
+** FAKE FUNCTION DEFINITIONS
+***************************************************************************************************/
+
+void irDmaInit(TIM_HandleTypeDef* signal, TIM_HandleTypeDef* carrier1, TIM_HandleTypeDef* carrier2) {
+    timings.clear();
+    source = NULL;
+    busy   = false;
+    starts = 0;
+    isChangedWhileBusy = false;
+}
+
+bool irDmaStart(const IrTiming* t, uint32_t n) {
+    checkSource();
+    if (n < 2) {
+        return false;
+    }
+    timings.assign(t, t + n);
+    source = t;
+    busy   = true;
+    starts++;
+    return true;
+}
+
+void irDmaStop() {
+    checkSource();
+    busy = false;
+}
+
+bool irDmaIsBusy() {
+    checkSource();
+    return busy;
+}
+
+/***************************************************************************************************
+** PUBLIC FUNCTION DEFINITIONS
+***************************************************************************************************/
+
+std::vector<IrTiming> fakeIrDmaTimings() {
+    return timings;
+}
+
+int fakeIrDmaStarts() {
+    return starts;
+}
+
+void fakeIrDmaComplete() {
+    checkSource();
+    busy = false;
+}
+
+bool fakeIrDmaChangedWhileBusy() {
+    checkSource();
+    return isChangedWhileBusy;
+}
@@ -0,0 +1,31 @@
+/*!
+** @file   fake_irDma.h
+** @brief  Fake of the DMA driven IR transmission
+** @date   18/10/2026
+*/
+
+#ifndef FAKE_IR_DMA_H_
+#define FAKE_IR_DMA_H_
+
+#include <stdint.h>
+#include <vector>
+
+#include "irDma.h"
+
+/***************************************************************************************************
+** PUBLIC FUNCTION DECLARATIONS
+***************************************************************************************************/
+
+/* Copy of the sequence given to the last call of irDmaStart */
+std::vector<IrTiming> fakeIrDmaTimings();
+
+/* Number of transmissions started since irDmaInit */
+int fakeIrDmaStarts();
+
+/* Finishes the transmission in progress */
+void fakeIrDmaComplete();
+
+/* True if an array was changed while the DMA could still be reading it */
+bool fakeIrDmaChangedWhileBusy();
+
+#endif /* FAKE_IR_DMA_H_ */
@@ -17,6 +17,12 @@ extern "C" {
 #include "fake_stm32xxxx_hal.h"
 #include "fake_StmGpio.h"
 #include "fake_USBprint.h"
+#include "fake_flashWriter.h"
+
+/* Real supporting units */
+#include "piecewiseLinear.c"
+#include "flashRecord.c"
+#include "flashWriter.c"
 
 /* UUT */
 #include "calibration.c"
@@ -36,7 +42,7 @@ class AnalogCalibrationTest: public ::testing::Test
         *******************************************************************************************/
         AnalogCalibrationTest()
         {
-
+            fakeFlashWriterInit();
         }
     
         /*******************************************************************************************
@@ -222,6 +228,17 @@ TEST_F(AnalogCalibrationTest, testCalibrateSensor)
     EXPECT_NEAR(cal.sensorCalVal[(port5-1)*2+1], beta-1, 1e-5);
     EXPECT_EQ(cal.measurementType[port5-1], 1);
 
+    // Each port of a batch gets its own measurement type
+    CACalibration mixedCalibration[2] = {{port4, alpha, beta, 0}, {port5, alpha, beta, 1}};
+    calibrateSensor(2, mixedCalibration, &cal, sizeof(cal));
+    EXPECT_EQ(cal.measurementType[port4-1], 0);
+    EXPECT_EQ(cal.measurementType[port5-1], 1);
+
+    CACalibration swappedCalibration[2] = {{port4, alpha, beta, 1}, {port5, alpha, beta, 0}};
+    calibrateSensor(2, swappedCalibration, &cal, sizeof(cal));
+    EXPECT_EQ(cal.measurementType[port4-1], 1);
+    EXPECT_EQ(cal.measurementType[port5-1], 0);
+
     // Reset calibration
     CACalibration defaultCal[NO_CALIBRATION_CHANNELS] = {0};
     for (int i = 0; i<NO_CALIBRATION_CHANNELS; i++)
@@ -272,4 +289,64 @@ TEST_F(AnalogCalibrationTest, testCalibrationRW)
     // The calibration should read out the updated values
     calibrationRW(false, &cal, sizeof(cal));
     EXPECT_FLUSH_USB(Contains("Calibration: CAL 1,0.5000000000,1.5000000000,1 2,1.0000000000,0.0000000000,0 3,1.0000000000,0.0000000000,0 4,1.0000000000,0.0000000000,0 5,1.0000000000,0.0000000000,0 6,1.0000000000,0.0000000000,0\r"));
-}
\ No newline at end of file
+}
+TEST_F(AnalogCalibrationTest, testCalibrationTable)
+{
+    calibrationInit(&hcrc, &cal, sizeof(cal));
+    for (int i = 0; i<NO_CALIBRATION_CHANNELS; i++) 
+    { 
+        EXPECT_FALSE(pwlIsValid(&cal.sensorTable[i]));
+    }
+
+    // Points of port 2, in any order, and a point of port 7 which does not exist
+    CACalibration points[4] = {{2, 10.0, 100.0, CAL_TABLE_POINT}, {2, 0.0, -5.0, CAL_TABLE_POINT},
+                               {2, 5.0, 20.0, CAL_TABLE_POINT}, {7, 1.0, 1.0, CAL_TABLE_POINT}};
+    calibrateSensor(4, points, &cal, sizeof(cal));
+
+    ASSERT_TRUE(pwlIsValid(&cal.sensorTable[1]));
+    EXPECT_FLOAT_EQ(pwlEval(&cal.sensorTable[1], 2.5), 7.5);
+    EXPECT_FLOAT_EQ(pwlEval(&cal.sensorTable[1], 7.5), 60.0);
+    EXPECT_NEAR(cal.sensorCalVal[2], 1.0, 1e-5);
+
+    // The table is printed as the CAL command which sets it
+    calibrationRW(false, &cal, sizeof(cal));
+    EXPECT_FLUSH_USB(Contains("Calibration table: CAL 2,0.0000000000,-5.0000000000,4 2,5.0000000000,20.0000000000,4 2,10.0000000000,100.0000000000,4\r"));
+
+    // The table is stored in flash, in the background
+    fakeFlashWriterFlush();
+    FlashCalibration stored = {0};
+    calibrationInit(&hcrc, &stored, sizeof(stored));
+    EXPECT_EQ(memcmp(&stored.sensorTable[1], &cal.sensorTable[1], sizeof(PwlTable)), 0);
+
+    // A new slope and offset replace the table
+    CACalibration linear[1] = {{2, 2.0, 1.0, 0}};
+    calibrateSensor(1, linear, &cal, sizeof(cal));
+    EXPECT_FALSE(pwlIsValid(&cal.sensorTable[1]));
+
+    // A table can be cleared
+    calibrateSensor(2, points, &cal, sizeof(cal));
+    CACalibration clear[1] = {{2, 0.0, 0.0, CAL_TABLE_CLEAR}};
+    calibrateSensor(1, clear, &cal, sizeof(cal));
+    EXPECT_EQ(cal.sensorTable[1].noOfPoints, 0U);
+}
+
+TEST_F(AnalogCalibrationTest, testCalibrationWithoutTables)
+{
+    // A calibration stored before the tables were added is still used
+    calibrationInit(&hcrc, &cal, sizeof(cal));
+    cal.sensorCalVal[0] = 3.0;
+    cal.sensorCalVal[1] = -1.0;
+    ASSERT_EQ(writeToFlashCRC(&hcrc, (uint32_t)FLASH_ADDR_CAL, (uint8_t*)&cal,
+                              offsetof(FlashCalibration, sensorTable)), 0);
+
+    FlashCalibration stored;
+    memset(&stored, 0xff, sizeof(stored));
+    calibrationInit(&hcrc, &stored, sizeof(stored));
+
+    EXPECT_NEAR(stored.sensorCalVal[0], 3.0, 1e-5);
+    EXPECT_NEAR(stored.sensorCalVal[1], -1.0, 1e-5);
+    for (int i = 0; i<NO_CALIBRATION_CHANNELS; i++) 
+    { 
+        EXPECT_EQ(stored.sensorTable[i].noOfPoints, 0U);
+    }
+}
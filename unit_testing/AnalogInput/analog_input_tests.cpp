@@ -19,6 +19,9 @@ extern "C" {
 #include "fake_stm32xxxx_hal.h"
 #include "fake_StmGpio.h"
 #include "fake_USBprint.h"
+#include "fake_digipotBus.h"
+#include "fake_cycleCount.h"
+#include "fake_flashWriter.h"
 
 /* Real supporting units */
 #include "CAProtocol.c"
@@ -27,13 +30,21 @@ extern "C" {
 #include "ADCmonitor.c"
 #include "MCP4531.c"
 #include "uptime.c"
+#include "cycleCount.c"
+#include "digipotQueue.c"
+#include "decimator.c"
+#include "piecewiseLinear.c"
+#include "flashRecord.c"
+#include "flashWriter.c"
 
 /* UUT */
 #include "analog_input.c"
 
 using ::testing::Contains;
 using ::testing::ElementsAre;
+using ::testing::HasSubstr;
 using ::testing::IsSupersetOf;
+using ::testing::Not;
 using namespace std;
 
 /***************************************************************************************************
@@ -106,6 +117,10 @@ class AnalogInputTest: public CaBoardUnitTest
         *******************************************************************************************/
         AnalogInputTest() : CaBoardUnitTest(&analogInputLoop, AnalogInput, {LATEST_MAJOR, LATEST_MINOR}) {
             hadc.Init.NbrOfConversion = 8;
+            fakeFlashWriterInit();
+            fakeCycleCountInit();
+            decimCycles = {};
+            calCycles   = {};
 
             /* Add virtual potentiometers */
             for(int i = 0; i < NO_CALIBRATION_CHANNELS; i++) {
@@ -120,15 +135,17 @@ class AnalogInputTest: public CaBoardUnitTest
         }
 
         void simTick() {
-            if(tickCounter != 0 && (tickCounter % 100 == 0)) {
-                if(tickCounter % 200 == 0) {
-                    HAL_ADC_ConvCpltCallback(&hadc);
+            fakeFlashTick([this] {
+                if(tickCounter != 0 && (tickCounter % 100 == 0)) {
+                    if(tickCounter % 200 == 0) {
+                        HAL_ADC_ConvCpltCallback(&hadc);
+                    }
+                    else {
+                        HAL_ADC_ConvHalfCpltCallback(&hadc);
+                    }
                 }
-                else {
-                    HAL_ADC_ConvHalfCpltCallback(&hadc);
-                }
-            }
-            analogInputLoop(bootMsg);
+                analogInputLoop(bootMsg);
+            });
         }
 
         void setAdcChannelBuffer(int channel, int value) {
@@ -138,6 +155,24 @@ class AnalogInputTest: public CaBoardUnitTest
             }
         }
 
+        /* Fills a channel with the ADC value of a voltage on the range set by the digipot */
+        void setInputVoltage(int channel, double volts) {
+            double range = digipotIdxToMeasureVoltage(digipots[channel]->wipers[0]);
+            setAdcChannelBuffer(channel, min(lround(ADC_MAX * volts / range), (long)ADC_MAX));
+        }
+
+        /* Runs the auto range on a signal for a number of buffers. Returns true if any was flagged
+        ** as settling */
+        bool autoRangeBuffers(int channel, double volts, int buffers) {
+            bool settling = false;
+            for (int i = 0; i < buffers; i++) {
+                setInputVoltage(channel, volts);
+                simTicks(100);
+                settling |= bsGetField(PORT_SETTLING_Msk(channel));
+            }
+            return settling;
+        }
+
         /*******************************************************************************************
         ** MEMBERS
         *******************************************************************************************/
@@ -222,6 +257,12 @@ TEST_F(AnalogInputTest, testAnalogInputStatus) {
 
 TEST_F(AnalogInputTest, testAnalogInputStatusDef) {
     statusDefPrintoutTest(sst, "0x7e003fc0,System errors\r", {
+        "0x00080000,Port 6 range settling\r", 
+        "0x00040000,Port 5 range settling\r", 
+        "0x00020000,Port 4 range settling\r", 
+        "0x00010000,Port 3 range settling\r", 
+        "0x00008000,Port 2 range settling\r", 
+        "0x00004000,Port 1 range settling\r", 
         "0x00002000,Error I2C Channel 6\r", 
         "0x00001000,Error I2C Channel 5\r", 
         "0x00000800,Error I2C Channel 4\r", 
@@ -239,6 +280,22 @@ TEST_F(AnalogInputTest, testAnalogInputStatusDef) {
     });
 }
 
+TEST_F(AnalogInputTest, testAnalogInputCycles) {
+    /* 1000 cycles for the filter and for the calibration, within 5 ms at 16 MHz */
+    fakeCycleCountInit(1000);
+    simTicks(100);
+    writeBoardMessage("cycles\n");
+    EXPECT_FLUSH_USB(Contains("Filter: 1000 cycles (max 1000), calibration: 1000 cycles (max 1000), budget: 80000 cycles\r"));
+    writeBoardMessage("Status\n");
+    EXPECT_FLUSH_USB(Not(Contains(HasSubstr("Filter and calibration"))));
+
+    /* Over the budget, which the status reports */
+    fakeCycleCountInit(50000);
+    simTicks(100);
+    writeBoardMessage("Status\n");
+    EXPECT_FLUSH_USB(Contains("Filter and calibration took up to 100000 cycles of 80000\r"));
+}
+
 TEST_F(AnalogInputTest, testAnalogInputSerial) {
     serialPrintoutTest(sst, "AnalogInput", 
         "Calibration: CAL 1,1.0000000000,0.0000000000,0 2,1.0000000000,0.0000000000,0 3,1.0000000000,0.0000000000,0 4,1.0000000000,0.0000000000,0 5,1.0000000000,0.0000000000,0 6,1.0000000000,0.0000000000,0\r");
@@ -328,3 +385,191 @@ TEST_F(AnalogInputTest, testAnalogInputMeasurementRange) {
         EXPECT_NEAR(channel, 2.561, 1E-3);
     }
 }
+
+TEST_F(AnalogInputTest, testAnalogInputAutoRangeDown) {
+    simTicks(1);
+    writeBoardMessage("p1 inmax auto\n");
+
+    /* 0.4V on the 5.1V range is at 8 % of full scale. The range goes down to put it at ~70 % */
+    EXPECT_TRUE(autoRangeBuffers(0, 0.4, 10));
+    EXPECT_FALSE(bsGetField(PORT_SETTLING_Msk(0)));
+
+    double range = digipotIdxToMeasureVoltage(digipots[0]->wipers[0]);
+    EXPECT_GE(0.4 / range, AUTO_RANGE_LOW);
+    EXPECT_LE(0.4 / range, AUTO_RANGE_HIGH);
+    EXPECT_FLOAT_EQ(measure_pots[0].voltage_range, range);
+    EXPECT_EQ(digipots[1]->wipers[0], 53);
+
+    /* The value is rescaled to the new range */
+    writeBoardMessage("LOG p1\n");
+    (void)hostUSBread(true);
+    setInputVoltage(0, 0.4);
+    simTicks(100);
+    vector<string> lines = hostUSBread(true);
+    vector<string> channels = getChannelsFromLine(lines[0]);
+    EXPECT_NEAR(stod(channels[0]), 0.4, 2E-3);
+
+    /* A signal within the band does not change the range */
+    uint16_t pos = digipots[0]->wipers[0];
+    EXPECT_FALSE(autoRangeBuffers(0, 0.45, 5));
+    EXPECT_EQ(digipots[0]->wipers[0], pos);
+}
+
+TEST_F(AnalogInputTest, testAnalogInputAutoRangeUp) {
+    simTicks(1);
+    writeBoardMessage("p1 inmax auto\n");
+
+    /* 12V clips the 5.1V range, so the range is doubled until the signal fits */
+    EXPECT_TRUE(autoRangeBuffers(0, 12.0, 20));
+    EXPECT_FALSE(bsGetField(PORT_SETTLING_Msk(0)));
+
+    double range = digipotIdxToMeasureVoltage(digipots[0]->wipers[0]);
+    EXPECT_GE(12.0 / range, AUTO_RANGE_LOW);
+    EXPECT_LE(12.0 / range, AUTO_RANGE_HIGH);
+
+    /* Above the maximum range the range stays at the maximum */
+    EXPECT_TRUE(autoRangeBuffers(0, 30.0, 20));
+    EXPECT_EQ(digipots[0]->wipers[0], measureVoltageToDigipotIdx(MAX_VOLTAGE));
+    EXPECT_FALSE(bsGetField(PORT_SETTLING_Msk(0)));
+}
+
+TEST_F(AnalogInputTest, testAnalogInputAutoRangeManual) {
+    simTicks(1);
+    writeBoardMessage("p1 inmax auto\n");
+    EXPECT_TRUE(autoRangeBuffers(0, 0.4, 10));
+
+    statusPrintoutTest(sst, {
+        "The board is operating normally.\r",
+        "Port 1 measures voltage [0-0.6V], auto range\r", 
+        "Port 2 measures voltage [0-5V]\r", 
+        "Port 3 measures voltage [0-5V]\r", 
+        "Port 4 measures voltage [0-5V]\r", 
+        "Port 5 measures voltage [0-5V]\r", 
+        "Port 6 measures voltage [0-5V]\r", 
+    });
+
+    /* A manual range ends the auto ranging, but is still flagged while it changes */
+    writeBoardMessage("p1 inmax 10.1\n");
+    EXPECT_TRUE(autoRangeBuffers(0, 0.4, 10));
+    EXPECT_EQ(digipots[0]->wipers[0], 104);
+    EXPECT_FALSE(bsGetField(PORT_SETTLING_Msk(0)));
+
+    /* Only voltage inputs can be auto ranged */
+    const CACalibration calibration[1] = {2, 0.00188, -1.79, 1};
+    calibrateSensorOrBoard(1, calibration);
+    writeBoardMessage("p2 inmax auto\n");
+    simTicks(1);
+    EXPECT_FALSE(autoRange[1]);
+    EXPECT_FLUSH_USB(Contains("MISREAD: p2 inmax auto\r"));
+}
+
+TEST_F(AnalogInputTest, testAnalogInputDigipotTargetsCoalesce) {
+    simTicks(1);
+    (void)fakeDigipotBusTakeWrites();
+
+    /* The second target replaces the first one before it is reached, so the wiper goes straight
+    ** on to it */
+    writeBoardMessage("p1 volt 24\n");
+    simTicks(5);
+    writeBoardMessage("p1 volt 10.1\n");
+    simTicks(100);
+
+    EXPECT_EQ(digipots[0]->wipers[1], 102);
+    EXPECT_TRUE(digipotQueueIsSettled(POWER_POT(0)));
+    EXPECT_EQ(fakeDigipotBusTakeWrites(), 102 - 52);
+}
+
+TEST_F(AnalogInputTest, testAnalogInputDigipotStepsOnTimer) {
+    simTicks(1);
+    writeBoardMessage("p2 volt 10.1\n");
+    uint16_t pos = digipots[1]->wipers[1];
+
+    /* Running the loop again within the same millisecond does not step the wiper */
+    (void)fakeDigipotBusTakeWrites();
+    for (int i = 0; i < 10; i++) {
+        analogInputLoop(bootMsg);
+    }
+    EXPECT_EQ(digipots[1]->wipers[1], pos);
+    EXPECT_EQ(fakeDigipotBusTakeWrites(), 0);
+
+    simTicks(1);
+    EXPECT_EQ(digipots[1]->wipers[1], pos + 1);
+}
+
+TEST_F(AnalogInputTest, testAnalogInputDigipotOneWritePerLoop) {
+    simTicks(1);
+
+    for (int i = 0; i < NO_CALIBRATION_CHANNELS; i++) {
+        char buf[100] = {0};
+        sprintf(buf, "p%d volt 10.1\n", (i+1));
+        writeBoardMessage(buf);
+        sprintf(buf, "p%d inmax 10.1\n", (i+1));
+        writeBoardMessage(buf);
+    }
+
+    /* 12 wipers moving 50 steps each, with at most one I2C write per pass of the main loop */
+    (void)fakeDigipotBusTakeWrites();
+    for (int j = 0; j < 2 * NO_CALIBRATION_CHANNELS * 51; j++) {
+        simTicks(1);
+        ASSERT_LE(fakeDigipotBusTakeWrites(), 1) << "Tick " << j;
+    }
+
+    for (int i = 0; i < NO_CALIBRATION_CHANNELS; i++) {
+        EXPECT_EQ(digipots[i]->wipers[0], 104) << "Channel " << i;
+        EXPECT_EQ(digipots[i]->wipers[1], 102) << "Channel " << i;
+        EXPECT_TRUE(digipotQueueIsSettled(MEASURE_POT(i))) << "Channel " << i;
+        EXPECT_TRUE(digipotQueueIsSettled(POWER_POT(i))) << "Channel " << i;
+    }
+}
+
+TEST_F(AnalogInputTest, testAnalogInputDigipotRetry) {
+    simTicks(1);
+
+    /* A failed write flags the channel, without blocking the others */
+    digipots[2]->setError(HAL_ERROR);
+    writeBoardMessage("p3 volt 10.1\n");
+    writeBoardMessage("p4 volt 10.1\n");
+    simTicks(60);
+
+    EXPECT_TRUE(bsGetField(I2C_ERROR_Msk(2)));
+    EXPECT_FALSE(bsGetField(I2C_ERROR_Msk(3)));
+    EXPECT_FALSE(digipotQueueIsSettled(POWER_POT(2)));
+    EXPECT_EQ(digipots[3]->wipers[1], 102);
+
+    /* Once the device answers again, the wiper is written straight to its target */
+    digipots[2]->setError(HAL_OK);
+    simTicks(DIGIPOT_RETRY_MS);
+
+    EXPECT_FALSE(bsGetField(I2C_ERROR_Msk(2)));
+    EXPECT_TRUE(digipotQueueIsSettled(POWER_POT(2)));
+    EXPECT_EQ(digipots[2]->wipers[1], 102);
+}
+
+TEST_F(AnalogInputTest, testAnalogInputDigipotTimeout) {
+    simTicks(1);
+
+    /* A write which never completes is aborted, and the wiper is flagged */
+    fakeDigipotBusSetHanging(true);
+    writeBoardMessage("p3 volt 10.1\n");
+    simTicks(DIGIPOT_TIMEOUT_MS + 5);
+
+    EXPECT_EQ(fakeDigipotBusAborts(), 1);
+    EXPECT_TRUE(digipotQueueHasFailed(POWER_POT(2)));
+    EXPECT_EQ(digipots[2]->wipers[1], 52);
+
+    /* The aborted write does not complete the next one, which really reaches the device */
+    fakeDigipotBusSetHanging(false);
+    writeBoardMessage("p4 volt 10.1\n");
+    simTicks(60);
+
+    EXPECT_EQ(digipots[2]->wipers[1], 52);
+    EXPECT_EQ(digipots[3]->wipers[1], 102);
+    EXPECT_TRUE(digipotQueueIsSettled(POWER_POT(3)));
+    EXPECT_FALSE(bsGetField(I2C_ERROR_Msk(3)));
+
+    /* The flagged wiper is written again, straight to its target */
+    simTicks(DIGIPOT_RETRY_MS);
+    EXPECT_EQ(fakeDigipotBusAborts(), 1);
+    EXPECT_TRUE(digipotQueueIsSettled(POWER_POT(2)));
+    EXPECT_EQ(digipots[2]->wipers[1], 102);
+}
@@ -0,0 +1,102 @@
+/*!
+** @file   fake_digipotBus.cpp
+** @brief  Fake of the interrupt driven digipot writes
+** @date   18/10/2026
+**
+** The data is written straight away to the devices added to the HAL fake, and the completion
+** interrupt is raised before the write returns, i.e. the fastest a real bus could answer. A bus
+** which hangs keeps the write in flight until it is aborted or released.
+*/
+
+#include <stddef.h>
+#include <string.h>
+
+#include "fake_stm32xxxx_hal.h"
+
+#include "digipotQueue.h"
+#include "fake_digipotBus.h"
+
+/***************************************************************************************************
+** PRIVATE VARIABLES
+***************************************************************************************************/
+
+static I2C_HandleTypeDef* bus = NULL;
+static int writes = 0;
+static int aborts = 0;
+static bool hanging = false;
+
+/* Write in flight on a hanging bus */
+static bool isPending = false;
+static uint16_t pendingAddr = 0;
+static uint8_t pendingData[4];
+static uint16_t pendingLen = 0;
+
+/***************************************************************************************************
+** PRIVATE FUNCTION DEFINITIONS
+***************************************************************************************************/
+
+static void complete(uint16_t addr, uint8_t* data, uint16_t len) {
+    if (HAL_I2C_Master_Transmit(bus, addr, data, len, 10) == HAL_OK) {
+        digipotQueueTxComplete();
+    }
+    else {
+        digipotQueueError();
+    }
+}
+
+/***************************************************************************************************
+** FAKED FUNCTION DEFINITIONS
+***************************************************************************************************/
+
+void digipotBusInit(I2C_HandleTypeDef* hi2c) {
+    bus       = hi2c;
+    writes    = 0;
+    aborts    = 0;
+    hanging   = false;
+    isPending = false;
+}
+
+int digipotBusWrite(uint16_t addr, uint8_t* data, uint16_t len) {
+    if (bus == NULL) {
+        return -1;
+    }
+
+    writes++;
+    if (hanging) {
+        isPending   = true;
+        pendingAddr = addr;
+        pendingLen  = (len < sizeof(pendingData)) ? len : sizeof(pendingData);
+        memcpy(pendingData, data, pendingLen);
+        return 0;
+    }
+
+    complete(addr, data, len);
+    return 0;
+}
+
+void digipotBusAbort() {
+    aborts++;
+    isPending = false;
+}
+
+/***************************************************************************************************
+** FAKE CONTROL FUNCTIONS
+***************************************************************************************************/
+
+void fakeDigipotBusSetHanging(bool isHanging) {
+    hanging = isHanging;
+    if (!hanging && isPending) {
+        isPending = false;
+        complete(pendingAddr, pendingData, pendingLen);
+    }
+}
+
+int fakeDigipotBusAborts() {
+    return aborts;
+}
+
+int fakeDigipotBusTakeWrites() {
+    int n  = writes;
+    writes = 0;
+    return n;
+}
@@ -0,0 +1,28 @@
+/*!
+** @file   fake_digipotBus.h
+** @brief  Fake of the interrupt driven digipot writes
+** @date   18/10/2026
+*/
+
+#ifndef FAKE_DIGIPOT_BUS_H_
+#define FAKE_DIGIPOT_BUS_H_
+
+#include <stdbool.h>
+
+#include "digipotBus.h"
+
+/***************************************************************************************************
+** PUBLIC FUNCTION DECLARATIONS
+***************************************************************************************************/
+
+/* Keeps the writes in flight, as if a device held the clock low. Releasing the bus completes a
+** write which has not been aborted, as its callback would on a real bus */
+void fakeDigipotBusSetHanging(bool isHanging);
+
+/* Number of writes aborted since the bus was initialised */
+int fakeDigipotBusAborts();
+
+/* Number of writes started since the last call */
+int fakeDigipotBusTakeWrites();
+
+#endif /* FAKE_DIGIPOT_BUS_H_ */
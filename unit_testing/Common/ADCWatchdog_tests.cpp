@@ -0,0 +1,207 @@
+/*!
+** @file   ADCWatchdog_tests.cpp
+** @date   18/10/2026
+*/
+
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <vector>
+
+/* UUT */
+#include "ADCWatchdog.c"
+
+using ::testing::ElementsAre;
+using namespace std;
+
+/***************************************************************************************************
+** TEST FIXTURES
+***************************************************************************************************/
+
+class ADCWatchdog: public ::testing::Test 
+{
+    protected:
+        /*******************************************************************************************
+        ** METHODS
+        *******************************************************************************************/
+        ADCWatchdog()
+        {
+            trips.clear();
+            for (int16_t& sample : buffer) sample = 1000;
+            adcWatchdogInit(buffer, NO_CHANNELS, NO_SAMPLES);
+        }
+
+        void setSamples(int channel, int from, int to, int16_t value)
+        {
+            for (int i = from; i < to; i++) buffer[i * NO_CHANNELS + channel] = value;
+        }
+
+        static void onTrip(int id, int channel, int16_t value)
+        {
+            trips.push_back({id, channel, value});
+        }
+
+        /*******************************************************************************************
+        ** MEMBERS
+        *******************************************************************************************/
+        static const int NO_CHANNELS = 3;
+        static const int NO_SAMPLES  = 20;
+
+        struct Trip {
+            int id;
+            int channel;
+            int16_t value;
+        };
+
+        int16_t buffer[NO_CHANNELS * NO_SAMPLES];
+        static vector<Trip> trips;
+};
+
+vector<ADCWatchdog::Trip> ADCWatchdog::trips;
+
+/***************************************************************************************************
+** TESTS
+***************************************************************************************************/
+
+TEST_F(ADCWatchdog, addLimits)
+{
+    for (int i = 0; i < ADC_WATCHDOG_MAX_WATCHES; i++) {
+        EXPECT_EQ(adcWatchdogAdd(i % NO_CHANNELS, 0, 2000, 1, onTrip), i);
+    }
+    EXPECT_EQ(adcWatchdogAdd(0, 0, 2000, 1, onTrip), -1);
+
+    adcWatchdogInit(buffer, NO_CHANNELS, NO_SAMPLES);
+    EXPECT_EQ(adcWatchdogAdd(-1, 0, 2000, 1, onTrip), -1);
+    EXPECT_EQ(adcWatchdogAdd(NO_CHANNELS, 0, 2000, 1, onTrip), -1);
+    EXPECT_FALSE(adcWatchdogIsTripped(-1));
+    EXPECT_FALSE(adcWatchdogIsTripped(0));
+}
+
+TEST_F(ADCWatchdog, dmaIndex)
+{
+    /* NDTR counts down from the full buffer length */
+    EXPECT_EQ(adcWatchdogDmaIndex(NO_CHANNELS * NO_SAMPLES), 0);
+    EXPECT_EQ(adcWatchdogDmaIndex(NO_CHANNELS * NO_SAMPLES - 1), 0);
+    EXPECT_EQ(adcWatchdogDmaIndex(NO_CHANNELS * NO_SAMPLES - NO_CHANNELS), 1);
+    EXPECT_EQ(adcWatchdogDmaIndex(NO_CHANNELS * NO_SAMPLES - 4 * NO_CHANNELS - 2), 4);
+    EXPECT_EQ(adcWatchdogDmaIndex(1), NO_SAMPLES - 1);
+
+    /* The scan index follows the scans, and ignores invalid ones */
+    EXPECT_EQ(adcWatchdogScanIndex(), 0);
+    adcWatchdogScan(7);
+    EXPECT_EQ(adcWatchdogScanIndex(), 7);
+    adcWatchdogScan(NO_SAMPLES);
+    EXPECT_EQ(adcWatchdogScanIndex(), 7);
+}
+
+TEST_F(ADCWatchdog, tripsOnExactSample)
+{
+    int low  = adcWatchdogAdd(1, 500, 1500, 1, onTrip);
+    int high = adcWatchdogAdd(2, 500, 1500, 1, onTrip);
+
+    setSamples(1, 7, 8, 499);
+    setSamples(2, 12, 13, 1501);
+
+    /* Limits are inclusive */
+    setSamples(2, 3, 4, 1500);
+    setSamples(1, 4, 5, 500);
+
+    adcWatchdogScan(7);
+    EXPECT_TRUE(trips.empty());
+
+    adcWatchdogScan(8);
+    EXPECT_TRUE(adcWatchdogIsTripped(low));
+    EXPECT_FALSE(adcWatchdogIsTripped(high));
+    ASSERT_EQ(trips.size(), 1U);
+    EXPECT_EQ(trips[0].id, low);
+    EXPECT_EQ(trips[0].channel, 1);
+    EXPECT_EQ(trips[0].value, 499);
+
+    adcWatchdogScan(12);
+    EXPECT_FALSE(adcWatchdogIsTripped(high));
+    adcWatchdogScan(13);
+    EXPECT_TRUE(adcWatchdogIsTripped(high));
+    ASSERT_EQ(trips.size(), 2U);
+    EXPECT_EQ(trips[1].channel, 2);
+    EXPECT_EQ(trips[1].value, 1501);
+}
+
+TEST_F(ADCWatchdog, debounce)
+{
+    int id = adcWatchdogAdd(0, 500, 1500, 3, onTrip);
+
+    /* Two samples out, one back in, then three out */
+    setSamples(0, 2, 4, 2000);
+    setSamples(0, 5, 8, 2000);
+
+    adcWatchdogScan(7);
+    EXPECT_FALSE(adcWatchdogIsTripped(id));
+    adcWatchdogScan(8);
+    EXPECT_TRUE(adcWatchdogIsTripped(id));
+    EXPECT_EQ(trips.size(), 1U);
+}
+
+TEST_F(ADCWatchdog, latchAndRearm)
+{
+    int id = adcWatchdogAdd(0, 500, 1500, 1, onTrip);
+
+    setSamples(0, 2, 10, 2000);
+    adcWatchdogScan(10);
+
+    /* Callback only once while latched */
+    EXPECT_TRUE(adcWatchdogIsTripped(id));
+    EXPECT_EQ(trips.size(), 1U);
+
+    /* Trips again after rearming, if still out of the window */
+    adcWatchdogRearm(id);
+    EXPECT_FALSE(adcWatchdogIsTripped(id));
+    setSamples(0, 10, 11, 2000);
+    adcWatchdogScan(11);
+    EXPECT_TRUE(adcWatchdogIsTripped(id));
+    EXPECT_EQ(trips.size(), 2U);
+}
+
+TEST_F(ADCWatchdog, wrapAround)
+{
+    int id = adcWatchdogAdd(0, 500, 1500, 2, onTrip);
+
+    adcWatchdogScan(NO_SAMPLES - 1);
+
+    /* Out of the window across the end of the circular buffer */
+    setSamples(0, NO_SAMPLES - 1, NO_SAMPLES, 2000);
+    setSamples(0, 0, 1, 2000);
+
+    adcWatchdogScan(0);
+    EXPECT_FALSE(adcWatchdogIsTripped(id));
+    adcWatchdogScan(1);
+    EXPECT_TRUE(adcWatchdogIsTripped(id));
+    EXPECT_EQ(trips[0].value, 2000);
+
+    /* Invalid indices are ignored */
+    adcWatchdogRearm(id);
+    adcWatchdogScan(-1);
+    adcWatchdogScan(NO_SAMPLES);
+    EXPECT_FALSE(adcWatchdogIsTripped(id));
+}
+
+TEST_F(ADCWatchdog, limitsAndEnable)
+{
+    int id = adcWatchdogAdd(0, 500, 1500, 1, NULL);
+
+    /* Disabled watches never trip */
+    adcWatchdogEnable(id, false);
+    setSamples(0, 0, NO_SAMPLES, 2000);
+    adcWatchdogScan(5);
+    EXPECT_FALSE(adcWatchdogIsTripped(id));
+
+    /* New limits used from the next sample */
+    adcWatchdogEnable(id, true);
+    adcWatchdogSetLimits(id, 500, 2500);
+    adcWatchdogScan(10);
+    EXPECT_FALSE(adcWatchdogIsTripped(id));
+
+    adcWatchdogSetLimits(id, 500, 1999);
+    adcWatchdogScan(11);
+    EXPECT_TRUE(adcWatchdogIsTripped(id));
+    EXPECT_TRUE(trips.empty());
+}
@@ -0,0 +1,115 @@
+/*!
+** @file   callbackCost_benchmark.cpp
+** @date   19/10/2026
+**
+** Host timings of the filter and calibration run in the ADC callback of Pressure and AnalogInput.
+** The timings depend on the machine and its load, so this is not run by ctest: run it by hand after
+** changing the decimator or the calibration tables.
+**
+** The 5 ms budget of the callback can only be checked on target, where the "cycles" command of both
+** boards reports the cost from the DWT cycle counter. The host only bounds the cost of the new code
+** relative to the code it replaced.
+*/
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+/* UUT */
+#include "decimator.c"
+#include "piecewiseLinear.c"
+
+using namespace std;
+
+/***************************************************************************************************
+** PRIVATE FUNCTIONS
+***************************************************************************************************/
+
+/* Shortest of 200 runs in us, which leaves out the preemptions of the test machine */
+template <class F> static double shortestRun(F f)
+{
+    double shortest = 1e9;
+    for (int i = 0; i < 200; i++) {
+        auto start = chrono::steady_clock::now();
+        f();
+        chrono::duration<double, micro> elapsed = chrono::steady_clock::now() - start;
+        shortest = min(shortest, elapsed.count());
+    }
+    return shortest;
+}
+
+/***************************************************************************************************
+** TESTS
+***************************************************************************************************/
+
+static const int NO_CHANNELS = 8;
+static const int NO_SAMPLES  = 400;
+static const int SAMPLE_RATE = 4000;
+
+TEST(CallbackCost, decimator)
+{
+    /* The most expensive setup, on all channels, against the plain mean of the same buffer that
+    ** ADCMonitor used to take: 6x with -O2, 11x with -O0 when written */
+    static int16_t samples[NO_CHANNELS * NO_SAMPLES];
+    for (int i = 0; i < NO_CHANNELS * NO_SAMPLES; i++) {
+        samples[i] = (i * 37) % 4096;
+    }
+
+    volatile double sink = 0.0;
+    double meanUs = shortestRun([&] {
+        for (int channel = 0; channel < NO_CHANNELS; channel++) {
+            double sum = 0.0;
+            for (int i = 0; i < NO_SAMPLES; i++) {
+                sum += samples[i * NO_CHANNELS + channel];
+            }
+            sink = sum / NO_SAMPLES;
+        }
+    });
+
+    decimInit(NO_CHANNELS, NO_SAMPLES, SAMPLE_RATE, 12);
+    for (int channel = 0; channel < NO_CHANNELS; channel++) {
+        ASSERT_TRUE(decimConfigure(channel, 50, DECIM_FIR_FLAT, DECIM_NOTCH_50HZ));
+        ASSERT_TRUE(decimSetSpikeFilter(channel, DECIM_SPIKE_MEDIAN5));
+    }
+    double decimUs = shortestRun([&] { decimRun(samples, NO_SAMPLES); });
+
+    cout << "decimRun: " << decimUs << " us per callback, plain mean: " << meanUs << " us" << endl;
+    EXPECT_LT(decimUs, 20 * meanUs);
+}
+
+TEST(CallbackCost, piecewiseLinear)
+{
+    /* A full table against the scalar and offset it replaces: 11x with -O2, 5x with -O0 when
+    ** written. The callback evaluates one table per port */
+    PwlTable table;
+    pwlClear(&table);
+    for (int i = 0; i < PWL_MAX_POINTS; i++) {
+        ASSERT_EQ(pwlAddPoint(&table, i * 250.0f, (float)(i * i)), 0);
+    }
+
+    float inputs[1024];
+    for (int i = 0; i < 1024; i++) {
+        inputs[i] = (float)((i * 53) % 4100);
+    }
+
+    volatile float sink = 0.0f;
+    double linearUs = shortestRun([&] {
+        float sum = 0.0f;
+        for (int i = 0; i < 1024; i++) {
+            sum += inputs[i] * 0.5f + 1.0f;
+        }
+        sink = sum;
+    });
+    double tableUs = shortestRun([&] {
+        float sum = 0.0f;
+        for (int i = 0; i < 1024; i++) {
+            sum += pwlEval(&table, inputs[i]);
+        }
+        sink = sum;
+    });
+
+    cout << "pwlEval: " << tableUs << " us per 1024, scalar and offset: " << linearUs << " us" << endl;
+    EXPECT_LT(tableUs, 25 * linearUs);
+}
@@ -0,0 +1,38 @@
+/*!
+** @file   cycleCount_tests.cpp
+** @date   19/10/2026
+*/
+
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+/* UUT */
+#include "cycleCount.c"
+
+using namespace std;
+
+/***************************************************************************************************
+** TESTS
+***************************************************************************************************/
+
+TEST(CycleCount, lastAndMax)
+{
+    CycleStats stats = {};
+
+    cycleStatsAdd(&stats, 500);
+    cycleStatsAdd(&stats, 2000);
+    cycleStatsAdd(&stats, 1000);
+    EXPECT_EQ(stats.last, 1000U);
+    EXPECT_EQ(stats.max, 2000U);
+}
+
+TEST(CycleCount, counterWraps)
+{
+    CycleStats stats = {};
+
+    /* The difference of two reads is correct when the counter wraps in between */
+    uint32_t start = 0xFFFFFF00U;
+    uint32_t end   = 0x00000100U;
+    cycleStatsAdd(&stats, end - start);
+    EXPECT_EQ(stats.last, 0x200U);
+}
@@ -0,0 +1,266 @@
+/*!
+** @file   decimator_tests.cpp
+** @date   18/10/2026
+*/
+
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <algorithm>
+#include <cmath>
+
+/* UUT */
+#include "decimator.c"
+
+using namespace std;
+
+/***************************************************************************************************
+** TEST FIXTURES
+***************************************************************************************************/
+
+class Decimator: public ::testing::Test
+{
+    protected:
+        /*******************************************************************************************
+        ** METHODS
+        *******************************************************************************************/
+        Decimator()
+        {
+            decimInit(NO_CHANNELS, NO_SAMPLES, SAMPLE_RATE, 12);
+        }
+
+        /* Fills the next half buffer of a channel with a DC level plus a sine wave */
+        void fill(int channel, double dc, double amplitude = 0.0, double freq = 50.0)
+        {
+            for (int i = 0; i < NO_SAMPLES; i++) {
+                double t = (double)(sampleIdx + i) / SAMPLE_RATE;
+                buffer[i * NO_CHANNELS + channel] = lround(dc + amplitude * sin(2 * M_PI * freq * t));
+            }
+        }
+
+        void run()
+        {
+            decimRun(buffer, NO_SAMPLES);
+            sampleIdx += NO_SAMPLES;
+        }
+
+        /*******************************************************************************************
+        ** MEMBERS
+        *******************************************************************************************/
+        static const int NO_CHANNELS = 3;
+        static const int NO_SAMPLES  = 400;
+        static const int SAMPLE_RATE = 4000;
+
+        int16_t buffer[NO_CHANNELS * NO_SAMPLES] = {0};
+        int sampleIdx = 0;
+};
+
+/***************************************************************************************************
+** TESTS
+***************************************************************************************************/
+
+TEST_F(Decimator, defaultIsMeanOfHalfBuffer)
+{
+    for (int i = 0; i < NO_SAMPLES; i++) {
+        buffer[i * NO_CHANNELS]     = i;
+        buffer[i * NO_CHANNELS + 1] = 1000 + (i % 2);
+        buffer[i * NO_CHANNELS + 2] = 4095;
+    }
+    run();
+
+    EXPECT_FLOAT_EQ(decimValue(0), 199.5f);
+    EXPECT_FLOAT_EQ(decimValue(1), 1000.5f);
+    EXPECT_FLOAT_EQ(decimValue(2), 4095.0f);
+    EXPECT_EQ(decimRate(0), 10);
+}
+
+TEST_F(Decimator, configure)
+{
+    /* The output rate must divide the sample rate */
+    EXPECT_FALSE(decimConfigure(0, 30, DECIM_FIR_NONE, DECIM_NOTCH_NONE));
+    EXPECT_FALSE(decimConfigure(0, 0, DECIM_FIR_NONE, DECIM_NOTCH_NONE));
+    EXPECT_FALSE(decimConfigure(0, 8000, DECIM_FIR_NONE, DECIM_NOTCH_NONE));
+    EXPECT_FALSE(decimConfigure(NO_CHANNELS, 10, DECIM_FIR_NONE, DECIM_NOTCH_NONE));
+
+    /* The notches need a whole number of mains periods in the boxcar */
+    EXPECT_TRUE(decimConfigure(0, 50, DECIM_FIR_NONE, DECIM_NOTCH_50HZ));
+    EXPECT_FALSE(decimConfigure(0, 40, DECIM_FIR_NONE, DECIM_NOTCH_50HZ));
+    EXPECT_FALSE(decimConfigure(0, 50, DECIM_FIR_NONE, DECIM_NOTCH_60HZ));
+    EXPECT_TRUE(decimConfigure(0, 20, DECIM_FIR_NONE, DECIM_NOTCH_60HZ));
+    EXPECT_FALSE(decimConfigure(0, 20, DECIM_FIR_NONE, DECIM_NOTCH_50_60HZ));
+    EXPECT_TRUE(decimConfigure(0, 10, DECIM_FIR_NONE, DECIM_NOTCH_50_60HZ));
+    EXPECT_TRUE(decimConfigure(0, 5, DECIM_FIR_NONE, DECIM_NOTCH_50_60HZ));
+
+    /* A failed configuration leaves the channel as it was */
+    EXPECT_EQ(decimRate(0), 5);
+}
+
+TEST_F(Decimator, mainsNotch)
+{
+    ASSERT_TRUE(decimConfigure(0, 50, DECIM_FIR_NONE, DECIM_NOTCH_50HZ));
+    ASSERT_TRUE(decimConfigure(1, 20, DECIM_FIR_NONE, DECIM_NOTCH_60HZ));
+    ASSERT_TRUE(decimConfigure(2, 40, DECIM_FIR_NONE, DECIM_NOTCH_NONE));
+
+    /* 50 Hz pick-up on the 50 Hz notch, 60 Hz on the 60 Hz notch, 50 Hz without a notch */
+    fill(0, 2000, 200, 50);
+    fill(1, 2000, 200, 60);
+    fill(2, 2000, 200, 50);
+    run();
+
+    EXPECT_NEAR(decimValue(0), 2000, 0.05);
+    EXPECT_NEAR(decimValue(1), 2000, 0.05);
+    EXPECT_GT(fabs(decimValue(2) - 2000), 10);
+}
+
+TEST_F(Decimator, latestOutput)
+{
+    /* The value is the boxcar ending with the last sample of the buffer */
+    ASSERT_TRUE(decimConfigure(0, 200, DECIM_FIR_NONE, DECIM_NOTCH_NONE));
+    for (int i = 0; i < NO_SAMPLES; i++) {
+        buffer[i * NO_CHANNELS] = i;
+    }
+    run();
+
+    EXPECT_FLOAT_EQ(decimValue(0), 389.5f);
+}
+
+TEST_F(Decimator, boxcarAcrossBuffers)
+{
+    ASSERT_TRUE(decimConfigure(0, 5, DECIM_FIR_NONE, DECIM_NOTCH_NONE));
+
+    fill(0, 1000);
+    run();
+    EXPECT_FLOAT_EQ(decimValue(0), 0.0f);
+
+    fill(0, 2000);
+    run();
+    EXPECT_FLOAT_EQ(decimValue(0), 1500.0f);
+}
+
+TEST_F(Decimator, compensationFilters)
+{
+    ASSERT_TRUE(decimConfigure(0, 100, DECIM_FIR_FLAT, DECIM_NOTCH_NONE));
+    ASSERT_TRUE(decimConfigure(1, 100, DECIM_FIR_SMOOTH, DECIM_NOTCH_NONE));
+
+    /* No transient from the start-up */
+    fill(0, 1000);
+    fill(1, 1000);
+    run();
+    EXPECT_FLOAT_EQ(decimValue(0), 1000.0f);
+    EXPECT_FLOAT_EQ(decimValue(1), 1000.0f);
+
+    /* Step in the last boxcar of the buffer: both FIRs are one output behind */
+    for (int i = NO_SAMPLES - SAMPLE_RATE / 100; i < NO_SAMPLES; i++) {
+        buffer[i * NO_CHANNELS]     = 1800;
+        buffer[i * NO_CHANNELS + 1] = 1800;
+    }
+    run();
+    EXPECT_FLOAT_EQ(decimValue(0), 900.0f);
+    EXPECT_FLOAT_EQ(decimValue(1), 1200.0f);
+
+    fill(0, 1800);
+    fill(1, 1800);
+    run();
+    EXPECT_FLOAT_EQ(decimValue(0), 1800.0f);
+    EXPECT_FLOAT_EQ(decimValue(1), 1800.0f);
+}
+
+TEST_F(Decimator, spikeRejection)
+{
+    ASSERT_TRUE(decimSetSpikeFilter(1, DECIM_SPIKE_MEDIAN3));
+    ASSERT_TRUE(decimSetSpikeFilter(2, DECIM_SPIKE_MEDIAN5));
+
+    /* Full scale spikes of one sample every 20 samples, and of two samples every 50 */
+    for (int ch = 0; ch < NO_CHANNELS; ch++) {
+        fill(ch, 2000);
+    }
+    for (int i = 10; i < NO_SAMPLES; i += 20) {
+        for (int ch = 0; ch < NO_CHANNELS; ch++) {
+            buffer[i * NO_CHANNELS + ch] = 4095;
+        }
+    }
+    for (int i = 25; i < NO_SAMPLES - 1; i += 50) {
+        buffer[i * NO_CHANNELS + 2]       = 4095;
+        buffer[(i + 1) * NO_CHANNELS + 2] = 4095;
+    }
+    run();
+
+    EXPECT_GT(decimValue(0), 2100);
+    EXPECT_FLOAT_EQ(decimValue(1), 2000.0f);
+    EXPECT_FLOAT_EQ(decimValue(2), 2000.0f);
+}
+
+TEST_F(Decimator, spikeFilterIsMedian)
+{
+    ASSERT_TRUE(decimSetSpikeFilter(0, DECIM_SPIKE_MEDIAN3));
+    ASSERT_TRUE(decimSetSpikeFilter(1, DECIM_SPIKE_MEDIAN5));
+    ASSERT_TRUE(decimConfigure(0, SAMPLE_RATE, DECIM_FIR_NONE, DECIM_NOTCH_NONE));
+    ASSERT_TRUE(decimConfigure(1, SAMPLE_RATE, DECIM_FIR_NONE, DECIM_NOTCH_NONE));
+
+    /* With one sample per output, the output is the median of the latest samples. The window
+    ** starts filled with the first sample */
+    srand(1);
+    int16_t first = rand() % 4096;
+    vector<int16_t> samples(4, first);
+    for (int i = 0; i < 1000; i++) {
+        int16_t sample = (i == 0) ? first : rand() % 4096;
+        int16_t block[NO_CHANNELS] = {sample, sample, 0};
+        samples.push_back(sample);
+        decimRun(block, 1);
+
+        vector<int16_t> last3(samples.end() - 3, samples.end());
+        vector<int16_t> last5(samples.end() - 5, samples.end());
+        sort(last3.begin(), last3.end());
+        sort(last5.begin(), last5.end());
+        ASSERT_EQ(decimValue(0), last3[1]) << "Sample " << i;
+        ASSERT_EQ(decimValue(1), last5[2]) << "Sample " << i;
+    }
+
+    /* Steps go through unchanged, two samples late */
+    ASSERT_TRUE(decimSetSpikeFilter(1, DECIM_SPIKE_MEDIAN5));
+    int16_t low[NO_CHANNELS]  = {0, 1000, 0};
+    int16_t high[NO_CHANNELS] = {0, 3000, 0};
+    decimRun(low, 1);
+    decimRun(high, 1);
+    decimRun(high, 1);
+    EXPECT_FLOAT_EQ(decimValue(1), 1000.0f);
+    decimRun(high, 1);
+    EXPECT_FLOAT_EQ(decimValue(1), 3000.0f);
+}
+
+TEST_F(Decimator, effectiveBits)
+{
+    EXPECT_FLOAT_EQ(decimEffectiveBits(0), 16.0f);
+
+    ASSERT_TRUE(decimConfigure(0, 50, DECIM_FIR_NONE, DECIM_NOTCH_50HZ));
+    EXPECT_NEAR(decimEffectiveBits(0), 15.16, 0.01);
+
+    ASSERT_TRUE(decimConfigure(0, 200, DECIM_FIR_FLAT, DECIM_NOTCH_NONE));
+    EXPECT_NEAR(decimEffectiveBits(0), 13.83, 0.01);
+
+    ASSERT_TRUE(decimConfigure(0, 200, DECIM_FIR_SMOOTH, DECIM_NOTCH_NONE));
+    EXPECT_NEAR(decimEffectiveBits(0), 14.87, 0.01);
+}
+
+TEST_F(Decimator, parse)
+{
+    DecimFir fir;
+    DecimNotch notch;
+
+    EXPECT_TRUE(decimParseFir("flat", &fir));
+    EXPECT_EQ(fir, DECIM_FIR_FLAT);
+    EXPECT_FALSE(decimParseFir("sharp", &fir));
+
+    EXPECT_TRUE(decimParseNotch("50/60", &notch));
+    EXPECT_EQ(notch, DECIM_NOTCH_50_60HZ);
+    EXPECT_TRUE(decimParseNotch("none", &notch));
+    EXPECT_EQ(notch, DECIM_NOTCH_NONE);
+    EXPECT_FALSE(decimParseNotch("55", &notch));
+
+    DecimSpike spike;
+    EXPECT_TRUE(decimParseSpike("median5", &spike));
+    EXPECT_EQ(spike, DECIM_SPIKE_MEDIAN5);
+    EXPECT_FALSE(decimParseSpike("median4", &spike));
+    EXPECT_FALSE(decimSetSpikeFilter(0, (DecimSpike)4));
+    EXPECT_FALSE(decimSetSpikeFilter(NO_CHANNELS, DECIM_SPIKE_MEDIAN3));
+}
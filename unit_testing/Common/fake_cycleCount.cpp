@@ -0,0 +1,37 @@
+/*!
+** @file   fake_cycleCount.cpp
+** @brief  Fake cycle counter
+** @date   19/10/2026
+*/
+
+#include "fake_cycleCount.h"
+
+/***************************************************************************************************
+** PRIVATE VARIABLES
+***************************************************************************************************/
+
+static uint32_t counter = 0;
+static uint32_t step    = 0;
+static uint32_t perMs   = 16000;
+
+/***************************************************************************************************
+** PUBLIC FUNCTIONS
+***************************************************************************************************/
+
+void fakeCycleCountInit(uint32_t cyclesPerRead, uint32_t cyclesPerMs) {
+    counter = 0;
+    step    = cyclesPerRead;
+    perMs   = cyclesPerMs;
+}
+
+void cycleCountInit() {}
+
+uint32_t cycleCountNow() {
+    uint32_t now = counter;
+    counter += step;
+    return now;
+}
+
+uint32_t cycleCountPerMs() {
+    return perMs;
+}
@@ -0,0 +1,21 @@
+/*!
+** @file   fake_cycleCount.h
+** @brief  Fake cycle counter
+** @date   19/10/2026
+*/
+
+#ifndef FAKE_CYCLE_COUNT_H_
+#define FAKE_CYCLE_COUNT_H_
+
+#include <stdint.h>
+
+#include "cycleCount.h"
+
+/***************************************************************************************************
+** PUBLIC FUNCTION DECLARATIONS
+***************************************************************************************************/
+
+/* Restarts the counter. Each read of cycleCountNow advances it by cyclesPerRead */
+void fakeCycleCountInit(uint32_t cyclesPerRead = 0, uint32_t cyclesPerMs = 16000);
+
+#endif /* FAKE_CYCLE_COUNT_H_ */
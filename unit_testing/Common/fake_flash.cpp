@@ -0,0 +1,169 @@
+/*!
+** @file   fake_flash.cpp
+** @brief  Fake flash for the flash records, with erase stalls and power cuts
+** @date   19/10/2026
+**
+** The flash is sparse, so any address can be used, e.g. FLASH_ADDR_CAL cast to 32 bits. As on the
+** STM32F4, programming can only clear bits, a word must be erased before it is programmed, and the
+** CPU stalls during an erase.
+*/
+
+#include <gtest/gtest.h>
+
+#include <map>
+#include <string.h>
+
+#include "fake_flash.h"
+
+using namespace std;
+
+/***************************************************************************************************
+** PRIVATE VARIABLES
+***************************************************************************************************/
+
+static map<uint32_t, uint8_t> memory;   // Programmed bytes, the others are erased
+static map<uint32_t, int> erases;       // Erases per sector address
+static uint32_t sectorSize = 0x4000;
+static int eraseStallMs    = 0;
+static int stallLeft       = 0;
+static bool isFailing      = false;
+static int powerBudget     = -1;        // Operations left before the power is cut, -1 for never
+static int programs        = 0;
+
+/***************************************************************************************************
+** PRIVATE FUNCTION DEFINITIONS
+***************************************************************************************************/
+
+/* Consumes one operation. Returns false if the power is cut during it */
+static bool consumePower() {
+    if (powerBudget > 0) {
+        powerBudget--;
+    }
+    return powerBudget != 0;
+}
+
+static uint8_t readByte(uint32_t addr) {
+    auto it = memory.find(addr);
+    return (it == memory.end()) ? 0xFF : it->second;
+}
+
+static int fakeRead(uint32_t addr, void* data, uint32_t len) {
+    uint8_t* bytes = (uint8_t*)data;
+    for (uint32_t i = 0; i < len; i++) {
+        bytes[i] = readByte(addr + i);
+    }
+    return 0;
+}
+
+static void programByte(uint32_t addr, uint8_t value) {
+    uint8_t now = readByte(addr) & value;
+    if (now == 0xFF) {
+        memory.erase(addr);
+    }
+    else {
+        memory[addr] = now;
+    }
+}
+
+static int fakeProgram(uint32_t addr, const void* data, uint32_t len) {
+    const uint8_t* bytes = (const uint8_t*)data;
+
+    EXPECT_EQ(addr % 4, 0u);
+    EXPECT_EQ(len % 4, 0u);
+    if (isFailing || powerBudget == 0) {
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < len; i += 4) {
+        bool isPowered = consumePower();
+        for (uint32_t b = 0; b < 4; b++) {
+            EXPECT_EQ(readByte(addr + i + b), 0xFF) << "Programmed twice without erase";
+            /* A cut word only has some of its bits cleared */
+            uint8_t value = isPowered ? bytes[i + b] : bytes[i + b] | (uint8_t)(0x5A << b);
+            programByte(addr + i + b, value);
+        }
+        if (!isPowered) {
+            return -1;
+        }
+        programs++;
+    }
+    return 0;
+}
+
+static int fakeErase(uint32_t addr) {
+    if (isFailing || powerBudget == 0) {
+        return -1;
+    }
+
+    /* A cut erase leaves part of the sector as it was */
+    bool isPowered = consumePower();
+    uint32_t len   = isPowered ? sectorSize : sectorSize / 2;
+    memory.erase(memory.lower_bound(addr), memory.lower_bound(addr + len));
+    erases[addr]++;
+    stallLeft = eraseStallMs;
+    return isPowered ? 0 : -1;
+}
+
+/***************************************************************************************************
+** PUBLIC OBJECTS
+***************************************************************************************************/
+
+const FlashOps fakeFlashOps = {fakeRead, fakeProgram, fakeErase};
+
+/***************************************************************************************************
+** PUBLIC FUNCTION DEFINITIONS
+***************************************************************************************************/
+
+void fakeFlashInit(uint32_t size, int stallMs) {
+    memory.clear();
+    erases.clear();
+    sectorSize   = size;
+    eraseStallMs = stallMs;
+    stallLeft    = 0;
+    isFailing    = false;
+    powerBudget  = -1;
+    programs     = 0;
+}
+
+bool fakeFlashIsStalled() {
+    if (stallLeft > 0) {
+        stallLeft--;
+        return true;
+    }
+    return false;
+}
+
+void fakeFlashTick(const function<void()>& tick) {
+    /* Neither the interrupts nor the main loop run during the stall */
+    if (!fakeFlashIsStalled()) {
+        tick();
+    }
+}
+
+void fakeFlashFail(bool fail) {
+    isFailing = fail;
+}
+
+void fakeFlashCutPowerAfter(int operations) {
+    powerBudget = operations;
+}
+
+void fakeFlashPowerOn() {
+    powerBudget = -1;
+    stallLeft   = 0;
+}
+
+int fakeFlashPrograms() {
+    return programs;
+}
+
+int fakeFlashErases(uint32_t addr) {
+    return erases.count(addr) ? erases[addr] : 0;
+}
+
+uint8_t& fakeFlashByte(uint32_t addr) {
+    if (memory.count(addr) == 0) {
+        memory[addr] = 0xFF;
+    }
+    return memory[addr];
+}
@@ -0,0 +1,54 @@
+/*!
+** @file   fake_flash.h
+** @brief  Fake flash for the flash records, with erase stalls and power cuts
+** @date   19/10/2026
+*/
+
+#ifndef FAKE_FLASH_H_
+#define FAKE_FLASH_H_
+
+#include <stdint.h>
+
+#include <functional>
+
+#include "flashRecord.h"
+
+/***************************************************************************************************
+** PUBLIC OBJECTS
+***************************************************************************************************/
+
+extern const FlashOps fakeFlashOps;
+
+/***************************************************************************************************
+** PUBLIC FUNCTION DECLARATIONS
+***************************************************************************************************/
+
+/* Erases the whole flash. An erase clears sectorSize bytes from its address, and then stalls the
+** CPU for eraseStallMs */
+void fakeFlashInit(uint32_t sectorSize = 0x4000, int eraseStallMs = 0);
+
+/* True while an erase stalls the CPU. Each call is one ms of the stall */
+bool fakeFlashIsStalled();
+
+/* Runs one ms of a board test: tick runs the interrupts and the main loop of the board, unless an
+** erase stalls the CPU */
+void fakeFlashTick(const std::function<void()>& tick);
+
+/* Makes the erases and programming fail, or succeed again */
+void fakeFlashFail(bool isFailing);
+
+/* Cuts the power after that many more programmed words or erases. The one in progress is left half
+** done, and all following ones fail until fakeFlashPowerOn */
+void fakeFlashCutPowerAfter(int operations);
+void fakeFlashPowerOn();
+
+/* Words programmed since fakeFlashInit */
+int fakeFlashPrograms();
+
+/* Erases of the sector at addr since fakeFlashInit */
+int fakeFlashErases(uint32_t addr);
+
+/* Byte of the fake flash, which can be changed to corrupt it */
+uint8_t& fakeFlashByte(uint32_t addr);
+
+#endif /* FAKE_FLASH_H_ */
@@ -0,0 +1,26 @@
+/*!
+** @file   fake_flashWriter.cpp
+** @brief  Fake flash for the flash writer
+** @date   19/10/2026
+*/
+
+#include <gtest/gtest.h>
+
+#include "fake_flashWriter.h"
+
+/***************************************************************************************************
+** PUBLIC FUNCTION DEFINITIONS
+***************************************************************************************************/
+
+void fakeFlashWriterInit(int eraseStallMs) {
+    fakeFlashInit(0x4000, eraseStallMs);
+    flashWriterInit(&fakeFlashOps, NULL);
+}
+
+void fakeFlashWriterFlush() {
+    for (int i = 0; i < 100000 && flashWriterIsBusy(); i++) {
+        flashWriterRun();
+        while (fakeFlashIsStalled()) {}
+    }
+    EXPECT_FALSE(flashWriterIsBusy());
+}
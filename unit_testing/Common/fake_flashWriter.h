@@ -0,0 +1,24 @@
+/*!
+** @file   fake_flashWriter.h
+** @brief  Fake flash for the flash writer
+** @date   19/10/2026
+*/
+
+#ifndef FAKE_FLASH_WRITER_H_
+#define FAKE_FLASH_WRITER_H_
+
+#include "fake_flash.h"
+#include "flashWriter.h"
+
+/***************************************************************************************************
+** PUBLIC FUNCTION DECLARATIONS
+***************************************************************************************************/
+
+/* Erases the whole fake flash, and gives it to flashWriterInit. An erase stalls the CPU for
+** eraseStallMs, which board tests emulate with fakeFlashTick */
+void fakeFlashWriterInit(int eraseStallMs = 0);
+
+/* Runs the flash writer until all writes are done */
+void fakeFlashWriterFlush();
+
+#endif /* FAKE_FLASH_WRITER_H_ */
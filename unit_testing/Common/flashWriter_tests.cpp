@@ -0,0 +1,256 @@
+/*!
+** @file   flashWriter_tests.cpp
+** @date   19/10/2026
+*/
+
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <string>
+#include <vector>
+
+#include "fake_flashWriter.h"
+
+/* Real supporting units */
+#include "flashRecord.c"
+
+/* UUT */
+#include "flashWriter.c"
+
+using namespace std;
+
+/***************************************************************************************************
+** TEST FIXTURES
+***************************************************************************************************/
+
+static vector<int> doneStatus;
+
+static void onDone(int status) {
+    doneStatus.push_back(status);
+}
+
+class FlashWriter: public ::testing::Test
+{
+    protected:
+        /*******************************************************************************************
+        ** METHODS
+        *******************************************************************************************/
+        FlashWriter()
+        {
+            fakeFlashWriterInit(ERASE_MS);
+            doneStatus.clear();
+            for (size_t i = 0; i < sizeof(data); i++) {
+                data[i] = i * 7;
+            }
+        }
+
+        /* Runs the writer, and returns the ms the CPU was stalled */
+        int run()
+        {
+            int stallMs = 0;
+            flashWriterRun();
+            while (fakeFlashIsStalled()) {
+                stallMs++;
+            }
+            return stallMs;
+        }
+
+        /* Runs the writer until the callback, and returns the number of runs */
+        int runUntilDone()
+        {
+            size_t calls = doneStatus.size();
+            int runs     = 0;
+            while (doneStatus.size() == calls && runs < 10000) {
+                run();
+                runs++;
+            }
+            return runs;
+        }
+
+        /*******************************************************************************************
+        ** MEMBERS
+        *******************************************************************************************/
+        static const uint32_t ADDR  = 0x08020000;
+        static const int ERASE_MS    = 250;
+
+        uint8_t data[1001];
+};
+
+/***************************************************************************************************
+** TESTS
+***************************************************************************************************/
+
+TEST_F(FlashWriter, writeAndRead)
+{
+    uint8_t readBack[sizeof(data)] = {0};
+
+    ASSERT_EQ(flashWriterStart(ADDR, data, sizeof(data), onDone), 0);
+    EXPECT_TRUE(flashWriterIsBusy());
+    EXPECT_EQ(flashWriterRead(ADDR, readBack, sizeof(readBack)), -1);
+
+    /* Erase and header, then 251 words of data and the CRC, 32 words per run */
+    EXPECT_EQ(runUntilDone(), 1 + 8);
+    EXPECT_THAT(doneStatus, testing::ElementsAre(0));
+    EXPECT_FALSE(flashWriterIsBusy());
+    EXPECT_EQ(fakeFlashPrograms(), 2 + 251 + 1);
+
+    EXPECT_EQ(flashWriterRead(ADDR, readBack, sizeof(readBack)), (int)sizeof(data));
+    EXPECT_EQ(memcmp(readBack, data, sizeof(data)), 0);
+
+    /* A smaller buffer gets the start of the data */
+    uint8_t start[10] = {0};
+    EXPECT_EQ(flashWriterRead(ADDR, start, sizeof(start)), (int)sizeof(data));
+    EXPECT_EQ(memcmp(start, data, sizeof(start)), 0);
+
+    /* Nothing more to do */
+    flashWriterRun();
+    EXPECT_EQ(doneStatus.size(), 1u);
+}
+
+TEST_F(FlashWriter, programsInSlices)
+{
+    ASSERT_EQ(flashWriterStart(ADDR, data, sizeof(data), NULL), 0);
+
+    /* Only the erase stalls the CPU */
+    EXPECT_EQ(run(), (int)ERASE_MS);
+    int previous = fakeFlashPrograms();
+    while (flashWriterIsBusy()) {
+        EXPECT_EQ(run(), 0);
+        EXPECT_LE(fakeFlashPrograms() - previous, FLASH_WRITER_WORDS_PER_RUN + 1);
+        previous = fakeFlashPrograms();
+    }
+    EXPECT_EQ(flashWriterRead(ADDR, NULL, 0), (int)sizeof(data));
+    EXPECT_EQ(fakeFlashErases(ADDR), 1);
+}
+
+TEST_F(FlashWriter, stallHook)
+{
+    static vector<string> stalls;
+    stalls.clear();
+    flashWriterInit(&fakeFlashOps, [](bool isStalled) {
+        stalls.push_back(string(isStalled ? "stalled" : "resumed") + " after " +
+                         to_string(fakeFlashErases(ADDR)) + " erases");
+    });
+
+    /* Called around the erase only, e.g. to stop the window watchdog */
+    ASSERT_EQ(flashWriterStart(ADDR, data, sizeof(data), onDone), 0);
+    runUntilDone();
+    EXPECT_THAT(stalls, testing::ElementsAre("stalled after 0 erases", "resumed after 1 erases"));
+
+    /* Also when the erase fails */
+    fakeFlashFail(true);
+    ASSERT_EQ(flashWriterStart(ADDR, data, sizeof(data), onDone), 0);
+    runUntilDone();
+    EXPECT_EQ(stalls.size(), 4u);
+    EXPECT_EQ(stalls.back(), "resumed after 1 erases");
+}
+
+TEST_F(FlashWriter, sharedRecordFormat)
+{
+    /* The data is a flash record, whose version counts the writes */
+    FlashRecordHeader h;
+    for (uint32_t version = 1; version <= 3; version++) {
+        ASSERT_EQ(flashWriterStart(ADDR, data, sizeof(data), onDone), 0);
+        runUntilDone();
+        ASSERT_EQ(fakeFlashOps.read(ADDR, &h, sizeof(h)), 0);
+        EXPECT_EQ(h.key, FLASH_WRITER_KEY);
+        EXPECT_EQ(h.len, sizeof(data));
+        EXPECT_EQ(h.version, version);
+        EXPECT_TRUE(flashRecordCheck(&fakeFlashOps, ADDR, &h));
+    }
+
+    EXPECT_EQ(flashWriterStart(ADDR, data, 0x10000, onDone), -1);
+}
+
+TEST_F(FlashWriter, changeDuringWrite)
+{
+    uint8_t other[8] = {0};
+
+    ASSERT_EQ(flashWriterStart(ADDR, data, sizeof(data), onDone), 0);
+    for (int i = 0; i < 3; i++) {
+        run();
+    }
+
+    /* The data changes after its start has been programmed: it is written again */
+    data[0] = 0xAB;
+    data[sizeof(data) - 1] = 0xCD;
+    ASSERT_EQ(flashWriterStart(ADDR, data, sizeof(data), onDone), 0);
+    EXPECT_EQ(flashWriterStart(ADDR + 0x20000, other, sizeof(other), onDone), -1);
+
+    runUntilDone();
+    EXPECT_TRUE(flashWriterIsBusy());
+    runUntilDone();
+    EXPECT_FALSE(flashWriterIsBusy());
+    EXPECT_THAT(doneStatus, testing::ElementsAre(0, 0));
+
+    uint8_t readBack[sizeof(data)] = {0};
+    ASSERT_EQ(flashWriterRead(ADDR, readBack, sizeof(readBack)), (int)sizeof(data));
+    EXPECT_EQ(memcmp(readBack, data, sizeof(data)), 0);
+}
+
+TEST_F(FlashWriter, incompleteWrite)
+{
+    uint8_t readBack[sizeof(data)];
+
+    /* Nothing written yet */
+    EXPECT_EQ(flashWriterRead(ADDR, readBack, sizeof(readBack)), -1);
+
+    /* Cut by a power failure at each step of the write. The sector is erased first, so the previous
+    ** data is lost too, and the caller falls back to its defaults */
+    for (int cut = 1; cut < 2 + 251 + 1 + 1; cut++) {
+        ASSERT_EQ(flashWriterStart(ADDR, data, sizeof(data), onDone), 0);
+        runUntilDone();
+        ASSERT_EQ(flashWriterRead(ADDR, NULL, 0), (int)sizeof(data));
+
+        fakeFlashCutPowerAfter(cut);
+        ASSERT_EQ(flashWriterStart(ADDR, data, sizeof(data), onDone), 0);
+        runUntilDone();
+        fakeFlashPowerOn();
+        flashWriterInit(&fakeFlashOps, NULL);
+
+        memset(readBack, 0x55, sizeof(readBack));
+        EXPECT_EQ(flashWriterRead(ADDR, readBack, sizeof(readBack)), -1) << "Cut " << cut;
+        EXPECT_EQ(readBack[0], 0x55);
+    }
+
+    /* Corrupted after the write */
+    ASSERT_EQ(flashWriterStart(ADDR, data, sizeof(data), onDone), 0);
+    runUntilDone();
+    ASSERT_EQ(flashWriterRead(ADDR, readBack, sizeof(readBack)), (int)sizeof(data));
+    fakeFlashByte(ADDR + 100) ^= 0x10;
+    EXPECT_EQ(flashWriterRead(ADDR, readBack, sizeof(readBack)), -1);
+}
+
+TEST_F(FlashWriter, failures)
+{
+    /* Without flash */
+    flashWriterInit(NULL, NULL);
+    EXPECT_EQ(flashWriterStart(ADDR, data, sizeof(data), onDone), -1);
+    EXPECT_EQ(flashWriterRead(ADDR, data, sizeof(data)), -1);
+
+    fakeFlashWriterInit(ERASE_MS);
+    EXPECT_EQ(flashWriterStart(ADDR + 2, data, sizeof(data), onDone), -1);
+
+    /* Failed erase */
+    ASSERT_EQ(flashWriterStart(ADDR, data, sizeof(data), onDone), 0);
+    fakeFlashFail(true);
+    runUntilDone();
+    EXPECT_THAT(doneStatus, testing::ElementsAre(-1));
+    EXPECT_FALSE(flashWriterIsBusy());
+
+    /* Failed programming */
+    fakeFlashFail(false);
+    ASSERT_EQ(flashWriterStart(ADDR, data, sizeof(data), onDone), 0);
+    run();
+    fakeFlashFail(true);
+    runUntilDone();
+    EXPECT_THAT(doneStatus, testing::ElementsAre(-1, -1));
+    EXPECT_EQ(flashWriterRead(ADDR, data, sizeof(data)), -1);
+
+    /* The next write succeeds again */
+    fakeFlashFail(false);
+    ASSERT_EQ(flashWriterStart(ADDR, data, sizeof(data), onDone), 0);
+    runUntilDone();
+    EXPECT_THAT(doneStatus, testing::ElementsAre(-1, -1, 0));
+    EXPECT_EQ(flashWriterRead(ADDR, NULL, 0), (int)sizeof(data));
+}
@@ -0,0 +1,246 @@
+/*!
+** @file   kvStore_tests.cpp
+** @date   19/10/2026
+*/
+
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <string>
+#include <vector>
+
+/* Fakes */
+#include "fake_flash.h"
+
+/* Real supporting units */
+#include "flashRecord.c"
+
+/* UUT */
+#include "kvStore.c"
+
+using namespace std;
+
+/***************************************************************************************************
+** TEST FIXTURES
+***************************************************************************************************/
+
+class KVStore: public ::testing::Test
+{
+    protected:
+        /*******************************************************************************************
+        ** METHODS
+        *******************************************************************************************/
+        KVStore()
+        {
+            fakeFlashInit(SECTOR_SIZE);
+        }
+
+        int init()
+        {
+            return kvInit(&fakeFlashOps, SECTOR_A, SECTOR_B, SECTOR_SIZE);
+        }
+
+        int write(uint16_t key, const string& value)
+        {
+            return kvWrite(key, value.data(), value.size());
+        }
+
+        string read(uint16_t key)
+        {
+            char buf[256];
+            int len = kvRead(key, buf, sizeof(buf));
+            return (len < 0) ? "<none>" : string(buf, len);
+        }
+
+        int erases()
+        {
+            return fakeFlashErases(SECTOR_A) + fakeFlashErases(SECTOR_B);
+        }
+
+        /*******************************************************************************************
+        ** MEMBERS
+        *******************************************************************************************/
+        /* Two small sectors, so that they fill quickly */
+        static const uint32_t SECTOR_SIZE = 512;
+        static const uint32_t SECTOR_A    = 0x08004000;
+        static const uint32_t SECTOR_B    = 0x08008000;
+};
+
+/***************************************************************************************************
+** TESTS
+***************************************************************************************************/
+
+TEST_F(KVStore, readWrite)
+{
+    ASSERT_EQ(init(), 0);
+    EXPECT_EQ(read(0), "<none>");
+    EXPECT_EQ(kvVersion(0), 0u);
+
+    EXPECT_EQ(write(0, "offset 12"), 0);
+    EXPECT_EQ(write(2, "abcd"), 0);
+    EXPECT_EQ(read(0), "offset 12");
+    EXPECT_EQ(read(2), "abcd");
+    EXPECT_EQ(kvVersion(0), 1u);
+
+    EXPECT_EQ(write(0, "offset 13, gain 2"), 0);
+    EXPECT_EQ(read(0), "offset 13, gain 2");
+    EXPECT_EQ(kvVersion(0), 2u);
+
+    /* A short buffer gets the start of the value, and the full length */
+    char buf[4];
+    EXPECT_EQ(kvRead(0, buf, sizeof(buf)), 17);
+    EXPECT_EQ(string(buf, 4), "offs");
+
+    EXPECT_EQ(write(KV_MAX_KEYS, "x"), -1);
+    EXPECT_EQ(kvWrite(0, NULL, 4), -1);
+
+    /* 16 byte sector header, then 12 bytes + padded data per record */
+    EXPECT_EQ(kvFree(), SECTOR_SIZE - 16 - (12 + 12) - (12 + 4) - (12 + 20));
+}
+
+TEST_F(KVStore, deleteKey)
+{
+    ASSERT_EQ(init(), 0);
+    EXPECT_EQ(kvDelete(3), 0);
+    EXPECT_EQ(kvVersion(3), 0u);
+
+    EXPECT_EQ(write(3, "value"), 0);
+    EXPECT_EQ(kvDelete(3), 0);
+    EXPECT_EQ(read(3), "<none>");
+    EXPECT_EQ(kvVersion(3), 2u);
+
+    ASSERT_EQ(init(), 0);
+    EXPECT_EQ(read(3), "<none>");
+
+    /* The version of a deleted key carries on after a garbage collection and a restart */
+    for (int i = 0; erases() < 2; i++) {
+        ASSERT_EQ(write(0, "value " + to_string(i)), 0);
+    }
+    EXPECT_EQ(kvVersion(3), 2u);
+    ASSERT_EQ(init(), 0);
+    EXPECT_EQ(read(3), "<none>");
+    EXPECT_EQ(kvVersion(3), 2u);
+    EXPECT_EQ(write(3, "again"), 0);
+    EXPECT_EQ(kvVersion(3), 3u);
+}
+
+TEST_F(KVStore, persistence)
+{
+    ASSERT_EQ(init(), 0);
+    EXPECT_EQ(write(0, "first"), 0);
+    EXPECT_EQ(write(1, "second"), 0);
+    EXPECT_EQ(write(0, "third"), 0);
+    uint32_t free = kvFree();
+
+    ASSERT_EQ(init(), 0);
+    EXPECT_EQ(read(0), "third");
+    EXPECT_EQ(read(1), "second");
+    EXPECT_EQ(kvVersion(0), 2u);
+    EXPECT_EQ(kvFree(), free);
+    EXPECT_EQ(erases(), 1);
+}
+
+TEST_F(KVStore, garbageCollection)
+{
+    ASSERT_EQ(init(), 0);
+    EXPECT_EQ(write(5, "constant"), 0);
+
+    /* Each sector is erased once it has been filled, not once per write */
+    for (int i = 0; i < 200; i++) {
+        ASSERT_EQ(write(0, "value " + to_string(i)), 0) << "Write " << i;
+        ASSERT_EQ(write(1, to_string(i * i)), 0) << "Write " << i;
+    }
+    EXPECT_EQ(read(0), "value 199");
+    EXPECT_EQ(read(1), "39601");
+    EXPECT_EQ(read(5), "constant");
+    EXPECT_EQ(kvVersion(0), 200u);
+    EXPECT_LT(erases(), 40);
+    EXPECT_LE(abs(fakeFlashErases(SECTOR_A) - fakeFlashErases(SECTOR_B)), 1);
+
+    ASSERT_EQ(init(), 0);
+    EXPECT_EQ(read(0), "value 199");
+    EXPECT_EQ(read(5), "constant");
+    EXPECT_EQ(kvVersion(0), 200u);
+
+    /* A value which can never fit */
+    EXPECT_EQ(write(2, string(SECTOR_SIZE, 'x')), -1);
+    EXPECT_EQ(read(0), "value 199");
+}
+
+TEST_F(KVStore, corruptedFlash)
+{
+    /* Random content: a new store is started */
+    for (uint32_t i = 0; i < SECTOR_SIZE; i++) {
+        fakeFlashByte(SECTOR_A + i) = i * 37;
+        fakeFlashByte(SECTOR_B + i) = i * 41;
+    }
+    ASSERT_EQ(init(), 0);
+    EXPECT_EQ(read(0), "<none>");
+    EXPECT_EQ(write(0, "new"), 0);
+
+    /* A corrupted record is ignored */
+    EXPECT_EQ(write(0, "newer"), 0);
+    uint32_t offset = kvIndex[0].offset;
+    fakeFlashByte(sectors[active] + offset + 8) ^= 0x01;
+    EXPECT_EQ(read(0), "<none>");
+
+    ASSERT_EQ(init(), 0);
+    EXPECT_EQ(read(0), "new");
+    EXPECT_EQ(write(0, "newest"), 0);
+    EXPECT_EQ(read(0), "newest");
+}
+
+TEST_F(KVStore, powerCut)
+{
+    /* Cuts the power at each step of a sequence of writes which includes a garbage collection.
+    ** After the restart, each key has its value from before or after the write in progress, and
+    ** the store can still be written */
+    int erasesBefore = 0;
+    for (int cut = 1; cut < 400; cut++) {
+        fakeFlashInit(SECTOR_SIZE);
+        ASSERT_EQ(init(), 0);
+        ASSERT_EQ(write(7, "unchanged"), 0);
+        for (int i = 0; i < 10; i++) {
+            ASSERT_EQ(write(0, "old " + to_string(i)), 0);
+        }
+
+        vector<string> values(KV_MAX_KEYS, "<none>");
+        values[7] = "unchanged";
+        values[0] = "old 9";
+
+        erasesBefore = erases();
+        fakeFlashCutPowerAfter(cut);
+        bool isCut = false;
+        for (int i = 0; i < 30 && !isCut; i++) {
+            uint16_t key  = i % 3;
+            string value  = "new " + to_string(i) + string(i % 7, '-');
+            isCut         = write(key, value) != 0;
+            string before = values[key];
+            if (!isCut) {
+                values[key] = value;
+            }
+            else {
+                /* Restart */
+                fakeFlashPowerOn();
+                ASSERT_EQ(init(), 0) << "Cut " << cut;
+                string after = read(key);
+                ASSERT_TRUE(after == before || after == value) << "Cut " << cut << ": " << after;
+                values[key] = after;
+            }
+        }
+        if (!isCut) {
+            break;  // The whole sequence completed: every step has been cut
+        }
+
+        for (int key = 0; key < KV_MAX_KEYS; key++) {
+            ASSERT_EQ(read(key), values[key]) << "Cut " << cut << ", key " << key;
+        }
+        ASSERT_EQ(write(1, "after"), 0) << "Cut " << cut;
+        ASSERT_EQ(init(), 0);
+        ASSERT_EQ(read(1), "after") << "Cut " << cut;
+        ASSERT_EQ(read(7), "unchanged") << "Cut " << cut;
+    }
+
+    /* The sequence includes a garbage collection, so erases have been cut too */
+    EXPECT_GT(erases(), erasesBefore);
+}
@@ -0,0 +1,108 @@
+/*!
+** @file   piecewiseLinear_tests.cpp
+** @date   19/10/2026
+*/
+
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <cmath>
+
+/* UUT */
+#include "piecewiseLinear.c"
+
+using namespace std;
+
+/***************************************************************************************************
+** TEST FIXTURES
+***************************************************************************************************/
+
+class PiecewiseLinear: public ::testing::Test
+{
+    protected:
+        /*******************************************************************************************
+        ** METHODS
+        *******************************************************************************************/
+        PiecewiseLinear()
+        {
+            pwlClear(&table);
+        }
+
+        /*******************************************************************************************
+        ** MEMBERS
+        *******************************************************************************************/
+        PwlTable table;
+};
+
+/***************************************************************************************************
+** TESTS
+***************************************************************************************************/
+
+TEST_F(PiecewiseLinear, needsTwoPoints)
+{
+    EXPECT_FALSE(pwlIsValid(&table));
+    EXPECT_EQ(pwlAddPoint(&table, 1.0f, 2.0f), 0);
+    EXPECT_FALSE(pwlIsValid(&table));
+    EXPECT_EQ(pwlAddPoint(&table, 2.0f, 4.0f), 0);
+    EXPECT_TRUE(pwlIsValid(&table));
+
+    EXPECT_EQ(pwlAddPoint(&table, NAN, 1.0f), -1);
+    EXPECT_EQ(pwlAddPoint(&table, 1.0f, INFINITY), -1);
+    EXPECT_EQ(table.noOfPoints, 2U);
+}
+
+TEST_F(PiecewiseLinear, pointsAreSorted)
+{
+    /* Added out of order, with one point replaced */
+    EXPECT_EQ(pwlAddPoint(&table, 3.0f, 0.0f), 0);
+    EXPECT_EQ(pwlAddPoint(&table, 1.0f, 10.0f), 0);
+    EXPECT_EQ(pwlAddPoint(&table, 2.0f, 99.0f), 0);
+    EXPECT_EQ(pwlAddPoint(&table, 2.0f, 20.0f), 0);
+
+    ASSERT_EQ(table.noOfPoints, 3U);
+    EXPECT_FLOAT_EQ(table.x[0], 1.0f);
+    EXPECT_FLOAT_EQ(table.x[1], 2.0f);
+    EXPECT_FLOAT_EQ(table.x[2], 3.0f);
+
+    EXPECT_FLOAT_EQ(pwlEval(&table, 1.0f), 10.0f);
+    EXPECT_FLOAT_EQ(pwlEval(&table, 1.5f), 15.0f);
+    EXPECT_FLOAT_EQ(pwlEval(&table, 2.0f), 20.0f);
+    EXPECT_FLOAT_EQ(pwlEval(&table, 2.5f), 10.0f);
+
+    /* Extrapolated from the end segments */
+    EXPECT_FLOAT_EQ(pwlEval(&table, 0.0f), 0.0f);
+    EXPECT_FLOAT_EQ(pwlEval(&table, 4.0f), -20.0f);
+}
+
+TEST_F(PiecewiseLinear, full)
+{
+    for (int i = 0; i < PWL_MAX_POINTS; i++) {
+        EXPECT_EQ(pwlAddPoint(&table, i, 2 * i), 0);
+    }
+    EXPECT_EQ(pwlAddPoint(&table, 100.0f, 0.0f), -1);
+
+    /* Existing points can still be changed */
+    EXPECT_EQ(pwlAddPoint(&table, 15.0f, 0.0f), 0);
+    EXPECT_FLOAT_EQ(pwlEval(&table, 14.5f), 14.0f);
+}
+
+TEST_F(PiecewiseLinear, accuracy)
+{
+    /* 16 points on a square root sensor curve, denser where it bends most */
+    for (int i = 0; i < PWL_MAX_POINTS; i++) {
+        float x = 5.0f * pow(i / 15.0, 2);
+        ASSERT_EQ(pwlAddPoint(&table, x, sqrt(x)), 0);
+    }
+
+    /* Exact on the breakpoints. In between, the error is the chord error of the square root, which
+    ** is largest on the first segment: a quarter of its rise */
+    for (int i = 0; i < PWL_MAX_POINTS; i++) {
+        EXPECT_FLOAT_EQ(pwlEval(&table, table.x[i]), sqrt(table.x[i]));
+    }
+
+    double maxError = 0;
+    for (double x = 0; x <= 5.0; x += 0.001) {
+        maxError = max(maxError, fabs(pwlEval(&table, x) - sqrt(x)));
+    }
+    EXPECT_LT(maxError, sqrt(5.0) / 15.0 / 4 + 1e-6);
+}
@@ -0,0 +1,112 @@
+/*!
+** @file   portCurrent_tests.cpp
+** @date   18/10/2026
+*/
+
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+/* UUT */
+#include "portCurrent.c"
+
+using namespace std;
+
+/***************************************************************************************************
+** TEST FIXTURES
+***************************************************************************************************/
+
+class PortCurrent: public ::testing::Test
+{
+    protected:
+        /*******************************************************************************************
+        ** METHODS
+        *******************************************************************************************/
+        PortCurrent()
+        {
+            pcInit(buffer, NO_PORTS, NO_CHANNELS, HALF_SAMPLES, SAMPLES_PER_MS);
+        }
+
+        /* Moves the DMA to a sample of the buffer, and records the state of the ports from then on */
+        void record(int sample, uint16_t mask)
+        {
+            pcDmaPosition((2 * HALF_SAMPLES - sample) * NO_CHANNELS);
+            pcRecordPortStates(mask);
+        }
+
+        void setSamples(int channel, int from, int to, int16_t value)
+        {
+            for (int i = from; i < to; i++) {
+                buffer[i * NO_CHANNELS + channel] = value;
+            }
+        }
+
+        /*******************************************************************************************
+        ** MEMBERS
+        *******************************************************************************************/
+        static const int NO_PORTS       = 2;
+        static const int NO_CHANNELS    = 3;
+        static const int HALF_SAMPLES   = 400;
+        static const int SAMPLES_PER_MS = 4;
+
+        int16_t buffer[2 * HALF_SAMPLES * NO_CHANNELS] = {0};
+        const int16_t zeroLevels[NO_PORTS]             = {0, 0};
+        PortCurrentStats stats[NO_PORTS];
+};
+
+/***************************************************************************************************
+** TESTS
+***************************************************************************************************/
+
+TEST_F(PortCurrent, splitOnOff)
+{
+    setSamples(0, 0, 200, 100);
+    record(0, 0x1);
+    record(200, 0x0);
+    record(HALF_SAMPLES, 0x0);
+    pcUpdate(buffer, NO_CHANNELS, HALF_SAMPLES, zeroLevels, stats);
+
+    /* The first 10 ms after each change are not counted */
+    EXPECT_EQ(stats[0].onSamples, 160);
+    EXPECT_EQ(stats[0].offSamples, 160);
+    EXPECT_DOUBLE_EQ(stats[0].onRms, 100.0);
+    EXPECT_DOUBLE_EQ(stats[0].offRms, 0.0);
+
+    EXPECT_EQ(stats[1].onSamples, 0);
+    EXPECT_EQ(stats[1].offSamples, 400);
+}
+
+TEST_F(PortCurrent, toggleWithinSettlingTime)
+{
+    /* On for 10 samples only: the current of the next 10 ms is not counted for either state */
+    setSamples(0, 100, 150, 1000);
+    record(100, 0x1);
+    record(110, 0x0);
+    record(HALF_SAMPLES, 0x0);
+    pcUpdate(buffer, NO_CHANNELS, HALF_SAMPLES, zeroLevels, stats);
+
+    EXPECT_EQ(stats[0].onSamples, 0);
+    EXPECT_EQ(stats[0].offSamples, HALF_SAMPLES - 50);
+    EXPECT_DOUBLE_EQ(stats[0].offRms, 0.0);
+}
+
+TEST_F(PortCurrent, settlingAcrossHalves)
+{
+    /* Switched on just before the end of the first half: the start of the second half is not
+    ** counted. The DMA wraps at the end of the buffer */
+    int16_t* second = &buffer[HALF_SAMPLES * NO_CHANNELS];
+    setSamples(0, HALF_SAMPLES, 2 * HALF_SAMPLES, 50);
+    record(HALF_SAMPLES - 20, 0x1);
+    record(0, 0x1);
+    pcUpdate(second, NO_CHANNELS, HALF_SAMPLES, zeroLevels, stats);
+
+    EXPECT_EQ(stats[0].onSamples, HALF_SAMPLES - 20);
+    EXPECT_EQ(stats[0].offSamples, 0);
+    EXPECT_DOUBLE_EQ(stats[0].onRms, 50.0);
+}
+
+TEST_F(PortCurrent, mainsOn)
+{
+    EXPECT_FALSE(pcIsMainsOn(0.0f));
+    EXPECT_FALSE(pcIsMainsOn(0.5f));
+    EXPECT_TRUE(pcIsMainsOn(0.51f));
+}
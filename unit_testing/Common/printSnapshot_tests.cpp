@@ -0,0 +1,91 @@
+/*!
+** @file   printSnapshot_tests.cpp
+** @date   18/10/2026
+*/
+
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+/* UUT */
+#include "printSnapshot.c"
+
+/***************************************************************************************************
+** TEST FIXTURES
+***************************************************************************************************/
+
+class PrintSnapshotTest: public ::testing::Test 
+{
+    protected:
+        /*******************************************************************************************
+        ** METHODS
+        *******************************************************************************************/
+        PrintSnapshotTest()
+        {
+            snapshotInit(&sb);
+        }
+
+        /* What the timer interrupt does */
+        void publish(float value, uint32_t status)
+        {
+            PrintSnapshot* s = snapshotWrite(&sb);
+            for (float& v : s->values) v = value;
+            s->status = status;
+            snapshotPublish(&sb);
+        }
+
+        /*******************************************************************************************
+        ** MEMBERS
+        *******************************************************************************************/
+        SnapshotBuffer sb;
+        PrintSnapshot out;
+};
+
+/***************************************************************************************************
+** TESTS
+***************************************************************************************************/
+
+TEST_F(PrintSnapshotTest, readOnce)
+{
+    EXPECT_FALSE(snapshotRead(&sb, &out));
+
+    publish(1.5, 0x80000000);
+    EXPECT_TRUE(snapshotRead(&sb, &out));
+    EXPECT_EQ(out.values[0], 1.5);
+    EXPECT_EQ(out.values[SNAPSHOT_MAX_VALUES - 1], 1.5);
+    EXPECT_EQ(out.status, 0x80000000);
+
+    EXPECT_FALSE(snapshotRead(&sb, &out));
+}
+
+TEST_F(PrintSnapshotTest, latestWins)
+{
+    /* The main loop missed two snapshots. Only the latest is printed */
+    publish(1, 1);
+    publish(2, 2);
+    publish(3, 3);
+
+    EXPECT_TRUE(snapshotRead(&sb, &out));
+    EXPECT_EQ(out.values[0], 3);
+    EXPECT_EQ(out.status, 3U);
+    EXPECT_FALSE(snapshotRead(&sb, &out));
+}
+
+TEST_F(PrintSnapshotTest, interruptWhileReading)
+{
+    publish(1, 1);
+
+    /* The main loop has started copying the latest slot when the interrupt publishes twice */
+    int slot   = sb.latest;
+    sb.reading = slot;
+    publish(2, 2);
+    publish(3, 3);
+
+    EXPECT_EQ(sb.slots[slot].values[0], 1);
+    EXPECT_EQ(sb.slots[slot].status, 1U);
+
+    /* The next read gets the latest snapshot */
+    sb.reading = -1;
+    EXPECT_TRUE(snapshotRead(&sb, &out));
+    EXPECT_EQ(out.values[0], 3);
+    EXPECT_EQ(sb.reading, -1);
+}
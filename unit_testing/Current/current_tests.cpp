@@ -20,6 +20,7 @@ extern "C" {
 #include "fake_stm32xxxx_hal.h"
 #include "fake_StmGpio.h"
 #include "fake_USBprint.h"
+#include "fake_flashWriter.h"
 
 /* Real supporting units */
 #include "array-math.c"
@@ -29,6 +30,8 @@ extern "C" {
 #include "ADCmonitor.c"
 #include "CAProtocol.c"
 #include "CAProtocolStm.c"
+#include "flashRecord.c"
+#include "flashWriter.c"
 
 /* UUT */
 #include "CurrentApp.c"
@@ -50,21 +53,24 @@ class CurrentTest: public CaBoardUnitTest
         *******************************************************************************************/
         CurrentTest() : CaBoardUnitTest(currentAppLoop, Current, {LATEST_MAJOR, LATEST_MINOR}) {
             hadc.Init.NbrOfConversion = 5;
+            fakeFlashWriterInit(250);
         }
 
         void simTick()
         {
-            if(tickCounter != 0) {
-                /* ADC sampling speed ~= 2048 Hz, buffer = 1024 * 2. Will fill in a second */
-                if(tickCounter % 200 == 0) {
-                    HAL_ADC_ConvCpltCallback(&hadc);
+            fakeFlashTick([this] {
+                if(tickCounter != 0) {
+                    /* ADC sampling speed ~= 2048 Hz, buffer = 1024 * 2. Will fill in a second */
+                    if(tickCounter % 200 == 0) {
+                        HAL_ADC_ConvCpltCallback(&hadc);
+                    }
+                    else if(tickCounter % 100 == 0) {
+                        HAL_ADC_ConvHalfCpltCallback(&hadc);
+                    }
                 }
-                else if(tickCounter % 100 == 0) {
-                    HAL_ADC_ConvHalfCpltCallback(&hadc);
-                }
-            }
 
-            currentAppLoop(bootMsg);
+                currentAppLoop(bootMsg);
+            });
         }
 
         void fillAdcChannel(int ch, uint16_t val) {
@@ -159,6 +165,23 @@ TEST_F(CurrentTest, printSerial) {
     serialPrintoutTest(sst, "Current", "Calibration: CAL 1,1.000000,0 2,1.000000,0 3,1.000000,0\r");
 }
 
+TEST_F(CurrentTest, calibrationStored) {
+    currentSetup();
+    currentAppLoop(bootMsg);
+    (void) hostUSBread(true);
+
+    /* The calibration is written by the loop, which prints the currents again after the erase */
+    writeBoardMessage("CAL 2,2.5,0\n");
+    EXPECT_TRUE(flashWriterIsBusy());
+    goToTick(tickCounter + 400);
+    EXPECT_FALSE(flashWriterIsBusy());
+    EXPECT_FALSE(hostUSBread(true).empty());
+
+    currentSetup();
+    writeBoardMessage("Serial\n");
+    EXPECT_FLUSH_USB(Contains("Calibration: CAL 1,1.000000,0 2,2.500000,0 3,1.000000,0\r"));
+}
+
 TEST_F(CurrentTest, printStatus) {
     currentSetup();
     /* Note: usb RX buffer is flushed during the first loop, so a single loop must be done before
@@ -19,6 +19,7 @@
 #include "CAProtocol.c"
 #include "CAProtocolStm.c"
 #include "CAProtocolACDC.c"
+#include "ADCWatchdog.c"
 
 /* UUT */
 #include "DCBoard.c"
@@ -124,12 +125,12 @@ TEST_F(DCBoard, printStatus)
 {
     statusPrintoutTest(sst, {
         "The board is operating normally.\r",
-        "Port 0: On: 0, PWM percent: 0\r",
-        "Port 1: On: 0, PWM percent: 0\r",
-        "Port 2: On: 0, PWM percent: 0\r",
-        "Port 3: On: 0, PWM percent: 0\r",
-        "Port 4: On: 0, PWM percent: 0\r",
-        "Port 5: On: 0, PWM percent: 0\r"});
+        "Port 0: On: 0, PWM percent: 0, Peak current: 0.00 A\r",
+        "Port 1: On: 0, PWM percent: 0, Peak current: 0.00 A\r",
+        "Port 2: On: 0, PWM percent: 0, Peak current: 0.00 A\r",
+        "Port 3: On: 0, PWM percent: 0, Peak current: 0.00 A\r",
+        "Port 4: On: 0, PWM percent: 0, Peak current: 0.00 A\r",
+        "Port 5: On: 0, PWM percent: 0, Peak current: 0.00 A\r"});
     
     writeDcMessage("p2 on\n");
     writeDcMessage("p4 on\n");
@@ -139,12 +140,12 @@ TEST_F(DCBoard, printStatus)
     EXPECT_FLUSH_USB(ElementsAre( 
         "Start of board status:\r",
         "The board is operating normally.\r",
-        "Port 0: On: 0, PWM percent: 0\r",
-        "Port 1: On: 1, PWM percent: 999\r",
-        "Port 2: On: 0, PWM percent: 0\r",
-        "Port 3: On: 1, PWM percent: 999\r",
-        "Port 4: On: 0, PWM percent: 0\r",
-        "Port 5: On: 1, PWM percent: 999\r",
+        "Port 0: On: 0, PWM percent: 0, Peak current: 0.00 A\r",
+        "Port 1: On: 1, PWM percent: 999, Peak current: 0.00 A\r",
+        "Port 2: On: 0, PWM percent: 0, Peak current: 0.00 A\r",
+        "Port 3: On: 1, PWM percent: 999, Peak current: 0.00 A\r",
+        "Port 4: On: 0, PWM percent: 0, Peak current: 0.00 A\r",
+        "Port 5: On: 1, PWM percent: 999, Peak current: 0.00 A\r",
         "End of board status.\r"
     ));
 }
@@ -190,12 +191,12 @@ TEST_F(DCBoard, status24v)
     //     "\r", 
     //     "Start of board status:\r", 
     //     "Under voltage. The board operates at too low voltage of 0.00V. Check power supply.\r",
-    //     "Port 0: On: 0, PWM percent: 0\r", 
-    //     "Port 1: On: 0, PWM percent: 0\r", 
-    //     "Port 2: On: 0, PWM percent: 0\r", 
-    //     "Port 3: On: 0, PWM percent: 0\r", 
-    //     "Port 4: On: 0, PWM percent: 0\r", 
-    //     "Port 5: On: 0, PWM percent: 0\r", 
+    //     "Port 0: On: 0, PWM percent: 0, Peak current: 0.00 A\r", 
+    //     "Port 1: On: 0, PWM percent: 0, Peak current: 0.00 A\r", 
+    //     "Port 2: On: 0, PWM percent: 0, Peak current: 0.00 A\r", 
+    //     "Port 3: On: 0, PWM percent: 0, Peak current: 0.00 A\r", 
+    //     "Port 4: On: 0, PWM percent: 0, Peak current: 0.00 A\r", 
+    //     "Port 5: On: 0, PWM percent: 0, Peak current: 0.00 A\r", 
     //     "\r", 
     //     "End of board status. \r"
     // ));
@@ -206,7 +207,7 @@ TEST_F(DCBoard, status24v)
     // EXPECT_FLUSH_USB(Contains("0.00, 0.00, 0.00, 0.00, 0.00, 0.00, 0xb0000000"));
 }
 
-/* Grey box - uses getTimerCCR() */
+/* Grey box - uses portCCR */
 TEST_F(DCBoard, portsNoTimeout) 
 {
     dcSetup();
@@ -220,7 +221,7 @@ TEST_F(DCBoard, portsNoTimeout)
 
         if(i == 0 || i == (ACTUATIONPORTS + 1)) {
             for(int j = 0; j < ACTUATIONPORTS; j++) {
-                ASSERT_EQ(*getTimerCCR(j), 0) << "j = " << j;
+                ASSERT_EQ(*portCCR[j], 0) << "j = " << j;
             }
             sprintf(cmd, "MISREAD: Invalid Pin: %d\r", i);
             EXPECT_FLUSH_USB(Contains(cmd));
@@ -228,10 +229,10 @@ TEST_F(DCBoard, portsNoTimeout)
         else {
             for(int j = 1; j <= ACTUATIONPORTS; j++) {
                 if(j != i) {
-                    ASSERT_EQ(*getTimerCCR(j-1), 0) << "j = " << j;
+                    ASSERT_EQ(*portCCR[j-1], 0) << "j = " << j;
                 }
                 else {
-                    ASSERT_EQ(*getTimerCCR(j-1), 999) << "j = " << j;
+                    ASSERT_EQ(*portCCR[j-1], 999) << "j = " << j;
                 }
             }
         }
@@ -240,7 +241,7 @@ TEST_F(DCBoard, portsNoTimeout)
     }
 }
 
-/* Grey box - uses getTimerCCR() */
+/* Grey box - uses portCCR */
 TEST_F(DCBoard, portsPct) 
 {
     dcSetup();
@@ -255,7 +256,7 @@ TEST_F(DCBoard, portsPct)
 
         if(i == 0 || i == (ACTUATIONPORTS + 1)) {
             for(int j = 0; j < ACTUATIONPORTS; j++) {
-                ASSERT_EQ(*getTimerCCR(j), 0) << "j = " << j;
+                ASSERT_EQ(*portCCR[j], 0) << "j = " << j;
             }
             sprintf(cmd, "MISREAD: Invalid Pin: %d\r", i);
             EXPECT_FLUSH_USB(Contains(cmd));
@@ -263,10 +264,10 @@ TEST_F(DCBoard, portsPct)
         else {
             for(int j = 1; j <= ACTUATIONPORTS; j++) {
                 if(j != i) {
-                    ASSERT_EQ(*getTimerCCR(j-1), 0) << "j = " << j;
+                    ASSERT_EQ(*portCCR[j-1], 0) << "j = " << j;
                 }
                 else {
-                    ASSERT_EQ(*getTimerCCR(j-1), pct_ccr) << "j = " << j;
+                    ASSERT_EQ(*portCCR[j-1], pct_ccr) << "j = " << j;
                 }
             }
         }
@@ -275,7 +276,7 @@ TEST_F(DCBoard, portsPct)
     }
 }
 
-/* Grey box - uses getTimerCCR() */
+/* Grey box - uses portCCR */
 TEST_F(DCBoard, portsTimeout) 
 {
     dcSetup();
@@ -290,7 +291,7 @@ TEST_F(DCBoard, portsTimeout)
 
         if(i == 0 || i == (ACTUATIONPORTS + 1)) {
             for(int j = 0; j < ACTUATIONPORTS; j++) {
-                ASSERT_EQ(*getTimerCCR(j), 0) << "j = " << j << ", tick = " << tickCounter;
+                ASSERT_EQ(*portCCR[j], 0) << "j = " << j << ", tick = " << tickCounter;
             }
             sprintf(cmd, "MISREAD: Invalid Pin: %d\r", i);
             EXPECT_FLUSH_USB(Contains(cmd));
@@ -299,12 +300,12 @@ TEST_F(DCBoard, portsTimeout)
             simTicks(timeout_ticks);
             for(int j = 1; j <= ACTUATIONPORTS; j++) {
                 if(j != i) {
-                    ASSERT_EQ(*getTimerCCR(j-1), 0) << "j = " << j << ", tick = " << tickCounter;
+                    ASSERT_EQ(*portCCR[j-1], 0) << "j = " << j << ", tick = " << tickCounter;
                 }
                 else {
-                    ASSERT_EQ(*getTimerCCR(j-1), 999) << "j = " << j << ", tick = " << tickCounter;
+                    ASSERT_EQ(*portCCR[j-1], 999) << "j = " << j << ", tick = " << tickCounter;
                     simTicks();
-                    ASSERT_EQ(*getTimerCCR(j-1), 0) << "j = " << j << ", tick = " << tickCounter;
+                    ASSERT_EQ(*portCCR[j-1], 0) << "j = " << j << ", tick = " << tickCounter;
                 }
             }
         }
@@ -313,7 +314,7 @@ TEST_F(DCBoard, portsTimeout)
     }
 }
 
-/* Grey box - uses getTimerCCR() */
+/* Grey box - uses portCCR */
 TEST_F(DCBoard, onboardButtons) 
 {
     dcSetup();
@@ -322,7 +323,7 @@ TEST_F(DCBoard, onboardButtons)
     for(int i = 0; i < ACTUATIONPORTS; i++) {
         /* All ports initially off */
         for(int j = 0; j < ACTUATIONPORTS; j++) {
-            ASSERT_EQ(*getTimerCCR(j), 0) << "j = " << j;
+            ASSERT_EQ(*portCCR[j], 0) << "j = " << j;
         }
 
         /* Press a button */
@@ -332,10 +333,10 @@ TEST_F(DCBoard, onboardButtons)
         /* Only the requested port should be on */
         for(int j = 0; j < ACTUATIONPORTS; j++) {
             if(j != i) {
-                ASSERT_EQ(*getTimerCCR(j), 0) << "j = " << j;    
+                ASSERT_EQ(*portCCR[j], 0) << "j = " << j;    
             } 
             else {
-                ASSERT_EQ(*getTimerCCR(j), 999) << "j = " << j;
+                ASSERT_EQ(*portCCR[j], 999) << "j = " << j;
             }
         }
 
@@ -363,7 +364,7 @@ TEST_F(DCBoard, onboardButtons)
     }
 }   
 
-/* Grey box - uses getTimerCCR() */
+/* Grey box - uses portCCR */
 TEST_F(DCBoard, onboardButtonsOff) 
 {
     dcSetup();
@@ -374,7 +375,7 @@ TEST_F(DCBoard, onboardButtonsOff)
         writeDcMessage("all on 5\n");
 
         for(int j = 0; j < ACTUATIONPORTS; j++) {
-            ASSERT_EQ(*getTimerCCR(j), 999) << "j = " << j;
+            ASSERT_EQ(*portCCR[j], 999) << "j = " << j;
         }
 
         /* Put one port on a timer */
@@ -388,7 +389,7 @@ TEST_F(DCBoard, onboardButtonsOff)
 
         /* There should be no effect */
         for(int j = 0; j < ACTUATIONPORTS; j++) {
-            ASSERT_EQ(*getTimerCCR(j), 999) << "j = " << j;    
+            ASSERT_EQ(*portCCR[j], 999) << "j = " << j;    
         }
 
         simTicks(100); /* Could take up to 100 ms for another print */
@@ -401,13 +402,13 @@ TEST_F(DCBoard, onboardButtonsOff)
 
         /* Timer port should turn off 1 second after the start of the test */
         simTicks(700);
-        ASSERT_EQ(*getTimerCCR(i), 999) << "i = " << i;   
+        ASSERT_EQ(*portCCR[i], 999) << "i = " << i;   
         simTicks();
-        ASSERT_EQ(*getTimerCCR(i), 0) << "i = " << i;   
+        ASSERT_EQ(*portCCR[i], 0) << "i = " << i;   
     }
 }   
 
-/* Grey box - uses getTimerCCR() */
+/* Grey box - uses portCCR */
 TEST_F(DCBoard, onboardButtonsPortDurationExpiresDuringOnPeriod) 
 {
     dcSetup();
@@ -418,7 +419,7 @@ TEST_F(DCBoard, onboardButtonsPortDurationExpiresDuringOnPeriod)
         writeDcMessage("all on 5\n");
 
         for(int j = 0; j < ACTUATIONPORTS; j++) {
-            ASSERT_EQ(*getTimerCCR(j), 999) << "j = " << j;
+            ASSERT_EQ(*portCCR[j], 999) << "j = " << j;
         }
 
         /* Put one port on a shorter timer */
@@ -432,7 +433,7 @@ TEST_F(DCBoard, onboardButtonsPortDurationExpiresDuringOnPeriod)
 
         /* There should be no effect */
         for(int j = 0; j < ACTUATIONPORTS; j++) {
-            ASSERT_EQ(*getTimerCCR(j), 999) << "j = " << j;    
+            ASSERT_EQ(*portCCR[j], 999) << "j = " << j;    
         }
 
         simTicks(100); /* Could take up to 100 ms for another print */
@@ -442,15 +443,246 @@ TEST_F(DCBoard, onboardButtonsPortDurationExpiresDuringOnPeriod)
         /* Timer port should time out after 1 second but not turn off because button is pressed */
         simTicks(800);
         simTicks();
-        ASSERT_EQ(*getTimerCCR(i), 999) << "i = " << i;   
+        ASSERT_EQ(*portCCR[i], 999) << "i = " << i;   
 
         /* Release button */
         stmSetGpio(buttonGpio[i], true);
         simTicks(100); /* Should respond within 100 ms */
-        ASSERT_EQ(*getTimerCCR(i), 0) << "i = " << i;   
+        ASSERT_EQ(*portCCR[i], 0) << "i = " << i;   
     }
 }   
 
+/* Grey box - uses portCCR */
+TEST_F(DCBoard, portsWriteOnChange) 
+{
+    dcSetup();
+    goToTick(1);
+
+    writeDcMessage("p1 on\n");
+    EXPECT_EQ(*portCCR[0], 999);
+
+    /* Registers are not rewritten while the duty cycles are unchanged */
+    *portCCR[0] = 123;
+    *portCCR[1] = 456;
+    simTicks(10);
+    EXPECT_EQ(*portCCR[0], 123);
+    EXPECT_EQ(*portCCR[1], 456);
+
+    /* Only the changed port is written */
+    writeDcMessage("p2 on\n");
+    EXPECT_EQ(*portCCR[0], 123);
+    EXPECT_EQ(*portCCR[1], 999);
+
+    /* Update events are enabled again after writing */
+    EXPECT_FALSE(TIM1->CR1 & TIM_CR1_UDIS);
+    EXPECT_FALSE(TIM2->CR1 & TIM_CR1_UDIS);
+
+    writeDcMessage("all off\n");
+    for(int j = 0; j < ACTUATIONPORTS; j++) {
+        EXPECT_EQ(*portCCR[j], 0) << "j = " << j;
+    }
+}
+
+/* Grey box - uses portCCR and calls the ADC watchdog scan that normally runs in the timer ISR */
+TEST_F(DCBoard, overVoltageTrip) 
+{
+    dcSetup();
+    goToTick(1);
+
+    writeDcMessage("all on 20\n");
+    for(int j = 0; j < ACTUATIONPORTS; j++) {
+        ASSERT_EQ(*portCCR[j], 999) << "j = " << j;
+    }
+
+    /* Short over voltage spike in the middle of the buffer - too short to show in the mean */
+    int16_t* adcBuffer = (int16_t*)hadc.dma_address;
+    for(int i = 50; i < 50 + OVER_VOLTAGE_DEBOUNCE; i++) {
+        adcBuffer[ADC_CHANNELS*i + INPUT_V_CHANNEL_IDX] = 1100;
+    }
+
+    /* One sample short of the debounce - ports stay on */
+    adcWatchdogScan(50 + OVER_VOLTAGE_DEBOUNCE - 1);
+    for(int j = 0; j < ACTUATIONPORTS; j++) {
+        ASSERT_EQ(*portCCR[j], 999) << "j = " << j;
+    }
+
+    /* Ports are cut directly from the interrupt */
+    adcWatchdogScan(50 + OVER_VOLTAGE_DEBOUNCE);
+    for(int j = 0; j < ACTUATIONPORTS; j++) {
+        ASSERT_EQ(*portCCR[j], 0) << "j = " << j;
+    }
+
+    /* ... and stay off in the main loop, which reports the over voltage */
+    goToTick(100);
+    EXPECT_FLUSH_USB(Contains("0.00, 0.00, 0.00, 0.00, 0.00, 0.00, 0x90000000\r"));
+    for(int j = 0; j < ACTUATIONPORTS; j++) {
+        ASSERT_EQ(*portCCR[j], 0) << "j = " << j;
+    }
+
+    /* Spike gone from the mean - error clears and the ports can be turned on again */
+    setADCChannelBuffer(INPUT_V_CHANNEL_IDX, 800);
+    goToTick(300);
+    EXPECT_FLUSH_USB(Contains("0.00, 0.00, 0.00, 0.00, 0.00, 0.00, 0x00000000\r"));
+    writeDcMessage("p1 on\n");
+    EXPECT_EQ(*portCCR[0], 999);
+}
+
+/* Grey box - uses portCCR and calls the ADC watchdog scan that normally runs in the timer ISR */
+TEST_F(DCBoard, overCurrentTrip) 
+{
+    dcSetup();
+    goToTick(1);
+
+    writeDcMessage("all on 20\n");
+
+    /* Short over current on port 2 - ~6A */
+    int16_t* adcBuffer = (int16_t*)hadc.dma_address;
+    for(int i = 50; i < 50 + PORT_OVER_CURRENT_DEBOUNCE; i++) {
+        adcBuffer[ADC_CHANNELS*i + 1] = 4000;
+    }
+
+    adcWatchdogScan(50 + PORT_OVER_CURRENT_DEBOUNCE - 1);
+    ASSERT_EQ(*portCCR[1], 999);
+
+    /* Only the port with the over current is cut */
+    adcWatchdogScan(50 + PORT_OVER_CURRENT_DEBOUNCE);
+    for(int j = 0; j < ACTUATIONPORTS; j++) {
+        ASSERT_EQ(*portCCR[j], (j == 1) ? 0 : 999) << "j = " << j;
+    }
+
+    /* The port stays off and the error is reported until the port is commanded again */
+    for(int i = 50; i < 50 + PORT_OVER_CURRENT_DEBOUNCE; i++) {
+        adcBuffer[ADC_CHANNELS*i + 1] = 2048;
+    }
+    goToTick(300);
+    EXPECT_EQ(*portCCR[1], 0);
+    EXPECT_TRUE(bsGetField(DC_BOARD_PORT_x_OVER_CURRENT_Msk(1)));
+    EXPECT_FALSE(bsGetField(DC_BOARD_PORT_x_OVER_CURRENT_Msk(0)));
+    EXPECT_TRUE(bsGetField(BS_ERROR_Msk));
+
+    writeDcMessage("p2 on\n");
+    EXPECT_EQ(*portCCR[1], 999);
+    EXPECT_FALSE(bsGetField(DC_BOARD_PORTS_OVER_CURRENT_Msk));
+    EXPECT_FALSE(bsGetField(BS_ERROR_Msk));
+
+    writeDcMessage("all off\n");
+}
+
+/* Grey box - an over current trip between overCurrentLoop and handlePorts in the main loop */
+TEST_F(DCBoard, overCurrentTripBeforeHandlePorts) 
+{
+    dcSetup();
+    goToTick(1);
+
+    writeDcMessage("p2 on\n");
+
+    int16_t* adcBuffer = (int16_t*)hadc.dma_address;
+    for(int i = 50; i < 50 + PORT_OVER_CURRENT_DEBOUNCE; i++) {
+        adcBuffer[ADC_CHANNELS*i + 1] = 4000;
+    }
+
+    overCurrentLoop();
+    adcWatchdogScan(50 + PORT_OVER_CURRENT_DEBOUNCE);
+    ASSERT_EQ(*portCCR[1], 0);
+
+    /* The port is still commanded on, but is not switched back on */
+    handlePorts();
+    EXPECT_EQ(*portCCR[1], 0);
+
+    /* The next loop reports the over current */
+    for(int i = 50; i < 50 + PORT_OVER_CURRENT_DEBOUNCE; i++) {
+        adcBuffer[ADC_CHANNELS*i + 1] = 2048;
+    }
+    simTicks(1);
+    EXPECT_EQ(*portCCR[1], 0);
+    EXPECT_TRUE(bsGetField(DC_BOARD_PORT_x_OVER_CURRENT_Msk(1)));
+
+    writeDcMessage("p2 on\n");
+    EXPECT_EQ(*portCCR[1], 999);
+    writeDcMessage("all off\n");
+}
+
+/* Grey box - an over voltage trip between overVoltageLoop and handlePorts in the main loop */
+TEST_F(DCBoard, overVoltageTripBeforeHandlePorts) 
+{
+    dcSetup();
+    goToTick(1);
+
+    writeDcMessage("all on 20\n");
+
+    int16_t* adcBuffer = (int16_t*)hadc.dma_address;
+    for(int i = 50; i < 50 + OVER_VOLTAGE_DEBOUNCE; i++) {
+        adcBuffer[ADC_CHANNELS*i + INPUT_V_CHANNEL_IDX] = 1100;
+    }
+
+    overVoltageLoop();
+    adcWatchdogScan(50 + OVER_VOLTAGE_DEBOUNCE);
+    handlePorts();
+    for(int j = 0; j < ACTUATIONPORTS; j++) {
+        EXPECT_EQ(*portCCR[j], 0) << "j = " << j;
+    }
+
+    /* The next loop turns the ports off */
+    setADCChannelBuffer(INPUT_V_CHANNEL_IDX, 800);
+    simTicks(1);
+    for(int j = 0; j < ACTUATIONPORTS; j++) {
+        EXPECT_EQ(port_state[j], 0) << "j = " << j;
+        EXPECT_EQ(*portCCR[j], 0) << "j = " << j;
+    }
+}
+
+/* The highest current of each port in a PWM period is shown in the status */
+TEST_F(DCBoard, peakCurrent) 
+{
+    dcSetup();
+    goToTick(1);
+
+    /* ~2A, with a single period of ~4A on port 1 */
+    writeDcMessage("p1 on 50%\n");
+    setADCChannelBuffer(0, 2703);
+    int16_t* adcBuffer = (int16_t*)hadc.dma_address;
+    adcBuffer[ADC_CHANNELS*30] = 3359;
+    goToTick(100);
+    EXPECT_FLUSH_USB(Contains("1.00, 0.00, 0.00, 0.00, 0.00, 0.00, 0x00000001\r"));
+
+    writeDcMessage("Status\n");
+    EXPECT_FLUSH_USB(ElementsAre( 
+        "Start of board status:\r",
+        "The board is operating normally.\r",
+        "Port 0: On: 1, PWM percent: 499, Peak current: 4.00 A\r",
+        "Port 1: On: 0, PWM percent: 0, Peak current: 0.00 A\r",
+        "Port 2: On: 0, PWM percent: 0, Peak current: 0.00 A\r",
+        "Port 3: On: 0, PWM percent: 0, Peak current: 0.00 A\r",
+        "Port 4: On: 0, PWM percent: 0, Peak current: 0.00 A\r",
+        "Port 5: On: 0, PWM percent: 0, Peak current: 0.00 A\r",
+        "End of board status.\r"
+    ));
+
+    writeDcMessage("p1 off\n");
+}
+
+/* The current is sampled at the centre of the PWM pulse, so the mean is scaled by the duty cycle */
+TEST_F(DCBoard, pwmCurrent) 
+{
+    dcSetup();
+    goToTick(1);
+
+    /* ~2A while the port is on */
+    setADCChannelBuffer(0, 2703);
+    writeDcMessage("p1 on 50%\n");
+    goToTick(200);
+    EXPECT_FLUSH_USB(Contains("1.00, 0.00, 0.00, 0.00, 0.00, 0.00, 0x00000001\r"));
+
+    writeDcMessage("p1 on\n");
+    goToTick(400);
+    EXPECT_FLUSH_USB(Contains("2.00, 0.00, 0.00, 0.00, 0.00, 0.00, 0x00000001\r"));
+
+    writeDcMessage("p1 off\n");
+    setADCChannelBuffer(0, 2048);
+    goToTick(600);
+    EXPECT_FLUSH_USB(Contains("0.00, 0.00, 0.00, 0.00, 0.00, 0.00, 0x00000000\r"));
+}
+
 TEST_F(DCBoard, testCurrentBuffer) {
     dcSetup();
     goToTick(100);
@@ -485,19 +717,19 @@ TEST_F(DCBoard, testPortShutOffAtUSBDisconnect)
 
     /* All ports should be on */
     for(int j = 0; j < ACTUATIONPORTS; j++) {
-        ASSERT_EQ(*getTimerCCR(j), 999) << "j = " << j;    
+        ASSERT_EQ(*portCCR[j], 999) << "j = " << j;    
     }
 
     goToTick(5000);
     /* All ports should still be on */
     for(int j = 0; j < ACTUATIONPORTS; j++) {
-        ASSERT_EQ(*getTimerCCR(j), 999) << "j = " << j;    
+        ASSERT_EQ(*portCCR[j], 999) << "j = " << j;    
     }
 
     goToTick(20002);
     /* All ports should be shut off after 20 seconds */
     for(int j = 0; j < ACTUATIONPORTS; j++) {
-        ASSERT_EQ(*getTimerCCR(j), 0) << "j = " << j;    
+        ASSERT_EQ(*portCCR[j], 0) << "j = " << j;    
     }
 
     // Reset timer and turn on ports on again
@@ -505,7 +737,7 @@ TEST_F(DCBoard, testPortShutOffAtUSBDisconnect)
 
     /* All ports should be on */
     for(int j = 0; j < ACTUATIONPORTS; j++) {
-        ASSERT_EQ(*getTimerCCR(j), 999) << "j = " << j;    
+        ASSERT_EQ(*portCCR[j], 999) << "j = " << j;    
     }
 
     /* Disconnect USB */
@@ -513,13 +745,13 @@ TEST_F(DCBoard, testPortShutOffAtUSBDisconnect)
     goToTick(22500);
      /* Ports should not turn off until 5 seconds after USB disconnect */
     for(int j = 0; j < ACTUATIONPORTS; j++) {
-        ASSERT_EQ(*getTimerCCR(j), 999) << "j = " << j;    
+        ASSERT_EQ(*portCCR[j], 999) << "j = " << j;    
     }
 
     // Takes a 100 ticks to go to the ADC callback function
     goToTick(25100);
     /* Ports should not turn off until 5 seconds after USB disconnect */
     for(int j = 0; j < ACTUATIONPORTS; j++) {
-        ASSERT_EQ(*getTimerCCR(j), 0) << "j = " << j;    
+        ASSERT_EQ(*portCCR[j], 0) << "j = " << j;    
     }
 }
\ No newline at end of file
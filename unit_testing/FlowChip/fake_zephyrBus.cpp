@@ -0,0 +1,101 @@
+/*!
+** @file   fake_zephyrBus.cpp
+** @brief  Fake of the interrupt driven reads of the Honeywell Zephyr flow sensor
+** @date   18/10/2026
+**
+** A read completes straight away with the flow at the tick it was started at, encoded with the
+** transfer function of the sensor. zephyrBusInit restores a flow of 0.
+*/
+
+#include <math.h>
+
+#include "fake_stm32xxxx_hal.h"
+#include "fake_zephyrBus.h"
+
+/***************************************************************************************************
+** PRIVATE VARIABLES
+***************************************************************************************************/
+
+static std::function<float(uint32_t)> flowOf;
+static ZephyrBusState state = ZEPHYR_BUS_IDLE;
+static uint16_t lastCode = 0;
+static uint16_t status = 0;
+static bool failing = false;
+static int reads = 0;
+static int collisions = 0;
+
+/***************************************************************************************************
+** PRIVATE FUNCTION DEFINITIONS
+***************************************************************************************************/
+
+static uint16_t encode(float flow) {
+    /* Rounded up, so a flow of 0 does not print as -0.00 */
+    float code = ceilf((flow * ZEPHYR_CODE_SPAN + ZEPHYR_CODE_OFFSET) * ZEPHYR_CODE_RANGE);
+    code = fmaxf(0.0f, fminf(code, ZEPHYR_CODE_RANGE - 1));
+    return (uint16_t) code;
+}
+
+/***************************************************************************************************
+** FAKED FUNCTION DEFINITIONS
+***************************************************************************************************/
+
+void zephyrBusInit(I2C_HandleTypeDef* hi2c) {
+    (void) hi2c;
+    flowOf     = [](uint32_t) { return 0.0f; };
+    state      = ZEPHYR_BUS_IDLE;
+    failing    = false;
+    status     = 0;
+    reads      = 0;
+    collisions = 0;
+}
+
+bool zephyrBusStartRead() {
+    if (state != ZEPHYR_BUS_IDLE) {
+        collisions++;
+        return false;
+    }
+
+    if (failing) {
+        state = ZEPHYR_BUS_ERROR;
+        return true;
+    }
+
+    lastCode = encode(flowOf(HAL_GetTick())) | status;
+    state    = ZEPHYR_BUS_DONE;
+    reads++;
+    return true;
+}
+
+ZephyrBusState zephyrBusPoll(uint16_t* code) {
+    ZephyrBusState s = state;
+
+    if (s == ZEPHYR_BUS_DONE) {
+        *code = lastCode;
+    }
+    state = ZEPHYR_BUS_IDLE;
+    return s;
+}
+
+/***************************************************************************************************
+** FAKE CONTROL FUNCTIONS
+***************************************************************************************************/
+
+void fakeZephyrBusSetFlow(std::function<float(uint32_t)> flow) {
+    flowOf = flow;
+}
+
+void fakeZephyrBusSetFailing(bool isFailing) {
+    failing = isFailing;
+}
+
+void fakeZephyrBusSetStatus(uint16_t statusBits) {
+    status = statusBits & ZEPHYR_CODE_STATUS_Msk;
+}
+
+int fakeZephyrBusReads() {
+    return reads;
+}
+
+int fakeZephyrBusCollisions() {
+    return collisions;
+}
@@ -0,0 +1,34 @@
+/*!
+** @file   fake_zephyrBus.h
+** @brief  Fake of the interrupt driven reads of the Honeywell Zephyr flow sensor
+** @date   18/10/2026
+*/
+
+#ifndef FAKE_ZEPHYR_BUS_H_
+#define FAKE_ZEPHYR_BUS_H_
+
+#include <stdint.h>
+#include <functional>
+
+#include "zephyrBus.h"
+
+/***************************************************************************************************
+** PUBLIC FUNCTION DECLARATIONS
+***************************************************************************************************/
+
+/* Sets the flow (fraction of full scale) as a function of the tick a read is started at */
+void fakeZephyrBusSetFlow(std::function<float(uint32_t)> flow);
+
+/* Makes all reads fail, e.g. as if the sensor was unplugged */
+void fakeZephyrBusSetFailing(bool isFailing);
+
+/* Sets the status bits of the reads, e.g. as if the sensor reported a fault */
+void fakeZephyrBusSetStatus(uint16_t statusBits);
+
+/* Number of successful reads */
+int fakeZephyrBusReads();
+
+/* Number of reads started while another one was in flight. Must always be 0 */
+int fakeZephyrBusCollisions();
+
+#endif /* FAKE_ZEPHYR_BUS_H_ */
@@ -8,6 +8,7 @@
 
 extern "C" {
     uint32_t _FlashAddrCal = 0;
+    uint32_t _FlashAddrCalLegacy = 0;
 }
 
 #include "caBoardUnitTests.h"
@@ -16,11 +17,16 @@ extern "C" {
 /* Fakes */
 #include "fake_stm32xxxx_hal.h"
 #include "fake_USBprint.h"
+#include "fake_zephyrBus.h"
+#include "fake_flashWriter.h"
 #include "FLASH_readwrite.h"
 
 /* Real supporting units */
 #include "CAProtocol.c"
 #include "CAProtocolStm.c"
+#include "flowTotaliser.c"
+#include "flashRecord.c"
+#include "flashWriter.c"
 
 /* UUT */
 #include "flowChip.c"
@@ -29,6 +35,7 @@ using ::testing::AnyOf;
 using ::testing::AllOf;
 using ::testing::Contains;
 using ::testing::ElementsAre;
+using ::testing::HasSubstr;
 using ::testing::IsEmpty;
 using namespace std;
 
@@ -42,15 +49,23 @@ class FlowChipBoard: public CaBoardUnitTest
         /*******************************************************************************************
         ** METHODS
         *******************************************************************************************/
-        FlowChipBoard() : CaBoardUnitTest(flowChipLoop, GasFlow, {LATEST_MAJOR, LATEST_MINOR}) { }
+        FlowChipBoard() : CaBoardUnitTest(flowChipLoop, GasFlow, {LATEST_MAJOR, LATEST_MINOR}) {
+            fakeFlashWriterInit(250);
+        }
 
         void simTick() {
-            flowChipLoop(bootMsg);
+            fakeFlashTick([this] {
+                /* Emulates a main loop which is sometimes late, e.g. due to a slow USB transfer */
+                if ((tickCounter % 250) >= stallMs) {
+                    flowChipLoop(bootMsg);
+                }
+            });
         }
 
         void storeCalibrationInFlash() {
-            uint32_t offset = 0;
-            writeToFlash(FLASH_ADDR_CAL, (uint8_t*) &offset, sizeof(uint32_t));
+            static float stored = 0;
+            ASSERT_EQ(flashWriterStart((uint32_t) FLASH_ADDR_CAL, &stored, sizeof(stored), NULL), 0);
+            fakeFlashWriterFlush();
         }
 
         /*******************************************************************************************
@@ -61,6 +76,8 @@ class FlowChipBoard: public CaBoardUnitTest
         WWDG_HandleTypeDef hwwdg;
         CRC_HandleTypeDef hcrc;
 
+        uint32_t stallMs = 0;
+
         SerialStatusTest sst = {
             .boundInit = bind(flowChipInit, &hi2c, &hwwdg, &hcrc),
             .testFixture = this,
@@ -123,3 +140,139 @@ TEST_F(FlowChipBoard, wrongotp) {
         "End of board status. \r"
     ));
 }
+
+TEST_F(FlowChipBoard, pulsatingFlow) {
+    storeCalibrationInFlash();
+    flowChipInit(&hi2c, &hwwdg, &hcrc);
+
+    /* Full scale for 50 ms, then 0 for 50 ms. A single reading every 100 ms only sees one phase */
+    fakeZephyrBusSetFlow([](uint32_t tick) { return ((tick / 50) % 2) ? 0.0f : 1.0f; });
+    goToTick(10000);
+
+    /* Every tick is sampled. The samples from tick 1 to tick 9999 have been integrated */
+    EXPECT_EQ(fakeZephyrBusReads(), 10000);
+    EXPECT_EQ(fakeZephyrBusCollisions(), 0);
+    EXPECT_NEAR(flowTotTotal(&totaliser), 0.5 * SLPM * 9998 / 60000.0, 0.001);
+
+    char mean[20];
+    snprintf(mean, sizeof(mean), "%0.2f, ", 0.5 * SLPM);
+    EXPECT_FLUSH_USB(Contains(HasSubstr(mean)));
+}
+
+TEST_F(FlowChipBoard, lateLoop) {
+    storeCalibrationInFlash();
+    flowChipInit(&hi2c, &hwwdg, &hcrc);
+
+    /* The loop doesn't run for 150 ms out of every 250 ms, so it only prints every 250 ms */
+    stallMs = 150;
+    fakeZephyrBusSetFlow([](uint32_t tick) { (void) tick; return 0.6f; });
+    goToTick(60151);
+
+    /* The first sample is taken at tick 150 and the last one at tick 60150, i.e. 1 minute */
+    double flow = lastFlowData * SLPM + offset;
+    EXPECT_NEAR(flowTotTotal(&totaliser), flow, 1e-6);
+    EXPECT_EQ(fakeZephyrBusCollisions(), 0);
+
+    /* The last print is at tick 60150. The read started at tick 59999 was the last one before */
+    char line[40];
+    snprintf(line, sizeof(line), "%0.2f, %0.2f, 0x00000000", flow, flow * 59849 / 60000.0);
+    EXPECT_FLUSH_USB(Contains(HasSubstr(line)));
+
+    writeBoardMessage("reset\n");
+    EXPECT_EQ(flowTotTotal(&totaliser), 0);
+}
+
+TEST_F(FlowChipBoard, calibrationStored) {
+    flowChipInit(&hi2c, &hwwdg, &hcrc);
+    fakeZephyrBusSetFlow([](uint32_t tick) { (void) tick; return 0.5f; });
+    goToTick(1000);
+    EXPECT_TRUE(bsGetField(FLOWCHIP_WARNING_NO_CAL_Msk));
+
+    /* Written by the loop. The CPU stalls during the erase, so the sensor is not read meanwhile */
+    writeBoardMessage("CAL 1,0.5,0\n");
+    EXPECT_TRUE(flashWriterIsBusy());
+    int reads = fakeZephyrBusReads();
+    goToTick(1200);
+    EXPECT_TRUE(flashWriterIsBusy());
+    EXPECT_LE(fakeZephyrBusReads() - reads, 2);
+
+    /* The warning is cleared once done, and the sensor is sampled again */
+    goToTick(1300);
+    EXPECT_FALSE(flashWriterIsBusy());
+    EXPECT_FALSE(bsGetField(FLOWCHIP_WARNING_NO_CAL_Msk));
+    reads = fakeZephyrBusReads();
+    goToTick(1400);
+    EXPECT_GE(fakeZephyrBusReads() - reads, 99);
+
+    float stored = 0;
+    ASSERT_EQ(flashWriterRead((uint32_t) FLASH_ADDR_CAL, &stored, sizeof(stored)), (int) sizeof(stored));
+    EXPECT_FLOAT_EQ(stored, offset);
+}
+
+TEST_F(FlowChipBoard, calibrationMoved) {
+    /* Written by a firmware which kept the calibration in the 128K sector */
+    float legacy = 1.5f;
+    ASSERT_EQ(writeToFlashCRC(&hcrc, (uint32_t) FLASH_ADDR_CAL_LEGACY, (uint8_t*) &legacy, sizeof(legacy)), 0);
+
+    flowChipInit(&hi2c, &hwwdg, &hcrc);
+    EXPECT_FLOAT_EQ(offset, legacy);
+    EXPECT_FALSE(bsGetField(FLOWCHIP_WARNING_NO_CAL_Msk));
+
+    /* Moved to the calibration sector once, by the loop */
+    EXPECT_TRUE(flashWriterIsBusy());
+    goToTick(1000);
+    EXPECT_FALSE(flashWriterIsBusy());
+    float stored = 0;
+    ASSERT_EQ(flashWriterRead((uint32_t) FLASH_ADDR_CAL, &stored, sizeof(stored)), (int) sizeof(stored));
+    EXPECT_FLOAT_EQ(stored, legacy);
+}
+
+TEST_F(FlowChipBoard, sensorError) {
+    storeCalibrationInFlash();
+    flowChipInit(&hi2c, &hwwdg, &hcrc);
+
+    fakeZephyrBusSetFlow([](uint32_t tick) { (void) tick; return 0.5f; });
+    goToTick(1000);
+
+    /* The read in flight still completes */
+    fakeZephyrBusSetFailing(true);
+    goToTick(1001);
+    double total = flowTotTotal(&totaliser);
+    EXPECT_GT(total, 0);
+
+    /* Nothing is added while the sensor doesn't answer, and the gap is not interpolated */
+    goToTick(2001);
+    EXPECT_EQ(flowTotTotal(&totaliser), total);
+    EXPECT_FLUSH_USB(Contains(HasSubstr("10000.00, ")));
+
+    writeBoardMessage("CAL 1,0.5,0\n");
+    EXPECT_FLUSH_USB(Contains(HasSubstr("Could not communicate with sensor")));
+
+    /* The first sample after the error starts a new segment, the second one adds 1 ms */
+    fakeZephyrBusSetFailing(false);
+    goToTick(2004);
+    EXPECT_NEAR(flowTotTotal(&totaliser), total + (lastFlowData * SLPM + offset) / 60000.0, 1e-9);
+}
+
+TEST_F(FlowChipBoard, sensorStatusBits) {
+    storeCalibrationInFlash();
+    flowChipInit(&hi2c, &hwwdg, &hcrc);
+
+    fakeZephyrBusSetFlow([](uint32_t tick) { (void) tick; return 0.5f; });
+    goToTick(1000);
+
+    /* A reading with the status bits set is not a flow, and ends the segment like a failed read */
+    fakeZephyrBusSetStatus(ZEPHYR_CODE_STATUS_Msk);
+    goToTick(1001);
+    double total = flowTotTotal(&totaliser);
+    EXPECT_GT(total, 0);
+
+    goToTick(2001);
+    EXPECT_EQ(flowTotTotal(&totaliser), total);
+    EXPECT_FALSE(isFlowValid);
+    EXPECT_FLUSH_USB(Contains(HasSubstr("10000.00, ")));
+
+    fakeZephyrBusSetStatus(0);
+    goToTick(2004);
+    EXPECT_NEAR(flowTotTotal(&totaliser), total + (lastFlowData * SLPM + offset) / 60000.0, 1e-9);
+}
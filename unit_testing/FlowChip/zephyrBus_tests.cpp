@@ -0,0 +1,116 @@
+/*!
+** @file   zephyrBus_tests.cpp
+** @date   19/10/2026
+**
+** The I2C driver is faked here, so that reads can be left in flight for as long as a test needs.
+*/
+
+#include <gtest/gtest.h>
+
+#include "stm32f4xx_hal.h"
+
+/* Fakes */
+static uint32_t tick = 0;
+static uint8_t* rxData = NULL;
+static HAL_StatusTypeDef rxStatus = HAL_OK;
+static int rxStarts = 0;
+static int reinits = 0;
+
+uint32_t HAL_GetTick(void) { return tick; }
+HAL_StatusTypeDef HAL_I2C_Master_Receive_IT(I2C_HandleTypeDef* hi2c, uint16_t DevAddress, uint8_t* pData,
+                                            uint16_t Size) {
+    rxData = pData;
+    rxStarts++;
+    return rxStatus;
+}
+HAL_StatusTypeDef HAL_I2C_DeInit(I2C_HandleTypeDef* hi2c) { return HAL_OK; }
+HAL_StatusTypeDef HAL_I2C_Init(I2C_HandleTypeDef* hi2c) {
+    reinits++;
+    return HAL_OK;
+}
+
+/* Real supporting units */
+#include "time32.c"
+
+/* UUT */
+#include "zephyrBus.c"
+
+using namespace ::testing;
+
+/***************************************************************************************************
+** TEST FIXTURES
+***************************************************************************************************/
+
+class ZephyrBusTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        tick     = 1000;
+        rxData   = NULL;
+        rxStatus = HAL_OK;
+        rxStarts = 0;
+        reinits  = 0;
+        zephyrBusInit(&hi2c);
+    }
+
+    I2C_HandleTypeDef hi2c = {0};
+};
+
+/***************************************************************************************************
+** TESTS
+***************************************************************************************************/
+
+TEST_F(ZephyrBusTest, readCompletes) {
+    uint16_t code = 0;
+
+    ASSERT_TRUE(zephyrBusStartRead());
+    EXPECT_FALSE(zephyrBusStartRead());
+    EXPECT_EQ(zephyrBusPoll(&code), ZEPHYR_BUS_BUSY);
+
+    rxData[0] = 0x12;
+    rxData[1] = 0x34;
+    HAL_I2C_MasterRxCpltCallback(&hi2c);
+    EXPECT_EQ(zephyrBusPoll(&code), ZEPHYR_BUS_DONE);
+    EXPECT_EQ(code, 0x1234);
+    EXPECT_EQ(zephyrBusPoll(&code), ZEPHYR_BUS_IDLE);
+    EXPECT_EQ(rxStarts, 1);
+}
+
+TEST_F(ZephyrBusTest, failedStart) {
+    uint16_t code = 0;
+
+    rxStatus = HAL_BUSY;
+    EXPECT_FALSE(zephyrBusStartRead());
+    EXPECT_EQ(zephyrBusPoll(&code), ZEPHYR_BUS_IDLE);
+}
+
+TEST_F(ZephyrBusTest, stuckReadTimesOut) {
+    uint16_t code = 0;
+
+    ASSERT_TRUE(zephyrBusStartRead());
+    tick += ZEPHYR_BUS_TIMEOUT_MS - 1;
+    EXPECT_EQ(zephyrBusPoll(&code), ZEPHYR_BUS_BUSY);
+    EXPECT_EQ(reinits, 0);
+
+    /* Given up once, with the peripheral re-initialised */
+    tick++;
+    EXPECT_EQ(zephyrBusPoll(&code), ZEPHYR_BUS_ERROR);
+    EXPECT_EQ(reinits, 1);
+    EXPECT_EQ(zephyrBusPoll(&code), ZEPHYR_BUS_IDLE);
+
+    /* The next read is started as normal */
+    EXPECT_TRUE(zephyrBusStartRead());
+    EXPECT_EQ(rxStarts, 2);
+    tick++;
+    HAL_I2C_MasterRxCpltCallback(&hi2c);
+    EXPECT_EQ(zephyrBusPoll(&code), ZEPHYR_BUS_DONE);
+}
+
+TEST_F(ZephyrBusTest, errorCallback) {
+    uint16_t code = 0;
+
+    ASSERT_TRUE(zephyrBusStartRead());
+    HAL_I2C_ErrorCallback(&hi2c);
+    EXPECT_EQ(zephyrBusPoll(&code), ZEPHYR_BUS_ERROR);
+    EXPECT_EQ(zephyrBusPoll(&code), ZEPHYR_BUS_IDLE);
+    EXPECT_EQ(reinits, 0);
+}
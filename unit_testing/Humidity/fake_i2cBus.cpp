@@ -0,0 +1,158 @@
+/*!
+** @file   fake_i2cBus.cpp
+** @brief  Fake of the interrupt driven I2C buses, with programmable transfer latency
+** @date   18/10/2026
+**
+** The data is exchanged straight away with the devices added to the HAL fake, while the completion
+** interrupts are raised by fakeI2cBusRun once the latency of the bus has passed. Like the SHT45, a
+** bus NACKs reads until the execution time (datasheet maximum) of the last command has passed.
+*/
+
+#include <string.h>
+
+#include "fake_stm32xxxx_hal.h"
+#include "sht45.h"
+
+#include "i2cQueue.h"
+#include "fake_i2cBus.h"
+
+/***************************************************************************************************
+** TYPEDEFS
+***************************************************************************************************/
+
+typedef struct FakeI2cBus {
+    I2C_HandleTypeDef* hi2c;
+    uint32_t latency;
+    bool isFailing;
+
+    bool inFlight;
+    bool isRead;
+    bool isOk;
+    uint32_t doneTick;      // Tick at which the transfer in flight completes
+    uint32_t readyTick;     // Tick at which the device has executed the last command
+
+    int reads;
+    int nacks;
+    int collisions;
+} FakeI2cBus;
+
+/***************************************************************************************************
+** PRIVATE VARIABLES
+***************************************************************************************************/
+
+static FakeI2cBus buses[I2C_QUEUE_MAX_BUSES];
+
+/***************************************************************************************************
+** PRIVATE FUNCTION DEFINITIONS
+***************************************************************************************************/
+
+static uint32_t executionTime(uint8_t cmd) {
+    switch (cmd) {
+        case SHT4X_MEASURE_HIGHREP:    return 9;       // 8.3 ms
+        case SHT4X_HEATER_200mW_100ms: return 110;
+        case SHT4X_HEATER_110mW_1s:    return 1100;
+        default:                       return 1;
+    }
+}
+
+static bool canStart(int bus) {
+    FakeI2cBus* b = &buses[bus];
+    if (b->inFlight) {
+        b->collisions++;
+    }
+    return b->hi2c != NULL && !b->inFlight;
+}
+
+static int start(int bus, bool isRead, bool isOk) {
+    FakeI2cBus* b = &buses[bus];
+    b->inFlight   = true;
+    b->isRead     = isRead;
+    b->isOk       = isOk && !b->isFailing;
+    b->doneTick   = HAL_GetTick() + b->latency;
+    return 0;
+}
+
+/***************************************************************************************************
+** FAKED FUNCTION DEFINITIONS
+***************************************************************************************************/
+
+void i2cBusInit(int bus, I2C_HandleTypeDef* hi2c) {
+    memset(&buses[bus], 0, sizeof(buses[bus]));
+    buses[bus].hi2c = hi2c;
+}
+
+int i2cBusWrite(int bus, uint16_t addr, uint8_t* data, uint16_t len) {
+    if (!canStart(bus)) {
+        return -1;
+    }
+
+    FakeI2cBus* b = &buses[bus];
+    bool isOk     = HAL_I2C_Master_Transmit(b->hi2c, addr, data, len, 10) == HAL_OK;
+    b->readyTick  = HAL_GetTick() + executionTime(data[0]);
+    return start(bus, false, isOk);
+}
+
+int i2cBusRead(int bus, uint16_t addr, uint8_t* data, uint16_t len) {
+    if (!canStart(bus)) {
+        return -1;
+    }
+
+    FakeI2cBus* b = &buses[bus];
+    bool isOk     = false;
+    if ((int32_t)(HAL_GetTick() - b->readyTick) < 0) {
+        b->nacks++;
+    }
+    else {
+        isOk = HAL_I2C_Master_Receive(b->hi2c, addr, data, len, 10) == HAL_OK;
+    }
+    return start(bus, true, isOk);
+}
+
+/***************************************************************************************************
+** FAKE CONTROL FUNCTIONS
+***************************************************************************************************/
+
+void fakeI2cBusSetLatency(int bus, uint32_t ms) {
+    buses[bus].latency = ms;
+}
+
+void fakeI2cBusSetFailing(int bus, bool isFailing) {
+    buses[bus].isFailing = isFailing;
+}
+
+void fakeI2cBusRun() {
+    for (int i = 0; i < I2C_QUEUE_MAX_BUSES; i++) {
+        FakeI2cBus* b = &buses[i];
+        if (!b->inFlight || (int32_t)(HAL_GetTick() - b->doneTick) < 0) {
+            continue;
+        }
+
+        b->inFlight = false;
+        if (!b->isOk) {
+            i2cQueueError(i);
+        }
+        else if (b->isRead) {
+            b->reads++;
+            i2cQueueRxComplete(i);
+        }
+        else {
+            i2cQueueTxComplete(i, HAL_GetTick());
+        }
+    }
+}
+
+bool fakeI2cBusIsBusy(int bus) {
+    return buses[bus].inFlight;
+}
+
+int fakeI2cBusReads(int bus) {
+    return buses[bus].reads;
+}
+
+int fakeI2cBusNacks(int bus) {
+    return buses[bus].nacks;
+}
+
+int fakeI2cBusCollisions(int bus) {
+    return buses[bus].collisions;
+}
@@ -0,0 +1,39 @@
+/*!
+** @file   fake_i2cBus.h
+** @brief  Fake of the interrupt driven I2C buses, with programmable transfer latency
+** @date   18/10/2026
+*/
+
+#ifndef FAKE_I2C_BUS_H_
+#define FAKE_I2C_BUS_H_
+
+#include <stdint.h>
+
+#include "i2cBus.h"
+
+/***************************************************************************************************
+** PUBLIC FUNCTION DECLARATIONS
+***************************************************************************************************/
+
+/* Sets the time from the start of a transfer on a bus until its completion interrupt */
+void fakeI2cBusSetLatency(int bus, uint32_t ms);
+
+/* Makes all transfers on a bus fail, e.g. as if the sensor was unplugged */
+void fakeI2cBusSetFailing(int bus, bool isFailing);
+
+/* Raises the completion interrupts of the transfers whose latency has passed */
+void fakeI2cBusRun();
+
+/* True if a transfer is in flight on the bus */
+bool fakeI2cBusIsBusy(int bus);
+
+/* Number of successful reads on a bus */
+int fakeI2cBusReads(int bus);
+
+/* Number of reads started before the sensor had executed the last command. Must always be 0 */
+int fakeI2cBusNacks(int bus);
+
+/* Number of transfers started while another one was in flight. Must always be 0 */
+int fakeI2cBusCollisions(int bus);
+
+#endif /* FAKE_I2C_BUS_H_ */
@@ -19,6 +19,7 @@ extern "C" {
 #include "fake_stm32xxxx_hal.h"
 #include "fake_USBprint.h"
 #include "fake_StmGpio.h"
+#include "fake_i2cBus.h"
 
 /* Real supporting units */
 #include "CAProtocol.c"
@@ -29,6 +30,8 @@ extern "C" {
 #define __NOP() do { continue; } while (0)
 
 /* UUT */
+#include "printSnapshot.c"
+#include "i2cQueue.c"
 #include "humidityApp.c"
 
 
@@ -106,15 +109,17 @@ class HumidityUnitTest: public CaBoardUnitTest
 
         void simTick()
         {
-            // For every update in print out the main loop must be called 3 times for the humidity to be updated
-            // through the state machine
+            // The print timer only takes a snapshot, which is printed by the main loop
+            if(tickCounter != 0 && (tickCounter % 100 == 0)) {
+                HAL_TIM_PeriodElapsedCallback(&printTim);
+            }
+
+            // The main loop runs several times per ms on hardware. The I2C transfers complete once
+            // their latency (0 ms by default) has passed
             for (int i = 0; i < 3; i++)
             {
                 LoopHumidity(bootMsg);
-            }
-
-            if(tickCounter != 0 && (tickCounter % 100 == 0)) {
-                HAL_TIM_PeriodElapsedCallback(&printTim);
+                fakeI2cBusRun();
             }
         }
         /*******************************************************************************************
@@ -179,3 +184,60 @@ TEST_F(HumidityUnitTest, printStatus) {
 TEST_F(HumidityUnitTest, printSerial) {
     serialPrintoutTest(sst, "HumidityChip");
 }
+
+TEST_F(HumidityUnitTest, scheduledReads) {
+    fakeHAL_I2C_addDevice(humiditySensor1);
+    humiditySensor1->setTemp(0x8000);
+    humiditySensor1->setHumidity(0x8000);
+
+    // High humidity, so sensor 2 also runs a heating cycle
+    fakeHAL_I2C_addDevice(humiditySensor2);
+    humiditySensor2->setTemp(0x8000);
+    humiditySensor2->setHumidity(0xF000);
+
+    sst.boundInit();
+    fakeI2cBusSetLatency(0, 2);
+    simTicks(3000);
+
+    // The reads are never started before the conversion (or heating) time has passed
+    for (int i = 0; i < NUM_SENSORS; i++) {
+        EXPECT_EQ(fakeI2cBusNacks(i), 0);
+        EXPECT_EQ(fakeI2cBusCollisions(i), 0);
+    }
+
+    /* A measurement takes 9 ms plus the transfer latencies. The buses run concurrently, so
+    ** together they deliver more than the 333 measurements possible one at a time */
+    EXPECT_GT(fakeI2cBusReads(0), 150);
+    EXPECT_GT(fakeI2cBusReads(1), 200);
+    EXPECT_GT(fakeI2cBusReads(0) + fakeI2cBusReads(1), 400);
+    EXPECT_NE(heating_state[1].lastHeating, 0U);
+    EXPECT_NEAR(mvgMeasurement[0].rh, 56.50, 0.01);
+}
+
+TEST_F(HumidityUnitTest, sensorLost) {
+    fakeHAL_I2C_addDevice(humiditySensor1);
+    humiditySensor1->setTemp(0x8000);
+    humiditySensor1->setHumidity(0x8000);
+
+    fakeHAL_I2C_addDevice(humiditySensor2);
+    humiditySensor2->setTemp(0x8000);
+    humiditySensor2->setHumidity(0x8000);
+
+    sst.boundInit();
+    simTicks(100);
+
+    // Sensor 2 outputs error values while it is lost, without disturbing sensor 1
+    fakeI2cBusSetFailing(1, true);
+    simTicks(500);
+    EXPECT_FALSE(bsGetField(SHT45_ERROR_Msk(0)));
+    EXPECT_TRUE(bsGetField(SHT45_ERROR_Msk(1)));
+    EXPECT_NEAR(mvgMeasurement[0].rh, 56.50, 0.01);
+    EXPECT_EQ(mvgMeasurement[1].rh, -1);
+
+    // Reconnection outputs the new measurement directly
+    fakeI2cBusSetFailing(1, false);
+    simTicks(100);
+    EXPECT_FALSE(bsGetField(SHT45_ERROR_Msk(1)));
+    EXPECT_NEAR(mvgMeasurement[1].rh, 56.50, 0.01);
+    EXPECT_EQ(fakeI2cBusNacks(1), 0);
+}
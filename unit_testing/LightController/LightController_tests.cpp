@@ -12,6 +12,7 @@
 #include "ADCmonitor.c"
 #include "CAProtocol.c"
 #include "CAProtocolStm.c"
+#include "ledFade.c"
 
 /* UUT */
 #include "LightController.c"
@@ -36,6 +37,11 @@ class LightControllerTests : public CaBoardUnitTest {
     }
 
     void simTick() {
+        // Colour transitions run from the TIM2 update interrupt (1 kHz) while it is enabled
+        if (htim2.Instance->DIER & TIM_IT_UPDATE) {
+            LightControllerFadeTick();
+        }
+
         // ADC buffer should be half full every 100 ms
         if (tickCounter != 0) {
             if (tickCounter % 200 == 0) {
@@ -48,6 +54,12 @@ class LightControllerTests : public CaBoardUnitTest {
         LightControllerLoop(bootMsg);
     }
 
+    /* Handles the message in a single loop, without advancing time */
+    void writeLightMessage(const char* msg) {
+        hostUSBprintf(msg);
+        LightControllerLoop(bootMsg);
+    }
+
     void setVoltage(int16_t adcVal) {
         int ch_dma_len = ADC_CHANNEL_BUF_SIZE * 2;
 
@@ -148,6 +160,10 @@ TEST_F(LightControllerTests, InputHandler) {
     // Wrong hex code (non valid hex characters)
     writeBoardMessage("p1 ACACFM\n");
     EXPECT_FLUSH_USB(ElementsAre("MISREAD: p1 ACACFM\r"));
+
+    // Not separated by a space
+    writeBoardMessage("p1\t0\n");
+    EXPECT_FLUSH_USB(ElementsAre("MISREAD: p1\t0\r"));
 }
 
 TEST_F(LightControllerTests, LEDSwitchingTimeout) {
@@ -171,3 +187,57 @@ TEST_F(LightControllerTests, LEDSwitchingTimeout) {
     simTicks(100); // Just after timeout
     EXPECT_FLUSH_USB(ElementsAre("000000, 000000, 000000, 0x00000000\r"));
 }
+
+/* Grey box - red of port 1 is TIM2 CH3, green of port 1 is TIM1 CH1 */
+TEST_F(LightControllerTests, colourFade) {
+    sst.boundInit();
+    simTicks(100);
+    (void)hostUSBread(true);
+    setVoltage(681);  // 24 V
+
+    /* Without a transition time the colour changes at once, and the interrupt is not used */
+    writeLightMessage("p1 00FF00\n");
+    EXPECT_EQ(htim1.Instance->CCR1, 255);
+    EXPECT_EQ(htim2.Instance->CCR3, 0);
+    EXPECT_FALSE(htim2.Instance->DIER & TIM_IT_UPDATE);
+
+    /* Green to red over 100 ms. The ramp is linear before gamma correction */
+    writeLightMessage("p1 FF0000 100\n");
+    EXPECT_TRUE(htim2.Instance->DIER & TIM_IT_UPDATE);
+
+    simTicks(50);
+    EXPECT_EQ(fadeLevel(0), 127);
+    EXPECT_EQ(fadeLevel(1), 128);
+    EXPECT_EQ(htim2.Instance->CCR3, gammaTable[127]);
+    EXPECT_EQ(htim1.Instance->CCR1, gammaTable[128]);
+
+    simTicks(49);
+    EXPECT_LT(htim2.Instance->CCR3, 255);
+    EXPECT_TRUE(htim2.Instance->DIER & TIM_IT_UPDATE);
+
+    /* Final values reached on time, after which the interrupt is disabled again */
+    simTicks(1);
+    EXPECT_EQ(htim2.Instance->CCR3, 255);
+    EXPECT_EQ(htim1.Instance->CCR1, 0);
+    EXPECT_FALSE(htim2.Instance->DIER & TIM_IT_UPDATE);
+    EXPECT_FLUSH_USB(Contains("ff0000, 000000, 000000, 0x00000001\r"));
+
+    /* Registers are only written when the values change */
+    htim2.Instance->CCR3 = 7;
+    simTicks(10);
+    EXPECT_EQ(htim2.Instance->CCR3, 7);
+
+    /* Invalid transition times */
+    writeLightMessage("p1 FF0000 abc\n");
+    EXPECT_FLUSH_USB(Contains("MISREAD: p1 FF0000 abc\r"));
+    writeLightMessage("p1 FF0000 60001\n");
+    EXPECT_FLUSH_USB(Contains("MISREAD: p1 FF0000 60001\r"));
+
+    /* Fade out */
+    writeLightMessage("p1 000000 20\n");
+    simTicks(19);
+    EXPECT_GT(htim2.Instance->CCR3, 0);
+    simTicks(1);
+    EXPECT_EQ(htim2.Instance->CCR3, 0);
+    EXPECT_FALSE(htim2.Instance->DIER & TIM_IT_UPDATE);
+}
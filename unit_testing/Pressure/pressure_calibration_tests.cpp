@@ -8,6 +8,7 @@
 
 extern "C" {
     uint32_t _FlashAddrCal = 0;
+    uint32_t _FlashAddrCalLegacy = 0;
 }
 
 #include <gtest/gtest.h>
@@ -17,9 +18,13 @@ extern "C" {
 #include "fake_stm32xxxx_hal.h"
 #include "fake_StmGpio.h"
 #include "fake_USBprint.h"
+#include "fake_flashWriter.h"
 
 /* Real supporting units */
 #include "crc.c"
+#include "piecewiseLinear.c"
+#include "flashRecord.c"
+#include "flashWriter.c"
 
 /* UUT */
 #include "calibration.c"
@@ -39,7 +44,7 @@ class PressureCalibrationTest: public ::testing::Test
         *******************************************************************************************/
         PressureCalibrationTest()
         {
-
+            fakeFlashWriterInit();
         }
     
         /*******************************************************************************************
@@ -226,6 +231,17 @@ TEST_F(PressureCalibrationTest, testCalibrateSensor)
     EXPECT_NEAR(cal.sensorCalVal[(port5-1)*2+1], beta-1, 1e-5);
     EXPECT_EQ(cal.measurementType[port5-1], 1);
 
+    // Each port of a batch gets its own measurement type
+    CACalibration mixedCalibration[2] = {{port4, alpha, beta, 0}, {port5, alpha, beta, 1}};
+    calibrateSensor(2, mixedCalibration, &cal, sizeof(cal));
+    EXPECT_EQ(cal.measurementType[port4-1], 0);
+    EXPECT_EQ(cal.measurementType[port5-1], 1);
+
+    CACalibration swappedCalibration[2] = {{port4, alpha, beta, 1}, {port5, alpha, beta, 0}};
+    calibrateSensor(2, swappedCalibration, &cal, sizeof(cal));
+    EXPECT_EQ(cal.measurementType[port4-1], 1);
+    EXPECT_EQ(cal.measurementType[port5-1], 0);
+
     // Reset calibration
     CACalibration defaultCal[NO_CALIBRATION_CHANNELS] = {0};
     for (int i = 0; i<NO_CALIBRATION_CHANNELS; i++)
@@ -276,4 +292,44 @@ TEST_F(PressureCalibrationTest, testCalibrationRW)
     // The calibration should read out the updated values
     calibrationRW(false, &cal, sizeof(cal));
     EXPECT_FLUSH_USB(Contains("Calibration: CAL 1,0.5000000000,1.5000000000,1 2,0.0018800000,-1.7899999619,0 3,0.0018800000,-1.7899999619,0 4,0.0018800000,-1.7899999619,0 5,0.0018800000,-1.7899999619,0 6,0.0018800000,-1.7899999619,0\r"));
-}
\ No newline at end of file
+}
+TEST_F(PressureCalibrationTest, testCalibrationTable)
+{
+    calibrationInit(&hcrc, &cal, sizeof(cal));
+
+    // Points of port 1, in any order
+    CACalibration points[3] = {{1, 4000.0, 10.0, CAL_TABLE_POINT}, {1, 0.0, -1.0, CAL_TABLE_POINT},
+                               {1, 1000.0, 0.0, CAL_TABLE_POINT}};
+    calibrateSensor(3, points, &cal, sizeof(cal));
+
+    ASSERT_TRUE(pwlIsValid(&cal.sensorTable[0]));
+    EXPECT_FLOAT_EQ(pwlEval(&cal.sensorTable[0], 500.0), -0.5);
+    EXPECT_FLOAT_EQ(pwlEval(&cal.sensorTable[0], 2500.0), 5.0);
+
+    calibrationRW(false, &cal, sizeof(cal));
+    EXPECT_FLUSH_USB(Contains("Calibration table: CAL 1,0.0000000000,-1.0000000000,4 1,1000.0000000000,0.0000000000,4 1,4000.0000000000,10.0000000000,4\r"));
+
+    // A calibration stored by a firmware without the tables is still used, without tables, and
+    // moved to the calibration sector
+    fakeFlashWriterInit();
+    ASSERT_EQ(writeToFlashCRC(&hcrc, (uint32_t)FLASH_ADDR_CAL_LEGACY, (uint8_t*)&cal,
+                              offsetof(FlashCalibration, sensorTable)), 0);
+    FlashCalibration stored;
+    memset(&stored, 0xff, sizeof(stored));
+    calibrationInit(&hcrc, &stored, sizeof(stored));
+
+    EXPECT_NEAR(stored.sensorCalVal[0], cal.sensorCalVal[0], 1e-5);
+    EXPECT_EQ(stored.sensorTable[0].noOfPoints, 0U);
+
+    fakeFlashWriterFlush();
+    FlashCalibration moved;
+    ASSERT_EQ(flashWriterRead((uint32_t)FLASH_ADDR_CAL, &moved, sizeof(moved)), (int)sizeof(moved));
+    EXPECT_NEAR(moved.sensorCalVal[0], cal.sensorCalVal[0], 1e-5);
+    EXPECT_EQ(moved.sensorTable[0].noOfPoints, 0U);
+
+    // A new scalar and offset replace the table
+    calibrateSensor(3, points, &cal, sizeof(cal));
+    CACalibration linear[1] = {{1, GANLITONG_SCALAR, GANLITONG_OFFSET, 0}};
+    calibrateSensor(1, linear, &cal, sizeof(cal));
+    EXPECT_FALSE(pwlIsValid(&cal.sensorTable[0]));
+}
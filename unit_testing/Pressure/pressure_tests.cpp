@@ -8,6 +8,7 @@
 
 extern "C" {
     uint32_t _FlashAddrCal = 0;
+    uint32_t _FlashAddrCalLegacy = 0;
 }
 
 #include "caBoardUnitTests.h"
@@ -17,6 +18,10 @@ extern "C" {
 #include "fake_stm32xxxx_hal.h"
 #include "fake_StmGpio.h"
 #include "fake_USBprint.h"
+#include "fake_cycleCount.h"
+#include "fake_flashWriter.h"
+
+#include <cmath>
 
 /* Real supporting units */
 #include "crc.c"
@@ -24,13 +29,21 @@ extern "C" {
 #include "CAProtocolStm.c"
 #include "calibration.c"
 #include "ADCmonitor.c"
+#include "cycleCount.c"
+#include "decimator.c"
+#include "piecewiseLinear.c"
+#include "flashRecord.c"
+#include "flashWriter.c"
+#include "transient.c"
 
 /* UUT */
 #include "pressure.c"
 
 using ::testing::Contains;
 using ::testing::ElementsAre;
+using ::testing::HasSubstr;
 using ::testing::IsSupersetOf;
+using ::testing::Not;
 using namespace std;
 
 /***************************************************************************************************
@@ -45,18 +58,24 @@ class PressureTest: public CaBoardUnitTest
         *******************************************************************************************/
         PressureTest() : CaBoardUnitTest(&pressureLoop, Pressure, {LATEST_MAJOR, LATEST_MINOR}) {
             hadc.Init.NbrOfConversion = 8;
+            fakeFlashWriterInit();
+            fakeCycleCountInit();
+            decimCycles = {};
+            calCycles   = {};
         }
 
         void simTick() {
-            if(tickCounter != 0 && (tickCounter % 100 == 0)) {
-                if(tickCounter % 200 == 0) {
-                    HAL_ADC_ConvCpltCallback(&hadc);
-                }
-                else {
-                    HAL_ADC_ConvHalfCpltCallback(&hadc);
+            fakeFlashTick([this] {
+                if(tickCounter != 0 && (tickCounter % 100 == 0)) {
+                    if(tickCounter % 200 == 0) {
+                        HAL_ADC_ConvCpltCallback(&hadc);
+                    }
+                    else {
+                        HAL_ADC_ConvHalfCpltCallback(&hadc);
+                    }
                 }
-            }
-            pressureLoop(bootMsg);
+                pressureLoop(bootMsg);
+            });
         }
 
         /*******************************************************************************************
@@ -240,4 +259,239 @@ TEST_F(PressureTest, testAdcCallback)
             EXPECT_NEAR(volts[i], ADCMeans[i]/(ADC_MAX+1)*MAX_VCC_IN, 1e-3);
         }   
     }
-}
\ No newline at end of file
+}
+TEST_F(PressureTest, testPressureFilter)
+{
+    pressureInit(&hadc, &hcrc);
+    pressureLoop(bootMsg);
+
+    /* 50 Hz output with a 50 Hz notch, and 40 Hz output which cannot have one */
+    writeBoardMessage("p1 filter 50 50 none\n");
+    EXPECT_FLUSH_USB(Contains("Port 1: 50 Hz, 15.2 effective bits\r"));
+    writeBoardMessage("p2 filter 40 50 none\n");
+    EXPECT_FLUSH_USB(Contains("MISREAD: p2 filter 40 50 none\r"));
+    writeBoardMessage("p2 filter 40 none none\n");
+    EXPECT_FLUSH_USB(Contains("Port 2: 40 Hz, 15.3 effective bits\r"));
+
+    /* 2000 with 50 Hz mains pick-up on all channels */
+    for (int i = 0; i < ADC_CHANNEL_BUF_SIZE*2; i++)
+    {
+        for (int channel = 0; channel < ADC_CHANNELS; channel++)
+        {
+            ADCBuffer[i*ADC_CHANNELS + channel] = lround(2000 + 200*sin(2*M_PI*50*i/ADC_SAMPLE_RATE));
+        }
+    }
+
+    goToTick(100);
+    pressureLoop(bootMsg);
+
+    /* The notch and the default 10 Hz output reject the pick-up, the 40 Hz output does not */
+    EXPECT_NEAR(ADCMeansRaw[0], 2000, 0.05);
+    EXPECT_GT(fabs(ADCMeansRaw[1] - 2000), 10);
+    EXPECT_NEAR(ADCMeansRaw[2], 2000, 0.05);
+}
+
+TEST_F(PressureTest, testPressureSpikeFilter)
+{
+    pressureInit(&hadc, &hcrc);
+    pressureLoop(bootMsg);
+
+    writeBoardMessage("p1 spike median3\n");
+    writeBoardMessage("p2 spike median5\n");
+    writeBoardMessage("p3 spike median4\n");
+    EXPECT_FLUSH_USB(Contains("MISREAD: p3 spike median4\r"));
+
+    /* 2000 with full scale switching spikes of one sample on all channels, and of two samples on
+    ** port 2 */
+    for (int i = 0; i < ADC_CHANNEL_BUF_SIZE*2; i++)
+    {
+        for (int channel = 0; channel < ADC_CHANNELS; channel++)
+        {
+            ADCBuffer[i*ADC_CHANNELS + channel] = (i % 20 == 10) ? 4095 : 2000;
+        }
+        if (i % 50 == 25 || i % 50 == 26)
+        {
+            ADCBuffer[i*ADC_CHANNELS + 1] = 4095;
+        }
+    }
+
+    goToTick(100);
+    pressureLoop(bootMsg);
+
+    /* The unfiltered mean is pulled up by the spikes */
+    EXPECT_FLOAT_EQ(ADCMeansRaw[0], 2000);
+    EXPECT_FLOAT_EQ(ADCMeansRaw[1], 2000);
+    EXPECT_GT(ADCMeansRaw[2], 2100);
+}
+
+TEST_F(PressureTest, testPressureCycles)
+{
+    pressureInit(&hadc, &hcrc);
+    pressureLoop(bootMsg);
+
+    /* 1000 cycles for the filter and for the calibration, within 5 ms at 16 MHz */
+    fakeCycleCountInit(1000);
+    goToTick(100);
+    pressureLoop(bootMsg);
+    writeBoardMessage("cycles\n");
+    EXPECT_FLUSH_USB(Contains("Filter: 1000 cycles (max 1000), calibration: 1000 cycles (max 1000), budget: 80000 cycles\r"));
+    writeBoardMessage("Status\n");
+    EXPECT_FLUSH_USB(Not(Contains(HasSubstr("Filter and calibration"))));
+
+    /* Over the budget, which the status reports */
+    fakeCycleCountInit(50000);
+    goToTick(200);
+    pressureLoop(bootMsg);
+    writeBoardMessage("Status\n");
+    EXPECT_FLUSH_USB(Contains("Filter and calibration took up to 100000 cycles of 80000\r"));
+}
+
+TEST_F(PressureTest, testPressureCalibrationTable)
+{
+    pressureInit(&hadc, &hcrc);
+    pressureLoop(bootMsg);
+
+    /* Non-linear sensor on port 1, the other ports keep the linear calibration */
+    const CACalibration table[3] = {{1, 4000, 10, CAL_TABLE_POINT}, {1, 0, 0, CAL_TABLE_POINT},
+                                    {1, 2000, 1, CAL_TABLE_POINT}};
+    calibrateSensorOrBoard(3, table);
+
+    for (int i = 0; i < ADC_CHANNELS*ADC_CHANNEL_BUF_SIZE*2; i++)
+    {
+        ADCBuffer[i] = 2068;
+    }
+    goToTick(100);
+    pressureLoop(bootMsg);
+
+    float input = ADCMeans[0]*VOLTAGE_SCALING;
+    EXPECT_NEAR(pressure[0], 1 + 9*(input - 2000)/2000, 1e-4);
+    for (int i = 1; i < NO_CALIBRATION_CHANNELS; i++)
+    {
+        EXPECT_NEAR(pressure[i], ADCMeans[i]*VOLTAGE_SCALING*GANLITONG_SCALAR + GANLITONG_OFFSET, 1e-3);
+    }
+
+    /* Clearing the table goes back to the linear calibration */
+    const CACalibration clear[1] = {{1, 0, 0, CAL_TABLE_CLEAR}};
+    calibrateSensorOrBoard(1, clear);
+    goToTick(200);
+    pressureLoop(bootMsg);
+    EXPECT_NEAR(pressure[0], ADCMeans[0]*VOLTAGE_SCALING*GANLITONG_SCALAR + GANLITONG_OFFSET, 1e-3);
+}
+
+TEST_F(PressureTest, testPressureTransientCapture)
+{
+    pressureInit(&hadc, &hcrc);
+    pressureLoop(bootMsg);
+
+    /* 10 ms before and 20 ms after a trigger, i.e. 40 and 80 samples. 600 ms do not fit */
+    writeBoardMessage("transient 10 20\n");
+    EXPECT_FLUSH_USB(Contains("Transient: 10 ms before, 20 ms after\r"));
+    writeBoardMessage("transient 400 200\n");
+    EXPECT_FLUSH_USB(Contains("MISREAD: transient 400 200\r"));
+    writeBoardMessage("p2 trigger level 3000\n");
+    writeBoardMessage("p3 trigger rate 0\n");
+    EXPECT_FLUSH_USB(Contains("MISREAD: p3 trigger rate 0\r"));
+
+    /* Each sample holds its index plus 1000 x its channel, with a surge on port 2 */
+    int16_t buffer[ADC_CHANNELS*ADC_CHANNEL_BUF_SIZE];
+    for (int i = 0; i < ADC_CHANNEL_BUF_SIZE; i++)
+    {
+        for (int channel = 0; channel < ADC_CHANNELS; channel++)
+        {
+            buffer[i*ADC_CHANNELS + channel] = 1000*channel + i;
+        }
+        if (i >= 150 && i < 160)
+        {
+            buffer[i*ADC_CHANNELS + 1] = 3500;
+        }
+    }
+    transientRun(buffer, ADC_CHANNEL_BUF_SIZE, 1000);
+    ASSERT_TRUE(transientIsReady());
+
+    /* Read in pieces of an odd size, which are rounded down to whole samples */
+    const int blockSize = sizeof(TransientHeader) + 120*NO_CALIBRATION_CHANNELS*2;
+    uint8_t block[blockSize + 1];
+    int len = 0;
+    int n   = 0;
+    while ((n = transientRead(&block[len], 101)) > 0)
+    {
+        EXPECT_EQ(n % 2, 0);
+        len += n;
+    }
+    ASSERT_EQ(len, blockSize);
+    EXPECT_FALSE(transientIsReady());
+
+    TransientHeader header;
+    memcpy(&header, block, sizeof(header));
+    EXPECT_EQ(header.tick, 1000 - (ADC_CHANNEL_BUF_SIZE - 1 - 150)*1000/ADC_SAMPLE_RATE);
+    EXPECT_EQ(header.sampleRate, ADC_SAMPLE_RATE);
+    EXPECT_EQ(header.preSamples, 40);
+    EXPECT_EQ(header.postSamples, 80);
+    EXPECT_EQ(header.noOfPorts, NO_CALIBRATION_CHANNELS);
+    EXPECT_EQ(header.port, 2);
+
+    for (int k = 0; k < 120; k++)
+    {
+        for (int channel = 0; channel < NO_CALIBRATION_CHANNELS; channel++)
+        {
+            int16_t sample;
+            memcpy(&sample, &block[sizeof(header) + (k*NO_CALIBRATION_CHANNELS + channel)*2], 2);
+            ASSERT_EQ(sample, buffer[(110 + k)*ADC_CHANNELS + channel]) << "Sample " << k;
+        }
+    }
+
+    /* A step on port 1 shortly after the ring restarted: only the samples recorded are sent */
+    writeBoardMessage("p2 trigger off\n");
+    writeBoardMessage("p1 trigger rate 50\n");
+    for (int i = 0; i < ADC_CHANNEL_BUF_SIZE; i++)
+    {
+        buffer[i*ADC_CHANNELS] = (i < 5) ? 0 : 100;
+    }
+    transientRun(buffer, ADC_CHANNEL_BUF_SIZE, 2000);
+    ASSERT_TRUE(transientIsReady());
+    ASSERT_EQ(transientRead(block, sizeof(header)), sizeof(header));
+    memcpy(&header, block, sizeof(header));
+    EXPECT_EQ(header.preSamples, 5);
+    EXPECT_EQ(header.port, 1);
+
+    /* A piece is only marked as read when told to, so a piece which could not be sent is sent 
+    ** again */
+    uint8_t first[8];
+    uint8_t again[8];
+    ASSERT_EQ(transientPeek(first, sizeof(first)), (int)sizeof(first));
+    ASSERT_EQ(transientPeek(again, sizeof(again)), (int)sizeof(again));
+    EXPECT_EQ(memcmp(first, again, sizeof(first)), 0);
+    transientAdvance(sizeof(first));
+    ASSERT_EQ(transientPeek(again, sizeof(again)), (int)sizeof(again));
+    EXPECT_NE(memcmp(first, again, sizeof(first)), 0);
+
+    int rest = (5 + 80)*NO_CALIBRATION_CHANNELS*2 - (int)sizeof(first);
+    transientAdvance(rest - 2);
+    EXPECT_TRUE(transientIsReady());
+    transientAdvance(2);
+    EXPECT_FALSE(transientIsReady());
+}
+
+TEST_F(PressureTest, testPressureTransientSend)
+{
+    pressureInit(&hadc, &hcrc);
+    pressureLoop(bootMsg);
+    writeBoardMessage("p1 trigger level 3000\n");
+
+    for (int i = 0; i < ADC_CHANNELS*ADC_CHANNEL_BUF_SIZE*2; i++)
+    {
+        ADCBuffer[i] = 2000;
+    }
+    ADCBuffer[100*ADC_CHANNELS] = 4000;
+
+    /* The trigger is in the first half buffer, and the 100 ms after it end in the second */
+    simTicks(150);
+    EXPECT_FALSE(transientIsReady());
+    simTicks(60);
+    EXPECT_TRUE(transientIsReady());
+
+    /* The block, 9.6 kB, goes out in pieces in between the 10 Hz lines */
+    simTicks(40);
+    EXPECT_FALSE(transientIsReady());
+    EXPECT_FLOAT_EQ(ADCMeansRaw[1], 2000);
+}
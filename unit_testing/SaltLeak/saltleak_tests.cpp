@@ -7,7 +7,7 @@
 /* Linker script variables */
 #include <inttypes.h>
 extern "C" {
-    uint32_t _FlashAddrCal = 0;
+    uint32_t _FlashAddrCalLegacy = 0;
 }
 
 /* CA unit tests */
@@ -16,13 +16,19 @@ extern "C" {
 
 /* Fakes */
 #include "fake_StmGpio.h"
+#include "fake_flash.h"
+#include "FLASH_readwrite.h"
 
 /* Real supporting units */
 #include "ADCmonitor.c"
+#include "ADCWatchdog.c"
 #include "CAProtocol.c"
 #include "CAProtocolStm.c"
 #include "calibration.c"
 #include "crc.c"
+#include "flashRecord.c"
+#include "kvStore.c"
+#include "leakLog.c"
 #include "systeminfo.c"
 #include "time32.c"
 
@@ -34,6 +40,8 @@ using ::testing::AnyOf;
 using ::testing::Contains;
 using ::testing::ElementsAre;
 using ::testing::IsEmpty;
+using ::testing::IsSupersetOf;
+using ::testing::MatchesRegex;
 using namespace std;
 
 /***************************************************************************************************
@@ -47,19 +55,28 @@ class SaltLeakBoard : public CaBoardUnitTest {
     *******************************************************************************************/
     SaltLeakBoard() : CaBoardUnitTest(saltleakLoop, SaltLeak, {LATEST_MAJOR, LATEST_MINOR}) {
         hadc.Init.NbrOfConversion = ADC_CHANNELS;
+        fakeFlashInit();
+        openKvStore();
+    }
+
+    /* Opens the key/value store as main.c does, e.g. after a restart */
+    void openKvStore() {
+        ASSERT_EQ(kvInit(&fakeFlashOps, KV_SECTOR_A, KV_SECTOR_B, KV_SECTOR_SIZE), 0);
     }
 
     void simTick() {
-        if (tickCounter != 0 && (tickCounter % 100 == 0)) {
-            /* ADC cicular buffer is calling callback function at 10 Hz */
-            if (tickCounter % 200 == 0) {
-                HAL_ADC_ConvCpltCallback(&hadc);
-            }
-            else {
-                HAL_ADC_ConvHalfCpltCallback(&hadc);
+        fakeFlashTick([this] {
+            if (tickCounter != 0 && (tickCounter % 100 == 0)) {
+                /* ADC cicular buffer is calling callback function at 10 Hz */
+                if (tickCounter % 200 == 0) {
+                    HAL_ADC_ConvCpltCallback(&hadc);
+                }
+                else {
+                    HAL_ADC_ConvHalfCpltCallback(&hadc);
+                }
             }
-        }
-        saltleakLoop(bootMsg);
+            saltleakLoop(bootMsg);
+        });
     }
 
     void setAdcBufferChannel(int ch, int16_t val){
@@ -75,6 +92,10 @@ class SaltLeakBoard : public CaBoardUnitTest {
     ** MEMBERS
     *******************************************************************************************/
 
+    static const uint32_t KV_SECTOR_SIZE = 0x4000;
+    static const uint32_t KV_SECTOR_A    = 0x08004000;
+    static const uint32_t KV_SECTOR_B    = 0x08008000;
+
     ADC_HandleTypeDef hadc = { 0 };
     CRC_HandleTypeDef hcrc;
 
@@ -233,3 +254,158 @@ TEST_F(SaltLeakBoard, resistanceCalculation) {
     goToTick(500);
     EXPECT_FLUSH_USB(Contains("-1.00, -1.00, -305.99, -1.00, -1.00, -1.00, 3, 3, 2, 3, 3, 3, 48.01, 0x00000001\r"));
 }
+
+TEST_F(SaltLeakBoard, shortLeakLatched) {
+    saltleakInit(&hadc, &hcrc);
+    setAdcBufferChannel(6, 3858); // Boost voltage - 48.01 V
+    setAdcBufferChannel(7, 3656); // VCC voltage - 5.00 V
+    setAdcBufferChannel(2, 1607); // Sensor voltage - 20.0 V - Medium resistance (~23 kOhm)
+
+    goToTick(100);
+    EXPECT_FLUSH_USB(Contains("-1.00, -1.00, 23.48, -1.00, -1.00, -1.00, 3, 3, 0, 3, 3, 3, 48.01, 0x00000001\r"));
+
+    /* Leak spike shorter than the debounce is ignored (the scan normally runs in the timer ISR) */
+    int16_t* adcBuffer = (int16_t*)hadc.dma_address;
+    for (int i = 300; i < 300 + LEAK_DEBOUNCE - 1; i++) {
+        adcBuffer[2 + i * ADC_CHANNELS] = 2867;
+    }
+    adcWatchdogScan(350);
+    setAdcBufferChannel(2, 1607);
+
+    goToTick(200);
+    EXPECT_FLUSH_USB(Contains("-1.00, -1.00, 23.48, -1.00, -1.00, -1.00, 3, 3, 0, 3, 3, 3, 48.01, 0x00000001\r"));
+
+    /* Leak lasting 5 ms is latched, even though it does not show in the mean resistance */
+    for (int i = 500; i < 500 + LEAK_DEBOUNCE; i++) {
+        adcBuffer[2 + i * ADC_CHANNELS] = 2867;
+    }
+    adcWatchdogScan(600);
+    setAdcBufferChannel(2, 1607);
+
+    goToTick(300);
+    EXPECT_FLUSH_USB(Contains("-1.00, -1.00, 23.48, -1.00, -1.00, -1.00, 3, 3, 1, 3, 3, 3, 48.01, 0x00000001\r"));
+
+    /* Latch is released once reported */
+    goToTick(400);
+    EXPECT_FLUSH_USB(Contains("-1.00, -1.00, 23.48, -1.00, -1.00, -1.00, 3, 3, 0, 3, 3, 3, 48.01, 0x00000001\r"));
+}
+
+TEST_F(SaltLeakBoard, leakHistory) {
+    saltleakInit(&hadc, &hcrc);
+    setAdcBufferChannel(6, 3858); // Boost voltage - 48.01 V
+    setAdcBufferChannel(7, 3656); // VCC voltage - 5.00 V
+    setAdcBufferChannel(2, 1607); // Sensor voltage - 20.0 V - Medium resistance (~23 kOhm)
+
+    goToTick(100);
+    EXPECT_FLUSH_USB(Contains("-1.00, -1.00, 23.48, -1.00, -1.00, -1.00, 3, 3, 0, 3, 3, 3, 48.01, 0x00000001\r"));
+
+    /* The leak state is entered by the next pass of the main loop, not at the next 10 Hz update */
+    int16_t* adcBuffer = (int16_t*)hadc.dma_address;
+    for (int i = 500; i < 500 + LEAK_DEBOUNCE; i++) {
+        adcBuffer[2 + i * ADC_CHANNELS] = 2867;
+    }
+    adcWatchdogScan(600);
+    setAdcBufferChannel(2, 1607);
+    saltleakLoop(bootMsg);
+    EXPECT_EQ(sensorStates[2], LEAK_STATE);
+
+    /* Back to nominal once the latched leak has been reported */
+    goToTick(300);
+    EXPECT_FLUSH_USB(Contains("-1.00, -1.00, 23.48, -1.00, -1.00, -1.00, 3, 3, 1, 3, 3, 3, 48.01, 0x00000001\r"));
+    goToTick(400);
+
+    /* Boost off is not a change of the sensors */
+    writeBoardMessage("boost 1 1\n");
+    goToTick(1200);
+    writeBoardMessage("switch off\n");
+    goToTick(1500);
+    EXPECT_FLUSH_USB(Contains("-1.00, -1.00, 23.48, -1.00, -1.00, -1.00, 3, 3, 0, 3, 3, 3, 48.01, 0x00000001\r"));
+
+    /* The sensors which were not connected at start-up are not recorded */
+    writeBoardMessage("history\n");
+    EXPECT_FLUSH_USB(IsSupersetOf({
+        "Leak history: 2 of 2 events\r",
+        MatchesRegex("Boot 1, [0-9]+ ms: sensor 3, 0 -> 1, 0\\.02 kOhm\r"),
+        MatchesRegex("Boot 1, [0-9]+ ms: sensor 3, 1 -> 0, 23\\.48 kOhm\r")
+    }));
+
+    /* The first event was saved at once, the second one a minute later, each as a record of the
+    ** key/value store, next to the calibration */
+    goToTick(61000);
+    EXPECT_EQ(kvVersion(KV_KEY_LEAK_LOG), 2u);
+    EXPECT_EQ(kvVersion(KV_KEY_CALIBRATION), 0u);
+
+    /* The log survives a restart, and the next events are marked with the next boot */
+    openKvStore();
+    saltleakInit(&hadc, &hcrc);
+    (void)hostUSBread(true);
+    writeBoardMessage("history\n");
+    EXPECT_FLUSH_USB(Contains("Leak history: 2 of 2 events\r"));
+    EXPECT_EQ(leakLog.boot, 2);
+
+    writeBoardMessage("history clear\n");
+    writeBoardMessage("history\n");
+    EXPECT_FLUSH_USB(Contains("Leak history: 0 of 0 events\r"));
+}
+
+TEST_F(SaltLeakBoard, calibrationStored) {
+    saltleakInit(&hadc, &hcrc);
+    writeBoardMessage("CAL 1,6.3,101\n");
+
+    /* Restored after a restart */
+    openKvStore();
+    saltleakInit(&hadc, &hcrc);
+    EXPECT_EQ(kvVersion(KV_KEY_CALIBRATION), 1u);
+    EXPECT_FLOAT_EQ(cal.sensorCal[0].resP1, 6.3f);
+    EXPECT_FLOAT_EQ(cal.sensorCal[0].resP2, 101.0f);
+}
+
+TEST_F(SaltLeakBoard, calibrationMoved) {
+    /* Written by a firmware which kept the calibration in the 128K sector */
+    FlashCalibration_t legacy = cal;
+    legacy.sensorCal[0].resN1 = 18.2f;
+    ASSERT_EQ(writeToFlashCRC(&hcrc, (uint32_t)FLASH_ADDR_CAL_LEGACY, (uint8_t*)&legacy,
+                              sizeof(legacy)), 0);
+
+    saltleakInit(&hadc, &hcrc);
+    EXPECT_FLOAT_EQ(cal.sensorCal[0].resN1, 18.2f);
+
+    /* Moved to the key/value store once */
+    FlashCalibration_t stored;
+    ASSERT_EQ(kvRead(KV_KEY_CALIBRATION, &stored, sizeof(stored)), (int)sizeof(stored));
+    EXPECT_FLOAT_EQ(stored.sensorCal[0].resN1, 18.2f);
+    saltleakInit(&hadc, &hcrc);
+    EXPECT_EQ(kvVersion(KV_KEY_CALIBRATION), 1u);
+}
+
+TEST_F(SaltLeakBoard, boostSettling) {
+    saltleakInit(&hadc, &hcrc);
+    setAdcBufferChannel(6, 3858); // Boost voltage - 48.01 V
+    setAdcBufferChannel(7, 3656); // VCC voltage - 5.00 V
+    setAdcBufferChannel(2, 1607); // Sensor voltage - 20.0 V - Medium resistance (~23 kOhm)
+
+    goToTick(100);
+    writeBoardMessage("boost 0.1 0.1\n");
+
+    /* Boost off at 200, and on again at 300 while sample 410 is being converted */
+    goToTick(200);
+    adcWatchdogScan(410);
+    goToTick(300);
+    EXPECT_FLUSH_USB(Contains("-1.00, -1.00, 23.48, -1.00, -1.00, -1.00, 5, 5, 5, 5, 5, 5, 48.01, 0x00000002\r"));
+
+    /* Boost and sense voltages still low up to the toggle and 20 ms after it. Averaged in, they
+    ** would make a boost error */
+    int16_t* adcBuffer = (int16_t*)hadc.dma_address;
+    for (int i = 400; i < 410 + BOOST_SETTLE_DEFAULT * ADC_SAMPLES_PER_MS; i++) {
+        adcBuffer[6 + i * ADC_CHANNELS] = 1000;
+        adcBuffer[2 + i * ADC_CHANNELS] = 400;
+    }
+    goToTick(400);
+    EXPECT_FLUSH_USB(Contains("-1.00, -1.00, 23.48, -1.00, -1.00, -1.00, 3, 3, 0, 3, 3, 3, 48.01, 0x00000003\r"));
+
+    /* The settling time must leave samples in each half buffer */
+    writeBoardMessage("boost settle 100\n");
+    EXPECT_FLUSH_USB(Contains("MISREAD: boost settle 100\r"));
+    writeBoardMessage("boost settle 50\n");
+    EXPECT_FLUSH_USB(Contains("Boost settling time: 50 ms\r"));
+}
@@ -0,0 +1,71 @@
+/*!
+** @file   fake_tachoCapture.cpp
+** @brief  Fake of the TIM2 input capture DMA of the tachometer
+** @date   18/10/2026
+**
+** Every started channel behaves like a circular DMA: each edge is written to the next entry of its
+** buffer and the remaining count (NDTR) is reloaded when it reaches 0.
+*/
+
+#include <string.h>
+
+#include "fake_tachoCapture.h"
+
+/***************************************************************************************************
+** TYPEDEFS
+***************************************************************************************************/
+
+typedef struct FakeCapture {
+    uint32_t* buf;
+    uint16_t len;
+    uint32_t remaining;
+} FakeCapture;
+
+/***************************************************************************************************
+** PRIVATE VARIABLES
+***************************************************************************************************/
+
+static FakeCapture captures[4];
+
+/***************************************************************************************************
+** FAKED FUNCTION DEFINITIONS
+***************************************************************************************************/
+
+void tachoCaptureInit(TIM_HandleTypeDef* htim) {
+    (void) htim;
+    memset(captures, 0, sizeof(captures));
+}
+
+bool tachoCaptureStart(uint32_t timChannel, uint16_t pin, uint32_t* buf, uint16_t len) {
+    (void) pin;
+    uint32_t idx = timChannel >> 2;
+    if (idx >= 4 || buf == NULL || len == 0) {
+        return false;
+    }
+
+    captures[idx].buf       = buf;
+    captures[idx].len       = len;
+    captures[idx].remaining = len;
+    return true;
+}
+
+uint32_t tachoCaptureRemaining(uint32_t timChannel) {
+    uint32_t idx = timChannel >> 2;
+    return (idx < 4) ? captures[idx].remaining : 0;
+}
+
+/***************************************************************************************************
+** FAKE CONTROL FUNCTIONS
+***************************************************************************************************/
+
+bool fakeTachoCaptureEdge(uint32_t timChannel, uint32_t timCount) {
+    uint32_t idx = timChannel >> 2;
+    if (idx >= 4 || captures[idx].buf == NULL) {
+        return false;
+    }
+
+    FakeCapture* c = &captures[idx];
+    c->buf[c->len - c->remaining] = timCount;
+    c->remaining = (c->remaining > 1) ? c->remaining - 1 : c->len;
+    return true;
+}
@@ -0,0 +1,21 @@
+/*!
+** @file   fake_tachoCapture.h
+** @brief  Fake of the TIM2 input capture DMA of the tachometer
+** @date   18/10/2026
+*/
+
+#ifndef FAKE_TACHO_CAPTURE_H_
+#define FAKE_TACHO_CAPTURE_H_
+
+#include <stdint.h>
+
+#include "tachoCapture.h"
+
+/***************************************************************************************************
+** PUBLIC FUNCTION DECLARATIONS
+***************************************************************************************************/
+
+/* Captures an edge on a TIM2 channel like the DMA. Returns false if the channel isn't started */
+bool fakeTachoCaptureEdge(uint32_t timChannel, uint32_t timCount);
+
+#endif /* FAKE_TACHO_CAPTURE_H_ */
@@ -0,0 +1,103 @@
+/*!
+** @file   tachoCapture_tests.cpp
+** @date   19/10/2026
+**
+** The real GPIO driver is run against fake registers, so that what is left of the EXTI after a
+** pin has been moved to the timer can be checked.
+*/
+
+#include <gtest/gtest.h>
+
+#include "stm32f4xx_hal.h"
+
+/* Fakes */
+static GPIO_TypeDef   fakeGpioA;
+static EXTI_TypeDef   fakeExti;
+static SYSCFG_TypeDef fakeSyscfg;
+static RCC_TypeDef    fakeRcc;
+
+#undef GPIOA
+#define GPIOA (&fakeGpioA)
+#undef EXTI
+#define EXTI (&fakeExti)
+#undef SYSCFG
+#define SYSCFG (&fakeSyscfg)
+#undef RCC
+#define RCC (&fakeRcc)
+
+static HAL_StatusTypeDef icStartStatus = HAL_OK;
+
+HAL_StatusTypeDef HAL_TIM_IC_Init(TIM_HandleTypeDef* htim) { return HAL_OK; }
+HAL_StatusTypeDef HAL_DMA_Init(DMA_HandleTypeDef* hdma) { return HAL_OK; }
+HAL_StatusTypeDef HAL_TIM_IC_ConfigChannel(TIM_HandleTypeDef* htim, const TIM_IC_InitTypeDef* sConfig,
+                                           uint32_t Channel) {
+    return HAL_OK;
+}
+HAL_StatusTypeDef HAL_TIM_IC_Start_DMA(TIM_HandleTypeDef* htim, uint32_t Channel, uint32_t* pData,
+                                       uint16_t Length) {
+    return icStartStatus;
+}
+
+/* Real supporting units */
+#include "stm32f4xx_hal_gpio.c"
+
+/* UUT */
+#include "tachoCapture.c"
+
+using namespace ::testing;
+
+/***************************************************************************************************
+** TEST FIXTURES
+***************************************************************************************************/
+
+class TachoCaptureTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        memset(&fakeGpioA, 0, sizeof(fakeGpioA));
+        memset(&fakeExti, 0, sizeof(fakeExti));
+        memset(&fakeSyscfg, 0, sizeof(fakeSyscfg));
+        memset(&fakeRcc, 0, sizeof(fakeRcc));
+        icStartStatus = HAL_OK;
+
+        /* As initGpio() in tachometer.c */
+        GPIO_InitTypeDef gpio = {0};
+        gpio.Pin  = GPIO_PIN_2 | GPIO_PIN_3;
+        gpio.Mode = GPIO_MODE_IT_RISING;
+        gpio.Pull = GPIO_NOPULL;
+        HAL_GPIO_Init(GPIOA, &gpio);
+
+        tachoCaptureInit(&htim);
+    }
+
+    TIM_HandleTypeDef htim = {0};
+    uint32_t buf[8]        = {0};
+};
+
+/***************************************************************************************************
+** TESTS
+***************************************************************************************************/
+
+TEST_F(TachoCaptureTest, captureMasksExti) {
+    ASSERT_TRUE(EXTI->IMR & GPIO_PIN_2);
+
+    EXPECT_TRUE(tachoCaptureStart(TIM_CHANNEL_3, GPIO_PIN_2, buf, 8));
+
+    EXPECT_FALSE(EXTI->IMR & GPIO_PIN_2);
+    EXPECT_FALSE(EXTI->RTSR & GPIO_PIN_2);
+    EXPECT_EQ((GPIOA->MODER >> 4) & 3u, GPIO_MODE_AF_PP & 3u);
+    EXPECT_EQ((GPIOA->AFR[0] >> 8) & 0xFu, (uint32_t) GPIO_AF1_TIM2);
+
+    /* The other pin is still counted by the EXTI */
+    EXPECT_TRUE(EXTI->IMR & GPIO_PIN_3);
+    EXPECT_TRUE(EXTI->RTSR & GPIO_PIN_3);
+}
+
+TEST_F(TachoCaptureTest, failedCaptureRearmsExti) {
+    icStartStatus = HAL_ERROR;
+
+    EXPECT_FALSE(tachoCaptureStart(TIM_CHANNEL_4, GPIO_PIN_3, buf, 8));
+
+    EXPECT_TRUE(EXTI->IMR & GPIO_PIN_3);
+    EXPECT_TRUE(EXTI->RTSR & GPIO_PIN_3);
+    EXPECT_EQ((GPIOA->MODER >> 6) & 3u, (uint32_t) MODE_INPUT);
+}
@@ -10,11 +10,17 @@
 /* Fakes */
 #include "fake_stm32xxxx_hal.h"
 #include "fake_USBprint.h"
+#include "fake_tachoCapture.h"
 
 /* Real supporting units */
 #include "CAProtocol.c"
 #include "CAProtocolStm.c"
 
+/* Real supporting units */
+#include "edgeRing.c"
+#include "tachoEstimator.c"
+#include "printSnapshot.c"
+
 /* UUT */
 #include "tachometer.c"
 
@@ -42,6 +48,34 @@ class TachoUnitTest: public CaBoardUnitTest, public WithParamInterface<int>
             tachoInputLoop(bootMsg);
         }
 
+        /* Generates a rising edge on a channel at the current timer count */
+        void edge(int channel) {
+            if (captureChannels[channel] >= 0) {
+                fakeTachoCaptureEdge(captureChannels[channel], testTachoTim.Instance->CNT);
+            }
+            else {
+                HAL_GPIO_EXTI_Callback(gpio_pins[channel]);
+            }
+        }
+
+        /* Generates edges every periods[i] us on channel i (none if 0) up to the given tick */
+        void runEdges(const vector<uint32_t>& periods, uint32_t untilTick) {
+            static const uint32_t US_PER_TICK = 1000;
+
+            for (uint32_t us = tickCounter * US_PER_TICK + 1; us <= untilTick * US_PER_TICK; us++) {
+                testTachoTim.Instance->CNT = us;
+                for (size_t i = 0; i < periods.size(); i++) {
+                    if (periods[i] != 0 && us % periods[i] == 0) {
+                        edge(i);
+                    }
+                }
+
+                if (us % US_PER_TICK == 0) {
+                    goToTick(us / US_PER_TICK);
+                }
+            }
+        }
+
         /*******************************************************************************************
         ** MEMBERS
         *******************************************************************************************/
@@ -93,12 +127,10 @@ TEST_P(TachoUnitTest, testTacho) {
         pulse_train[i] = pulse_train[i-1] + 100 * i;
     }
 
-    uint32_t gpio_param = gpio_pins[GetParam()];
-
     for(int i = 0; i < len_pulse_train; i++) {
         /* Set the timer to the latest count and generate the event */
         testTachoTim.Instance->CNT = pulse_train[i];
-        HAL_GPIO_EXTI_Callback(gpio_param);
+        edge(GetParam());
 
         /* Ticks run at 10Hz frequency, but the timer is 1 MHz. Generate timer ticks at appropriate
         ** intervals */
@@ -127,10 +159,10 @@ TEST_P(TachoUnitTest, testTacho) {
     ** with wrong messages */
     for(int i = 0; i < NUM_CHANNELS; i++) {
         if(i == GetParam()) {
-            EXPECT_EQ(os->at(0)->at(i), "976.66");
-            EXPECT_EQ(os->at(1)->at(i), "226.83");
-            EXPECT_EQ(os->at(2)->at(i), "147.95");
-            ASSERT_EQ(os->at(3)->at(i), "122.12");
+            EXPECT_EQ(os->at(0)->at(i), "434.78");
+            EXPECT_EQ(os->at(1)->at(i), "183.49");
+            EXPECT_EQ(os->at(2)->at(i), "141.84");
+            ASSERT_EQ(os->at(3)->at(i), "119.76");
         }
         else {
             for( int j = 0; j < 4; j++) {
@@ -150,9 +182,9 @@ TEST_F(TachoUnitTest, tachoRollover) {
 
 
     testTachoTim.Instance->CNT = 0xFFFFFFFE;
-    HAL_GPIO_EXTI_Callback(GPIO_PIN_5);
+    edge(0);
     testTachoTim.Instance->CNT += 100000;
-    HAL_GPIO_EXTI_Callback(GPIO_PIN_5);
+    edge(0);
 
     goToTick(100);
 
@@ -193,11 +225,144 @@ TEST_F(TachoUnitTest, reverse_channels) {
     /* Get data from USB into array */
     EXPECT_READ_USB(ElementsAre(
         "Boot Unit Test\r",
-        "0.00, 0.00, 0.00, 0.00, 0.00, 976.66, 0x00000000\r",
-        "0.00, 0.00, 0.00, 0.00, 0.00, 226.83, 0x00000000\r",
-        "0.00, 0.00, 0.00, 0.00, 0.00, 147.95, 0x00000000\r",
-        "0.00, 0.00, 0.00, 0.00, 0.00, 122.12, 0x00000000\r"
+        "0.00, 0.00, 0.00, 0.00, 0.00, 434.78, 0x00000000\r",
+        "0.00, 0.00, 0.00, 0.00, 0.00, 183.49, 0x00000000\r",
+        "0.00, 0.00, 0.00, 0.00, 0.00, 141.84, 0x00000000\r",
+        "0.00, 0.00, 0.00, 0.00, 0.00, 119.76, 0x00000000\r"
     ));
 
     /* Memory leaks from VS/OS cleared by test runner */
-} 
\ No newline at end of file
+} 
+
+TEST_F(TachoUnitTest, captureOrExti) {
+    tachoInputInit(&testTachoTim, &testPrintTim);
+
+    /* On the latest PCB only PA3 and PA2 are TIM2 inputs. PB1, PA7 and PA6 are only on TIM3 (16 
+    ** bit) and PA4 isn't a timer input, so these are timestamped by the EXTI */
+    EXPECT_EQ(captureChannels[0], -1);
+    EXPECT_EQ(captureChannels[1], -1);
+    EXPECT_EQ(captureChannels[2], -1);
+    EXPECT_EQ(captureChannels[3], -1);
+    EXPECT_EQ(captureChannels[4], (int) TIM_CHANNEL_4);
+    EXPECT_EQ(captureChannels[5], (int) TIM_CHANNEL_3);
+
+    /* An EXTI line without a channel is ignored */
+    HAL_GPIO_EXTI_Callback(GPIO_PIN_5);
+    for (int i = 0; i < NUM_CHANNELS; i++) {
+        EXPECT_EQ(edges[i].swIdx, 0);
+    }
+}
+
+TEST_F(TachoUnitTest, exactFrequency) {
+    tachoInputInit(&testTachoTim, &testPrintTim);
+    tachoInputLoop(bootMsg);
+
+    /* Periods in us. Channels 4 and 5 are captured by the DMA, the others by the EXTI */
+    runEdges({1000, 2000, 500, 250, 125, 400}, 300);
+
+    EXPECT_READ_USB(ElementsAre(
+        "Boot Unit Test\r",
+        "1000.00, 500.00, 2000.00, 4000.00, 8000.00, 2500.00, 0x00000000\r",
+        "1000.00, 500.00, 2000.00, 4000.00, 8000.00, 2500.00, 0x00000000\r",
+        "1000.00, 500.00, 2000.00, 4000.00, 8000.00, 2500.00, 0x00000000\r"
+    ));
+}
+
+TEST_P(TachoUnitTest, maxEdgeRate) {
+    /* The main loop runs every tick (1 ms) in the tests. At most TACHO_EDGE_RING_LEN - 2 edges can
+    ** be timestamped between two runs */
+    static const uint32_t MAX_EDGES_PER_MS = TACHO_EDGE_RING_LEN - 2;
+    const uint32_t fastestPeriod = (1000 + MAX_EDGES_PER_MS - 1) / MAX_EDGES_PER_MS;
+    const uint32_t tooFastPeriod = 1000 / TACHO_EDGE_RING_LEN;
+
+    tachoInputInit(&testTachoTim, &testPrintTim);
+    tachoInputLoop(bootMsg);
+
+    vector<uint32_t> periods(NUM_CHANNELS, 0);
+    periods[GetParam()] = fastestPeriod;
+    runEdges(periods, 100);
+
+    EXPECT_EQ(edges[GetParam()].overruns, 0U);
+    EXPECT_FLOAT_EQ(freq[GetParam()], estCfg.tickHz / fastestPeriod);
+
+    /* Edges are lost when going faster. The channel restarts from the newest edge every time */
+    periods[GetParam()] = tooFastPeriod;
+    runEdges(periods, 200);
+
+    EXPECT_GT(edges[GetParam()].overruns, 90U);
+}
+
+TEST_F(TachoUnitTest, lowFrequency) {
+    tachoInputInit(&testTachoTim, &testPrintTim);
+    tachoInputLoop(bootMsg);
+
+    /* 0.4 Hz. The period is measured across several print periods */
+    runEdges({2500000, 0, 0, 0, 0, 0}, 10000);
+    EXPECT_FLOAT_EQ(freq[0], 0.4);
+
+    /* When the edges stop, it can at most be one period since the last edge (at 10 s) */
+    runEdges({0, 0, 0, 0, 0, 0}, 12600);
+    EXPECT_FLOAT_EQ(freq[0], 1 / 2.6);
+
+    /* And 0 after the timeout */
+    runEdges({0, 0, 0, 0, 0, 0}, 20100);
+    EXPECT_EQ(freq[0], 0);
+}
+
+TEST_F(TachoUnitTest, estimatorModes) {
+    tachoInputInit(&testTachoTim, &testPrintTim);
+    tachoInputLoop(bootMsg);
+
+    /* 3333.33 Hz. The edge aligned window resolves it fully, whereas counting the edges in the
+    ** print period is off by one edge */
+    runEdges({300, 300, 0, 0, 0, 0}, 300);
+    EXPECT_FLOAT_EQ(freq[0], 1000000.0 / 300);
+
+    writeBoardMessage("mode count 2000\n");
+    runEdges({300, 300, 0, 0, 0, 0}, 600);
+    EXPECT_THAT(freq[0], AnyOf(FloatEq(3330), FloatEq(3340)));
+
+    writeBoardMessage("mode\n");
+    EXPECT_FLUSH_USB(Contains("Mode: count, timeout 2000 ms, ppr 1 1 1 1 1 1\r"));
+
+    /* Port 2 at 4 pulses per revolution */
+    writeBoardMessage("mode auto 10000\n");
+    writeBoardMessage("ppr 2 4\n");
+    runEdges({300, 300, 0, 0, 0, 0}, 900);
+    EXPECT_FLOAT_EQ(freq[0], 1000000.0 / 300);
+    EXPECT_FLOAT_EQ(freq[1], 1000000.0 / 300 / 4);
+
+    /* Unknown mode, timeout out of range and invalid port */
+    writeBoardMessage("mode fast 1000\n");
+    EXPECT_FLUSH_USB(Contains("MISREAD: mode fast 1000\r"));
+    writeBoardMessage("mode auto 50\n");
+    EXPECT_FLUSH_USB(Contains("MISREAD: mode auto 50\r"));
+    writeBoardMessage("ppr 7 1\n");
+    EXPECT_FLUSH_USB(Contains("MISREAD: ppr 7 1\r"));
+}
+
+TEST_F(TachoUnitTest, periodStats) {
+    tachoInputInit(&testTachoTim, &testPrintTim);
+    tachoInputLoop(bootMsg);
+
+    /* Alternating 900 and 1100 us periods on port 1, i.e. 1 kHz with 100 us of jitter */
+    for (uint32_t us = 0; tickCounter < 300; us += (us % 2000 == 0) ? 900 : 1100) {
+        testTachoTim.Instance->CNT = us;
+        edge(0);
+        goToTick(us / 1000);
+    }
+    EXPECT_FLOAT_EQ(freq[0], 1000);
+
+    const TachoPeriodStats* s = tachoEstStats(&estimators[0]);
+    EXPECT_EQ(s->count, 100U);
+    EXPECT_EQ(s->min, 900U);
+    EXPECT_EQ(s->max, 1100U);
+    EXPECT_FLOAT_EQ(s->mean, 1000);
+    EXPECT_NEAR(s->stddev, 100.5, 0.1);
+
+    writeBoardMessage("stats\n");
+    EXPECT_FLUSH_USB(IsSupersetOf({
+        "Port 1: 100 periods, min 900.0, max 1100.0, mean 1000.0, stddev 100.50 us\r",
+        "Port 2: 0 periods, min 0.0, max 0.0, mean 0.0, stddev 0.00 us\r"
+    }));
+}
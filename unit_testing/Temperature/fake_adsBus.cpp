@@ -0,0 +1,143 @@
+/*!
+** @file   fake_adsBus.cpp
+** @brief  Fake of the ADS1120 SPI DMA bus, simulating the chips behind it
+** @date   18/10/2026
+**
+** Each simulated chip decodes the register writes and START command in the frames it receives,
+** and returns the result of its last conversion at the start of the next frame. The DRDY and DMA
+** complete interrupts are raised by the test through fakeAdsConvert and fakeAdsBusComplete.
+*/
+
+#include <string.h>
+
+#include "adsAcquisition.h"
+#include "fake_adsBus.h"
+
+using namespace std;
+
+/***************************************************************************************************
+** TYPEDEFS
+***************************************************************************************************/
+
+typedef struct FakeAdsChip {
+    int16_t codes[ACQ_NO_INPUTS];
+    int16_t output;         // Result of the last conversion
+    AcqInput input;         // Input selected by the last register write
+    bool isConverting;
+} FakeAdsChip;
+
+/***************************************************************************************************
+** PRIVATE VARIABLES
+***************************************************************************************************/
+
+static FakeAdsChip chips[ACQ_MAX_CHIPS];
+
+static bool inFlight = false;
+static int selected  = -1;
+static const uint8_t* txBuf = NULL;
+static uint8_t* rxBuf       = NULL;
+static uint16_t length      = 0;
+
+static vector<int> transferLog;
+static int collisions = 0;
+
+/***************************************************************************************************
+** FAKED FUNCTION DEFINITIONS
+***************************************************************************************************/
+
+void adsBusInit(SPI_HandleTypeDef* hspi) {
+    memset(chips, 0, sizeof(chips));
+    inFlight   = false;
+    selected   = -1;
+    collisions = 0;
+    transferLog.clear();
+}
+
+void adsBusAddChip(int chip, StmGpio cs, GPIO_TypeDef* drdyPort, uint16_t drdyPin) {}
+
+int adsBusTransfer(int chip, const uint8_t* tx, uint8_t* rx, uint16_t len) {
+    if (inFlight) {
+        collisions++;
+        return -1;
+    }
+
+    inFlight = true;
+    selected = chip;
+    txBuf    = tx;
+    rxBuf    = rx;
+    length   = len;
+    transferLog.push_back(chip);
+    return 0;
+}
+
+void adsBusRelease(int chip) {
+    if (chip == selected) {
+        selected = -1;
+    }
+}
+
+/***************************************************************************************************
+** FAKE CONTROL FUNCTIONS
+***************************************************************************************************/
+
+void fakeAdsSetCodes(int chip, int16_t codeA, int16_t codeB, int16_t codeInternal) {
+    chips[chip].codes[ACQ_CH_A]     = codeA;
+    chips[chip].codes[ACQ_CH_B]     = codeB;
+    chips[chip].codes[ACQ_INTERNAL] = codeInternal;
+}
+
+void fakeAdsConvert(int chip) {
+    FakeAdsChip* c = &chips[chip];
+    if (!c->isConverting) {
+        return;
+    }
+
+    c->output       = c->codes[c->input];
+    c->isConverting = false;
+    acqDataReady(chip);
+}
+
+bool fakeAdsBusComplete() {
+    if (!inFlight || length < ACQ_FRAME_LEN) {
+        return false;
+    }
+
+    FakeAdsChip* c = &chips[selected];
+    rxBuf[0]       = (uint8_t)(c->output >> 8);
+    rxBuf[1]       = (uint8_t)c->output;
+    memset(&rxBuf[2], 0, length - 2);
+
+    // WREG to registers 0 and 1, followed by START
+    if (txBuf[2] == 0x41) {
+        if (txBuf[4] & 0x02) {
+            c->input = ACQ_INTERNAL;
+        }
+        else {
+            c->input = ((txBuf[3] >> 4) == 0x5) ? ACQ_CH_B : ACQ_CH_A;
+        }
+    }
+    if (txBuf[5] == 0x08) {
+        c->isConverting = true;
+    }
+
+    inFlight = false;
+    acqTransferComplete();
+    return true;
+}
+
+void fakeAdsBusRun() {
+    while (fakeAdsBusComplete()) {
+    }
+}
+
+bool fakeAdsBusIsBusy() {
+    return inFlight;
+}
+
+vector<int>& fakeAdsBusLog() {
+    return transferLog;
+}
+
+int fakeAdsBusCollisions() {
+    return collisions;
+}
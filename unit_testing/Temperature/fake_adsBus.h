@@ -0,0 +1,40 @@
+/*!
+** @file   fake_adsBus.h
+** @brief  Fake of the ADS1120 SPI DMA bus, simulating the chips behind it
+** @date   18/10/2026
+*/
+
+#ifndef FAKE_ADS_BUS_H_
+#define FAKE_ADS_BUS_H_
+
+#include <stdint.h>
+#include <vector>
+
+#include "adsBus.h"
+
+/***************************************************************************************************
+** PUBLIC FUNCTION DECLARATIONS
+***************************************************************************************************/
+
+/* Sets the conversion results a chip returns for channel A, channel B and its internal sensor */
+void fakeAdsSetCodes(int chip, int16_t codeA, int16_t codeB, int16_t codeInternal);
+
+/* Finishes the conversion in progress on a chip (if any) and raises its DRDY interrupt */
+void fakeAdsConvert(int chip);
+
+/* Completes the transfer in flight, if any. Returns false if the bus was idle */
+bool fakeAdsBusComplete();
+
+/* Completes transfers until the bus is idle */
+void fakeAdsBusRun();
+
+/* True if a transfer is in flight */
+bool fakeAdsBusIsBusy();
+
+/* Chips served, in the order their transfers were started */
+std::vector<int>& fakeAdsBusLog();
+
+/* Number of transfers started while another one was in flight. Must always be 0 */
+int fakeAdsBusCollisions();
+
+#endif /* FAKE_ADS_BUS_H_ */
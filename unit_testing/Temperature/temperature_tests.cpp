@@ -8,6 +8,7 @@
 
 extern "C" {
     uint32_t _FlashAddrCal = 0;
+    uint32_t _FlashAddrCalLegacy = 0;
 }
 
 #include "caBoardUnitTests.h"
@@ -18,16 +19,25 @@ extern "C" {
 #include "fake_stm32xxxx_hal.h"
 #include "fake_USBprint.h"
 #include "fake_ADS1120.h"
+#include "fake_adsBus.h"
+#include "fake_flashWriter.h"
 
 /* Real supporting units */
 #include "CAProtocol.c"
 #include "CAProtocolStm.c"
 #include "crc.c"
+#include "flashRecord.c"
+#include "flashWriter.c"
 
 /* UUT */
+#include "adsAcquisition.c"
+#include "thermocouple.c"
 #include "Temperature.c"
 
 using namespace std;
+using ::testing::Contains;
+using ::testing::Each;
+using ::testing::ElementsAre;
 
 /***************************************************************************************************
 ** TEST FIXTURES
@@ -39,10 +49,19 @@ class TemperatureBoardTest: public CaBoardUnitTest
         /*******************************************************************************************
         ** METHODS
         *******************************************************************************************/
-        TemperatureBoardTest() : CaBoardUnitTest(&LoopTemperature, Temperature, {LATEST_MAJOR, LATEST_MINOR}) {}
+        TemperatureBoardTest() : CaBoardUnitTest(&LoopTemperature, Temperature, {LATEST_MAJOR, LATEST_MINOR}) {
+            fakeFlashWriterInit();
+        }
 
         void simTick() {
-            LoopTemperature(bootMsg);
+            /* The chips convert much faster than on hardware, so every tick delivers results */
+            for (int i = 0; i < NO_SPI_DEVICES; i++) {
+                fakeAdsConvert(i);
+            }
+            fakeFlashTick([this] {
+                fakeAdsBusRun();
+                LoopTemperature(bootMsg);
+            });
         }
 
         /*******************************************************************************************
@@ -72,10 +91,172 @@ class TemperatureBoardTest: public CaBoardUnitTest
 TEST_F(TemperatureBoardTest, goldenPath) {
     sst.boundInit();
     for(int i = 0; i < NO_SPI_DEVICES; i++) {
-        setTemp(&ads1120[i], 24.00, 26.00, 25.00);
+        /* 0 mV and 1 mV on the thermocouples, 25 C at the cold junction */
+        fakeAdsSetCodes(i, 0, 512, 25 * 32 * 4);
+    }
+
+    goldenPathTest(sst, "24.99, 49.48, 24.99, 49.48, 24.99, 49.48, 24.99, 49.48, 24.99, 49.48, 25.00, 0x00000000\r");
+}
+
+TEST(ThermocoupleTest, nistReference) {
+    /* Points from the NIST ITS-90 reference tables, in C and mV with the reference junction at 0 C */
+    struct {
+        TcType type;
+        float temp;
+        float mV;
+    } points[] = {
+        {TC_TYPE_K, -200, -5.891}, {TC_TYPE_K, -100, -3.554}, {TC_TYPE_K, 100, 4.096},
+        {TC_TYPE_K, 500, 20.644},  {TC_TYPE_K, 1000, 41.276}, {TC_TYPE_K, 1372, 54.886},
+        {TC_TYPE_J, -200, -7.890}, {TC_TYPE_J, 100, 5.269},   {TC_TYPE_J, 760, 42.919},
+        {TC_TYPE_J, 1200, 69.553}, {TC_TYPE_N, -200, -3.990}, {TC_TYPE_N, 100, 2.774},
+        {TC_TYPE_N, 1000, 36.256}, {TC_TYPE_N, 1300, 47.513}, {TC_TYPE_T, -200, -5.603},
+        {TC_TYPE_T, -100, -3.379}, {TC_TYPE_T, 200, 9.288},   {TC_TYPE_T, 400, 20.872},
+    };
+
+    for (auto& p : points) {
+        EXPECT_NEAR(tcVoltage(p.type, p.temp), p.mV, 0.002) << "Type " << p.type << " at " << p.temp;
+        EXPECT_NEAR(tcTemperature(p.type, p.mV), p.temp, 0.1) << "Type " << p.type << " at " << p.mV;
     }
+}
+
+TEST(ThermocoupleTest, coldJunction) {
+    /* Type K at 500 C gives 20.644 mV, of which 1.000 mV is lost to a cold junction at 25 C */
+    EXPECT_NEAR(tcCompensate(TC_TYPE_K, 20.644 - 1.000, 25.0), 500.0, 0.1);
+    EXPECT_NEAR(tcCompensate(TC_TYPE_J, 0.0, 40.0), 40.0, 0.05);
+
+    EXPECT_EQ(tcTypeFromSensitivity(TYPE_K_DELTA), TC_TYPE_K);
+    EXPECT_EQ(tcTypeFromSensitivity(TYPE_J_DELTA), TC_TYPE_J);
+    EXPECT_EQ(tcTypeFromSensitivity(TYPE_N_DELTA), TC_TYPE_N);
+    EXPECT_EQ(tcTypeFromSensitivity(TYPE_T_DELTA), TC_TYPE_T);
+    EXPECT_EQ(tcTypeFromSensitivity(0.00005), TC_TYPE_UNKNOWN);
+    EXPECT_TRUE(isnan(tcTemperature(TC_TYPE_UNKNOWN, 1.0)));
+}
+
+TEST_F(TemperatureBoardTest, interleavedDrdy) {
+    sst.boundInit();
+    fakeAdsBusRun();    // Frames starting the first conversions
+    EXPECT_EQ(fakeAdsBusLog(), vector<int>({0, 1, 2, 3, 4}));
+    fakeAdsBusLog().clear();
+
+    /* Only one transfer at a time, the other chips queue behind it */
+    fakeAdsConvert(3);
+    fakeAdsConvert(0);
+    fakeAdsConvert(4);
+    EXPECT_TRUE(fakeAdsBusIsBusy());
+    EXPECT_EQ(fakeAdsBusLog(), vector<int>({3}));
+
+    /* Served round robin from the last chip served */
+    fakeAdsBusRun();
+    EXPECT_EQ(fakeAdsBusLog(), vector<int>({3, 4, 0}));
+    EXPECT_EQ(fakeAdsBusCollisions(), 0);
+
+    AcqResults res;
+    acqGetResults(&res);
+    EXPECT_EQ(res.count[0][ACQ_INTERNAL], 1U);
+    EXPECT_EQ(res.count[1][ACQ_INTERNAL], 0U);
+    EXPECT_EQ(res.count[3][ACQ_INTERNAL], 1U);
+    EXPECT_EQ(res.count[4][ACQ_INTERNAL], 1U);
+
+    /* A DRDY arriving during a transfer of another chip is not lost */
+    fakeAdsSetCodes(1, 100, 200, 300);
+    fakeAdsConvert(2);
+    fakeAdsConvert(1);
+    fakeAdsBusRun();
+    for (int i = 0; i < 2; i++) {
+        fakeAdsConvert(1);
+        fakeAdsBusRun();
+    }
+    acqGetResults(&res);
+    EXPECT_EQ(res.code[1][ACQ_INTERNAL], 300);
+    EXPECT_EQ(res.code[1][ACQ_CH_A], 100);
+    EXPECT_EQ(res.code[1][ACQ_CH_B], 200);
+    EXPECT_EQ(res.count[2][ACQ_INTERNAL], 1U);
+    EXPECT_EQ(fakeAdsBusCollisions(), 0);
+}
+
+TEST_F(TemperatureBoardTest, modeCommand) {
+    sst.boundInit();
+    for(int i = 0; i < NO_SPI_DEVICES; i++) {
+        fakeAdsSetCodes(i, 0, 512, 25 * 32 * 4);
+    }
+    simTicks(200);
+
+    /* Ports 1 and 2 at 100 Hz, averaged */
+    writeBoardMessage("mode 1200 10 1 0x003\n");
+    simTicks(20);
+    (void)hostUSBread(true);
+    simTicks(10);
+    EXPECT_FLUSH_USB(ElementsAre("24.99, 49.48, nan, nan, nan, nan, nan, nan, nan, nan, 25.00, 0x00000000\r"));
+
+    /* Only the chip measuring ports 1 and 2 is read, in turbo mode at 600 SPS */
+    fakeAdsBusLog().clear();
+    simTicks(10);
+    EXPECT_THAT(fakeAdsBusLog(), Each(0));
+    EXPECT_EQ(chips[0].rateBits, (5 << 5) | (2 << 3));
+
+    writeBoardMessage("mode\n");
+    EXPECT_FLUSH_USB(Contains("Mode: 1200 SPS, 10 ms, average 1, ports 0x003\r"));
+
+    /* Unsupported data rate, period and ports */
+    writeBoardMessage("mode 100 10 0\n");
+    EXPECT_FLUSH_USB(Contains("MISREAD: mode 100 10 0\r"));
+    writeBoardMessage("mode 45 5 0\n");
+    EXPECT_FLUSH_USB(Contains("MISREAD: mode 45 5 0\r"));
+    writeBoardMessage("mode 45 100 0 0x400\n");
+    EXPECT_FLUSH_USB(Contains("MISREAD: mode 45 100 0 0x400\r"));
+
+    /* Back to the defaults, which are stored in FLASH */
+    writeBoardMessage("mode 45 100 0\n");
+    simTicks(200);
+    (void)hostUSBread(true);
+    simTicks(100);
+    EXPECT_FLUSH_USB(ElementsAre("24.99, 49.48, 24.99, 49.48, 24.99, 49.48, 24.99, 49.48, 24.99, 49.48, 25.00, 0x00000000\r"));
+
+    /* Written by the loop in the background */
+    TempCalibration stored;
+    int len = flashWriterRead((uint32_t)FLASH_ADDR_CAL, &stored, sizeof(stored));
+    ASSERT_EQ(len, (int)sizeof(stored));
+    EXPECT_EQ(stored.settings.dataRate, 45u);
+    EXPECT_EQ(stored.settings.printMs, 100u);
+}
+
+TEST_F(TemperatureBoardTest, calibrationMoved) {
+    /* Thermocouple calibrations written by a firmware which kept them in the 128K sector */
+    float legacy[NO_SPI_DEVICES * 2][2] = {{1.5f, 2.5f}};
+    ASSERT_EQ(writeToFlashCRC(&hcrc, (uint32_t)FLASH_ADDR_CAL_LEGACY, (uint8_t*)legacy,
+                              sizeof(legacy)), 0);
+
+    sst.boundInit();
+    EXPECT_FLOAT_EQ(cal.portCalVal[0][0], 1.5f);
+    EXPECT_EQ(cal.settings.dataRate, ACQ_DEFAULT_RATE);
+
+    /* Moved to the calibration sector once, by the loop */
+    EXPECT_TRUE(flashWriterIsBusy());
+    simTicks(50);
+    EXPECT_FALSE(flashWriterIsBusy());
+    TempCalibration stored;
+    ASSERT_EQ(flashWriterRead((uint32_t)FLASH_ADDR_CAL, &stored, sizeof(stored)), (int)sizeof(stored));
+    EXPECT_FLOAT_EQ(stored.portCalVal[0][1], 2.5f);
+    EXPECT_EQ(stored.settings.dataRate, ACQ_DEFAULT_RATE);
+}
+
+TEST_F(TemperatureBoardTest, busLock) {
+    sst.boundInit();
+    fakeAdsBusRun();
+
+    /* Cannot take the bus while a transfer is in flight */
+    fakeAdsConvert(1);
+    EXPECT_FALSE(acqLock());
+    fakeAdsBusComplete();
+    EXPECT_TRUE(acqLock());
 
-    goldenPathTest(sst, "24.00, 26.00, 24.00, 26.00, 24.00, 26.00, 24.00, 26.00, 24.00, 26.00, 25.00, 0x00000000\r");
+    /* DRDYs are registered while locked, and served when unlocking */
+    fakeAdsConvert(2);
+    EXPECT_FALSE(fakeAdsBusIsBusy());
+    acqUnlock();
+    EXPECT_TRUE(fakeAdsBusIsBusy());
+    fakeAdsBusRun();
+    EXPECT_EQ(fakeAdsBusCollisions(), 0);
 }
 
 TEST_F(TemperatureBoardTest, incorrectBoard) {